@@ -1,6 +1,7 @@
 #pragma once
 
 #include "general.h"
+#include "memory_arena.h"
 
 #include <stdlib.h>
 
@@ -68,6 +69,10 @@ struct Array {
     int allocated = 0;
     int count = 0;
 
+    // If set, storage comes from here instead of the heap, and outgrown
+    // storage is left behind rather than freed.
+    Memory_Arena *arena = NULL;
+
     ~Array();
 
     void reserve(int size);
@@ -79,14 +84,19 @@ struct Array {
     void unordered_remove_by_index(int n);
     
     inline void deallocate() {
-        if (data) {
-            free(data);
-            data = NULL;
-        }
+        if (data && !arena) tracked_free(data);
+        data = NULL;
 
         allocated = 0;
         count = 0;
     }
+
+    // Empties the array and takes its storage from the arena from now on.
+    // Call it again after the arena is reset: the old storage is gone.
+    inline void use_arena(Memory_Arena *_arena) {
+        deallocate();
+        arena = _arena;
+    }
     
     inline void ordered_remove_by_value(T const &value) {
         int index = find(value);
@@ -106,10 +116,8 @@ struct Array {
 
 template <typename T>
 inline Array <T>::~Array() {
-    if (data) {
-        free(data);
-        data = NULL;
-    }
+    if (data && !arena) tracked_free(data);
+    data = NULL;
 }
 
 template <typename T>
@@ -122,11 +130,14 @@ inline void Array <T>::reserve(int size) {
     int new_bytes = new_allocated * sizeof(T);
     int old_bytes = allocated * sizeof(T);
 
-    void *new_data = malloc(new_bytes);
-    
+    void *new_data;
+    if (arena) new_data = arena->allocate_aligned(new_bytes, Max(alignof(T), MEMORY_ARENA_DEFAULT_ALIGNMENT));
+    else       new_data = tracked_malloc(new_bytes, ALLOCATION_TAG_ARRAYS);
+    if (!new_data) out_of_memory(new_bytes);
+
     if (data) {
         memcpy(new_data, data, old_bytes);
-        free(data);
+        if (!arena) tracked_free(data);
     }
 
     data = (T *)new_data;
@@ -141,7 +152,8 @@ inline void Array <T>::resize(int size) {
 
 template <typename T>
 inline void Array <T>::add(T const &item) {
-    reserve(count+1);
+    // Grow geometrically, so a run of adds costs amortized O(1) each.
+    if (count >= allocated) reserve(Max(allocated * 2, count + 1));
     data[count] = item;
     count++;
 }
@@ -190,7 +202,8 @@ inline T &Array <T>::operator[](int index) {
 
 template <typename T>
 inline T *Array <T>::copy_to_array() {
-    T *result = (T *)malloc(count * sizeof(T));
+    T *result = (T *)tracked_malloc(count * sizeof(T), ALLOCATION_TAG_ARRAYS);
+    if (!result) out_of_memory(count * sizeof(T));
     memcpy(result, data, count * sizeof(T));
     return result;
 }
@@ -6,12 +6,15 @@ static SDL_AudioDeviceID audio_device;
 static Array <Sound *> current_sounds;
 
 static void SDLCALL audio_callback(void *userdata, Uint8 *stream, int len) {
+    set_profile_thread_name("Audio");
+    profile_zone("audio_callback");
+
     SDL_memset(stream, 0, len);
 
     for (int i = 0; i < current_sounds.count; i++) {
         Sound *sound = current_sounds[i];
-        if (!sound || !sound->playing)
-            continue;
+        if (!sound || !sound->playing || !sound->buffer)
+            continue; // No buffer: still loading, and silent till then.
 
         Uint32 remaining = sound->length - sound->position;
         Uint32 to_copy = (remaining > (Uint32)len) ? (Uint32)len : remaining;
@@ -70,103 +73,104 @@ void destroy_audio() {
     }
 }
 
-Sound *load_sound(char *filepath, bool looping) {
-    SDL_AudioSpec spec;
-    Uint8 *buf;
-    Uint32 len;
-
-    if (!SDL_LoadWAV(filepath, &spec, &buf, &len)) {
-        logprintf("Failed to load sound %s: %s\n", filepath, SDL_GetError());
-        return NULL;
-    }
-
-    // --- Convert to match device format ---
-    SDL_AudioCVT cvt;
-    if (SDL_BuildAudioCVT(&cvt,
-                          spec.format, spec.channels, spec.freq,
-                          AUDIO_F32, 2, 48000) < 0) {
-        logprintf("Failed to build audio CVT for %s: %s\n", filepath, SDL_GetError());
-        SDL_FreeWAV(buf);
-        return NULL;
-    }
-
-    cvt.len = len;
-    cvt.buf = (Uint8 *)SDL_malloc(len * cvt.len_mult);
-    SDL_memcpy(cvt.buf, buf, len);
-    SDL_FreeWAV(buf);
-
-    if (SDL_ConvertAudio(&cvt) < 0) {
-        logprintf("Audio conversion failed for %s: %s\n", filepath, SDL_GetError());
-        SDL_free(cvt.buf);
-        return NULL;
-    }
+Sound *make_sound(bool looping) {
+    allocation_tag(ALLOCATION_TAG_AUDIO);
 
     Sound *sound = new Sound();
     sound->spec.format = AUDIO_F32;
     sound->spec.channels = 2;
     sound->spec.freq = 48000;
-    sound->buffer = cvt.buf;
-    sound->length = cvt.len_cvt;
+    sound->buffer = NULL;
+    sound->length = 0;
     sound->position = 0;
     sound->playing = false;
     sound->looping = looping;
     sound->volume  = 0.5f;
-
-    logprintf("Loaded sound: %s len=%u format=%u\n",
-              filepath, sound->length, sound->spec.format);
-
     return sound;
 }
 
-Sound *load_sound_from_memory(s64 data_size, u8 *data, bool looping) {
-    if (!data || data_size <= 0) return NULL;
+bool decode_sound(SDL_RWops *rw, char *label, u8 **buffer, u32 *length) {
+    allocation_tag(ALLOCATION_TAG_AUDIO);
 
-    SDL_RWops *rw = SDL_RWFromMem(data, (int)data_size);
     if (!rw) {
-        logprintf("Failed to create SDL_RWops from memory: %s\n", SDL_GetError());
-        return NULL;
+        logprintf("Failed to open sound %s: %s\n", label, SDL_GetError());
+        return false;
     }
 
     SDL_AudioSpec spec;
     Uint8 *buf;
     Uint32 len;
 
-    if (!SDL_LoadWAV_RW(rw, 1, &spec, &buf, &len)) {
-        logprintf("Failed to load WAV from memory: %s\n", SDL_GetError());
-        SDL_RWclose(rw);
-        return NULL;
+    if (!SDL_LoadWAV_RW(rw, 1, &spec, &buf, &len)) { // Closes rw either way.
+        logprintf("Failed to load sound %s: %s\n", label, SDL_GetError());
+        return false;
     }
 
+    // --- Convert to match device format ---
     SDL_AudioCVT cvt;
     if (SDL_BuildAudioCVT(&cvt,
                           spec.format, spec.channels, spec.freq,
                           AUDIO_F32, 2, 48000) < 0) {
-        logprintf("Failed to build audio CVT for memory WAV: %s\n", SDL_GetError());
+        logprintf("Failed to build audio CVT for %s: %s\n", label, SDL_GetError());
         SDL_FreeWAV(buf);
-        return NULL;
+        return false;
     }
 
     cvt.len = len;
-    cvt.buf = (Uint8 *)SDL_malloc(len * cvt.len_mult);
+    cvt.buf = (Uint8 *)tracked_malloc(len * cvt.len_mult, ALLOCATION_TAG_AUDIO);
+    if (!cvt.buf) {
+        logprintf("Out of memory converting %s.\n", label);
+        SDL_FreeWAV(buf);
+        return false;
+    }
     SDL_memcpy(cvt.buf, buf, len);
     SDL_FreeWAV(buf);
 
     if (SDL_ConvertAudio(&cvt) < 0) {
-        logprintf("Audio conversion failed for memory WAV: %s\n", SDL_GetError());
-        SDL_free(cvt.buf);
-        return NULL;
+        logprintf("Audio conversion failed for %s: %s\n", label, SDL_GetError());
+        tracked_free(cvt.buf);
+        return false;
     }
 
-    Sound *sound = new Sound();
-    sound->spec.format = AUDIO_F32;
-    sound->spec.channels = 2;
-    sound->spec.freq = 48000;
-    sound->buffer = cvt.buf;
-    sound->length = cvt.len_cvt;
+    *buffer = cvt.buf;
+    *length = cvt.len_cvt;
+    return true;
+}
+
+void set_sound_data(Sound *sound, u8 *buffer, u32 length) {
+    SDL_LockAudioDevice(audio_device);
+    sound->buffer   = buffer;
+    sound->length   = length;
     sound->position = 0;
-    sound->playing = false;
-    sound->looping = looping;
-    sound->volume  = 0.5f;
+    SDL_UnlockAudioDevice(audio_device);
+}
+
+Sound *load_sound(char *filepath, bool looping) {
+    u8 *buffer;
+    u32 length;
+    if (!decode_sound(SDL_RWFromFile(filepath, "rb"), filepath, &buffer, &length)) return NULL;
+
+    Sound *sound = make_sound(looping);
+    sound->buffer = buffer;
+    sound->length = length;
+
+    logprintf("Loaded sound: %s len=%u format=%u\n",
+              filepath, sound->length, sound->spec.format);
+
+    return sound;
+}
+
+Sound *load_sound_from_memory(s64 data_size, u8 *data, bool looping) {
+    if (!data || data_size <= 0) return NULL;
+
+    u8 *buffer;
+    u32 length;
+    SDL_RWops *rw = SDL_RWFromConstMem(data, (int)data_size); // May be a read-only package mapping.
+    if (!decode_sound(rw, "from memory", &buffer, &length)) return NULL;
+
+    Sound *sound = make_sound(looping);
+    sound->buffer = buffer;
+    sound->length = length;
 
     logprintf("Loaded sound from memory, len=%u format=%u\n", sound->length, sound->spec.format);
     return sound;
@@ -174,6 +178,8 @@ Sound *load_sound_from_memory(s64 data_size, u8 *data, bool looping) {
 
 void play_sound(Sound *sound) {
     if (!sound) return;
+
+    allocation_tag(ALLOCATION_TAG_AUDIO);
     
     sound->playing = true;
     sound->position = 0;
@@ -205,7 +211,7 @@ void free_sound(Sound *sound) {
     if (!sound) return;
     if (!sound->buffer) return;
     
-    SDL_free(sound->buffer);
+    tracked_free(sound->buffer);
 }
 
 void update_volumes() {
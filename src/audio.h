@@ -14,6 +14,13 @@ bool init_audio();
 void destroy_audio();
 
 Sound *load_sound(char *filepath, bool looping);
+Sound *make_sound(bool looping); // Silent until it is given data.
+
+// Reads a WAV and converts it to the device's format, closing rw. Safe to
+// call off the main thread.
+bool decode_sound(SDL_RWops *rw, char *label, u8 **buffer, u32 *length);
+void set_sound_data(Sound *sound, u8 *buffer, u32 length);
+
 Sound *load_sound_from_memory(s64 data_size, u8 *data, bool looping);
 void play_sound(Sound *sound);
 void stop_sound(Sound *sound);
@@ -0,0 +1,2135 @@
+#include "main.h"
+#include "benchmarks.h"
+#include "world.h"
+#include "entity.h"
+#include "tilemap.h"
+#include "broadphase.h"
+#include "headless.h"
+#include "jobs.h"
+#include "particles.h"
+#include "frame_pacer.h"
+#include "camera.h"
+#include "rendering.h"
+#include "render_queue.h"
+#include "main_menu.h"
+#include "resource_manager.h"
+#include "audio.h"
+
+#include <stb_image.h>
+#include <stb_image_write.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <float.h>
+
+struct Benchmark_Options {
+    int count = 0; // 0 means the benchmark's own default,
+    int ticks = 0; // for both of these.
+    u64 seed = 1;
+
+    char *golden_directory = NULL; // For the frames benchmark.
+    bool write_golden = false;
+};
+
+static void parse_benchmark_options(Benchmark_Options *options, int argc, char *argv[]) {
+    for (int i = 1; i < argc; i++) {
+        char *arg = argv[i];
+        bool has_value = i < argc - 1;
+
+        if (strings_match(arg, "-count") && has_value) {
+            options->count = atoi(argv[++i]);
+        } else if (strings_match(arg, "-ticks") && has_value) {
+            options->ticks = atoi(argv[++i]);
+        } else if (strings_match(arg, "-seed") && has_value) {
+            options->seed = strtoull(argv[++i], NULL, 10);
+        } else if (strings_match(arg, "-golden") && has_value) {
+            options->golden_directory = argv[++i];
+        } else if (strings_match(arg, "-write_golden")) {
+            options->write_golden = true;
+        }
+    }
+
+    options->count = Max(options->count, 0);
+    options->ticks = Max(options->ticks, 0);
+}
+
+static World *make_benchmark_world(int level_width, u64 seed) {
+    World *world = new World();
+    init_world(world, v2i(level_width, 18));
+    generate_random_level(world, level_width, 18, seed);
+    return world;
+}
+
+static void free_benchmark_world(World *world) {
+    destroy_world(world);
+    delete world;
+}
+
+//
+// pools: the enemy step swept over the world pool's hot fields (structure of
+// arrays), over the same enemies as whole structs in a pool (array of
+// structures, where every field of every entity sits in the struct), and
+// over such structs allocated one at a time, the way entities used to be.
+// All three run step_enemy, so only the layout differs.
+//
+
+// An enemy with its hot fields inline, as Enemy was before they moved out.
+struct Aos_Enemy : public Entity {
+    Vector2 position;
+    float speed;
+    float radius;
+    u8 flags;
+    float time_since_last_projectile;
+    float time_between_projectiles;
+};
+
+static void step_aos_enemy(World *world, Aos_Enemy *enemy, float dt) {
+    Vector2 projectile_position;
+    step_enemy(world, &enemy->position, enemy->radius, enemy->speed, &enemy->flags,
+               &enemy->time_since_last_projectile, enemy->time_between_projectiles, dt, &projectile_position);
+}
+
+static void step_soa_enemies(World *world, float dt) {
+    Pool <Enemy, Enemy_Fields> *pool = &world->by_type._Enemy;
+    for (int index = 0; index < pool->num_slots; index++) {
+        auto *block = pool->blocks.data[index / POOL_BLOCK_SIZE];
+        int slot = index % POOL_BLOCK_SIZE;
+        if (!block->occupied[slot]) continue;
+
+        Enemy_Fields *fields = &block->hot;
+        Vector2 projectile_position;
+        step_enemy(world, &fields->position[slot], fields->radius[slot], fields->speed[slot], &fields->flags[slot],
+                   &fields->time_since_last_projectile[slot], fields->time_between_projectiles[slot], dt, &projectile_position);
+    }
+}
+
+static int benchmark_pools(Benchmark_Options *options) {
+    if (!options->count) options->count = 10000;
+    if (!options->ticks) options->ticks = 600;
+    
+    const float dt = 1.0f / 120.0f;
+
+    World *world = make_benchmark_world(Max(options->count / 8, 64), options->seed);
+    defer { free_benchmark_world(world); };
+
+    Random_State random;
+    seed_random(&random, options->seed);
+
+    // Everyone walks along the ground and never shoots, so every run does
+    // exactly the same work and ends in the same place.
+    for (int i = 0; i < options->count; i++) {
+        Enemy *enemy = make_enemy(world);
+        enemy->color = v4(0, 0, 1, 1);
+
+        int slot;
+        Enemy_Fields *fields = get_fields(enemy, &slot);
+        fields->position[slot] = v2(1.5f + random_float(&random) * (world->size.x - 3.0f), 1.5f);
+        fields->flags[slot]    = (random_u32(&random) & 1) ? MOVER_FACING_RIGHT : 0;
+        fields->time_between_projectiles[slot] = 1e9f;
+    }
+
+    Pool <Aos_Enemy> aos_pool;
+    Array <Aos_Enemy *> heap_enemies;
+    Array <Pickup *> heap_padding;
+    defer {
+        aos_pool.deallocate();
+        for (Aos_Enemy *enemy : heap_enemies) delete enemy;
+        for (Pickup *pickup : heap_padding) delete pickup;
+    };
+
+    for (Enemy *enemy : world->by_type._Enemy) {
+        int slot;
+        Enemy_Fields *fields = get_fields(enemy, &slot);
+
+        Aos_Enemy copy;
+        *(Entity *)&copy = *enemy;
+        copy.position = fields->position[slot];
+        copy.speed    = fields->speed[slot];
+        copy.radius   = fields->radius[slot];
+        copy.flags    = fields->flags[slot];
+        copy.time_since_last_projectile = fields->time_since_last_projectile[slot];
+        copy.time_between_projectiles   = fields->time_between_projectiles[slot];
+
+        *aos_pool.add() = copy;
+        heap_enemies.add(new Aos_Enemy(copy));
+        heap_padding.add(new Pickup()); // Levels interleave enemies with pickups.
+    }
+
+    // A heap that has been running for a while hands out addresses in no
+    // particular order; visiting the same objects shuffled models that.
+    Array <Aos_Enemy *> aged_heap_enemies;
+    aged_heap_enemies.resize(heap_enemies.count);
+    memcpy(aged_heap_enemies.data, heap_enemies.data, heap_enemies.count * sizeof(Aos_Enemy *));
+    for (int i = aged_heap_enemies.count - 1; i > 0; i--) {
+        int j = random_int(&random, i + 1);
+        Aos_Enemy *temp = aged_heap_enemies[i];
+        aged_heap_enemies[i] = aged_heap_enemies[j];
+        aged_heap_enemies[j] = temp;
+    }
+
+    s64 start_time = get_time_nanoseconds();
+    for (int tick = 0; tick < options->ticks; tick++) {
+        for (Aos_Enemy *enemy : aged_heap_enemies) step_aos_enemy(world, enemy, dt);
+    }
+    s64 heap_nanoseconds = get_time_nanoseconds() - start_time;
+
+    start_time = get_time_nanoseconds();
+    for (int tick = 0; tick < options->ticks; tick++) {
+        for (Aos_Enemy *enemy : aos_pool) step_aos_enemy(world, enemy, dt);
+    }
+    s64 aos_nanoseconds = get_time_nanoseconds() - start_time;
+
+    start_time = get_time_nanoseconds();
+    for (int tick = 0; tick < options->ticks; tick++) {
+        step_soa_enemies(world, dt);
+    }
+    s64 soa_nanoseconds = get_time_nanoseconds() - start_time;
+
+    Vector2 heap_sum = v2(0, 0);
+    Vector2 aos_sum  = v2(0, 0);
+    Vector2 soa_sum  = v2(0, 0);
+    for (Aos_Enemy *enemy : heap_enemies) heap_sum += enemy->position;
+    for (Aos_Enemy *enemy : aos_pool)     aos_sum  += enemy->position;
+    for (Enemy *enemy : world->by_type._Enemy) soa_sum += get_position(enemy);
+
+    bool match = heap_sum.x == soa_sum.x && heap_sum.y == soa_sum.y && aos_sum.x == soa_sum.x && aos_sum.y == soa_sum.y;
+
+    double num_updates = (double)options->count * options->ticks;
+    printf("Entity layout benchmark: %d enemies, %d ticks (%d bytes an Aos_Enemy, %d bytes of hot fields an enemy)\n",
+           options->count, options->ticks, (int)sizeof(Aos_Enemy), (int)(sizeof(Enemy_Fields) / POOL_BLOCK_SIZE));
+    printf("  heap, aged   %10.2f ns/update\n", heap_nanoseconds / num_updates);
+    printf("  pool, AoS    %10.2f ns/update\n", aos_nanoseconds / num_updates);
+    printf("  pool, SoA    %10.2f ns/update (%.2fx vs AoS, %.2fx vs heap)\n", soa_nanoseconds / num_updates,
+           soa_nanoseconds > 0 ? (double)aos_nanoseconds  / (double)soa_nanoseconds : 0.0,
+           soa_nanoseconds > 0 ? (double)heap_nanoseconds / (double)soa_nanoseconds : 0.0);
+    printf("  results %s\n", match ? "match" : "DIFFER");
+    fflush(stdout);
+
+    return match ? 0 : 1;
+}
+
+//
+// destruction: spawn and destroy projectiles in bulk and in per-tick churn,
+// then check that the entity bookkeeping is still consistent.
+//
+
+static bool check_entity_bookkeeping(World *world) {
+    if (world->entity_lookup.count != world->all_entities.count) return false;
+
+    for (int i = 0; i < world->all_entities.count; i++) {
+        Entity *e = world->all_entities[i];
+        if (e->all_entities_index != i) return false;
+        if (get_entity_by_id(world, e->id) != e) return false;
+    }
+
+    int num_pooled = world->by_type._Enemy.count + world->by_type._Projectile.count + world->by_type._Pickup.count;
+    int num_single = (world->by_type._Hero ? 1 : 0) + (world->by_type._Door ? 1 : 0);
+    return num_pooled + num_single == world->all_entities.count;
+}
+
+static void spawn_projectiles(World *world, Random_State *random, int count) {
+    for (int i = 0; i < count; i++) {
+        Projectile *projectile = make_projectile(world);
+
+        int slot;
+        Projectile_Fields *fields = get_fields(projectile, &slot);
+        fields->position[slot] = v2(random_float(random) * world->size.x, 1.5f);
+        fields->radius[slot]   = 0.2f;
+    }
+}
+
+static int benchmark_destruction(Benchmark_Options *options) {
+    if (!options->count) options->count = 100000;
+    if (!options->ticks) options->ticks = 600;
+    
+    World *world = make_benchmark_world(64, options->seed);
+    defer { free_benchmark_world(world); };
+
+    Random_State random;
+    seed_random(&random, options->seed);
+
+    int count = options->count;
+
+    s64 start_time = get_time_nanoseconds();
+    spawn_projectiles(world, &random, count);
+    s64 spawn_nanoseconds = get_time_nanoseconds() - start_time;
+
+    // Every tick a hundredth of the projectiles hit something and as many
+    // new ones get fired.
+    int churn = Max(count / 100, 1);
+    s64 num_churned = 0;
+    s64 churn_destroy_nanoseconds = 0;
+    for (int tick = 0; tick < options->ticks; tick++) {
+        int num_scheduled = 0;
+        while (num_scheduled < churn) {
+            Entity *e = world->all_entities[random_int(&random, world->all_entities.count)];
+            if (e->type != ENTITY_TYPE_PROJECTILE || e->scheduled_for_destruction) continue;
+
+            schedule_for_destruction(e);
+            num_scheduled++;
+        }
+
+        start_time = get_time_nanoseconds();
+        destroy_scheduled_entities(world);
+        churn_destroy_nanoseconds += get_time_nanoseconds() - start_time;
+        num_churned += num_scheduled;
+
+        spawn_projectiles(world, &random, num_scheduled);
+    }
+
+    bool consistent = check_entity_bookkeeping(world);
+
+    for (Projectile *projectile : world->by_type._Projectile) {
+        schedule_for_destruction(projectile);
+    }
+    
+    start_time = get_time_nanoseconds();
+    destroy_scheduled_entities(world);
+    s64 bulk_destroy_nanoseconds = get_time_nanoseconds() - start_time;
+
+    consistent = consistent && check_entity_bookkeeping(world) && world->by_type._Projectile.count == 0;
+
+    printf("Entity destruction benchmark: %d projectiles, %d ticks of %d\n", count, options->ticks, churn);
+    printf("  spawn          %10.1f ns/entity\n", (double)spawn_nanoseconds / count);
+    printf("  churn destroy  %10.1f ns/entity (%lld destroyed)\n",
+           num_churned > 0 ? (double)churn_destroy_nanoseconds / num_churned : 0.0, (long long)num_churned);
+    printf("  bulk destroy   %10.1f ns/entity\n", (double)bulk_destroy_nanoseconds / count);
+    printf("  bookkeeping %s\n", consistent ? "consistent" : "BROKEN");
+    fflush(stdout);
+
+    return consistent ? 0 : 1;
+}
+
+//
+// broadphase: a tick of entity movement plus the hero's collision tests,
+// against every entity vs through the grid (filing movers as they go, plus the
+// same two queries update_single_hero makes), at growing entity counts with
+// the density kept the same.
+//
+
+static int count_hits(Rectangle2 rect, Entity *e) {
+    return are_rect_and_circle_colliding(rect, get_position(e), get_radius(e)) ? 1 : 0;
+}
+
+template <typename T, typename Hot>
+static int count_pool_hits(Rectangle2 rect, Pool <T, Hot> *pool) {
+    int hits = 0;
+    for (T *e : *pool) hits += count_hits(rect, e);
+    return hits;
+}
+
+// Walk back and forth across the level at the entity's usual speed.
+template <typename T, typename Hot>
+static void move_pool(World *world, Pool <T, Hot> *pool, float dt, bool use_broadphase) {
+    for (T *e : *pool) {
+        int slot;
+        Hot *fields = pool->get_hot(e, e->pool_handle, &slot);
+        Vector2 *position = &fields->position[slot];
+
+        bool is_facing_right = (fields->flags[slot] & MOVER_FACING_RIGHT) != 0;
+        position->x += (is_facing_right ? fields->speed[slot] : -fields->speed[slot]) * dt;
+        if (position->x < 0.0f || position->x > world->size.x) {
+            fields->flags[slot] ^= MOVER_FACING_RIGHT;
+        }
+
+        if (use_broadphase) update_broadphase_entity(world->broadphase, e);
+    }
+}
+
+static int benchmark_broadphase(Benchmark_Options *options) {
+    const float dt = 1.0f / 120.0f;
+    
+    int max_count = options->count ? options->count : 100000;
+    bool all_match = true;
+
+    printf("Broadphase benchmark: movement plus hero vs enemies, projectiles and pickups\n");
+    printf("  %8s %8s %14s %14s %8s\n", "entities", "ticks", "brute ns/tick", "grid ns/tick", "speedup");
+
+    for (int count = 100; count <= max_count; count *= 10) {
+        int level_width = Max(count / 8, 64);
+        int ticks = Max(10, Min(10000, 10000000 / count));
+
+        s64 nanoseconds[2] = {};
+        s64 hits[2] = {};
+        
+        for (int use_broadphase = 0; use_broadphase < 2; use_broadphase++) {
+            World *world = make_benchmark_world(level_width, options->seed);
+            defer { free_benchmark_world(world); };
+
+            Random_State random;
+            seed_random(&random, options->seed);
+
+            for (int i = 0; i < count; i++) {
+                Vector2 position = v2(random_float(&random) * level_width, 1.0f + random_float(&random) * 16.0f);
+                u8 flags = (random_u32(&random) & 1) ? MOVER_FACING_RIGHT : 0;
+                int slot;
+                switch (i % 3) {
+                    case 0: { Enemy *e      = make_enemy(world);      Enemy_Fields *f      = get_fields(e, &slot); f->position[slot] = position; f->flags[slot] = flags; } break;
+                    case 1: { Projectile *e = make_projectile(world); Projectile_Fields *f = get_fields(e, &slot); f->position[slot] = position; f->flags[slot] = flags; f->radius[slot] = 0.2f; } break;
+                    case 2: { Pickup *e     = make_pickup(world);     e->position = position; } break;
+                }
+            }
+            sync_broadphase(world->broadphase);
+
+            Array <Entity *> nearby;
+            
+            s64 start_time = get_time_nanoseconds();
+            for (int tick = 0; tick < ticks; tick++) {
+                move_pool(world, &world->by_type._Enemy, dt, use_broadphase);
+                move_pool(world, &world->by_type._Projectile, dt, use_broadphase);
+
+                Vector2 position = v2(random_float(&random) * (level_width - 1), 1.0f + random_float(&random) * 15.0f);
+                Rectangle2 rect = {position.x, position.y, 1.0f, 1.0f};
+
+                if (use_broadphase) {
+                    query_broadphase(world->broadphase, rect, Bit(ENTITY_TYPE_ENEMY), &nearby);
+                    for (Entity *e : nearby) hits[1] += 2 * count_hits(rect, e);
+
+                    query_broadphase(world->broadphase, rect, Bit(ENTITY_TYPE_PROJECTILE) | Bit(ENTITY_TYPE_PICKUP), &nearby);
+                    for (Entity *e : nearby) hits[1] += count_hits(rect, e);
+                } else {
+                    // Enemies are walked twice, once for stomping and once for contact.
+                    hits[0] += count_pool_hits(rect, &world->by_type._Enemy);
+                    hits[0] += count_pool_hits(rect, &world->by_type._Enemy);
+                    hits[0] += count_pool_hits(rect, &world->by_type._Projectile);
+                    hits[0] += count_pool_hits(rect, &world->by_type._Pickup);
+                }
+            }
+            nanoseconds[use_broadphase] = get_time_nanoseconds() - start_time;
+        }
+
+        bool match = hits[0] == hits[1];
+        all_match = all_match && match;
+
+        printf("  %8d %8d %14.1f %14.1f %7.1fx%s\n", count, ticks,
+               (double)nanoseconds[0] / ticks, (double)nanoseconds[1] / ticks,
+               nanoseconds[1] > 0 ? (double)nanoseconds[0] / (double)nanoseconds[1] : 0.0,
+               match ? "" : " HITS DIFFER");
+    }
+
+    fflush(stdout);
+    return all_match ? 0 : 1;
+}
+
+//
+// jobs: update_world on a huge generated level with -count extra enemies, at
+// growing worker thread counts. Every run has to end in the same state.
+//
+
+static int benchmark_jobs(Benchmark_Options *options) {
+    const float dt = 1.0f / 120.0f;
+
+    int count = options->count ? options->count : 100000;
+    int ticks = options->ticks ? options->ticks : 120;
+    int level_width = Max(count / 8, 64);
+    int max_worker_threads = Max(get_num_worker_threads(), SDL_GetCPUCount() - 1);
+
+    printf("Job system benchmark: %d extra enemies on a level %d wide, %d ticks, batches of %d\n",
+           count, level_width, ticks, globals.world_update_batch_size);
+    printf("  %8s %14s %14s %14s %8s\n", "workers", "ms/tick", "enemies ms", "particles ms", "speedup");
+
+    double serial_ms = 0.0;
+    u64 serial_hash = 0;
+    bool all_match = true;
+
+    for (int num_worker_threads = 0;; num_worker_threads = num_worker_threads ? num_worker_threads * 2 : 1) {
+        num_worker_threads = Min(num_worker_threads, max_worker_threads);
+
+        shutdown_job_system();
+        init_job_system(num_worker_threads);
+
+        seed_random(options->seed);
+        seed_random(&globals.level_random, get_hash(options->seed));
+        globals.should_switch_worlds = false;
+
+        World *world = make_headless_world(level_width);
+        defer { free_benchmark_world(world); };
+
+        Random_State random;
+        seed_random(&random, options->seed);
+        for (int i = 0; i < count; i++) {
+            Enemy *enemy = make_enemy(world);
+            enemy->color = v4(0, 0, 1, 1);
+
+            int slot;
+            Enemy_Fields *fields = get_fields(enemy, &slot);
+            fields->position[slot] = v2(1.5f + random_float(&random) * (level_width - 3.0f), 1.5f);
+            fields->flags[slot]    = (random_u32(&random) & 1) ? MOVER_FACING_RIGHT : 0;
+            fields->time_since_last_projectile[slot] = random_float(&random) * fields->time_between_projectiles[slot];
+        }
+
+        for (int i = 0; i < count; i++) {
+            emit_stomp_particles(world->particle_system, v2(random_float(&random) * level_width, 4.0f));
+        }
+
+        s64 enemy_nanoseconds = 0;
+        s64 particle_nanoseconds = 0;
+        s64 start_time = get_time_nanoseconds();
+        for (int tick = 0; tick < ticks; tick++) {
+            update_world(world, dt);
+            enemy_nanoseconds    += world->update_stats.enemy_nanoseconds;
+            particle_nanoseconds += world->update_stats.particle_nanoseconds;
+        }
+        double ms = nanoseconds_to_seconds(get_time_nanoseconds() - start_time) * 1000.0 / ticks;
+
+        u64 hash = get_world_state_hash(world);
+        if (!num_worker_threads) {
+            serial_ms   = ms;
+            serial_hash = hash;
+        }
+
+        bool match = hash == serial_hash;
+        all_match = all_match && match;
+
+        printf("  %8d %14.3f %14.3f %14.3f %7.2fx%s\n", get_num_worker_threads(), ms,
+               nanoseconds_to_seconds(enemy_nanoseconds) * 1000.0 / ticks,
+               nanoseconds_to_seconds(particle_nanoseconds) * 1000.0 / ticks,
+               ms > 0.0 ? serial_ms / ms : 0.0, match ? "" : " STATE DIFFERS");
+
+        if (num_worker_threads >= max_worker_threads) break;
+    }
+
+    fflush(stdout);
+    return all_match ? 0 : 1;
+}
+
+//
+// tiles: point and box solidity queries against a tilemap, the way the old
+// linear scan over collidable_ids did them and through the bitsets.
+//
+
+static bool is_tile_id_collidable_by_scan(Tilemap *tilemap, u8 tile_id) {
+    for (int i = 0; i < tilemap->num_collidable_ids; i++) {
+        if (tilemap->collidable_ids[i] == tile_id) return true;
+    }
+    return false;
+}
+
+static int benchmark_tiles(Benchmark_Options *options) {
+    const int NUM_TILE_IDS = 16;
+    const int NUM_COLLIDABLE_IDS = 8;
+
+    int count = options->count ? options->count : 1000000;
+    int ticks = options->ticks ? options->ticks : 10;
+
+    Random_State random;
+    seed_random(&random, options->seed);
+
+    // Half the ids are collidable, as in a hand-made map with a few kinds of ground.
+    Tilemap tilemap;
+    tilemap.width  = 1024;
+    tilemap.height = 64;
+    tilemap.tiles  = new u8[tilemap.width * tilemap.height];
+    tilemap.num_collidable_ids = NUM_COLLIDABLE_IDS;
+    tilemap.collidable_ids = new u8[NUM_COLLIDABLE_IDS];
+    for (int i = 0; i < NUM_COLLIDABLE_IDS; i++) tilemap.collidable_ids[i] = (u8)(NUM_TILE_IDS - 1 - 2*i);
+    for (int i = 0; i < tilemap.width * tilemap.height; i++) {
+        tilemap.tiles[i] = random_int(&random, 4) ? 0 : (u8)random_int(&random, NUM_TILE_IDS);
+    }
+    update_tilemap_collision(&tilemap);
+    defer {
+        delete [] tilemap.tiles;
+        delete [] tilemap.collidable_ids;
+        free_tilemap_collision(&tilemap);
+    };
+
+    // Some queries fall a little outside the map.
+    Array <Vector2> points;
+    Array <Vector2> sizes;
+    points.reserve(count);
+    sizes.reserve(count);
+    for (int i = 0; i < count; i++) {
+        points.add(v2(-2.0f + random_float(&random) * (tilemap.width + 4), -2.0f + random_float(&random) * (tilemap.height + 4)));
+        sizes.add(v2(0.5f + random_float(&random) * 4.0f, 0.5f + random_float(&random) * 2.0f));
+    }
+    defer {
+        points.deallocate();
+        sizes.deallocate();
+    };
+
+    s64 nanoseconds[4] = {};
+    s64 hits[4] = {};
+
+    for (int tick = 0; tick < ticks; tick++) {
+        s64 start_time = get_time_nanoseconds();
+        for (Vector2 p : points) {
+            hits[0] += is_tile_id_collidable_by_scan(&tilemap, get_tile_id_at(&tilemap, p));
+        }
+        nanoseconds[0] += get_time_nanoseconds() - start_time;
+
+        start_time = get_time_nanoseconds();
+        for (Vector2 p : points) {
+            hits[1] += is_tile_id_collidable(&tilemap, get_tile_id_at(&tilemap, p));
+        }
+        nanoseconds[1] += get_time_nanoseconds() - start_time;
+
+        // Same truncation as get_tile_id_at, so the answers line up.
+        start_time = get_time_nanoseconds();
+        for (Vector2 p : points) {
+            hits[2] += is_cell_solid(&tilemap, (int)p.x, (int)p.y);
+        }
+        nanoseconds[2] += get_time_nanoseconds() - start_time;
+    }
+
+    s64 box_nanoseconds[2] = {};
+    s64 box_hits[2] = {};
+
+    for (int tick = 0; tick < ticks; tick++) {
+        s64 start_time = get_time_nanoseconds();
+        for (int i = 0; i < count; i++) {
+            int x0 = (int)floorf(points[i].x);
+            int y0 = (int)floorf(points[i].y);
+            int x1 = (int)floorf(points[i].x + sizes[i].x);
+            int y1 = (int)floorf(points[i].y + sizes[i].y);
+
+            bool solid = false;
+            for (int y = y0; y <= y1 && !solid; y++) {
+                for (int x = x0; x <= x1 && !solid; x++) {
+                    u8 id = (x < 0 || y < 0 || x >= tilemap.width || y >= tilemap.height) ? 0 : tilemap.tiles[y * tilemap.width + x];
+                    solid = is_tile_id_collidable_by_scan(&tilemap, id);
+                }
+            }
+            box_hits[0] += solid;
+        }
+        box_nanoseconds[0] += get_time_nanoseconds() - start_time;
+
+        start_time = get_time_nanoseconds();
+        for (int i = 0; i < count; i++) {
+            int x0 = (int)floorf(points[i].x);
+            int y0 = (int)floorf(points[i].y);
+            int x1 = (int)floorf(points[i].x + sizes[i].x);
+            int y1 = (int)floorf(points[i].y + sizes[i].y);
+            box_hits[1] += is_region_solid(&tilemap, x0, y0, x1, y1);
+        }
+        box_nanoseconds[1] += get_time_nanoseconds() - start_time;
+    }
+
+    s64 num_queries = (s64)count * ticks;
+    bool points_match = hits[0] == hits[1] && hits[0] == hits[2];
+    bool boxes_match  = box_hits[0] == box_hits[1];
+
+    printf("Tile collision benchmark: %dx%d map, %d of %d tile ids collidable, %lld queries each\n",
+           tilemap.width, tilemap.height, NUM_COLLIDABLE_IDS, NUM_TILE_IDS, (long long)num_queries);
+    printf("  %-34s %10s %10s\n", "query", "ns/query", "hits");
+    printf("  %-34s %10.2f %10lld\n", "point, scan collidable_ids",  (double)nanoseconds[0] / num_queries, (long long)hits[0]);
+    printf("  %-34s %10.2f %10lld\n", "point, collidable id bitset", (double)nanoseconds[1] / num_queries, (long long)hits[1]);
+    printf("  %-34s %10.2f %10lld%s\n", "point, solid bitmap",       (double)nanoseconds[2] / num_queries, (long long)hits[2],
+           points_match ? "" : " HITS DIFFER");
+    printf("  %-34s %10.2f %10lld\n", "box, scan every tile",        (double)box_nanoseconds[0] / num_queries, (long long)box_hits[0]);
+    printf("  %-34s %10.2f %10lld%s\n", "box, solid bitmap words",   (double)box_nanoseconds[1] / num_queries, (long long)box_hits[1],
+           boxes_match ? "" : " HITS DIFFER");
+
+    fflush(stdout);
+    return points_match && boxes_match ? 0 : 1;
+}
+
+//
+// sweeps: sweep_box_through_tilemap against hand-made cases at extreme
+// velocities, then random moves over a cluttered map checked for tunneling,
+// and the cost per sweep.
+//
+
+static Tilemap *make_sweep_tilemap(int width, int height) {
+    Tilemap *tilemap = new Tilemap();
+    tilemap->width  = width;
+    tilemap->height = height;
+    tilemap->tiles  = new u8[width * height];
+    memset(tilemap->tiles, 0, width * height);
+    tilemap->num_collidable_ids = 1;
+    tilemap->collidable_ids = new u8[1];
+    tilemap->collidable_ids[0] = 1;
+    return tilemap;
+}
+
+static void free_sweep_tilemap(Tilemap *tilemap) {
+    free_tilemap_collision(tilemap);
+    delete [] tilemap->tiles;
+    delete [] tilemap->collidable_ids;
+    delete tilemap;
+}
+
+// Overlap deeper than epsilon. Starting boxes are checked with none at all,
+// so the sweep can't count them as already overlapping a cell; results get
+// some slack for rounding.
+static bool box_overlaps_solid(Tilemap *tilemap, Vector2 position, Vector2 size, float epsilon = 1e-3f) {
+    int x0 = (int)floorf(position.x + epsilon);
+    int y0 = (int)floorf(position.y + epsilon);
+    int x1 = (int)ceilf(position.x + size.x - epsilon) - 1;
+    int y1 = (int)ceilf(position.y + size.y - epsilon) - 1;
+    return is_region_solid(tilemap, x0, y0, x1, y1);
+}
+
+static bool nearly_equal(float a, float b) {
+    return fabsf(a - b) <= 1e-3f * Max(1.0f, fabsf(b));
+}
+
+struct Sweep_Case {
+    char *name;
+    Vector2 position;
+    Vector2 size;
+    Vector2 delta;
+    Vector2 expected;
+    bool hit_x;
+    bool hit_y;
+};
+
+static int benchmark_sweeps(Benchmark_Options *options) {
+    int count = options->count ? options->count : 100000;
+    int ticks = options->ticks ? options->ticks : 10;
+    int num_failures = 0;
+
+    //
+    // A one-tile floor at row 10 with a gap at column 20, a one-tile wall at
+    // column 30 standing on it and a lone block at (50, 50).
+    //
+    Tilemap *tilemap = make_sweep_tilemap(64, 64);
+    defer { free_sweep_tilemap(tilemap); };
+
+    for (int x = 0; x < tilemap->width; x++) {
+        if (x != 20) tilemap->tiles[10 * tilemap->width + x] = 1;
+    }
+    for (int y = 11; y < tilemap->height; y++) tilemap->tiles[y * tilemap->width + 30] = 1;
+    tilemap->tiles[50 * tilemap->width + 50] = 1;
+    update_tilemap_collision(tilemap);
+
+    Sweep_Case cases[] = {
+        {"fall onto a one-tile floor",       v2(5, 40),      v2(1, 1),       v2(0, -1e4f),   v2(5, 11),         false, true},
+        {"jump into a one-tile ceiling",     v2(5, 2),       v2(1, 1),       v2(0, 1e4f),    v2(5, 9),          false, true},
+        {"run right into a one-tile wall",   v2(2, 20),      v2(1, 1),       v2(1e5f, 0),    v2(29, 20),        true,  false},
+        {"run left into a one-tile wall",    v2(40, 20),     v2(1, 1),       v2(-1e5f, 0),   v2(31, 20),        true,  false},
+        {"projectile into a one-tile wall",  v2(10, 20.3f),  v2(0.4f, 0.4f), v2(1e6f, 0),    v2(29.6f, 20.3f),  true,  false},
+        {"diagonal onto a corner",           v2(48, 48),     v2(1, 1),       v2(2, 2),       v2(50, 49),        false, true},
+        {"slide along the floor",            v2(5, 11),      v2(1, 1),       v2(20, -1e4f),  v2(25, 11),        false, true},
+        {"drop through a one-wide gap",      v2(20, 40),     v2(1, 1),       v2(0, -1e4f),   v2(20, 40 - 1e4f), false, false},
+        {"slide up the wall out of the map", v2(5, 30),      v2(1, 1),       v2(1e7f, 1e7f), v2(29, 30 + 1e7f), true,  false},
+        {"start inside a wall",              v2(29.5f, 20),  v2(1, 1),       v2(1e4f, 0),    v2(29.5f + 1e4f, 20), false, false},
+    };
+
+    printf("Tile sweep checks:\n");
+    for (Sweep_Case c : cases) {
+        Tile_Sweep sweep = sweep_box_through_tilemap(tilemap, c.position, c.size, c.delta);
+        bool ok = nearly_equal(sweep.position.x, c.expected.x) && nearly_equal(sweep.position.y, c.expected.y) &&
+                  sweep.hit_x == c.hit_x && sweep.hit_y == c.hit_y && !sweep.ran_out_of_steps;
+        if (!ok) num_failures++;
+
+        printf("  %-34s (%g, %g) %s%s %d steps%s\n", c.name, sweep.position.x, sweep.position.y,
+               sweep.hit_x ? "x" : "-", sweep.hit_y ? "y" : "-", sweep.num_steps, ok ? "" : "  FAILED");
+    }
+
+    //
+    // Random moves over a map a quarter full of single blocks. Every move has
+    // to end clear of solid cells, and a move along one axis must not have
+    // passed through any.
+    //
+    Random_State random;
+    seed_random(&random, options->seed);
+
+    Tilemap *cluttered = make_sweep_tilemap(128, 64);
+    defer { free_sweep_tilemap(cluttered); };
+    for (int i = 0; i < cluttered->width * cluttered->height; i++) {
+        cluttered->tiles[i] = random_int(&random, 4) == 0;
+    }
+    update_tilemap_collision(cluttered);
+
+    Array <Sweep_Case> moves;
+    moves.reserve(count);
+    defer { moves.deallocate(); };
+
+    while (moves.count < count) {
+        Sweep_Case move = {};
+        move.size     = v2(0.2f + random_float(&random) * 1.3f, 0.2f + random_float(&random) * 1.3f);
+        move.position = v2(random_float(&random) * cluttered->width, random_float(&random) * cluttered->height);
+        if (box_overlaps_solid(cluttered, move.position, move.size, 0.0f)) continue;
+
+        // Half of them the size of a tick's movement, half absurd.
+        float speed = (moves.count & 1) ? 1e4f : 0.25f;
+        float dx = (random_float(&random) * 2.0f - 1.0f) * speed;
+        float dy = (random_float(&random) * 2.0f - 1.0f) * speed;
+        switch (random_int(&random, 3)) {
+            case 0: move.delta = v2(dx, 0);  break;
+            case 1: move.delta = v2(0, dy);  break;
+            case 2: move.delta = v2(dx, dy); break;
+        }
+        moves.add(move);
+    }
+
+    int num_tunneled = 0;
+    int num_out_of_steps = 0;
+    for (Sweep_Case move : moves) {
+        Tile_Sweep sweep = sweep_box_through_tilemap(cluttered, move.position, move.size, move.delta);
+        if (sweep.ran_out_of_steps) num_out_of_steps++;
+
+        bool tunneled = box_overlaps_solid(cluttered, sweep.position, move.size);
+        if (move.delta.x == 0.0f || move.delta.y == 0.0f) {
+            Vector2 min = v2(Min(move.position.x, sweep.position.x), Min(move.position.y, sweep.position.y));
+            Vector2 max = v2(Max(move.position.x, sweep.position.x), Max(move.position.y, sweep.position.y));
+            tunneled = tunneled || box_overlaps_solid(cluttered, min, max - min + move.size);
+        }
+        if (tunneled) num_tunneled++;
+    }
+
+    if (num_tunneled || num_out_of_steps) num_failures++;
+    printf("Random moves: %d, tunneled: %d, out of steps: %d\n", moves.count, num_tunneled, num_out_of_steps);
+
+    //
+    // Cost, split into tick-sized and absurd moves.
+    //
+    s64 nanoseconds[2] = {};
+    s64 num_steps[2] = {};
+    for (int tick = 0; tick < ticks; tick++) {
+        for (int extreme = 0; extreme < 2; extreme++) {
+            s64 start_time = get_time_nanoseconds();
+            for (int i = extreme; i < moves.count; i += 2) {
+                Sweep_Case move = moves[i];
+                num_steps[extreme] += sweep_box_through_tilemap(cluttered, move.position, move.size, move.delta).num_steps;
+            }
+            nanoseconds[extreme] += get_time_nanoseconds() - start_time;
+        }
+    }
+
+    s64 num_sweeps = (s64)(moves.count / 2) * ticks;
+    if (num_sweeps) {
+        printf("  %-12s %10s %12s\n", "moves", "ns/sweep", "cells/sweep");
+        printf("  %-12s %10.1f %12.2f\n", "tick-sized", (double)nanoseconds[0] / num_sweeps, (double)num_steps[0] / num_sweeps);
+        printf("  %-12s %10.1f %12.2f\n", "extreme",    (double)nanoseconds[1] / num_sweeps, (double)num_steps[1] / num_sweeps);
+    }
+
+    printf("%s\n", num_failures ? "FAILED" : "All sweep checks passed.");
+    fflush(stdout);
+    return num_failures ? 1 : 0;
+}
+
+//
+// pacer: frames of a fixed amount of busy work held to 120 Hz, by spinning
+// until the deadline the way main_loop used to and by the frame pacer.
+// CPU use comes from clock(), which is process CPU time except on Windows,
+// where it is wall time and the CPU column is meaningless.
+//
+
+static void busy_work(s64 nanoseconds) {
+    s64 end_time = get_time_nanoseconds() + nanoseconds;
+    while (get_time_nanoseconds() < end_time) {}
+}
+
+static int benchmark_pacer(Benchmark_Options *options) {
+    const int FRAMES_PER_SECOND = 120;
+
+    int frames = options->ticks ? options->ticks : 240;
+    s64 work_time = (options->count ? options->count : 2000) * 1000LL; // -count is microseconds of work per frame.
+
+    printf("Frame pacer benchmark: %d frames at %d Hz, %.2f ms of work per frame\n",
+           frames, FRAMES_PER_SECOND, work_time / 1000000.0);
+    printf("  %-10s %8s %12s %12s %8s %10s %10s\n", "wait", "CPU %", "frame ms", "stddev ms", "late", "overslept", "sleep ms");
+
+    for (int busy_wait = 1; busy_wait >= 0; busy_wait--) {
+        Frame_Pacer pacer;
+        init_frame_pacer(&pacer, FRAMES_PER_SECOND);
+
+        clock_t start_clock = clock();
+        s64 start_time = get_time_nanoseconds();
+
+        for (int frame = 0; frame < frames; frame++) {
+            busy_work(work_time);
+            wait_for_next_frame(&pacer, busy_wait);
+        }
+
+        double wall_seconds = nanoseconds_to_seconds(get_time_nanoseconds() - start_time);
+        double cpu_seconds  = (double)(clock() - start_clock) / CLOCKS_PER_SEC;
+
+        Frame_Pacer_Stats *stats = &pacer.total;
+        printf("  %-10s %8.1f %12.3f %12.3f %8lld %10lld %10.3f\n", busy_wait ? "spin" : "sleep",
+               wall_seconds > 0.0 ? 100.0 * cpu_seconds / wall_seconds : 0.0,
+               get_average_frame_milliseconds(stats), get_frame_time_standard_deviation_milliseconds(stats),
+               (long long)stats->num_late_frames, (long long)stats->num_overslept_frames,
+               stats->num_frames ? stats->total_sleep_time / 1000000.0 / stats->num_frames : 0.0);
+    }
+
+    fflush(stdout);
+    return 0;
+}
+
+//
+// tilemap_draw: what drawing the tilemap submits per frame as the camera pans
+// across ever wider levels, the old way (an immediate quad for every solid
+// tile in the map) and from culled chunks. Only the CPU side: the cost
+// columns are building the quads vs finding the visible chunks.
+//
+
+static int benchmark_tilemap_draw(Benchmark_Options *options) {
+    int frames = options->ticks ? options->ticks : 600;
+    int max_width = options->count ? options->count : 30000;
+
+    printf("Tilemap draw benchmark: %d frames panning across each level\n", frames);
+    printf("  %8s %14s %14s %14s %14s %8s\n", "width", "old verts", "chunk verts", "old us/frame", "cull us/frame", "chunks");
+
+    for (int level_width = globals.start_level_width; level_width <= max_width; level_width *= 10) {
+        seed_random(&globals.level_random, get_hash(options->seed));
+        World *world = make_headless_world(level_width);
+        defer { free_benchmark_world(world); };
+
+        Tilemap *tilemap = world->tilemap;
+        Camera *camera = world->camera;
+
+        int num_chunks_x = (tilemap->width  + TILEMAP_CHUNK_WIDTH  - 1) / TILEMAP_CHUNK_WIDTH;
+        int num_chunks_y = (tilemap->height + TILEMAP_CHUNK_HEIGHT - 1) / TILEMAP_CHUNK_HEIGHT;
+
+        // What each chunk's vertex buffer would hold.
+        Array <Immediate_Vertex> vertices;
+        defer { vertices.deallocate(); };
+
+        Array <int> chunk_vertex_counts;
+        defer { chunk_vertex_counts.deallocate(); };
+        for (int y = 0; y < num_chunks_y; y++) {
+            for (int x = 0; x < num_chunks_x; x++) {
+                build_tilemap_chunk_vertices(tilemap, x, y, &vertices);
+                chunk_vertex_counts.add(vertices.count);
+            }
+        }
+
+        s64 old_vertices = 0;
+        s64 chunk_vertices = 0;
+        s64 num_chunks_drawn = 0;
+        s64 old_nanoseconds = 0;
+        s64 cull_nanoseconds = 0;
+
+        vertices.reserve(tilemap->width * tilemap->height * 6);
+
+        for (int frame = 0; frame < frames; frame++) {
+            float t = frames > 1 ? (float)frame / (float)(frames - 1) : 0.0f;
+            camera->position = v2(VIEW_AREA_WIDTH * 0.5f + t * Max(level_width - VIEW_AREA_WIDTH, 0), VIEW_AREA_HEIGHT * 0.5f);
+            camera->previous_position = camera->position;
+
+            // The old draw_tilemap: every cell, a quad per solid tile.
+            s64 start_time = get_time_nanoseconds();
+            vertices.count = 0;
+            for (int y = 0; y < tilemap->height; y++) {
+                for (int x = 0; x < tilemap->width; x++) {
+                    u8 tile_id = tilemap->tiles[y * tilemap->width + x];
+                    if (!tile_id) continue;
+
+                    Vector4 color = tilemap->colors[tile_id - 1];
+                    for (int i = 0; i < 6; i++) {
+                        vertices.data[vertices.count++] = make_immediate_vertex(v2((float)x, (float)y), color, v2(0, 0));
+                    }
+                }
+            }
+            old_nanoseconds += get_time_nanoseconds() - start_time;
+            old_vertices    += vertices.count;
+
+            start_time = get_time_nanoseconds();
+            int x0, y0, x1, y1;
+            if (get_tilemap_chunks_in_rect(tilemap, get_visible_world_rect(camera, world), &x0, &y0, &x1, &y1)) {
+                for (int y = y0; y <= y1; y++) {
+                    for (int x = x0; x <= x1; x++) {
+                        chunk_vertices += chunk_vertex_counts[y * num_chunks_x + x];
+                        num_chunks_drawn++;
+                    }
+                }
+            }
+            cull_nanoseconds += get_time_nanoseconds() - start_time;
+        }
+
+        printf("  %8d %14.0f %14.0f %14.2f %14.3f %8.2f\n", level_width,
+               (double)old_vertices / frames, (double)chunk_vertices / frames,
+               old_nanoseconds / 1000.0 / frames, cull_nanoseconds / 1000.0 / frames,
+               (double)num_chunks_drawn / frames);
+    }
+
+    fflush(stdout);
+    return 0;
+}
+
+//
+// culling: finding what draw_world should draw in one view-sized rect panning
+// across a crowded level, a radius test on every pooled entity vs
+// collect_visible_entities, checking both find the same entities.
+//
+
+template <typename T, typename Hot>
+static void collect_visible_in_pool(Pool <T, Hot> *pool, Rectangle2 rect, Array <Entity *> *results) {
+    for (T *e : *pool) {
+        if (e->scheduled_for_destruction) continue;
+        if (are_rect_and_circle_colliding(rect, get_draw_position(e), get_radius(e))) results->add(e);
+    }
+}
+
+static int benchmark_culling(Benchmark_Options *options) {
+    int max_count = options->count ? options->count : 100000;
+    int frames = options->ticks ? options->ticks : 1000;
+    bool all_match = true;
+
+    printf("Culling benchmark: %d frames panning a %dx%d view across the level\n", frames, VIEW_AREA_WIDTH, VIEW_AREA_HEIGHT);
+    printf("  %8s %10s %14s %14s %8s\n", "entities", "visible", "all ns/frame", "grid ns/frame", "speedup");
+
+    for (int count = 100; count <= max_count; count *= 10) {
+        int level_width = Max(count / 8, 64);
+
+        World *world = make_benchmark_world(level_width, options->seed);
+        defer { free_benchmark_world(world); };
+
+        Random_State random;
+        seed_random(&random, options->seed);
+
+        for (int i = 0; i < count; i++) {
+            Vector2 position = v2(random_float(&random) * level_width, 1.0f + random_float(&random) * 16.0f);
+            switch (i % 3) {
+                case 0: { Enemy *e      = make_enemy(world);      set_position(e, position); } break;
+                case 1: { Projectile *e = make_projectile(world); set_position(e, position); int slot; get_fields(e, &slot)->radius[slot] = 0.2f; } break;
+                case 2: { Pickup *e     = make_pickup(world);     set_position(e, position); } break;
+            }
+        }
+        sync_broadphase(world->broadphase);
+
+        Array <Entity *> all;
+        defer { all.deallocate(); };
+        Array <Entity *> culled;
+        defer { culled.deallocate(); };
+
+        s64 nanoseconds[2] = {};
+        s64 num_visible = 0;
+
+        for (int frame = 0; frame < frames; frame++) {
+            float t = frames > 1 ? (float)frame / (float)(frames - 1) : 0.0f;
+            Rectangle2 rect = {t * (level_width - VIEW_AREA_WIDTH), 4.0f, (float)VIEW_AREA_WIDTH, (float)VIEW_AREA_HEIGHT};
+
+            s64 start_time = get_time_nanoseconds();
+            all.count = 0;
+            collect_visible_in_pool(&world->by_type._Enemy, rect, &all);
+            collect_visible_in_pool(&world->by_type._Projectile, rect, &all);
+            collect_visible_in_pool(&world->by_type._Pickup, rect, &all);
+            nanoseconds[0] += get_time_nanoseconds() - start_time;
+
+            start_time = get_time_nanoseconds();
+            collect_visible_entities(world, rect, &culled);
+            nanoseconds[1] += get_time_nanoseconds() - start_time;
+
+            bool match = all.count == culled.count;
+            for (int i = 0; match && i < all.count; i++) {
+                if (all[i] != culled[i]) match = false;
+            }
+            if (!match) {
+                printf("  MISMATCH at %d entities, frame %d: %d vs %d visible\n", count, frame, all.count, culled.count);
+                all_match = false;
+                break;
+            }
+
+            num_visible += culled.count;
+        }
+
+        double all_ns  = (double)nanoseconds[0] / frames;
+        double grid_ns = (double)nanoseconds[1] / frames;
+        printf("  %8d %10.1f %14.0f %14.0f %7.1fx\n", count, (double)num_visible / frames, all_ns, grid_ns, grid_ns > 0 ? all_ns / grid_ns : 0.0);
+    }
+
+    printf(all_match ? "Both find the same entities.\n" : "FAILED: culling results differ.\n");
+    fflush(stdout);
+    return all_match ? 0 : 1;
+}
+
+//
+// circles: immediate_circle as a quad with the edge cut per pixel vs the
+// 100-triangle fan it replaced. Without a GPU, the vertices and draw calls
+// each would submit are counted, and both are drawn by a small reference
+// rasterizer (pixel centers, like GL) to check they cover the same pixels.
+//
+
+const int FAN_TRIANGLES_PER_CIRCLE = 100;
+const int FAN_IMMEDIATE_VERTICES = 2400; // The immediate buffer's size in the fan days.
+
+struct Reference_Image {
+    int width;
+    int height;
+    Array <u32> pixels;
+};
+
+static float edge_function(Vector2 a, Vector2 b, Vector2 p) {
+    return (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x);
+}
+
+// Fills the pixels whose centers are inside the triangle. With cut_circle,
+// only where the interpolated uv is within the unit circle, as the circle
+// shader does.
+static void rasterize_triangle(Reference_Image *image, Immediate_Vertex a, Immediate_Vertex b, Immediate_Vertex c, u32 value, bool cut_circle) {
+    float area = edge_function(a.position, b.position, c.position);
+    if (area == 0.0f) return;
+
+    int x0 = Max((int)floorf(Min(a.position.x, Min(b.position.x, c.position.x))), 0);
+    int y0 = Max((int)floorf(Min(a.position.y, Min(b.position.y, c.position.y))), 0);
+    int x1 = Min((int)ceilf(Max(a.position.x, Max(b.position.x, c.position.x))), image->width  - 1);
+    int y1 = Min((int)ceilf(Max(a.position.y, Max(b.position.y, c.position.y))), image->height - 1);
+
+    for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++) {
+            Vector2 p = v2(x + 0.5f, y + 0.5f);
+            float w0 = edge_function(b.position, c.position, p) / area;
+            float w1 = edge_function(c.position, a.position, p) / area;
+            float w2 = edge_function(a.position, b.position, p) / area;
+            if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f) continue;
+
+            if (cut_circle) {
+                Vector2 uv = get_vertex_uv(a) * w0 + get_vertex_uv(b) * w1 + get_vertex_uv(c) * w2;
+                if (uv.x * uv.x + uv.y * uv.y > 1.0f) continue;
+            }
+
+            image->pixels[y * image->width + x] = value;
+        }
+    }
+}
+
+// The triangles immediate_circle used to emit.
+static void rasterize_circle_fan(Reference_Image *image, Vector2 center, float radius, u32 value) {
+    float dtheta = TAU / (float)FAN_TRIANGLES_PER_CIRCLE;
+    for (int i = 0; i < FAN_TRIANGLES_PER_CIRCLE; i++) {
+        Immediate_Vertex v[3] = {};
+        v[0].position = center;
+        v[1].position = center + radius * get_vec2(i * dtheta);
+        v[2].position = center + radius * get_vec2((i+1) * dtheta);
+        rasterize_triangle(image, v[0], v[1], v[2], value, false);
+    }
+}
+
+static void rasterize_circle_quad(Reference_Image *image, Vector2 center, float radius, u32 value) {
+    Immediate_Vertex v[6];
+    get_circle_quad_vertices(center, radius, v4(1, 1, 1, 1), v);
+    rasterize_triangle(image, v[0], v[1], v[2], value, true);
+    rasterize_triangle(image, v[3], v[4], v[5], value, true);
+}
+
+struct Circle {
+    Vector2 center;
+    float radius;
+};
+
+static int benchmark_circles(Benchmark_Options *options) {
+    int num_circles = options->count ? options->count : 500;
+    bool all_match = true;
+
+    // How the old fan and the quads would have gone through the immediate
+    // buffer: a fan filled it after eight circles; quads all go in one batch.
+    s64 fan_vertices = 0, fan_draw_calls = 0;
+    int pending = 0;
+    for (int i = 0; i < num_circles * FAN_TRIANGLES_PER_CIRCLE; i++) {
+        if (pending + 3 > FAN_IMMEDIATE_VERTICES) {
+            fan_vertices += pending;
+            fan_draw_calls++;
+            pending = 0;
+        }
+        pending += 3;
+    }
+    if (pending) {
+        fan_vertices += pending;
+        fan_draw_calls++;
+    }
+
+    s64 quad_vertices   = num_circles * 6;
+    s64 quad_draw_calls = num_circles ? 1 : 0;
+
+    printf("Circle benchmark: %d circles\n", num_circles);
+    printf("  %-8s %12s %12s\n", "", "vertices", "draw calls");
+    printf("  %-8s %12lld %12lld\n", "fan", (long long)fan_vertices, (long long)fan_draw_calls);
+    printf("  %-8s %12lld %12lld\n", "quad", (long long)quad_vertices, (long long)quad_draw_calls);
+
+    printf("  %10s %10s %12s %12s %14s\n", "resolution", "radii", "covered", "differing", "worst off edge");
+
+    int resolutions[][2] = {{480, 270}, {1920, 1080}};
+    for (int r = 0; r < ArrayCount(resolutions); r++) {
+        Reference_Image fan  = {resolutions[r][0], resolutions[r][1]};
+        Reference_Image quad = {resolutions[r][0], resolutions[r][1]};
+        defer { fan.pixels.deallocate(); quad.pixels.deallocate(); };
+
+        int num_pixels = fan.width * fan.height;
+        fan.pixels.reserve(num_pixels);
+        quad.pixels.reserve(num_pixels);
+        fan.pixels.count  = num_pixels;
+        quad.pixels.count = num_pixels;
+        memset(fan.pixels.data,  0, num_pixels * sizeof(u32));
+        memset(quad.pixels.data, 0, num_pixels * sizeof(u32));
+
+        Random_State random;
+        seed_random(&random, options->seed);
+
+        // Tile-sized circles and up, at the sizes enemies, projectiles and
+        // pickups come out at this resolution and a little past.
+        float max_radius = fan.height / (float)VIEW_AREA_HEIGHT;
+
+        Array <Circle> circles;
+        defer { circles.deallocate(); };
+        circles.reserve(num_circles);
+        for (int i = 0; i < num_circles; i++) {
+            Circle c;
+            c.center = v2(random_float(&random) * fan.width, random_float(&random) * fan.height);
+            c.radius = 1.0f + random_float(&random) * max_radius;
+            circles.add(c);
+
+            rasterize_circle_fan(&fan, c.center, c.radius, i + 1);
+            rasterize_circle_quad(&quad, c.center, c.radius, i + 1);
+        }
+
+        // The fan is a polygon inside the circle, so they may only disagree
+        // right at an edge.
+        s64 num_covered = 0, num_differing = 0;
+        float worst = 0.0f;
+        for (int y = 0; y < fan.height; y++) {
+            for (int x = 0; x < fan.width; x++) {
+                u32 a = fan.pixels[y * fan.width + x];
+                u32 b = quad.pixels[y * fan.width + x];
+                if (a || b) num_covered++;
+                if (a == b) continue;
+
+                num_differing++;
+
+                Vector2 p = v2(x + 0.5f, y + 0.5f);
+                float nearest = FLT_MAX;
+                for (Circle c : circles) {
+                    Vector2 d = p - c.center;
+                    nearest = Min(nearest, fabsf(sqrtf(d.x * d.x + d.y * d.y) - c.radius));
+                }
+                worst = Max(worst, nearest);
+            }
+        }
+
+        if (worst > 1.0f) all_match = false;
+
+        char resolution[32];
+        snprintf(resolution, sizeof(resolution), "%dx%d", fan.width, fan.height);
+        printf("  %10s %4.0f-%-5.0f %12lld %12lld %12.3fpx\n", resolution, 1.0f, 1.0f + max_radius,
+               (long long)num_covered, (long long)num_differing, worst);
+    }
+
+    printf(all_match ? "Quads match the fans up to the edge pixels.\n" : "FAILED: quads and fans differ away from an edge.\n");
+    fflush(stdout);
+    return all_match ? 0 : 1;
+}
+
+//
+// render_queue: records a frame's worth of HUD, menu and debug text the way
+// the draw code interleaves it, then checks what flush_render_queue would do
+// with it: sorted, one batch per distinct state (more only where a state has
+// more quads than fit in one), and fewer state changes than drawing in
+// recorded order. Shaders and textures are only
+// compared, never used, so stand-ins do.
+//
+
+struct Queued_State {
+    Render_Layer layer;
+    Shader *shader;
+    Texture *texture;
+    int num_quads;
+};
+
+static void queue_test_quad(Array <Queued_State> *states, Render_Layer layer, Shader *shader, Texture *texture, float x, float y) {
+    queue_quad(layer, shader, texture, v2(x, y), v2(8, 8), v4(1, 1, 1, 1));
+
+    for (Queued_State &state : *states) {
+        if (state.layer == layer && state.shader == shader && state.texture == texture) {
+            state.num_quads++;
+            return;
+        }
+    }
+    states->add({layer, shader, texture, 1});
+}
+
+static void queue_test_frame(Array <Queued_State> *states) {
+    Shader *color_shader   = (Shader *)(uintptr_t)0x10;
+    Shader *circle_shader  = (Shader *)(uintptr_t)0x20;
+    Shader *texture_shader = (Shader *)(uintptr_t)0x30;
+    Shader *text_shader    = (Shader *)(uintptr_t)0x40;
+
+    Texture *full_heart  = (Texture *)(uintptr_t)0x100;
+    Texture *empty_heart = (Texture *)(uintptr_t)0x200;
+    Texture *restart     = (Texture *)(uintptr_t)0x300;
+    Texture *restart_off = (Texture *)(uintptr_t)0x400;
+    Texture *small_font  = (Texture *)(uintptr_t)0x500;
+    Texture *big_font    = (Texture *)(uintptr_t)0x600;
+
+    // World HUD: hearts, the pickup icon and count, restarts, level text.
+    for (int i = 0; i < 3; i++) queue_test_quad(states, RENDER_LAYER_HUD, texture_shader, i < 2 ? full_heart : empty_heart, i * 10.0f, 0);
+    queue_test_quad(states, RENDER_LAYER_HUD, circle_shader, NULL, 0, 10);
+    for (int i = 0; i < 3; i++) queue_test_quad(states, RENDER_LAYER_TEXT, text_shader, small_font, 10.0f + i * 8, 10);
+    for (int i = 0; i < 3; i++) queue_test_quad(states, RENDER_LAYER_HUD, texture_shader, i < 1 ? restart_off : restart, i * 10.0f, 20);
+    for (int i = 0; i < 7; i++) queue_test_quad(states, RENDER_LAYER_TEXT, text_shader, big_font, 100.0f + i * 8, 100);
+
+    // Menu: backdrop, a highlighted item with a shadow, a slider per
+    // labelled row.
+    queue_test_quad(states, RENDER_LAYER_BACKDROP, color_shader, NULL, 0, 0);
+    for (int item = 0; item < 6; item++) {
+        if (item == 2) queue_test_quad(states, RENDER_LAYER_HUD, color_shader, NULL, 50, item * 20.0f);
+        for (int i = 0; i < 8; i++) queue_test_quad(states, RENDER_LAYER_TEXT, text_shader, big_font, 50.0f + i * 8, item * 20.0f);
+        queue_test_quad(states, RENDER_LAYER_HUD, color_shader, NULL, 200, item * 20.0f);
+        queue_test_quad(states, RENDER_LAYER_HUD, color_shader, NULL, 210, item * 20.0f);
+    }
+
+    // Debug HUD.
+    for (int line = 0; line < 6; line++) {
+        for (int i = 0; i < 30; i++) queue_test_quad(states, RENDER_LAYER_TEXT, text_shader, small_font, 300.0f + i * 6, line * 10.0f);
+    }
+    queue_test_quad(states, RENDER_LAYER_FADE, color_shader, NULL, 0, 0);
+}
+
+static int benchmark_render_queue(Benchmark_Options *options) {
+    // The queue lives in the frame arena, which holds a few dozen copies of
+    // this frame at most.
+    int repeats = options->count ? options->count : 1;
+    clamp(&repeats, 1, 64);
+
+    Array <Queued_State> states;
+    defer { states.deallocate(); };
+
+    clear_render_queue();
+    for (int r = 0; r < repeats; r++) queue_test_frame(&states);
+
+    Render_Queue_Stats recorded = plan_render_queue(false);
+    Render_Queue_Stats sorted   = plan_render_queue(true);
+
+    s64 start_time = get_time_nanoseconds();
+    int num_plans = 1000;
+    for (int i = 0; i < num_plans; i++) plan_render_queue(true);
+    double plan_microseconds = (get_time_nanoseconds() - start_time) / 1000.0 / num_plans;
+
+    clear_render_queue();
+
+    int expected_batches = 0;
+    int quads_per_batch = MAX_IMMEDIATE_VERTICES / 6;
+    for (Queued_State state : states) {
+        expected_batches += (state.num_quads + quads_per_batch - 1) / quads_per_batch;
+    }
+
+    printf("Render queue benchmark: %d commands, %d distinct states\n", sorted.num_commands, states.count);
+    printf("  %-14s %10s %14s\n", "", "batches", "state changes");
+    printf("  %-14s %10d %14d\n", "recorded order", recorded.num_batches, recorded.num_state_changes);
+    printf("  %-14s %10d %14d\n", "sorted", sorted.num_batches, sorted.num_state_changes);
+    printf("  Sorting and planning: %.2f us\n", plan_microseconds);
+
+    bool ok = sorted.num_batches == expected_batches && sorted.num_state_changes <= recorded.num_state_changes;
+    printf(ok ? "One batch per distinct state.\n" : "FAILED: expected %d batches.\n", expected_batches);
+    fflush(stdout);
+    return ok ? 0 : 1;
+}
+
+//
+// frame_arena: `-ticks` frames (default 1000) of frame-local work: the
+// render_queue benchmark's HUD, menu and debug text recorded and planned,
+// debug HUD lines formatted, and a level generator's worth of scratch
+// platforms. Done in the frame arena, and done the way it used to be, in
+// arrays and strings that come from the heap and go back at the end of the
+// frame. The arena has to get through every frame, the first included,
+// without a single heap allocation.
+//
+
+struct Scratch_Platform {
+    int x, y, width;
+};
+
+static void do_frame_local_work(Array <Queued_State> *states, Array <Scratch_Platform> *platforms, bool use_heap, u64 *checksum) {
+    clear_render_queue();
+    queue_test_frame(states);
+    Render_Queue_Stats stats = plan_render_queue(true);
+    *checksum += stats.num_batches;
+
+    for (int i = 0; i < 200; i++) platforms->add({i * 3, (i * 7) % 18, 2 + i % 5});
+    for (Scratch_Platform platform : *platforms) *checksum += platform.x + platform.width;
+
+    for (int line = 0; line < 6; line++) {
+        char *format = "Line %d: %.3f ms, %d batches, %lld bytes";
+        if (use_heap) {
+            int length = snprintf(NULL, 0, format, line, line * 1.5, stats.num_batches, (long long)*checksum);
+            char *text = (char *)tracked_malloc(length + 1);
+            snprintf(text, length + 1, format, line, line * 1.5, stats.num_batches, (long long)*checksum);
+            *checksum += text[length - 1];
+            tracked_free(text);
+        } else {
+            char *text = tprint(format, line, line * 1.5, stats.num_batches, (long long)*checksum);
+            *checksum += text[strlen(text) - 1];
+        }
+    }
+
+    clear_render_queue();
+}
+
+static int benchmark_frame_arena(Benchmark_Options *options) {
+    int frames = options->ticks ? options->ticks : 1000;
+
+    printf("Frame arena benchmark: %d frames\n", frames);
+    printf("  %-6s %14s %14s %14s\n", "", "us per frame", "heap per frame", "arena bytes");
+
+    bool ok = true;
+    u64 checksums[2] = {};
+    for (int use_heap = 0; use_heap < 2; use_heap++) {
+        s64 allocations_before = allocation_counters.num_allocations;
+        size_t most_arena_bytes = 0;
+
+        s64 start_time = get_time_nanoseconds();
+        for (int frame = 0; frame < frames; frame++) {
+            reset_frame_arena();
+
+            Array <Queued_State> states;
+            Array <Scratch_Platform> platforms;
+            if (!use_heap) {
+                states.use_arena(&frame_arena);
+                platforms.use_arena(&frame_arena);
+            }
+
+            do_frame_local_work(&states, &platforms, use_heap, &checksums[use_heap]);
+            most_arena_bytes = Max(most_arena_bytes, frame_arena.offset);
+        }
+        double microseconds = (get_time_nanoseconds() - start_time) / 1000.0 / frames;
+
+        // malloc calls made by the frames themselves; the heap run also
+        // frees every one of them before its frame ends.
+        double allocations = (double)(allocation_counters.num_allocations - allocations_before) / frames;
+        if (!use_heap && allocations) ok = false;
+
+        printf("  %-6s %14.2f %14.1f %14lld\n", use_heap ? "heap" : "arena", microseconds, allocations, (long long)most_arena_bytes);
+    }
+
+    if (checksums[0] != checksums[1]) ok = false;
+
+    printf(ok ? "The arena frames made no heap allocations.\n" : "FAILED: the arena frames allocated or did different work.\n");
+    fflush(stdout);
+    return ok ? 0 : 1;
+}
+
+//
+// vertex_format: the immediate vertices a frame submits, panning over a level
+// of `-count` entities (their circle quads plus a debug HUD's worth of glyph
+// quads), written in the 16-byte packed format and in the 32-byte all-float
+// one it replaced: bytes uploaded per frame, and what the packing costs.
+//
+
+struct Float_Vertex {
+    Vector2 position;
+    Vector4 color;
+    Vector2 uv;
+};
+
+static int benchmark_vertex_format(Benchmark_Options *options) {
+    int count = options->count ? options->count : 10000;
+    int frames = options->ticks ? options->ticks : 1000;
+
+    const int NUM_TEXT_QUADS = 6 * 60; // The F debug HUD.
+
+    int level_width = Max(count / 8, 64);
+    World *world = make_benchmark_world(level_width, options->seed);
+    defer { free_benchmark_world(world); };
+
+    Random_State random;
+    seed_random(&random, options->seed);
+    for (int i = 0; i < count; i++) {
+        Enemy *e = make_enemy(world);
+        set_position(e, v2(random_float(&random) * level_width, 1.0f + random_float(&random) * 16.0f));
+    }
+    sync_broadphase(world->broadphase);
+
+    Array <Entity *> visible;
+    defer { visible.deallocate(); };
+
+    Array <Immediate_Vertex> packed;
+    defer { packed.deallocate(); };
+    Array <Float_Vertex> wide;
+    defer { wide.deallocate(); };
+
+    s64 num_vertices = 0;
+    s64 nanoseconds[2] = {};
+
+    for (int frame = 0; frame < frames; frame++) {
+        float t = frames > 1 ? (float)frame / (float)(frames - 1) : 0.0f;
+        Rectangle2 rect = {t * (level_width - VIEW_AREA_WIDTH), 4.0f, (float)VIEW_AREA_WIDTH, (float)VIEW_AREA_HEIGHT};
+        collect_visible_entities(world, rect, &visible);
+
+        int n = (visible.count + NUM_TEXT_QUADS) * 6;
+        packed.reserve(n);
+        wide.reserve(n);
+        num_vertices += n;
+
+        s64 start_time = get_time_nanoseconds();
+        packed.count = 0;
+        for (Entity *e : visible) {
+            get_circle_quad_vertices(get_position(e), get_radius(e), e->color, packed.data + packed.count);
+            packed.count += 6;
+        }
+        for (int i = 0; i < NUM_TEXT_QUADS; i++) {
+            Vector2 p = v2((float)(i % 60) * 8, (float)(i / 60) * 16);
+            Immediate_Vertex *v = packed.data + packed.count;
+            v[0] = make_immediate_vertex(p,             v4(1, 1, 1, 1), v2(0.25f, 0.5f));
+            v[1] = make_immediate_vertex(p + v2(8, 0),  v4(1, 1, 1, 1), v2(0.26f, 0.5f));
+            v[2] = make_immediate_vertex(p + v2(8, 16), v4(1, 1, 1, 1), v2(0.26f, 0.52f));
+            v[3] = v[0];
+            v[4] = v[2];
+            v[5] = make_immediate_vertex(p + v2(0, 16), v4(1, 1, 1, 1), v2(0.25f, 0.52f));
+            packed.count += 6;
+        }
+        nanoseconds[0] += get_time_nanoseconds() - start_time;
+
+        start_time = get_time_nanoseconds();
+        wide.count = 0;
+        for (Entity *e : visible) {
+            Enemy *enemy = (Enemy *)e;
+            Vector2 c = get_position(enemy);
+            float r = get_radius(enemy);
+            Float_Vertex *v = wide.data + wide.count;
+            v[0] = {v2(c.x - r, c.y - r), enemy->color, v2(-1, -1)};
+            v[1] = {v2(c.x + r, c.y - r), enemy->color, v2(+1, -1)};
+            v[2] = {v2(c.x + r, c.y + r), enemy->color, v2(+1, +1)};
+            v[3] = v[0];
+            v[4] = v[2];
+            v[5] = {v2(c.x - r, c.y + r), enemy->color, v2(-1, +1)};
+            wide.count += 6;
+        }
+        for (int i = 0; i < NUM_TEXT_QUADS; i++) {
+            Vector2 p = v2((float)(i % 60) * 8, (float)(i / 60) * 16);
+            Float_Vertex *v = wide.data + wide.count;
+            v[0] = {p,             v4(1, 1, 1, 1), v2(0.25f, 0.5f)};
+            v[1] = {p + v2(8, 0),  v4(1, 1, 1, 1), v2(0.26f, 0.5f)};
+            v[2] = {p + v2(8, 16), v4(1, 1, 1, 1), v2(0.26f, 0.52f)};
+            v[3] = v[0];
+            v[4] = v[2];
+            v[5] = {p + v2(0, 16), v4(1, 1, 1, 1), v2(0.25f, 0.52f)};
+            wide.count += 6;
+        }
+        nanoseconds[1] += get_time_nanoseconds() - start_time;
+    }
+
+    double vertices_per_frame = (double)num_vertices / frames;
+    printf("Vertex format benchmark: %d entities, %.0f vertices per frame\n", count, vertices_per_frame);
+    printf("  %-8s %12s %14s %16s\n", "format", "bytes/vert", "KB/frame", "write ns/frame");
+    printf("  %-8s %12d %14.1f %16.0f\n", "float", (int)sizeof(Float_Vertex), vertices_per_frame * sizeof(Float_Vertex) / 1024.0, (double)nanoseconds[1] / frames);
+    printf("  %-8s %12d %14.1f %16.0f\n", "packed", (int)sizeof(Immediate_Vertex), vertices_per_frame * sizeof(Immediate_Vertex) / 1024.0, (double)nanoseconds[0] / frames);
+    fflush(stdout);
+    return 0;
+}
+
+//
+// frames: draw_main_menu and draw_world, after `-ticks` ticks (default 240)
+// of the hero running right, into an offscreen framebuffer `-count` times
+// each (default 100): time per frame and what a frame submits. With
+// `-golden dir` the last frame of each is compared against dir/<name>.png,
+// or written there with -write_golden. Needs the software renderer, since
+// headless there is no GL context to draw with.
+//
+
+#ifdef RENDER_SOFTWARE
+
+const int FRAMES_WIDTH  = 1280;
+const int FRAMES_HEIGHT = 720;
+
+// A pixel differs when a channel is off by more than GOLDEN_TOLERANCE; a
+// frame matches with up to GOLDEN_MAX_DIFFERING of its pixels differing.
+// Slack for float math rounding differently between compilers, not for
+// anything that would show.
+const int GOLDEN_TOLERANCE = 2;
+const double GOLDEN_MAX_DIFFERING = 0.001;
+
+static bool check_golden_image(Benchmark_Options *options, char *name, u8 *rgba, int width, int height) {
+    char filepath[512];
+    snprintf(filepath, sizeof(filepath), "%s/%s.png", options->golden_directory, name);
+
+    if (options->write_golden) {
+        stbi_flip_vertically_on_write(1);
+        if (!stbi_write_png(filepath, width, height, 4, rgba, width * 4)) {
+            printf("  FAILED to write '%s'.\n", filepath);
+            return false;
+        }
+        printf("  Wrote '%s'.\n", filepath);
+        return true;
+    }
+
+    int golden_width, golden_height, channels;
+    stbi_set_flip_vertically_on_load(1);
+    u8 *golden = stbi_load(filepath, &golden_width, &golden_height, &channels, 4);
+    if (!golden) {
+        printf("  FAILED: no golden image '%s' (make one with -write_golden).\n", filepath);
+        return false;
+    }
+    defer { stbi_image_free(golden); };
+
+    if (golden_width != width || golden_height != height) {
+        printf("  FAILED: '%s' is %dx%d, the frame %dx%d.\n", filepath, golden_width, golden_height, width, height);
+        return false;
+    }
+
+    s64 num_pixels = (s64)width * height;
+    s64 num_differing = 0;
+    int max_difference = 0;
+    for (s64 i = 0; i < num_pixels; i++) {
+        int difference = 0;
+        for (int c = 0; c < 4; c++) {
+            difference = Max(difference, abs((int)rgba[i * 4 + c] - (int)golden[i * 4 + c]));
+        }
+
+        max_difference = Max(max_difference, difference);
+        if (difference > GOLDEN_TOLERANCE) num_differing++;
+    }
+
+    bool ok = num_differing <= (s64)(GOLDEN_MAX_DIFFERING * num_pixels);
+    printf("  %-6s %s '%s': %lld pixels differ, by up to %d\n", name, ok ? "matches" : "FAILED, differs from", filepath, (long long)num_differing, max_difference);
+    return ok;
+}
+
+static int benchmark_frames(Benchmark_Options *options) {
+    int repeats = options->count ? options->count : 100;
+    int ticks = options->ticks ? options->ticks : 240;
+
+    if (!init_rendering(NULL, false)) return 1;
+    init_shaders();
+    load_textures();
+    wait_for_asset_loads();
+
+    globals.window_width  = globals.render_width  = FRAMES_WIDTH;
+    globals.window_height = globals.render_height = FRAMES_HEIGHT;
+
+    Framebuffer *framebuffer = make_framebuffer(FRAMES_WIDTH, FRAMES_HEIGHT);
+    defer { release_framebuffer(framebuffer); free(framebuffer); };
+
+    seed_random(options->seed);
+    seed_random(&globals.level_random, get_hash(options->seed));
+    globals.should_switch_worlds = false;
+
+    create_menu_world();
+    defer { free_benchmark_world(globals.menu_world); globals.menu_world = NULL; };
+
+    World *world = make_headless_world(globals.start_level_width);
+    defer { free_benchmark_world(world); };
+
+    globals.current_world = world;
+    float dt = 1.0f / FIXED_UPDATE_HZ;
+    for (int tick = 0; tick < ticks && !globals.should_switch_worlds; tick++) {
+        advance_key_states();
+        set_key_state(SDL_SCANCODE_D, true);
+        update_world(world, dt);
+    }
+    advance_key_states();
+    set_key_state(SDL_SCANCODE_D, false);
+    advance_key_states();
+
+    Array <u8> pixels;
+    defer { pixels.deallocate(); };
+    pixels.reserve(FRAMES_WIDTH * FRAMES_HEIGHT * 4);
+
+    printf("Frames benchmark: %dx%d software rendered, %d frames each, world after %d ticks\n", FRAMES_WIDTH, FRAMES_HEIGHT, repeats, ticks);
+    printf("  %-6s %10s %10s %10s %12s\n", "frame", "ms/frame", "vertices", "draws", "allocating");
+
+    char *scene_names[] = {"menu", "game"};
+
+    bool ok = true;
+    for (int scene = 0; scene < 2; scene++) {
+        char *name = scene_names[scene];
+        globals.current_world = scene == 0 ? globals.menu_world : world;
+        globals.program_mode  = scene == 0 ? PROGRAM_MODE_MAIN_MENU : PROGRAM_MODE_GAME;
+
+        reset_allocation_frame_stats();
+
+        s64 start_time = get_time_nanoseconds();
+        for (int i = 0; i < repeats; i++) {
+            reset_frame_arena();
+            render_stats = {};
+
+            set_framebuffer(framebuffer);
+            set_viewport(0, 0, FRAMES_WIDTH, FRAMES_HEIGHT);
+            set_shader(NULL);
+
+            if (scene == 0) draw_main_menu();
+            else            draw_world(world);
+
+            // The first frame loads glyphs and sizes the queues; every one
+            // after it should draw without touching the heap.
+            if (i == 0) begin_allocation_frame();
+            else        end_allocation_frame();
+        }
+        double milliseconds = (get_time_nanoseconds() - start_time) / 1000000.0 / repeats;
+
+        printf("  %-6s %10.3f %10lld %10lld %6lld/%-5lld\n", name, milliseconds, (long long)render_stats.num_vertices, (long long)render_stats.num_draw_calls,
+               (long long)allocation_frame_stats.num_frames_that_allocated, (long long)allocation_frame_stats.num_frames);
+        if (allocation_frame_stats.num_frames_that_allocated) ok = false;
+
+        if (options->golden_directory) {
+            read_framebuffer(framebuffer, pixels.data);
+            if (!check_golden_image(options, name, pixels.data, FRAMES_WIDTH, FRAMES_HEIGHT)) ok = false;
+        }
+    }
+
+    globals.current_world = NULL;
+    globals.program_mode  = PROGRAM_MODE_MAIN_MENU;
+
+    fflush(stdout);
+    return ok ? 0 : 1;
+}
+
+#else
+
+static int benchmark_frames(Benchmark_Options *options) {
+    logprintf("The frames benchmark needs a build with RENDER_SOFTWARE.\n");
+    return 1;
+}
+
+#endif
+
+//
+// asset_loads: loads what load_assets does `-count` times (default 5), once
+// with the blocking find_or_load_* calls and once with the
+// find_or_start_loading_* ones the game starts with, calling
+// update_asset_loads once every frame (a millisecond of sleep here) until
+// everything is in. Reports how long until the calls return, which is when
+// the game could show the menu, how long until everything is loaded, and the
+// most one frame spent filling handles in. Both have to end up with the same
+// sounds. Needs the software renderer, to upload textures with no GL
+// context; builds with USE_PACKAGE load from assets.pak.
+//
+
+#ifdef RENDER_SOFTWARE
+
+struct Startup_Asset {
+    char *name;
+    bool is_sound;
+    bool is_looping;
+};
+
+static Startup_Asset startup_assets[] = {
+    {"heart_full_16x16",   false, false},
+    {"heart_half_16x16",   false, false},
+    {"heart_empty_16x16",  false, false},
+    {"restart_taken",      false, false},
+    {"restart_available",  false, false},
+    {"menu-music",         true,  true},
+    {"level-music",        true,  true},
+    {"coin-pickup",        true,  false},
+    {"level-completed",    true,  false},
+    {"death",              true,  false},
+    {"jump",               true,  false},
+    {"damage",             true,  false},
+    {"enemy-kill",         true,  false},
+    {"level-failed",       true,  false},
+    {"menu-change-option", true,  false},
+    {"menu-select",        true,  false},
+    {"exit-menu",          true,  false},
+};
+
+static int benchmark_asset_loads(Benchmark_Options *options) {
+    int repeats = options->count ? options->count : 5;
+    int num_assets = ArrayCount(startup_assets);
+
+    if (!init_rendering(NULL, false)) return 1;
+
+#ifdef USE_PACKAGE
+    if (!read_package(&globals.package)) return 1;
+    defer { free_package(&globals.package); };
+#endif
+
+    defer { shutdown_asset_loader(); };
+
+    Array <u32> sound_lengths;
+    sound_lengths.reserve(num_assets);
+    sound_lengths.count = num_assets;
+
+    s64 blocking_nanoseconds = 0;
+    for (int r = 0; r < repeats; r++) {
+        s64 start_time = get_time_nanoseconds();
+        for (int i = 0; i < num_assets; i++) {
+            Startup_Asset *asset = &startup_assets[i];
+            if (asset->is_sound) {
+                Sound *sound = find_or_load_sound(asset->name, asset->is_looping);
+                sound_lengths[i] = sound ? sound->length : 0;
+            } else {
+                find_or_load_texture(asset->name);
+            }
+        }
+        blocking_nanoseconds += get_time_nanoseconds() - start_time;
+
+        resource_manager_reset();
+    }
+
+    s64 return_nanoseconds = 0, loaded_nanoseconds = 0, max_frame_nanoseconds = 0;
+    int num_frames = 0;
+    bool ok = true;
+
+    for (int r = 0; r < repeats; r++) {
+        Array <Sound *> sounds;
+        sounds.reserve(num_assets);
+        sounds.count = num_assets;
+
+        s64 start_time = get_time_nanoseconds();
+        for (int i = 0; i < num_assets; i++) {
+            Startup_Asset *asset = &startup_assets[i];
+            if (asset->is_sound) sounds[i] = find_or_start_loading_sound(asset->name, asset->is_looping);
+            else                 find_or_start_loading_texture(asset->name);
+        }
+        return_nanoseconds += get_time_nanoseconds() - start_time;
+
+        while (get_num_asset_loads_in_flight()) {
+            sleep_nanoseconds(1000000); // The rest of the frame.
+
+            s64 frame_start_time = get_time_nanoseconds();
+            update_asset_loads();
+            max_frame_nanoseconds = Max(max_frame_nanoseconds, get_time_nanoseconds() - frame_start_time);
+            num_frames++;
+        }
+        loaded_nanoseconds += get_time_nanoseconds() - start_time;
+
+        for (int i = 0; i < num_assets; i++) {
+            if (!startup_assets[i].is_sound) continue;
+
+            u32 length = sounds[i] ? sounds[i]->length : 0;
+            if (length != sound_lengths[i]) ok = false;
+        }
+
+        resource_manager_reset();
+    }
+
+    printf("Asset load benchmark: %d textures and sounds, loaded %d times each way\n", num_assets, repeats);
+    printf("  blocking: %.2f ms\n", blocking_nanoseconds / 1.0e6 / repeats);
+    printf("  async: calls return in %.3f ms, everything in after %.2f ms and %.1f frames, at most %.3f ms a frame filling it in\n",
+           return_nanoseconds / 1.0e6 / repeats, loaded_nanoseconds / 1.0e6 / repeats, (double)num_frames / repeats, max_frame_nanoseconds / 1.0e6);
+
+    printf(ok ? "Both ways load the same sounds.\n" : "FAILED: the async loads differ from the blocking ones.\n");
+    fflush(stdout);
+    return ok ? 0 : 1;
+}
+
+#else
+
+static int benchmark_asset_loads(Benchmark_Options *options) {
+    logprintf("The asset_loads benchmark needs a build with RENDER_SOFTWARE.\n");
+    return 1;
+}
+
+#endif
+
+//
+// package: writes the game's assets as a version 1 package and as a mapped
+// version 2 one, then opens each `-count` times (default 20) the way startup
+// does: how long read_package takes, what it copies onto the heap, and how
+// long reading a byte from every page of every asset takes after that, which
+// is when a mapped package actually reads the file. Both have to hand out
+// the same entries with the same bytes. Run it from the directory with data/
+// in it.
+//
+
+static u64 touch_package(Package *package) {
+    u64 result = 0;
+    for (int i = 0; i < package->num_assets; i++) {
+        Package_Asset_Entry *entry = &package->assets[i];
+        for (s64 j = 0; j < entry->size; j += 4096) result += entry->data[j];
+    }
+    return result;
+}
+
+static bool packages_match(Package *a, Package *b) {
+    if (a->num_assets != b->num_assets) return false;
+
+    for (int i = 0; i < a->num_assets; i++) {
+        Package_Asset_Entry *x = &a->assets[i];
+        Package_Asset_Entry *y = &b->assets[i];
+        if (x->type != y->type || x->size != y->size || x->is_looping != y->is_looping) return false;
+        if (x->width != y->width || x->height != y->height) return false;
+        if (x->name_length != y->name_length || memcmp(x->name, y->name, x->name_length)) return false;
+        if (memcmp(x->data, y->data, x->size)) return false;
+    }
+    return true;
+}
+
+struct Package_Kind {
+    char *label;
+    char *filepath;
+    int version;
+    bool compress;
+    int num_worker_threads; // -1 for whatever the job system already has.
+};
+
+static int benchmark_package(Benchmark_Options *options) {
+    int repeats = options->count ? options->count : 20;
+
+    Package_Kind kinds[] = {
+        {"v1 copy",   "benchmark_v1.pak",    1, false, -1},
+        {"v2 mmap",   "benchmark_v2.pak",    2, false, -1},
+        {"v2 lz",     "benchmark_v2_lz.pak", 2, true,  -1},
+        {"lz serial", "benchmark_v2_lz.pak", 2, true,   0},
+    };
+    defer {
+        for (Package_Kind kind : kinds) remove(kind.filepath);
+    };
+
+    for (Package_Kind kind : kinds) {
+        Package_Options package_options;
+        package_options.output_filepath = kind.filepath;
+        package_options.version         = kind.version;
+        package_options.compress        = kind.compress;
+
+        if (!create_package(&package_options)) {
+            logprintf("Failed to write '%s'!\n", kind.filepath);
+            return 1;
+        }
+    }
+
+    Package reference;
+    if (!read_package(&reference, kinds[0].filepath)) return 1;
+    defer { free_package(&reference); };
+
+    s64 total_bytes = 0;
+    for (int i = 0; i < reference.num_assets; i++) total_bytes += reference.assets[i].size;
+
+    int num_worker_threads = get_num_worker_threads();
+
+    printf("Package benchmark: %d assets, %.1f KB, opened %d times each, %d worker threads\n", reference.num_assets, total_bytes / 1024.0, repeats, num_worker_threads);
+    printf("  %-10s %10s %12s %14s %12s\n", "", "file KB", "open us", "heap KB", "touch us");
+
+    bool ok = true;
+    for (Package_Kind kind : kinds) {
+        if (kind.num_worker_threads >= 0) {
+            shutdown_job_system();
+            init_job_system(kind.num_worker_threads);
+        }
+
+        File_Mapping file;
+        map_file(kind.filepath, &file);
+        s64 file_size = file.size;
+        unmap_file(&file);
+
+        s64 open_nanoseconds = 0, touch_nanoseconds = 0, heap_bytes = 0;
+        u64 checksum = 0;
+
+        for (int r = 0; r < repeats; r++) {
+            Package package;
+            s64 bytes_before = allocation_counters.num_bytes_allocated;
+
+            s64 start_time = get_time_nanoseconds();
+            if (!read_package(&package, kind.filepath)) return 1;
+            s64 open_time = get_time_nanoseconds();
+            checksum += touch_package(&package);
+            s64 touch_time = get_time_nanoseconds();
+
+            open_nanoseconds  += open_time - start_time;
+            touch_nanoseconds += touch_time - open_time;
+            heap_bytes = allocation_counters.num_bytes_allocated - bytes_before;
+
+            if (r == 0 && !packages_match(&reference, &package)) ok = false;
+            free_package(&package);
+        }
+
+        printf("  %-10s %10.1f %12.1f %14.1f %12.1f\n", kind.label, file_size / 1024.0,
+               open_nanoseconds / 1000.0 / repeats, heap_bytes / 1024.0, touch_nanoseconds / 1000.0 / repeats);
+        if (!checksum) ok = false; // Keeps the touching from being optimized out.
+
+        if (kind.num_worker_threads >= 0) {
+            shutdown_job_system();
+            init_job_system(num_worker_threads);
+        }
+    }
+
+    printf(ok ? "Every package hands out the same assets.\n" : "FAILED: the packages differ.\n");
+    fflush(stdout);
+    return ok ? 0 : 1;
+}
+
+//
+// package_lookup: a package of `-count` small made-up assets (default 4096,
+// about what shipping every font in data/fonts at a few sizes would be),
+// with every name looked up `-ticks` times (default 10) through the hashed
+// name index and by comparing names one entry at a time, as packages without
+// an index still are. Every lookup has to find its own entry, and names that
+// are not in the package nothing.
+//
+
+static int benchmark_package_lookup(Benchmark_Options *options) {
+    int count = options->count ? options->count : 4096;
+    int rounds = options->ticks ? options->ticks : 10;
+
+    char *filepath = "benchmark_lookup.pak";
+    defer { remove(filepath); };
+
+    Array <char *> names;
+    Array <Package_Asset_Entry> entries;
+    defer {
+        for (char *name : names) delete [] name;
+        names.deallocate();
+        entries.deallocate();
+    };
+
+    u8 data[64] = {};
+    for (int i = 0; i < count; i++) {
+        char *name = new char[32];
+        snprintf(name, 32, "Font-%05d-Regular", i);
+        names.add(name);
+
+        Package_Asset_Entry entry = {};
+        entry.type        = PACKAGE_ASSET_FONT;
+        entry.name        = name;
+        entry.name_length = (s64)strlen(name);
+        entry.size        = sizeof(data);
+        entry.data        = data;
+        entries.add(entry);
+    }
+
+    if (!write_package(filepath, entries.data, entries.count)) return 1;
+
+    Package package;
+    if (!read_package(&package, filepath)) return 1;
+    defer { free_package(&package); };
+
+    printf("Package lookup benchmark: %d assets, %d index slots, every name looked up %d times\n", count, package.num_index_slots, rounds);
+    printf("  %-8s %16s\n", "", "ns per lookup");
+
+    Package_Index_Slot *index = package.index;
+
+    bool ok = index != NULL;
+    for (int indexed = 1; indexed >= 0; indexed--) {
+        package.index = indexed ? index : NULL;
+
+        s64 start_time = get_time_nanoseconds();
+        for (int r = 0; r < rounds; r++) {
+            for (int i = 0; i < count; i++) {
+                if (find_asset_by_name(&package, names[i]) != &package.assets[i]) ok = false;
+            }
+        }
+        double nanoseconds = (double)(get_time_nanoseconds() - start_time) / ((double)rounds * count);
+
+        if (find_asset_by_name(&package, "Font-Missing-Regular")) ok = false;
+        if (find_asset_by_name(&package, "")) ok = false;
+
+        printf("  %-8s %16.1f\n", indexed ? "indexed" : "linear", nanoseconds);
+    }
+    package.index = index;
+
+    printf(ok ? "Every name found its own entry.\n" : "FAILED: a lookup found the wrong entry.\n");
+    fflush(stdout);
+    return ok ? 0 : 1;
+}
+
+//
+// package_build: builds a package from data/package.manifest plus one extra
+// texture, first with no cache, then again with the cache that wrote, then
+// after the extra texture changes, each `-count` times (default 5), with and
+// without compression. How long each takes and what it had to redo: the
+// second build should take everything from the cache and write exactly the
+// same package as the first, and the third redo only the changed texture.
+// Run it from the directory with data/ in it.
+//
+
+static bool write_build_texture(char *filepath, int size, u8 shade) {
+    Array <u8> pixels;
+    pixels.reserve(size * size * 4);
+    pixels.count = size * size * 4;
+    for (int i = 0; i < pixels.count; i++) pixels[i] = (i % 4 == 3) ? 255 : (u8)(shade + ((u32)i * 2654435761u >> 27));
+
+    return stbi_write_png(filepath, size, size, 4, pixels.data, size * 4) != 0;
+}
+
+static bool files_match(char *a, char *b) {
+    s64 a_length, b_length;
+    char *a_data = read_entire_file(a, &a_length, false);
+    char *b_data = read_entire_file(b, &b_length, false);
+    defer {
+        delete [] a_data;
+        delete [] b_data;
+    };
+
+    return a_data && b_data && a_length == b_length && memcmp(a_data, b_data, a_length) == 0;
+}
+
+static int benchmark_package_build(Benchmark_Options *options) {
+    int repeats = options->count ? options->count : 5;
+
+    char *manifest_filepath  = "benchmark_build.manifest";
+    char *texture_filepath   = "benchmark_build_texture.png";
+    char *output_filepath    = "benchmark_build.pak";
+    char *reference_filepath = "benchmark_build_reference.pak";
+    char *cache_filepath     = "benchmark_build.pak.cache";
+    defer {
+        remove(manifest_filepath);
+        remove(texture_filepath);
+        remove(output_filepath);
+        remove(reference_filepath);
+        remove(cache_filepath);
+    };
+
+    // The game's manifest with the texture on the end.
+    s64 manifest_length;
+    char *manifest = read_entire_file("data/package.manifest", &manifest_length, false);
+    if (!manifest) {
+        logprintf("Failed to read 'data/package.manifest'!\n");
+        return 1;
+    }
+    defer { delete [] manifest; };
+
+    FILE *file = fopen(manifest_filepath, "wb");
+    if (!file) return 1;
+    fwrite(manifest, 1, manifest_length, file);
+    fprintf(file, "\n%s\n", texture_filepath);
+    fclose(file);
+
+    printf("Package build benchmark: data/package.manifest and a 1024x1024 texture, each build %d times\n", repeats);
+    printf("  %-10s %10s %8s %8s %11s %8s\n", "", "build ms", "assets", "decoded", "compressed", "reused");
+
+    bool ok = true;
+    for (int compress = 0; compress <= 1; compress++) {
+        Package_Options package_options;
+        package_options.manifest_filepath = manifest_filepath;
+        package_options.output_filepath   = output_filepath;
+        package_options.cache_filepath    = cache_filepath;
+        package_options.compress          = compress != 0;
+
+        if (!write_build_texture(texture_filepath, 1024, 0)) return 1;
+
+        for (int step = 0; step < 3; step++) {
+            s64 nanoseconds = 0;
+            Package_Build_Stats stats;
+
+            for (int r = 0; r < repeats; r++) {
+                if (step == 0) remove(cache_filepath);
+                if (step == 2 && !write_build_texture(texture_filepath, 1024, (u8)(r + 1))) return 1;
+
+                s64 start_time = get_time_nanoseconds();
+                if (!create_package(&package_options, &stats)) return 1;
+                nanoseconds += get_time_nanoseconds() - start_time;
+            }
+
+            int num_assets = stats.num_assets;
+            if (step == 0) {
+                if (stats.num_reused || stats.num_decoded == 0) ok = false;
+                if (!replace_file(output_filepath, reference_filepath)) return 1;
+            } else if (step == 1) {
+                if (stats.num_reused != num_assets || stats.num_decoded || stats.num_compressed) ok = false;
+                if (!files_match(output_filepath, reference_filepath)) ok = false;
+            } else {
+                if (stats.num_reused != num_assets - 1 || stats.num_decoded != 1 || stats.num_compressed != compress) ok = false;
+            }
+
+            char *labels[] = {"cold", "warm", "edited"};
+            char label[32];
+            snprintf(label, sizeof(label), "%s%s", labels[step], compress ? " lz" : "");
+
+            printf("  %-10s %10.2f %8d %8d %11d %8d\n", label, nanoseconds / 1.0e6 / repeats,
+                   num_assets, stats.num_decoded, stats.num_compressed, stats.num_reused);
+        }
+    }
+
+    printf(ok ? "Warm builds reuse everything and write the same package; edits redo only what changed.\n" : "FAILED: a build redid the wrong assets or wrote a different package.\n");
+    fflush(stdout);
+    return ok ? 0 : 1;
+}
+
+int run_benchmark(char *name, int argc, char *argv[]) {
+    Benchmark_Options options;
+    parse_benchmark_options(&options, argc, argv);
+
+    if (strings_match(name, "pools"))       return benchmark_pools(&options);
+    if (strings_match(name, "destruction")) return benchmark_destruction(&options);
+    if (strings_match(name, "broadphase"))  return benchmark_broadphase(&options);
+    if (strings_match(name, "jobs"))        return benchmark_jobs(&options);
+    if (strings_match(name, "tiles"))       return benchmark_tiles(&options);
+    if (strings_match(name, "sweeps"))      return benchmark_sweeps(&options);
+    if (strings_match(name, "pacer"))       return benchmark_pacer(&options);
+    if (strings_match(name, "tilemap_draw")) return benchmark_tilemap_draw(&options);
+    if (strings_match(name, "culling"))     return benchmark_culling(&options);
+    if (strings_match(name, "circles"))     return benchmark_circles(&options);
+    if (strings_match(name, "render_queue")) return benchmark_render_queue(&options);
+    if (strings_match(name, "frame_arena")) return benchmark_frame_arena(&options);
+    if (strings_match(name, "vertex_format")) return benchmark_vertex_format(&options);
+    if (strings_match(name, "frames"))      return benchmark_frames(&options);
+    if (strings_match(name, "asset_loads")) return benchmark_asset_loads(&options);
+    if (strings_match(name, "package"))     return benchmark_package(&options);
+    if (strings_match(name, "package_lookup")) return benchmark_package_lookup(&options);
+    if (strings_match(name, "package_build")) return benchmark_package_build(&options);
+
+    logprintf("Unknown benchmark '%s'!\n", name);
+    return 1;
+}
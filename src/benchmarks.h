@@ -0,0 +1,5 @@
+#pragma once
+
+// Focused micro-benchmarks, run with `vertune -headless -benchmark <name>`.
+// Each prints its own report to stdout; returns the process exit code.
+int run_benchmark(char *name, int argc, char *argv[]);
@@ -0,0 +1,137 @@
+#include "main.h"
+#include "broadphase.h"
+#include "world.h"
+#include "entity.h"
+#include "sort.h"
+
+static int get_cell_x(Broadphase *broadphase, float x) {
+    int cell_x = (int)floorf(x);
+    return Max(0, Min(cell_x, broadphase->width - 1));
+}
+
+static int get_cell_y(Broadphase *broadphase, float y) {
+    int cell_y = (int)floorf(y);
+    return Max(0, Min(cell_y, broadphase->height - 1));
+}
+
+static int get_cell_index(Broadphase *broadphase, Vector2 position) {
+    return get_cell_y(broadphase, position.y) * broadphase->width + get_cell_x(broadphase, position.x);
+}
+
+static void link_into_cell(Broadphase *broadphase, Entity *e, int cell) {
+    Broadphase_Link *link = &e->broadphase_link;
+    link->cell = cell;
+    link->prev = NULL;
+    link->next = broadphase->cells.data[cell];
+    if (link->next) link->next->broadphase_link.prev = e;
+    broadphase->cells.data[cell] = e;
+}
+
+static void unlink_from_cell(Broadphase *broadphase, Entity *e) {
+    Broadphase_Link *link = &e->broadphase_link;
+    if (link->prev) link->prev->broadphase_link.next = link->next;
+    else            broadphase->cells.data[link->cell] = link->next;
+    if (link->next) link->next->broadphase_link.prev = link->prev;
+
+    link->cell = -1;
+    link->prev = NULL;
+    link->next = NULL;
+}
+
+void init_broadphase(Broadphase *broadphase, int width, int height) {
+    broadphase->width  = Max(width, 1);
+    broadphase->height = Max(height, 1);
+    broadphase->max_radius = 0.0f;
+
+    int num_cells = broadphase->width * broadphase->height;
+    broadphase->cells.resize(num_cells);
+    memset(broadphase->cells.data, 0, num_cells * sizeof(Entity *));
+
+    broadphase->pending.count = 0;
+}
+
+void deinit_broadphase(Broadphase *broadphase) {
+    broadphase->cells.deallocate();
+    broadphase->pending.deallocate();
+    broadphase->sort_scratch.deallocate();
+    broadphase->width  = 0;
+    broadphase->height = 0;
+}
+
+void add_to_broadphase(Broadphase *broadphase, Entity *e) {
+    Broadphase_Link *link = &e->broadphase_link;
+    assert(link->cell == -1 && link->pending_index == -1);
+
+    link->pending_index = broadphase->pending.count;
+    broadphase->pending.add(e);
+}
+
+void remove_from_broadphase(Broadphase *broadphase, Entity *e) {
+    Broadphase_Link *link = &e->broadphase_link;
+
+    if (link->pending_index != -1) {
+        int index = link->pending_index;
+        broadphase->pending.unordered_remove_by_index(index);
+        if (index < broadphase->pending.count) {
+            broadphase->pending[index]->broadphase_link.pending_index = index;
+        }
+        link->pending_index = -1;
+    }
+
+    if (link->cell != -1) unlink_from_cell(broadphase, e);
+}
+
+bool is_same_broadphase_cell(Broadphase *broadphase, Vector2 a, Vector2 b) {
+    return get_cell_index(broadphase, a) == get_cell_index(broadphase, b);
+}
+
+void update_broadphase_entity(Broadphase *broadphase, Entity *e) {
+    Broadphase_Link *link = &e->broadphase_link;
+    if (link->cell == -1) return; // Still pending, gets filed at the sync.
+
+    int cell = get_cell_index(broadphase, get_position(e));
+    if (cell == link->cell) return;
+
+    unlink_from_cell(broadphase, e);
+    link_into_cell(broadphase, e, cell);
+}
+
+void sync_broadphase(Broadphase *broadphase) {
+    for (Entity *e : broadphase->pending) {
+        e->broadphase_link.pending_index = -1;
+        link_into_cell(broadphase, e, get_cell_index(broadphase, get_position(e)));
+        broadphase->max_radius = Max(broadphase->max_radius, get_radius(e));
+    }
+    broadphase->pending.count = 0;
+}
+
+// Type, then slot: the order walking each type's pool in turn visits them.
+static u64 get_pool_order_key(Entity *e) {
+    return ((u64)e->type << 32) | e->pool_handle.index;
+}
+
+void query_broadphase(Broadphase *broadphase, Rectangle2 rect, u32 type_mask, Array <Entity *> *results) {
+    results->count = 0;
+    if (!broadphase->cells.count) return;
+
+    if (broadphase->pending.count) sync_broadphase(broadphase);
+
+    float r = broadphase->max_radius;
+    int x0 = get_cell_x(broadphase, rect.x - r);
+    int x1 = get_cell_x(broadphase, rect.x + rect.width + r);
+    int y0 = get_cell_y(broadphase, rect.y - r);
+    int y1 = get_cell_y(broadphase, rect.y + rect.height + r);
+
+    for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++) {
+            for (Entity *e = broadphase->cells.data[y * broadphase->width + x]; e; e = e->broadphase_link.next) {
+                if (type_mask & Bit(e->type)) results->add(e);
+            }
+        }
+    }
+
+    // Hits get resolved in order (the hero only stomps the first enemy) and
+    // entities drawn in order, so hand them back in the same order a full
+    // pool walk would visit them.
+    radix_sort_by_u64_key(results->data, results->count, &broadphase->sort_scratch, get_pool_order_key);
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+struct World;
+struct Entity;
+
+// Uniform grid over the world, one cell per tile, holding every enemy,
+// projectile and pickup in the cell its center is in. Cells are intrusive
+// linked lists through Entity::broadphase_link, so keeping the grid current is
+// O(1) per entity that changes cell: update_world re-files movers right after
+// updating them, and new entities wait in a pending list until the next sync,
+// since their positions get set after they are made.
+struct Broadphase {
+    int width = 0;
+    int height = 0;
+
+    float max_radius = 0.0f; // Queries grow by this, since entities are filed by center.
+
+    Array <Entity *> cells;   // width * height list heads.
+    Array <Entity *> pending; // Made, not yet filed.
+    Array <Entity *> sort_scratch; // For putting query results in pool order.
+};
+
+void init_broadphase(Broadphase *broadphase, int width, int height);
+void deinit_broadphase(Broadphase *broadphase);
+
+void add_to_broadphase(Broadphase *broadphase, Entity *e);      // Filed at the next sync.
+void remove_from_broadphase(Broadphase *broadphase, Entity *e);
+void update_broadphase_entity(Broadphase *broadphase, Entity *e); // Call after moving e.
+bool is_same_broadphase_cell(Broadphase *broadphase, Vector2 a, Vector2 b); // Read-only, safe on job threads.
+void sync_broadphase(Broadphase *broadphase);                   // Files everything pending.
+
+// Appends every entity whose type is in type_mask (Bit(ENTITY_TYPE_*)) and that
+// might touch rect, sorted the way the type's pool iterates. Callers still do
+// the exact test; results is cleared first.
+void query_broadphase(Broadphase *broadphase, Rectangle2 rect, u32 type_mask, Array <Entity *> *results);
@@ -25,19 +25,21 @@ void update_camera(Camera *camera, World *world, float dt) {
     Entity *e = get_entity_by_id(world, camera->following_id);
     if (!e) return;
 
+    Vector2 position = get_position(e);
+
     Vector2 dead_zone_min = camera->target - camera->dead_zone_size * 0.5f;
     Vector2 dead_zone_max = camera->target + camera->dead_zone_size * 0.5f;
 
-    if (e->position.x < dead_zone_min.x) {
-        camera->target.x = e->position.x + camera->dead_zone_size.x * 0.5f;
-    } else if (e->position.x > dead_zone_max.x) {
-        camera->target.x = e->position.x - camera->dead_zone_size.x * 0.5f;
+    if (position.x < dead_zone_min.x) {
+        camera->target.x = position.x + camera->dead_zone_size.x * 0.5f;
+    } else if (position.x > dead_zone_max.x) {
+        camera->target.x = position.x - camera->dead_zone_size.x * 0.5f;
     }
 
-    if (e->position.y < dead_zone_min.y) {
-        camera->target.y = e->position.y + camera->dead_zone_size.y * 0.5f;
-    } else if (e->position.y > dead_zone_max.y) {
-        camera->target.y = e->position.y - camera->dead_zone_size.y * 0.5f;
+    if (position.y < dead_zone_min.y) {
+        camera->target.y = position.y + camera->dead_zone_size.y * 0.5f;
+    } else if (position.y > dead_zone_max.y) {
+        camera->target.y = position.y - camera->dead_zone_size.y * 0.5f;
     }
 
     Vector2 half_size = v2((float)VIEW_AREA_WIDTH * 0.5f, (float)VIEW_AREA_HEIGHT * 0.5f);
@@ -59,14 +61,33 @@ void update_camera(Camera *camera, World *world, float dt) {
     }
 }
 
+// The world position at the bottom-left of the view, and the zoom, blended
+// between the last two ticks.
+static void get_view_origin_and_zoom(Camera *camera, World *world, Vector2 *origin, float *zoom) {
+    float alpha = world->interpolation_alpha;
+    *zoom   = lerp(camera->previous_zoom, camera->zoom, alpha);
+    *origin = lerp(camera->previous_position, camera->position, alpha) - v2(VIEW_AREA_WIDTH * 0.5f, VIEW_AREA_HEIGHT * 0.5f);
+}
+
+Rectangle2 get_visible_world_rect(Camera *camera, World *world) {
+    Vector2 origin;
+    float z;
+    get_view_origin_and_zoom(camera, world, &origin, &z);
+
+    // Zoom scales about the view's bottom-left corner.
+    Rectangle2 result = {origin.x, origin.y, VIEW_AREA_WIDTH / z, VIEW_AREA_HEIGHT / z};
+    return result;
+}
+
 Matrix4 get_world_to_view_matrix(Camera *camera, World *world) {
     Matrix4 m = matrix4_identity();
 
-    float z = camera->zoom;
+    Vector2 position;
+    float z;
+    get_view_origin_and_zoom(camera, world, &position, &z);
     m._11 = z;
     m._22 = z;
     
-    Vector2 position = camera->position - v2(VIEW_AREA_WIDTH * 0.5f, VIEW_AREA_HEIGHT * 0.5f);
     Vector2 screen_space_position = world_space_to_screen_space(world, position);
 
     screen_space_position.x = roundf(screen_space_position.x);
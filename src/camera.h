@@ -4,6 +4,7 @@ struct World;
 
 struct Camera {
     Vector2 position;
+    Vector2 previous_position; // At the start of the last tick, for drawing between ticks.
     Vector2 target;
     u64 following_id;
     Vector2 dead_zone_size;
@@ -18,7 +19,11 @@ struct Camera {
     float intro_start_zoom = 1.0f;
     float intro_end_zoom   = 1.0f;
     float zoom = 1.0f;
+    float previous_zoom = 1.0f;
 };
 
 void update_camera(Camera *camera, World *world, float dt);
 Matrix4 get_world_to_view_matrix(Camera *camera, World *world);
+
+// The part of the world the view matrix above puts on screen, in tiles.
+Rectangle2 get_visible_world_rect(Camera *camera, World *world);
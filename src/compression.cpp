@@ -0,0 +1,156 @@
+#include "general.h"
+#include "compression.h"
+
+#include <stdlib.h>
+
+const int LZ_HASH_BITS = 14;
+
+static inline u32 read_u32(u8 *at) {
+    u32 result;
+    memcpy(&result, at, sizeof(result));
+    return result;
+}
+
+static inline u32 get_lz_hash(u32 sequence) {
+    return (sequence * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+static inline u8 *write_length(u8 *out, s64 length) {
+    while (length >= 255) {
+        *out++ = 255;
+        length -= 255;
+    }
+    *out++ = (u8)length;
+    return out;
+}
+
+// A count that doesn't fit in a nibble takes a byte per 255 of it.
+static inline s64 get_sequence_bound(s64 num_literals, s64 match_length) {
+    return 1 + num_literals / 255 + 1 + num_literals + 2 + match_length / 255 + 1;
+}
+
+static u8 *write_sequence(u8 *out, u8 *literals, s64 num_literals, s64 offset, s64 match_length) {
+    s64 match_code = match_length ? match_length - LZ_MIN_MATCH : 0;
+
+    u8 *token = out++;
+    *token = (u8)((Min(num_literals, 15) << 4) | Min(match_code, 15));
+
+    if (num_literals >= 15) out = write_length(out, num_literals - 15);
+    memcpy(out, literals, num_literals);
+    out += num_literals;
+
+    if (!match_length) return out;
+
+    *out++ = (u8)(offset & 0xFF);
+    *out++ = (u8)(offset >> 8);
+    if (match_code >= 15) out = write_length(out, match_code - 15);
+
+    return out;
+}
+
+s64 get_lz_compress_bound(s64 size) {
+    // Nothing matched at all: one literal-only sequence.
+    return get_sequence_bound(size, 0);
+}
+
+s64 lz_compress(u8 *source, s64 source_size, u8 *dest, s64 dest_capacity) {
+    u32 *table = (u32 *)tracked_calloc(1 << LZ_HASH_BITS, sizeof(u32));
+    if (!table) return 0; // The caller stores the data as it is.
+    defer { tracked_free(table); };
+
+    u8 *out     = dest;
+    u8 *out_end = dest + dest_capacity;
+
+    s64 anchor = 0; // Start of the literals not written yet.
+    s64 at = 0;
+
+    while (at + LZ_MIN_MATCH <= source_size) {
+        u32 sequence = read_u32(source + at);
+        u32 hash = get_lz_hash(sequence);
+
+        s64 candidate = table[hash];
+        table[hash] = (u32)at;
+
+        if (candidate >= at || at - candidate > LZ_MAX_OFFSET || read_u32(source + candidate) != sequence) {
+            // Step further the longer nothing has matched, so data that
+            // doesn't compress doesn't take long to find that out.
+            at += 1 + ((at - anchor) >> 6);
+            continue;
+        }
+
+        s64 match_length = LZ_MIN_MATCH;
+        while (at + match_length < source_size && source[candidate + match_length] == source[at + match_length]) {
+            match_length++;
+        }
+
+        s64 num_literals = at - anchor;
+        if (get_sequence_bound(num_literals, match_length) > out_end - out) return 0;
+
+        out = write_sequence(out, source + anchor, num_literals, at - candidate, match_length);
+
+        at += match_length;
+        anchor = at;
+    }
+
+    s64 num_literals = source_size - anchor;
+    if (get_sequence_bound(num_literals, 0) > out_end - out) return 0;
+    out = write_sequence(out, source + anchor, num_literals, 0, 0);
+
+    return out - dest;
+}
+
+static inline bool read_length(u8 **at, u8 *end, s64 *length) {
+    u8 byte;
+    do {
+        if (*at >= end) return false;
+        byte = *(*at)++;
+        *length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+bool lz_decompress(u8 *source, s64 source_size, u8 *dest, s64 dest_size) {
+    u8 *in      = source;
+    u8 *in_end  = source + source_size;
+    u8 *out     = dest;
+    u8 *out_end = dest + dest_size;
+
+    while (in < in_end) {
+        u8 token = *in++;
+
+        s64 num_literals = token >> 4;
+        if (num_literals == 15 && !read_length(&in, in_end, &num_literals)) return false;
+        if (num_literals > in_end - in || num_literals > out_end - out) return false;
+
+        memcpy(out, in, num_literals);
+        in  += num_literals;
+        out += num_literals;
+
+        if (in == in_end) break; // The last sequence has no match.
+
+        if (in_end - in < 2) return false;
+        s64 offset = in[0] | (in[1] << 8);
+        in += 2;
+
+        s64 match_length = token & 15;
+        if (match_length == 15 && !read_length(&in, in_end, &match_length)) return false;
+        match_length += LZ_MIN_MATCH;
+
+        if (offset == 0 || offset > out - dest || match_length > out_end - out) return false;
+
+        // A match closer than its length repeats a pattern offset bytes long.
+        // Copying from span bytes back, for any multiple of offset, gives the
+        // same bytes, and the span doubles with every copy, so the copies
+        // never overlap and there are only a few of them.
+        s64 span = offset;
+        for (s64 copied = 0; copied < match_length; ) {
+            s64 n = Min(span, match_length - copied);
+            memcpy(out + copied, out + copied - span, n);
+            copied += n;
+            if (copied >= span) span *= 2;
+        }
+        out += match_length;
+    }
+
+    return out == out_end;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+// Byte-oriented LZ77 in the style of LZ4's block format: no entropy coding,
+// so it decodes at memory speed. A block is a run of sequences, each a token
+// byte (high nibble: literal count, low nibble: match length - 4; 15 in
+// either means more bytes follow, each added on, until one isn't 255), the
+// literals, then a 2-byte little-endian offset back into the output and the
+// match length's extra bytes. The last sequence is literals only and ends
+// the block.
+
+const int LZ_MIN_MATCH = 4;
+const int LZ_MAX_OFFSET = 65535;
+
+// No block decodes to more than this many bytes per byte of it: a match costs
+// at least three bytes for 19 bytes out, and every extra length byte adds at
+// most 255.
+const int LZ_MAX_EXPANSION = 255;
+
+// The most lz_compress can write for size bytes of input.
+s64 get_lz_compress_bound(s64 size);
+
+// Returns the compressed size, or 0 if it didn't fit in dest_capacity.
+s64 lz_compress(u8 *source, s64 source_size, u8 *dest, s64 dest_capacity);
+
+// Never reads or writes out of bounds, whatever it is given; returns false
+// unless source decodes to exactly dest_size bytes.
+bool lz_decompress(u8 *source, s64 source_size, u8 *dest, s64 dest_size);
@@ -5,6 +5,10 @@
 #include "tilemap.h"
 #include "particles.h"
 #include "audio.h"
+#include "broadphase.h"
+
+// Scratch for broadphase queries; only the hero queries, on the main thread.
+static Array <Entity *> nearby_entities;
 
 void update_single_hero(Hero *hero, float dt) {
     World *world = hero->world;
@@ -12,6 +16,10 @@ void update_single_hero(Hero *hero, float dt) {
 
     Tilemap *tilemap = world->tilemap;
     assert(tilemap);
+
+    // Sized up front, so the first crowd the hero runs into doesn't grow it
+    // mid-level.
+    nearby_entities.reserve(64);
     
     float input_x = 0.0f;
     if (is_key_down(SDL_SCANCODE_A) || is_key_down(SDL_SCANCODE_LEFT)) { input_x -= 1.0f; hero->is_facing_right = false; }
@@ -30,44 +38,28 @@ void update_single_hero(Hero *hero, float dt) {
 
     hero->velocity.y = Max(hero->velocity.y, MAX_FALL_SPEED);
 
-    Vector2 new_position = hero->position + hero->velocity * dt;
+    Tile_Sweep sweep = sweep_box_through_tilemap(tilemap, hero->position, hero->size, hero->velocity * dt);
+    Vector2 new_position = sweep.position;
     bool has_jumped_on_enemy = false;
+
+    Rectangle2 old_hero_rect = { hero->position.x, hero->position.y, hero->size.x, hero->size.y };
+    query_broadphase(world->broadphase, old_hero_rect, Bit(ENTITY_TYPE_ENEMY), &nearby_entities);
     
-    if (hero->velocity.x <= 0.0f) {
-        u8 tile1_id = get_tile_id_at(tilemap, v2(new_position.x, hero->position.y));
-        u8 tile2_id = get_tile_id_at(tilemap, v2(new_position.x, hero->position.y + hero->size.y * 0.9f));
-        if (is_tile_id_collidable(tilemap, tile1_id) || is_tile_id_collidable(tilemap, tile2_id)) {
-            new_position.x = (int)new_position.x + 1.0f;
-            hero->velocity.x = 0.0f;
-        }
-    } else {
-        u8 tile1_id = get_tile_id_at(tilemap, v2(new_position.x + hero->size.x, hero->position.y));
-        u8 tile2_id = get_tile_id_at(tilemap, v2(new_position.x + hero->size.x, hero->position.y + hero->size.y * 0.9f));
-        if (is_tile_id_collidable(tilemap, tile1_id) || is_tile_id_collidable(tilemap, tile2_id)) {
-            new_position.x = static_cast <float>((int)new_position.x);
-            hero->velocity.x = 0.0f;
-        }
+    if (sweep.hit_x) {
+        hero->velocity.x = 0.0f;
     }
 
     if (hero->velocity.y >= 0) {
-        u8 tile1_id = get_tile_id_at(tilemap, v2(new_position.x, new_position.y + hero->size.y));
-        u8 tile2_id = get_tile_id_at(tilemap, v2(new_position.x + 0.9f * hero->size.x, new_position.y + hero->size.y));
-        if (is_tile_id_collidable(tilemap, tile1_id) || is_tile_id_collidable(tilemap, tile2_id)) {
-            new_position.y = static_cast <float>((int)new_position.y);
-            hero->velocity.y = 0.0f;
-        }
+        if (sweep.hit_y) hero->velocity.y = 0.0f;
     } else {
-        u8 tile1_id = get_tile_id_at(tilemap, new_position);
-        u8 tile2_id = get_tile_id_at(tilemap, v2(new_position.x + 0.9f * hero->size.x, new_position.y));
-        if (is_tile_id_collidable(tilemap, tile1_id) || is_tile_id_collidable(tilemap, tile2_id)) {
-            new_position.y = (int)new_position.y + 1.0f;
+        if (sweep.hit_y) {
             hero->velocity.y = 0.0f;
             hero->is_on_ground = true;
         }
 
-        for (Enemy *enemy : world->by_type._Enemy) {
-            Rectangle2 hero_rect = { hero->position.x, hero->position.y, hero->size.x, hero->size.y };
-            if (are_rect_and_circle_colliding(hero_rect, enemy->position, enemy->radius) && !hero->is_on_ground) {
+        for (Entity *e : nearby_entities) {
+            Enemy *enemy = (Enemy *)e;
+            if (are_rect_and_circle_colliding(old_hero_rect, get_position(enemy), get_radius(enemy)) && !hero->is_on_ground) {
                 schedule_for_destruction(enemy);
                 new_position.y = (int)new_position.y + 1.0f;
                 hero->velocity.y = JUMP_FORCE * 1.5f;
@@ -75,7 +67,7 @@ void update_single_hero(Hero *hero, float dt) {
 
                 has_jumped_on_enemy = true;
 
-                emit_stomp_particles(world->particle_system, enemy->position);
+                emit_stomp_particles(world->particle_system, get_position(enemy));
                 play_sound(globals.enemy_kill_sfx);
                 
                 break;
@@ -84,14 +76,14 @@ void update_single_hero(Hero *hero, float dt) {
     }
 
     if (!has_jumped_on_enemy) {
-        for (Enemy *enemy : world->by_type._Enemy) {
-            Rectangle2 hero_rect = { hero->position.x, hero->position.y, hero->size.x, hero->size.y };
-            Rectangle2 enemy_rect = { enemy->position.x, enemy->position.y, enemy->size.x, enemy->size.y };
-            if (are_rect_and_circle_colliding(hero_rect, enemy->position, enemy->radius)) {
+        for (Entity *e : nearby_entities) {
+            Enemy *enemy = (Enemy *)e;
+            float radius = get_radius(enemy);
+            if (are_rect_and_circle_colliding(old_hero_rect, get_position(enemy), radius)) {
                 if (hero->velocity.x <= 0.0f) {
-                    new_position.x = (int)new_position.x + enemy->radius * 3.0f;
+                    new_position.x = (int)new_position.x + radius * 3.0f;
                 } else {
-                    new_position.x = (int)new_position.x - enemy->radius;
+                    new_position.x = (int)new_position.x - radius;
                 }
                 hero->velocity.x = 0.0f;
                 damage_hero(hero, ENEMY_DAMAGE);
@@ -116,16 +108,24 @@ void update_single_hero(Hero *hero, float dt) {
     }
 
     Rectangle2 hero_rect = { hero->position.x, hero->position.y, hero->size.x, hero->size.y };
-    for (Projectile *projectile : world->by_type._Projectile) {
+    query_broadphase(world->broadphase, hero_rect, Bit(ENTITY_TYPE_PROJECTILE) | Bit(ENTITY_TYPE_PICKUP), &nearby_entities);
+    
+    for (Entity *e : nearby_entities) {
+        if (e->type != ENTITY_TYPE_PROJECTILE) continue;
+        
+        Projectile *projectile = (Projectile *)e;
         if (projectile->scheduled_for_destruction) continue;
 
-        if (are_rect_and_circle_colliding(hero_rect, projectile->position, projectile->radius)) {
+        if (are_rect_and_circle_colliding(hero_rect, get_position(projectile), get_radius(projectile))) {
             damage_hero(hero, PROJECTILE_DAMAGE);
             schedule_for_destruction(projectile);
         }
     }
 
-    for (Pickup *pickup : world->by_type._Pickup) {
+    for (Entity *e : nearby_entities) {
+        if (e->type != ENTITY_TYPE_PICKUP) continue;
+        
+        Pickup *pickup = (Pickup *)e;
         if (pickup->scheduled_for_destruction) continue;
 
         if (are_rect_and_circle_colliding(hero_rect, pickup->position, pickup->radius)) {
@@ -173,10 +173,12 @@ void update_single_hero(Hero *hero, float dt) {
 void draw_single_hero(Hero *hero) {
     World *world = hero->world;
 
+    Vector2 position = get_draw_position(hero);
+
     Vector2 eye_size = hero->size * 0.25f;
     eye_size.y = hero->size.y * 0.35f;
 
-    Vector2 left_eye_position = hero->position + (hero->size * 0.5f - eye_size) * 0.5f;
+    Vector2 left_eye_position = position + (hero->size * 0.5f - eye_size) * 0.5f;
     left_eye_position.y += hero->size.y * 0.5f;
     
     Vector2 right_eye_position = left_eye_position + (hero->size * 0.5f);
@@ -202,7 +204,7 @@ void draw_single_hero(Hero *hero) {
         } break;
     }
     
-    Vector2 body_screen_space_position = world_space_to_screen_space(world, hero->position);
+    Vector2 body_screen_space_position = world_space_to_screen_space(world, position);
     Vector2 body_screen_space_size     = world_space_to_screen_space(world, hero->size);
 
     Vector2 left_eye_screen_space_position  = world_space_to_screen_space(world, left_eye_position);
@@ -234,150 +236,228 @@ void damage_hero(Hero *hero, double damage_amount) {
     }
 }
 
-void update_single_enemy(Enemy *enemy, float dt) {
-    World *world = enemy->world;
-    assert(world);
+static void fire_projectile(World *world, Vector2 position, bool is_facing_right) {
+    Projectile *projectile = make_projectile(world);
+    projectile->color      = v4(1, 0, 1, 1);
+
+    int slot;
+    Projectile_Fields *fields = get_fields(projectile, &slot);
+    fields->position[slot] = position;
+    fields->speed[slot]    = 5.0f;
+    fields->radius[slot]   = 0.2f;
+    fields->flags[slot]    = is_facing_right ? MOVER_FACING_RIGHT : 0;
+}
+
+void apply_entity_commands(World *world, Entity_Commands *commands) {
+    for (Entity_Command command : commands->commands) {
+        switch (command.type) {
+            case ENTITY_COMMAND_FIRE_PROJECTILE: {
+                fire_projectile(world, command.position, command.is_facing_right);
+            } break;
 
+            case ENTITY_COMMAND_DESTROY: {
+                schedule_for_destruction(command.entity);
+            } break;
+
+            case ENTITY_COMMAND_UPDATE_BROADPHASE: {
+                update_broadphase_entity(world->broadphase, command.entity);
+            } break;
+        }
+    }
+
+    commands->commands.count = 0;
+    commands->num_updated = 0;
+}
+
+// Movers only change cell in the sweeps, and were filed by where they were
+// before it, so comparing the two positions' cells is enough; the entity
+// itself isn't touched unless it did move on. Still-pending ones get filed at
+// the next sync anyway, which update_broadphase_entity knows.
+static void refile_if_moved_cell(World *world, Entity *e, Vector2 old_position, Vector2 new_position, Entity_Commands *commands) {
+    if (is_same_broadphase_cell(world->broadphase, old_position, new_position)) return;
+
+    if (commands) {
+        Entity_Command command = {ENTITY_COMMAND_UPDATE_BROADPHASE};
+        command.entity = e;
+        commands->commands.add(command);
+    } else {
+        update_broadphase_entity(world->broadphase, e);
+    }
+}
+
+bool step_enemy(World *world, Vector2 *position, float radius, float speed, u8 *flags,
+                float *time_since_last_projectile, float time_between_projectiles, float dt, Vector2 *projectile_position) {
     Tilemap *tilemap = world->tilemap;
     assert(tilemap);
 
+    bool is_facing_right = (*flags & MOVER_FACING_RIGHT) != 0;
+
     Vector2 move_dir = v2(0, 0);
-    if (enemy->is_facing_right) move_dir.x = +1.0f;
-    else                        move_dir.x = -1.0f;
+    if (is_facing_right) move_dir.x = +1.0f;
+    else                 move_dir.x = -1.0f;
     
-    Vector2 new_position = enemy->position + move_dir * enemy->speed * dt;
-    new_position.x -= 0.5f;
-    new_position.y -= 0.5f;
+    Vector2 box_position = *position - v2(radius, radius);
+    Vector2 box_size     = v2(radius * 2.0f, radius * 2.0f);
+    Tile_Sweep sweep = sweep_box_through_tilemap(tilemap, box_position, box_size, move_dir * speed * dt);
+    Vector2 new_position = sweep.position;
 
     float front_x = new_position.x;
-    if (!enemy->is_facing_right) {
+    if (!is_facing_right) {
         front_x -= 0.1f;
     } else {
-        front_x += enemy->radius * 2.0f + 0.1f;
+        front_x += radius * 2.0f + 0.1f;
     }
     float foot_y  = new_position.y - 0.1f;
     u8 tile_below = get_tile_id_at(tilemap, v2(front_x, foot_y));
 
     bool will_fall = !is_tile_id_collidable(tilemap, tile_below);
 
-    bool hitting_wall = false;
-    if (!enemy->is_facing_right) {
-        u8 tile1_id = get_tile_id_at(tilemap, v2(new_position.x, enemy->position.y));
-        u8 tile2_id = get_tile_id_at(tilemap, v2(new_position.x, enemy->position.y + enemy->radius * 0.9f));
-        if (is_tile_id_collidable(tilemap, tile1_id) || is_tile_id_collidable(tilemap, tile2_id)) {
-            hitting_wall = true;
-        }
-
+    bool hitting_wall = sweep.hit_x;
+    if (!is_facing_right) {
         if (new_position.x < 0.0f) {
             hitting_wall = true;
         }
     } else {
-#if 0
-        u8 tile1_id = get_tile_id_at(tilemap, v2(new_position.x + enemy->radius * 2.0f, enemy->position.y));
-        u8 tile2_id = get_tile_id_at(tilemap, v2(new_position.x + enemy->radius * 2.0f, enemy->position.y + enemy->radius * 0.9f));
-#else
-        u8 tile1_id = get_tile_id_at(tilemap, v2(new_position.x + enemy->radius * 2.0f, new_position.y));
-        u8 tile2_id = get_tile_id_at(tilemap, v2(new_position.x + enemy->radius * 2.0f, new_position.y + enemy->radius * 0.9f));
-#endif
-        if (is_tile_id_collidable(tilemap, tile1_id) || is_tile_id_collidable(tilemap, tile2_id)) {
-            hitting_wall = true;
-        }
-
-        if (new_position.x > world->size.x - enemy->radius * 2.0f) {
+        if (new_position.x > world->size.x - radius * 2.0f) {
             hitting_wall = true;
         }
     }
 
     if (will_fall || hitting_wall) {
-        if (!enemy->is_facing_right) {
-            enemy->is_facing_right = true;
-        } else {
-            enemy->is_facing_right = false;
-        }
+        is_facing_right = !is_facing_right;
+        *flags ^= MOVER_FACING_RIGHT;
     } else {
-        enemy->position = new_position + v2(0.5f, 0.5f);
+        *position = new_position + v2(radius, radius);
     }
     
-    enemy->time_since_last_projectile += dt;
-    if (enemy->time_since_last_projectile >= enemy->time_between_projectiles) {
-        Vector2 projectile_position = enemy->position;
-        if (enemy->is_facing_right) {
-            projectile_position.x += enemy->radius;
-        } else {
-            projectile_position.x -= enemy->radius;
+    *time_since_last_projectile += dt;
+    if (*time_since_last_projectile < time_between_projectiles) return false;
+
+    *projectile_position = *position;
+    if (is_facing_right) {
+        projectile_position->x += radius;
+    } else {
+        projectile_position->x -= radius;
+    }
+    *time_since_last_projectile = 0.0f;
+    return true;
+}
+
+int update_enemies(World *world, int begin, int end, float dt, Entity_Commands *commands) {
+    Pool <Enemy, Enemy_Fields> *pool = &world->by_type._Enemy;
+    int num_updated = 0;
+
+    for (int index = begin; index < end; index++) {
+        auto *block = pool->blocks.data[index / POOL_BLOCK_SIZE];
+        int slot = index % POOL_BLOCK_SIZE;
+
+        Enemy_Fields *fields = &block->hot;
+        if (!block->occupied[slot] || (fields->flags[slot] & MOVER_SCHEDULED_FOR_DESTRUCTION)) continue;
+
+        Vector2 old_position = fields->position[slot];
+        Vector2 projectile_position;
+        bool fires = step_enemy(world, &fields->position[slot], fields->radius[slot], fields->speed[slot], &fields->flags[slot],
+                                &fields->time_since_last_projectile[slot], fields->time_between_projectiles[slot], dt, &projectile_position);
+
+        if (fires) {
+            bool is_facing_right = (fields->flags[slot] & MOVER_FACING_RIGHT) != 0;
+            if (commands) {
+                Entity_Command command = {ENTITY_COMMAND_FIRE_PROJECTILE};
+                command.position        = projectile_position;
+                command.is_facing_right = is_facing_right;
+                commands->commands.add(command);
+            } else {
+                fire_projectile(world, projectile_position, is_facing_right);
+            }
         }
-        
-        Projectile *projectile      = make_projectile(world);
-        projectile->position        = projectile_position;
-        projectile->is_facing_right = enemy->is_facing_right;
-        projectile->speed           = 5.0f;
-        projectile->color           = v4(1, 0, 1, 1);
-        projectile->radius          = 0.2f;
-        enemy->time_since_last_projectile = 0.0f;
+
+        refile_if_moved_cell(world, &block->items[slot], old_position, fields->position[slot], commands);
+        num_updated++;
     }
+
+    return num_updated;
 }
 
 void draw_single_enemy(Enemy *enemy) {
     World *world = enemy->world;
     assert(world);
 
-    Vector2 screen_space_position = world_space_to_screen_space(world, enemy->position);
-    Vector2 screen_space_size     = world_space_to_screen_space(world, v2(0, enemy->radius));
+    Vector2 screen_space_position = world_space_to_screen_space(world, get_draw_position(enemy));
+    Vector2 screen_space_size     = world_space_to_screen_space(world, v2(0, get_radius(enemy)));
 
     immediate_circle(screen_space_position, screen_space_size.y, enemy->color);
 }
 
-void update_single_projectile(Projectile *projectile, float dt) {
-    World *world = projectile->world;
-    assert(world);
-
+bool step_projectile(World *world, Vector2 *position, float radius, float speed, u8 flags, float dt) {
     Tilemap *tilemap = world->tilemap;
     assert(tilemap);
 
+    bool is_facing_right = (flags & MOVER_FACING_RIGHT) != 0;
+
     Vector2 move_dir = v2(0, 0);
-    if (projectile->is_facing_right) move_dir.x = +1.0f;
-    else                             move_dir.x = -1.0f;
+    if (is_facing_right) move_dir.x = +1.0f;
+    else                 move_dir.x = -1.0f;
     
-    Vector2 new_position = projectile->position + move_dir * projectile->speed * dt;
-    new_position.x -= 0.5f;
-    new_position.y -= 0.5f;
-
-    bool has_collided = false;
-    if (!projectile->is_facing_right) {
-        u8 tile1_id = get_tile_id_at(tilemap, v2(new_position.x, projectile->position.y));
-        u8 tile2_id = get_tile_id_at(tilemap, v2(new_position.x, projectile->position.y + projectile->size.y * 0.9f));
-        if (is_tile_id_collidable(tilemap, tile1_id) || is_tile_id_collidable(tilemap, tile2_id)) {
-            has_collided = true;
-        }
+    Vector2 box_position = *position - v2(radius, radius);
+    Vector2 box_size     = v2(radius * 2.0f, radius * 2.0f);
+    Tile_Sweep sweep = sweep_box_through_tilemap(tilemap, box_position, box_size, move_dir * speed * dt);
+    Vector2 new_position = sweep.position;
 
+    bool has_collided = sweep.hit_x;
+    if (!is_facing_right) {
         if (new_position.x < 0.0f) {
             has_collided = true;
         }
     } else {
-        u8 tile1_id = get_tile_id_at(tilemap, v2(new_position.x + projectile->size.x, projectile->position.y));
-        u8 tile2_id = get_tile_id_at(tilemap, v2(new_position.x + projectile->size.x, projectile->position.y + projectile->size.y * 0.9f));
-        if (is_tile_id_collidable(tilemap, tile1_id) || is_tile_id_collidable(tilemap, tile2_id)) {
-            has_collided = true;
-        }
-
-        if (new_position.x > world->size.x - projectile->radius * 2.0f) {
+        if (new_position.x > world->size.x - radius * 2.0f) {
             has_collided = true;
         }
     }
     
-    if (!has_collided) {
-        projectile->position = new_position + v2(0.5f, 0.5f);
-    } else {
-        schedule_for_destruction(projectile);
+    if (has_collided) return true;
+
+    *position = new_position + v2(radius, radius);
+    return false;
+}
+
+int update_projectiles(World *world, int begin, int end, float dt, Entity_Commands *commands) {
+    Pool <Projectile, Projectile_Fields> *pool = &world->by_type._Projectile;
+    int num_updated = 0;
+
+    for (int index = begin; index < end; index++) {
+        auto *block = pool->blocks.data[index / POOL_BLOCK_SIZE];
+        int slot = index % POOL_BLOCK_SIZE;
+
+        Projectile_Fields *fields = &block->hot;
+        if (!block->occupied[slot] || (fields->flags[slot] & MOVER_SCHEDULED_FOR_DESTRUCTION)) continue;
+
+        Projectile *projectile = &block->items[slot];
+        Vector2 old_position = fields->position[slot];
+
+        bool has_collided = step_projectile(world, &fields->position[slot], fields->radius[slot], fields->speed[slot], fields->flags[slot], dt);
+        if (has_collided) {
+            if (commands) {
+                Entity_Command command = {ENTITY_COMMAND_DESTROY};
+                command.entity = projectile;
+                commands->commands.add(command);
+            } else {
+                schedule_for_destruction(projectile);
+            }
+        }
+
+        refile_if_moved_cell(world, projectile, old_position, fields->position[slot], commands);
+        num_updated++;
     }
+
+    return num_updated;
 }
 
 void draw_single_projectile(Projectile *projectile) {
     World *world = projectile->world;
     assert(world);
 
-    Vector2 screen_space_position = world_space_to_screen_space(world, projectile->position);
-    Vector2 screen_space_size     = world_space_to_screen_space(world, v2(0, projectile->radius));
+    Vector2 screen_space_position = world_space_to_screen_space(world, get_draw_position(projectile));
+    Vector2 screen_space_size     = world_space_to_screen_space(world, v2(0, get_radius(projectile)));
 
     immediate_circle(screen_space_position, screen_space_size.y, projectile->color);    
 }
@@ -386,7 +466,7 @@ void draw_single_pickup(Pickup *pickup) {
     World *world = pickup->world;
     assert(world);
 
-    Vector2 screen_space_position = world_space_to_screen_space(world, pickup->position);
+    Vector2 screen_space_position = world_space_to_screen_space(world, get_draw_position(pickup));
     Vector2 screen_space_size     = world_space_to_screen_space(world, v2(0, pickup->radius));
 
     immediate_circle(screen_space_position, screen_space_size.y, pickup->color);
@@ -396,7 +476,7 @@ void draw_single_door(Door *door) {
     World *world = door->world;
     assert(world);
 
-    Vector2 screen_space_position = world_space_to_screen_space(world, door->position);
+    Vector2 screen_space_position = world_space_to_screen_space(world, get_draw_position(door));
     Vector2 screen_space_size     = world_space_to_screen_space(world, door->size);
 
     Vector4 color = v4(0, 1, 0, 1);
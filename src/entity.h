@@ -20,15 +20,41 @@ enum Entity_Type {
     ENTITY_TYPE_DOOR,
 };
 
+struct Entity;
+struct Projectile;
+
+// Where an entity sits in the world's Broadphase; only broadphase.cpp touches it.
+struct Broadphase_Link {
+    int cell = -1;          // -1 while not filed in a cell.
+    int pending_index = -1; // Index into Broadphase::pending while waiting to be filed.
+    Entity *next = NULL;
+    Entity *prev = NULL;
+};
+
 struct Entity {
     Entity_Type type;
     u64 id;
     World *world;
     bool scheduled_for_destruction;
 
-    Vector2 position;
+    // The hero, the door and pickups keep their position in their own struct;
+    // enemies and projectiles in their pool block's hot fields. Code that
+    // doesn't know which goes through get_position.
     Vector2 size;
     Vector4 color;
+
+    // Where it was at the start of the last tick; drawing blends from here to
+    // position. Entities made during the tick have none yet.
+    Vector2 previous_position;
+    bool has_previous_position = false;
+
+    // Slot in the world's pool for this type; unused by the hero and door.
+    Pool_Handle pool_handle;
+
+    // Position in World::all_entities, so destruction can swap-remove.
+    int all_entities_index = -1;
+
+    Broadphase_Link broadphase_link;
 };
 
 enum Hero_State {
@@ -39,6 +65,7 @@ enum Hero_State {
 };
 
 struct Hero : public Entity {
+    Vector2 position;
     Hero_State state = HERO_STATE_IDLE;
     Vector2 velocity = v2(0, 0);
     bool is_facing_right = true;
@@ -53,35 +80,131 @@ void draw_single_hero(Hero *hero);
 
 void damage_hero(Hero *hero, double damage_amount);
 
-struct Enemy : public Entity {    
-    float speed = 2.0f;
-    bool is_facing_right = true;
-    float radius = 0.5f;
+// Enemies and projectiles are updated in sweeps over their pools, so what
+// those read and write lives in the pool blocks' hot fields (see Pool), one
+// array per field, rather than in the structs.
+enum Mover_Flags : u8 {
+    MOVER_FACING_RIGHT              = 0x1,
+    MOVER_SCHEDULED_FOR_DESTRUCTION = 0x2, // Mirrors Entity::scheduled_for_destruction.
+};
+
+struct Enemy_Fields {
+    Vector2 position[POOL_BLOCK_SIZE];
+    float speed[POOL_BLOCK_SIZE];
+    float radius[POOL_BLOCK_SIZE];
+    u8 flags[POOL_BLOCK_SIZE];
+    float time_since_last_projectile[POOL_BLOCK_SIZE];
+    float time_between_projectiles[POOL_BLOCK_SIZE];
+};
+
+struct Projectile_Fields {
+    Vector2 position[POOL_BLOCK_SIZE];
+    float speed[POOL_BLOCK_SIZE];
+    float radius[POOL_BLOCK_SIZE];
+    u8 flags[POOL_BLOCK_SIZE];
+};
 
-    float time_since_last_projectile = 0.0f;
-    float time_between_projectiles = 3.0f;
+// Everything an enemy has beyond Entity is in Enemy_Fields.
+struct Enemy : public Entity {
 };
 
-void update_single_enemy(Enemy *enemy, float dt);
+inline Enemy_Fields *get_fields(Enemy *enemy, int *slot) {
+    return Pool <Enemy, Enemy_Fields>::get_hot(enemy, enemy->pool_handle, slot);
+}
+
+// Side effects of entity updates that run on job threads. Each batch records
+// into its own buffer, and the buffers are applied in batch order once all the
+// batches are done, so the outcome is the same as applying them inline.
+enum Entity_Command_Type {
+    ENTITY_COMMAND_FIRE_PROJECTILE,
+    ENTITY_COMMAND_DESTROY,
+    ENTITY_COMMAND_UPDATE_BROADPHASE,
+};
+
+struct Entity_Command {
+    Entity_Command_Type type;
+    Entity *entity;       // DESTROY, UPDATE_BROADPHASE
+    Vector2 position;     // FIRE_PROJECTILE
+    bool is_facing_right; // FIRE_PROJECTILE
+};
+
+struct Entity_Commands {
+    Array <Entity_Command> commands;
+    int num_updated = 0;
+};
+
+void apply_entity_commands(World *world, Entity_Commands *commands);
+
+// One enemy's or projectile's tick, on its fields wherever they are kept.
+// step_enemy returns true if it fires, from *projectile_position;
+// step_projectile returns true if it hit something and has to go.
+bool step_enemy(World *world, Vector2 *position, float radius, float speed, u8 *flags,
+                float *time_since_last_projectile, float time_between_projectiles, float dt, Vector2 *projectile_position);
+bool step_projectile(World *world, Vector2 *position, float radius, float speed, u8 flags, float dt);
+
+// Step every live enemy or projectile in pool slots [begin, end), in slot
+// order, and re-file the ones that changed broadphase cell. With commands
+// NULL, side effects are applied right away. Return how many were updated.
+int update_enemies(World *world, int begin, int end, float dt, Entity_Commands *commands = NULL);
+int update_projectiles(World *world, int begin, int end, float dt, Entity_Commands *commands = NULL);
+
 void draw_single_enemy(Enemy *enemy);
 
+// Everything a projectile has beyond Entity is in Projectile_Fields.
 struct Projectile : public Entity {
-    float speed = 5.0f;
-    bool is_facing_right = true;
-    float radius = 0.5f;
 };
 
-void update_single_projectile(Projectile *projectile, float dt);
+inline Projectile_Fields *get_fields(Projectile *projectile, int *slot) {
+    return Pool <Projectile, Projectile_Fields>::get_hot(projectile, projectile->pool_handle, slot);
+}
+
 void draw_single_projectile(Projectile *projectile);
 
 struct Pickup : public Entity {
+    Vector2 position;
     float radius = 0.5f;
 };
 
 void draw_single_pickup(Pickup *pickup);
 
 struct Door : public Entity {
+    Vector2 position;
     bool locked = true;
 };
 
 void draw_single_door(Door *door);
+
+// Any entity's position and, for enemies, projectiles and pickups, radius
+// (0 for the rest), wherever it is kept.
+inline Vector2 get_position(Entity *e) {
+    int slot;
+    switch (e->type) {
+        case ENTITY_TYPE_HERO:       return ((Hero *)e)->position;
+        case ENTITY_TYPE_DOOR:       return ((Door *)e)->position;
+        case ENTITY_TYPE_PICKUP:     return ((Pickup *)e)->position;
+        case ENTITY_TYPE_ENEMY:      return get_fields((Enemy *)e, &slot)->position[slot];
+        case ENTITY_TYPE_PROJECTILE: return get_fields((Projectile *)e, &slot)->position[slot];
+    }
+    return v2(0, 0);
+}
+
+inline void set_position(Entity *e, Vector2 position) {
+    int slot;
+    switch (e->type) {
+        case ENTITY_TYPE_HERO:       ((Hero *)e)->position   = position; break;
+        case ENTITY_TYPE_DOOR:       ((Door *)e)->position   = position; break;
+        case ENTITY_TYPE_PICKUP:     ((Pickup *)e)->position = position; break;
+        case ENTITY_TYPE_ENEMY:      get_fields((Enemy *)e, &slot)->position[slot]      = position; break;
+        case ENTITY_TYPE_PROJECTILE: get_fields((Projectile *)e, &slot)->position[slot] = position; break;
+    }
+}
+
+inline float get_radius(Entity *e) {
+    int slot;
+    switch (e->type) {
+        case ENTITY_TYPE_PICKUP:     return ((Pickup *)e)->radius;
+        case ENTITY_TYPE_ENEMY:      return get_fields((Enemy *)e, &slot)->radius[slot];
+        case ENTITY_TYPE_PROJECTILE: return get_fields((Projectile *)e, &slot)->radius[slot];
+    }
+    return 0.0f;
+}
@@ -19,6 +19,8 @@ static int font_page_size_x;
 static int font_page_size_y;
 
 static void init_fonts(int _font_page_size_x, int _font_page_size_y) {
+    allocation_tag(ALLOCATION_TAG_FONTS);
+
     font_page_size_x = _font_page_size_x;
     font_page_size_y = _font_page_size_y;
 
@@ -34,6 +36,8 @@ static void ensure_fonts_initted() {
 }
 
 static Loaded_Font *get_loaded_font(char *name) {
+    allocation_tag(ALLOCATION_TAG_FONTS);
+
     for (int i = 0; i < loaded_fonts.count; i++) {
         Loaded_Font *font = loaded_fonts[i];
         if (strings_match(font->name, name)) return font;
@@ -69,6 +73,8 @@ static Loaded_Font *get_loaded_font(char *name) {
 
 #ifdef USE_PACKAGE
 static Loaded_Font *get_loaded_font_from_package(char *name) {
+    allocation_tag(ALLOCATION_TAG_FONTS);
+
     // Check if already loaded
     for (int i = 0; i < loaded_fonts.count; i++) {
         Loaded_Font *font = loaded_fonts[i];
@@ -112,6 +118,10 @@ Glyph_Data *Dynamic_Font::get_or_load_glyph(int utf32) {
     Glyph_Data **_data = glyph_lookup.find(utf32);
     if (_data) return *_data;
 
+    // Only misses are zoned; the lookups run for every character drawn.
+    profile_zone("get_or_load_glyph");
+    allocation_tag(ALLOCATION_TAG_FONTS);
+
     FT_Set_Pixel_Sizes(face, 0, character_height);
     
     unsigned long glyph_index = FT_Get_Char_Index(face, utf32);
@@ -203,6 +213,8 @@ void Dynamic_Font::prep_text(char *text, int x, int y) {
 
 void Dynamic_Font::generate_font_quads(char *text, int x, int y) {
     if (!text) return;
+
+    font_quads.use_arena(&frame_arena);
     
     int orig_x = x;
     
@@ -255,6 +267,8 @@ Dynamic_Font *get_font_at_size(char *name, int size) {
 #else
     Loaded_Font *loaded_font = get_loaded_font(name);
 #endif
+    allocation_tag(ALLOCATION_TAG_FONTS);
+
     Dynamic_Font *font = new Dynamic_Font();
     font->name = copy_string(name);
     font->load(loaded_font, size);
@@ -39,7 +39,7 @@ struct Dynamic_Font {
     Array <Font_Page *> font_pages;
     Font_Page *current_page = NULL;
 
-    Array <Font_Quad> font_quads;
+    Array <Font_Quad> font_quads; // From prep_text, in the frame arena.
     
     void load(Loaded_Font *font, int size);
     Glyph_Data *get_or_load_glyph(int utf32);
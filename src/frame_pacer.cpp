@@ -0,0 +1,113 @@
+#include "main.h"
+#include "frame_pacer.h"
+
+#include <math.h>
+
+const s64 MIN_SPIN_DURATION = 200000;   // 0.2 ms
+const s64 MAX_SPIN_DURATION = 2000000;  // 2 ms
+const s64 SPIN_MARGIN       = 100000;   // On top of the worst oversleep.
+
+void init_frame_pacer(Frame_Pacer *pacer, int frames_per_second) {
+    *pacer = {};
+    pacer->spin_duration = 1000000;
+    set_frame_pacer_rate(pacer, frames_per_second);
+
+    pacer->last_wake_time = get_time_nanoseconds();
+    pacer->next_deadline  = pacer->last_wake_time + pacer->frame_duration;
+}
+
+void set_frame_pacer_rate(Frame_Pacer *pacer, int frames_per_second) {
+    assert(frames_per_second > 0);
+    pacer->frame_duration = 1000000000LL / frames_per_second;
+}
+
+static void add_frame(Frame_Pacer_Stats *stats, s64 work_time, s64 sleep_time, s64 spin_time, s64 frame_time, bool late, bool early, bool overslept) {
+    stats->num_frames++;
+    if (late)      stats->num_late_frames++;
+    if (early)     stats->num_early_frames++;
+    if (overslept) stats->num_overslept_frames++;
+
+    stats->total_work_time  += work_time;
+    stats->max_work_time     = Max(stats->max_work_time, work_time);
+    stats->total_sleep_time += sleep_time;
+    stats->total_spin_time  += spin_time;
+
+    stats->total_frame_time         += frame_time;
+    stats->total_frame_time_squared += (double)frame_time * (double)frame_time;
+}
+
+void wait_for_next_frame(Frame_Pacer *pacer, bool busy_wait) {
+    s64 frame_start = pacer->last_wake_time;
+    s64 now = get_time_nanoseconds();
+    s64 work_time = now - frame_start;
+    s64 deadline = pacer->next_deadline;
+
+    bool late  = now > deadline;
+    bool early = work_time < pacer->frame_duration / 2;
+    bool overslept = false;
+    s64 sleep_time = 0;
+    s64 spin_time  = 0;
+
+#ifdef __EMSCRIPTEN__
+    // The browser paces us with requestAnimationFrame, and blocking its main
+    // thread only makes things worse.
+    busy_wait = false;
+    deadline  = now;
+#endif
+
+    if (!late) {
+        if (!busy_wait) {
+            s64 sleep_until = deadline - pacer->spin_duration;
+            if (now < sleep_until) {
+                sleep_nanoseconds(sleep_until - now);
+
+                s64 woke = get_time_nanoseconds();
+                pacer->max_oversleep = Max(pacer->max_oversleep, woke - sleep_until);
+                sleep_time = woke - now;
+                now = woke;
+
+                if (now > deadline) overslept = true;
+            }
+        }
+
+        s64 spin_start = now;
+        while (now < deadline) {
+            now = get_time_nanoseconds();
+        }
+        spin_time = now - spin_start;
+    }
+
+    s64 frame_time = now - frame_start;
+    add_frame(&pacer->window, work_time, sleep_time, spin_time, frame_time, late, early, overslept);
+    add_frame(&pacer->total,  work_time, sleep_time, spin_time, frame_time, late, early, overslept);
+
+    // A frame that ran long starts a new schedule instead of rushing the
+    // following ones to catch up.
+    if (now > deadline + pacer->frame_duration / 4) {
+        pacer->next_deadline = now + pacer->frame_duration;
+    } else {
+        pacer->next_deadline = deadline + pacer->frame_duration;
+    }
+    pacer->last_wake_time = now;
+
+    // Spin for a little more than the worst oversleep of the last window.
+    if (pacer->total.num_frames % 120 == 0) {
+        s64 spin_duration = pacer->max_oversleep + SPIN_MARGIN;
+        pacer->spin_duration = Max(MIN_SPIN_DURATION, Min(spin_duration, MAX_SPIN_DURATION));
+        pacer->max_oversleep = 0;
+    }
+}
+
+double get_average_frame_milliseconds(Frame_Pacer_Stats *stats) {
+    if (!stats->num_frames) return 0.0;
+    return (double)stats->total_frame_time / (double)stats->num_frames / 1000000.0;
+}
+
+double get_frame_time_standard_deviation_milliseconds(Frame_Pacer_Stats *stats) {
+    if (!stats->num_frames) return 0.0;
+
+    double n    = (double)stats->num_frames;
+    double mean = (double)stats->total_frame_time / n;
+    double variance = stats->total_frame_time_squared / n - mean * mean;
+    return sqrt(Max(variance, 0.0)) / 1000000.0;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+// Holds frames to a fixed rate without burning a core: sleeps until shortly
+// before each deadline and spins only the last stretch, sized from how much
+// the OS has been oversleeping. Also keeps per-window frame statistics for
+// the fps cap logic and the debug HUD.
+
+struct Frame_Pacer_Stats {
+    s64 num_frames = 0;
+    s64 num_late_frames = 0;      // The frame's work alone ran past the deadline.
+    s64 num_early_frames = 0;     // The work took under half the frame, so twice the rate would fit.
+    s64 num_overslept_frames = 0; // The work fit, but the sleep ran past the deadline.
+
+    s64 total_work_time = 0;  // From the end of the last wait to the start of this one.
+    s64 max_work_time = 0;
+    s64 total_sleep_time = 0;
+    s64 total_spin_time = 0;
+
+    s64 total_frame_time = 0; // From one frame's wake-up to the next.
+    double total_frame_time_squared = 0.0;
+};
+
+struct Frame_Pacer {
+    s64 frame_duration = 0;
+    s64 next_deadline = 0;
+    s64 last_wake_time = 0;
+
+    // How long before the deadline to stop sleeping and start spinning.
+    s64 spin_duration = 0;
+    s64 max_oversleep = 0; // Worst seen this window.
+
+    Frame_Pacer_Stats window; // Reset by whoever reads it.
+    Frame_Pacer_Stats total;
+};
+
+void init_frame_pacer(Frame_Pacer *pacer, int frames_per_second);
+void set_frame_pacer_rate(Frame_Pacer *pacer, int frames_per_second);
+
+// Waits until the end of the current frame. With busy_wait it spins the
+// whole time instead of sleeping, which is what the game used to do.
+void wait_for_next_frame(Frame_Pacer *pacer, bool busy_wait = false);
+
+double get_average_frame_milliseconds(Frame_Pacer_Stats *stats);
+double get_frame_time_standard_deviation_milliseconds(Frame_Pacer_Stats *stats);
@@ -6,10 +6,156 @@
 
 #ifdef _WIN32
 #include <Windows.h>
+#else
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #endif
 
 static FILE *log_file = NULL;
 
+Allocation_Counters allocation_counters;
+Allocation_Frame_Stats allocation_frame_stats;
+thread_local Allocation_Tag current_allocation_tag = ALLOCATION_TAG_OTHER;
+thread_local Allocation_Counters *current_allocation_counters = &allocation_counters;
+
+// Peaks come out as if everything counted elsewhere happened just now.
+template <typename Counters>
+static void add_counters(Counters *to, Counters *from) {
+    to->num_allocations     += from->num_allocations;
+    to->num_bytes_allocated += from->num_bytes_allocated;
+    to->num_frees           += from->num_frees;
+    to->live_bytes          += from->live_bytes;
+    to->peak_live_bytes      = Max(to->peak_live_bytes, to->live_bytes);
+}
+
+void add_allocation_counters(Allocation_Counters *counters) {
+    add_counters(&allocation_counters, counters);
+    for (int i = 0; i < NUM_ALLOCATION_TAGS; i++) add_counters(&allocation_counters.by_tag[i], &counters->by_tag[i]);
+}
+
+char *allocation_tag_names[NUM_ALLOCATION_TAGS] = {
+    "other",
+    "world",
+    "entities",
+    "fonts",
+    "audio",
+    "package",
+    "arrays",
+};
+
+// 16 bytes, so the block after it keeps malloc's alignment.
+struct Allocation_Header {
+    s64 size;
+    s64 tag;
+};
+
+void *tracked_malloc(s64 size, Allocation_Tag fallback_tag) {
+    Allocation_Tag tag = get_allocation_tag(fallback_tag);
+
+    if (size < 0 || size > INT64_MAX - (s64)sizeof(Allocation_Header)) return NULL;
+
+    Allocation_Header *header = (Allocation_Header *)malloc(sizeof(Allocation_Header) + (size_t)size);
+    if (!header) return NULL;
+
+    header->size = size;
+    header->tag  = tag;
+
+    count_allocation(size, tag);
+    return header + 1;
+}
+
+void *tracked_calloc(s64 count, s64 size, Allocation_Tag fallback_tag) {
+    if (count < 0 || size < 0) return NULL;
+    if (size && count > INT64_MAX / size) return NULL;
+
+    void *result = tracked_malloc(count * size, fallback_tag);
+    if (result) memset(result, 0, (size_t)(count * size));
+    return result;
+}
+
+void tracked_free(void *memory) {
+    if (!memory) return;
+
+    Allocation_Header *header = (Allocation_Header *)memory - 1;
+    count_free(header->size, (Allocation_Tag)header->tag);
+    free(header);
+}
+
+void out_of_memory(s64 size) {
+    logprintf("Out of memory: failed to allocate %lld bytes.\n", (long long)size);
+    abort();
+}
+
+// Returning NULL from new is undefined, so it stops the program like the
+// containers do.
+static void *tracked_new(size_t size) {
+    void *result = NULL;
+    if (size <= (size_t)INT64_MAX) result = tracked_malloc((s64)size);
+    if (!result) out_of_memory((s64)Min(size, (size_t)INT64_MAX));
+    return result;
+}
+
+void *operator new(size_t size) {
+    return tracked_new(size);
+}
+
+void *operator new[](size_t size) {
+    return tracked_new(size);
+}
+
+void operator delete(void *ptr) noexcept {
+    tracked_free(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+    tracked_free(ptr);
+}
+
+void operator delete(void *ptr, size_t size) noexcept {
+    tracked_free(ptr);
+}
+
+void operator delete[](void *ptr, size_t size) noexcept {
+    tracked_free(ptr);
+}
+
+static Allocation_Counters allocation_counters_at_frame_start;
+
+void begin_allocation_frame() {
+    allocation_counters_at_frame_start = allocation_counters;
+}
+
+void end_allocation_frame() {
+    Allocation_Frame_Stats *stats = &allocation_frame_stats;
+    Allocation_Counters *before = &allocation_counters_at_frame_start;
+
+    s64 num_allocations = allocation_counters.num_allocations     - before->num_allocations;
+    s64 num_bytes       = allocation_counters.num_bytes_allocated - before->num_bytes_allocated;
+
+    stats->num_frames++;
+    if (num_allocations) stats->num_frames_that_allocated++;
+
+    stats->last_frame_allocations = num_allocations;
+    stats->last_frame_bytes       = num_bytes;
+    stats->peak_frame_allocations = Max(stats->peak_frame_allocations, num_allocations);
+    stats->peak_frame_bytes       = Max(stats->peak_frame_bytes, num_bytes);
+
+    for (int i = 0; i < NUM_ALLOCATION_TAGS; i++) {
+        stats->allocations_by_tag[i] += allocation_counters.by_tag[i].num_allocations - before->by_tag[i].num_allocations;
+    }
+
+    begin_allocation_frame();
+}
+
+void reset_allocation_frame_stats() {
+    allocation_frame_stats = {};
+    begin_allocation_frame();
+}
+
 u64 round_to_next_power_of_2(u64 v) {
     v--;
     v |= v >> 1;
@@ -335,6 +481,76 @@ bool file_exists(char *filepath) {
     return true;
 }
 
+bool map_file(char *filepath, File_Mapping *mapping) {
+    *mapping = {};
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filepath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size) || size.QuadPart <= 0) {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE file_mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!file_mapping) {
+        CloseHandle(file);
+        return false;
+    }
+
+    void *data = MapViewOfFile(file_mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!data) {
+        CloseHandle(file_mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    mapping->data           = (u8 *)data;
+    mapping->size           = size.QuadPart;
+    mapping->file_handle    = file;
+    mapping->mapping_handle = file_mapping;
+#else
+    int file = open(filepath, O_RDONLY);
+    if (file < 0) return false;
+    defer { close(file); }; // The mapping outlives the descriptor.
+
+    struct stat info;
+    if (fstat(file, &info) != 0 || info.st_size <= 0) return false;
+
+    void *data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    if (data == MAP_FAILED) return false;
+
+    mapping->data = (u8 *)data;
+    mapping->size = (s64)info.st_size;
+#endif
+
+    return true;
+}
+
+void unmap_file(File_Mapping *mapping) {
+    if (!mapping->data) return;
+
+#ifdef _WIN32
+    UnmapViewOfFile(mapping->data);
+    CloseHandle((HANDLE)mapping->mapping_handle);
+    CloseHandle((HANDLE)mapping->file_handle);
+#else
+    munmap(mapping->data, (size_t)mapping->size);
+#endif
+
+    *mapping = {};
+}
+
+bool replace_file(char *source, char *dest) {
+#ifdef _WIN32
+    return MoveFileExA(source, dest, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return rename(source, dest) == 0;
+#endif
+}
+
 char *break_by_space(char *s) {
     if (!s) return NULL;
     if (*s == 0) return NULL;
@@ -377,8 +593,53 @@ float fract(float value) {
     return fractpart;
 }
 
+static Random_State global_random;
+
+const u64 PCG32_MULTIPLIER = 6364136223846793005ULL;
+const u64 PCG32_INCREMENT  = 1442695040888963407ULL;
+
+void seed_random(Random_State *random, u64 seed) {
+    random->state = 0;
+    random_u32(random);
+    random->state += seed;
+    random_u32(random);
+}
+
+u32 random_u32(Random_State *random) {
+    u64 old_state = random->state;
+    random->state = old_state * PCG32_MULTIPLIER + PCG32_INCREMENT;
+
+    u32 xorshifted = (u32)(((old_state >> 18) ^ old_state) >> 27);
+    u32 rotation   = (u32)(old_state >> 59);
+    return (xorshifted >> rotation) | (xorshifted << ((32 - rotation) & 31));
+}
+
+u64 random_u64(Random_State *random) {
+    u64 hi = random_u32(random);
+    u64 lo = random_u32(random);
+    return (hi << 32) | lo;
+}
+
+int random_int(Random_State *random, int upper_bound) {
+    if (upper_bound <= 0) return 0;
+    return (int)(random_u32(random) % (u32)upper_bound);
+}
+
+float random_float(Random_State *random) {
+    // 24 random bits, so the result is in [0, 1).
+    return (float)(random_u32(random) >> 8) * (1.0f / 16777216.0f);
+}
+
+void seed_random(u64 seed) {
+    seed_random(&global_random, seed);
+}
+
+u32 random_u32() {
+    return random_u32(&global_random);
+}
+
 float random_float() {
-    return (float)rand() / (float)RAND_MAX;
+    return random_float(&global_random);
 }
 
 
@@ -445,6 +706,37 @@ void enable_dpi_awareness() {
 s64 get_time_nanoseconds() {
     Uint64 counter = SDL_GetPerformanceCounter();
     Uint64 freq = SDL_GetPerformanceFrequency();
-    // Convert seconds → nanoseconds (1s = 1e9 ns)
-    return (Uint64)((counter * 1000000000ULL) / freq);
+    // Whole seconds and the remainder separately; counter * 1e9 overflows
+    // after a few hours of uptime with a nanosecond counter.
+    Uint64 seconds = counter / freq;
+    Uint64 remainder = counter % freq;
+    return (s64)(seconds * 1000000000ULL + remainder * 1000000000ULL / freq);
+}
+
+void sleep_nanoseconds(s64 nanoseconds) {
+    if (nanoseconds <= 0) return;
+
+#ifdef _WIN32
+    // High resolution waitable timers (Windows 10 1803+) wake within a
+    // fraction of a millisecond; without one Sleep rounds to the scheduler tick.
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+    static HANDLE timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    if (timer) {
+        LARGE_INTEGER due_time;
+        due_time.QuadPart = -(nanoseconds / 100); // Relative, in 100 ns units.
+        SetWaitableTimer(timer, &due_time, 0, NULL, NULL, FALSE);
+        WaitForSingleObject(timer, INFINITE);
+    } else {
+        Sleep((DWORD)(nanoseconds / 1000000));
+    }
+#elif defined(__EMSCRIPTEN__)
+    // Blocking the browser's main thread stalls everything else on the page.
+#else
+    struct timespec duration;
+    duration.tv_sec  = (time_t)(nanoseconds / 1000000000LL);
+    duration.tv_nsec = (long)(nanoseconds % 1000000000LL);
+    while (nanosleep(&duration, &duration) == -1 && errno == EINTR) {}
+#endif
 }
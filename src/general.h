@@ -83,10 +83,172 @@ void logprintf(char *fmt, ...);
 char *read_entire_file(char *filepath, s64 *length_pointer = NULL, bool zero_terminate = true);
 bool file_exists(char *filepath);
 
+// A whole file mapped read-only: pages are read in when first touched, and
+// nothing is copied. Writing through data crashes.
+struct File_Mapping {
+    u8 *data = NULL;
+    s64 size = 0;
+#ifdef _WIN32
+    void *file_handle = NULL;
+    void *mapping_handle = NULL;
+#endif
+};
+
+bool map_file(char *filepath, File_Mapping *mapping);
+void unmap_file(File_Mapping *mapping);
+
+// Renames source over dest in one step, so anyone opening dest sees either
+// the old file or the new one, never half of it.
+bool replace_file(char *source, char *dest);
+
 char *break_by_space(char *s);
 char *break_by_comma(char *s);
 
 float fract(float value);
+
+// PCG32. Everything that has to replay bit-exactly (level generation,
+// particles, menu messages) draws from one of these instead of rand().
+struct Random_State {
+    u64 state = 0x853c49e6748fea9bULL;
+};
+
+void seed_random(Random_State *random, u64 seed);
+u32 random_u32(Random_State *random);
+u64 random_u64(Random_State *random);
+int random_int(Random_State *random, int upper_bound); // [0, upper_bound)
+float random_float(Random_State *random);
+
+// Same as above but on the global random state.
+void seed_random(u64 seed);
+u32 random_u32();
 float random_float();
 
 s64 get_time_nanoseconds();
+void sleep_nanoseconds(s64 nanoseconds); // Does nothing on the web.
+
+// Global accounting of heap traffic, so the headless runner and the debug HUD
+// can show what a frame or a simulation tick allocates, and which subsystem
+// is holding how much. `new` goes through the replacement operators in
+// general.cpp; Array, Pool and Hash_Table storage, arena blocks and sound
+// buffers go through tracked_malloc. Both keep a small header in front of
+// the block with its size and tag, so frees are counted against the right
+// subsystem and live bytes stay exact.
+//
+// The counters are plain globals: worker threads allocating at the same
+// time may lose the odd increment, which is fine for what these are for.
+enum Allocation_Tag {
+    ALLOCATION_TAG_OTHER,
+    ALLOCATION_TAG_WORLD,    // Worlds, tilemaps, particles, broadphase, level generation.
+    ALLOCATION_TAG_ENTITIES, // Entity pools and lookups.
+    ALLOCATION_TAG_FONTS,
+    ALLOCATION_TAG_AUDIO,
+    ALLOCATION_TAG_PACKAGE,
+    ALLOCATION_TAG_ARRAYS,   // Array and Hash_Table growth outside any tagged scope.
+
+    NUM_ALLOCATION_TAGS
+};
+
+extern char *allocation_tag_names[NUM_ALLOCATION_TAGS];
+
+struct Allocation_Tag_Counters {
+    s64 num_allocations = 0;
+    s64 num_bytes_allocated = 0;
+    s64 num_frees = 0;
+    s64 live_bytes = 0;
+    s64 peak_live_bytes = 0;
+};
+
+struct Allocation_Counters {
+    s64 num_allocations = 0;
+    s64 num_bytes_allocated = 0;
+    s64 num_frees = 0;
+    s64 live_bytes = 0;
+    s64 peak_live_bytes = 0;
+
+    Allocation_Tag_Counters by_tag[NUM_ALLOCATION_TAGS];
+};
+
+extern Allocation_Counters allocation_counters;
+
+// Where this thread's allocations are counted. The counters aren't atomic,
+// so a thread that allocates alongside the main one points this at counters
+// of its own and hands them to the main thread to add in.
+extern thread_local Allocation_Counters *current_allocation_counters;
+void add_allocation_counters(Allocation_Counters *counters); // Main thread only.
+
+// Allocations inside an allocation_tag(...) scope are charged to that tag;
+// outside one, to whatever the allocation site falls back to.
+extern thread_local Allocation_Tag current_allocation_tag;
+
+struct Allocation_Tag_Scope {
+    Allocation_Tag previous;
+
+    inline Allocation_Tag_Scope(Allocation_Tag tag) {
+        previous = current_allocation_tag;
+        current_allocation_tag = tag;
+    }
+
+    inline ~Allocation_Tag_Scope() {
+        current_allocation_tag = previous;
+    }
+};
+
+#define allocation_tag(tag) Allocation_Tag_Scope CONCAT(allocation_tag__, __LINE__)(tag)
+
+inline Allocation_Tag get_allocation_tag(Allocation_Tag fallback) {
+    return current_allocation_tag != ALLOCATION_TAG_OTHER ? current_allocation_tag : fallback;
+}
+
+inline void count_allocation(s64 size, Allocation_Tag tag) {
+    Allocation_Counters *all = current_allocation_counters;
+
+    Allocation_Tag_Counters *counters = &all->by_tag[tag];
+    counters->num_allocations++;
+    counters->num_bytes_allocated += size;
+    counters->live_bytes += size;
+    if (counters->live_bytes > counters->peak_live_bytes) counters->peak_live_bytes = counters->live_bytes;
+
+    all->num_allocations++;
+    all->num_bytes_allocated += size;
+    all->live_bytes += size;
+    if (all->live_bytes > all->peak_live_bytes) all->peak_live_bytes = all->live_bytes;
+}
+
+inline void count_free(s64 size, Allocation_Tag tag) {
+    Allocation_Counters *all = current_allocation_counters;
+
+    all->by_tag[tag].num_frees++;
+    all->by_tag[tag].live_bytes -= size;
+
+    all->num_frees++;
+    all->live_bytes -= size;
+}
+
+void *tracked_malloc(s64 size, Allocation_Tag fallback_tag = ALLOCATION_TAG_OTHER); // NULL if malloc fails.
+void *tracked_calloc(s64 count, s64 size, Allocation_Tag fallback_tag = ALLOCATION_TAG_OTHER); // Zeroed. NULL if malloc fails or count * size overflows.
+void tracked_free(void *memory);
+
+// Logs and aborts. For callers that cannot carry on without the memory:
+// operator new and the containers.
+void out_of_memory(s64 size);
+
+// What frames (or simulation ticks) allocate. A frame runs from the last
+// begin_allocation_frame or end_allocation_frame to end_allocation_frame, so
+// a loop that counts every frame only needs to call the latter.
+struct Allocation_Frame_Stats {
+    s64 num_frames = 0;
+    s64 num_frames_that_allocated = 0;
+
+    s64 last_frame_allocations = 0;
+    s64 last_frame_bytes = 0;
+    s64 peak_frame_allocations = 0;
+    s64 peak_frame_bytes = 0;
+
+    s64 allocations_by_tag[NUM_ALLOCATION_TAGS] = {}; // Summed over every frame.
+};
+
+extern Allocation_Frame_Stats allocation_frame_stats;
+
+void begin_allocation_frame(); // Leaves out anything allocated since the last frame ended.
+void end_allocation_frame();
+void reset_allocation_frame_stats();
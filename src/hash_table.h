@@ -18,12 +18,12 @@ struct Hash_Table {
 
     inline void deallocate() {
         if (buckets) {
-            free(buckets);
+            tracked_free(buckets);
             buckets = NULL;
         }
 
         if (occupancy_mask) {
-            free(occupancy_mask);
+            tracked_free(occupancy_mask);
             occupancy_mask = NULL;
         }
 
@@ -38,34 +38,38 @@ struct Hash_Table {
             assert(allocated == 0);
             assert(count == 0);
 
-            buckets = (Bucket *)calloc(HASH_TABLE_INITIAL_CAPACITY, sizeof(Bucket));
-            occupancy_mask = (bool *)calloc(HASH_TABLE_INITIAL_CAPACITY, sizeof(bool));
+            buckets = (Bucket *)tracked_calloc(HASH_TABLE_INITIAL_CAPACITY, sizeof(Bucket), ALLOCATION_TAG_ARRAYS);
+            occupancy_mask = (bool *)tracked_calloc(HASH_TABLE_INITIAL_CAPACITY, sizeof(bool), ALLOCATION_TAG_ARRAYS);
+            if (!buckets || !occupancy_mask) out_of_memory(HASH_TABLE_INITIAL_CAPACITY * (sizeof(Bucket) + sizeof(bool)));
 
             allocated = HASH_TABLE_INITIAL_CAPACITY;
             count = 0;
         } else {
             Hash_Table <Key, Value> new_hash_table = {
-                (Bucket *)calloc(allocated * 2, sizeof(Bucket)),
-                (bool *)calloc(allocated * 2, sizeof(bool)),
+                (Bucket *)tracked_calloc(allocated * 2, sizeof(Bucket), ALLOCATION_TAG_ARRAYS),
+                (bool *)tracked_calloc(allocated * 2, sizeof(bool), ALLOCATION_TAG_ARRAYS),
                 allocated * 2,
                 0,
             };
+            if (!new_hash_table.buckets || !new_hash_table.occupancy_mask) out_of_memory(allocated * 2 * (sizeof(Bucket) + sizeof(bool)));
 
-            for (int i = 0; i < count; i++) {
+            for (int i = 0; i < allocated; i++) {
                 if (occupancy_mask[i]) {
                     new_hash_table.add(buckets[i].key, buckets[i].value);
                 }
             }
             
-            free(buckets);
-            free(occupancy_mask);
+            tracked_free(buckets);
+            tracked_free(occupancy_mask);
 
             *this = new_hash_table;
         }
     }
 
     inline void add(Key key, Value value) {
-        if (count >= allocated) {
+        // Keep the load under 3/4 so that probe runs stay short; a miss has to
+        // walk to the end of its run, and generate_id misses on every call.
+        if ((count + 1) * 4 > allocated * 3) {
             grow();
         }
 
@@ -74,24 +78,66 @@ struct Hash_Table {
             hk = (hk + 1) & (allocated - 1);
         }
 
+        if (!occupancy_mask[hk]) count++;
+        
         occupancy_mask[hk] = true;
         buckets[hk].key = key;
         buckets[hk].value = value;
-        count++;
     }
 
     inline Value *find(Key key) {
+        if (!buckets) return nullptr;
+        
         auto hk = get_hash(key) & (allocated - 1);
         for (int i = 0; i < allocated && occupancy_mask[hk] && buckets[hk].key != key; i++) {
             hk = (hk + 1) & (allocated - 1);
         }
 
-        if (buckets && occupancy_mask[hk] && buckets[hk].key == key) {
+        if (occupancy_mask[hk] && buckets[hk].key == key) {
             return &buckets[hk].value;
         } else {
             return nullptr;
         }
     }
+
+    // Backward-shift deletion: rather than leaving a tombstone, pull later
+    // entries of the probe run into the hole, so lookups never have to step
+    // over dead buckets and the table does not degrade with churn.
+    inline bool remove(Key key) {
+        if (!buckets) return false;
+
+        int mask = allocated - 1;
+        int hole = (int)(get_hash(key) & mask);
+        for (int i = 0; i < allocated && occupancy_mask[hole] && buckets[hole].key != key; i++) {
+            hole = (hole + 1) & mask;
+        }
+
+        if (!occupancy_mask[hole] || buckets[hole].key != key) return false;
+
+        occupancy_mask[hole] = false;
+        count--;
+
+        int next = hole;
+        for (;;) {
+            next = (next + 1) & mask;
+            if (!occupancy_mask[next]) break;
+
+            // An entry can move back into the hole only if its home bucket is
+            // not cyclically inside (hole, next], or it would become unreachable.
+            int home = (int)(get_hash(buckets[next].key) & mask);
+            bool stays;
+            if (hole <= next) stays = (home > hole) && (home <= next);
+            else              stays = (home > hole) || (home <= next);
+            if (stays) continue;
+
+            buckets[hole]        = buckets[next];
+            occupancy_mask[hole] = true;
+            occupancy_mask[next] = false;
+            hole = next;
+        }
+
+        return true;
+    }
 };
 
 template <typename Value>
@@ -111,17 +157,17 @@ struct String_Hash_Table {
             if (!occupancy_mask[i]) continue;
 
             if (buckets[i].key) {
-                free(buckets[i].key);
+                delete [] buckets[i].key; // From copy_string.
             }
         }
         
         if (buckets) {
-            free(buckets);
+            tracked_free(buckets);
             buckets = NULL;
         }
 
         if (occupancy_mask) {
-            free(occupancy_mask);
+            tracked_free(occupancy_mask);
             occupancy_mask = NULL;
         }
 
@@ -136,18 +182,20 @@ struct String_Hash_Table {
             assert(allocated == 0);
             assert(count == 0);
             
-            buckets = (Bucket *)calloc(HASH_TABLE_INITIAL_CAPACITY, sizeof(Bucket));
-            occupancy_mask = (bool *)calloc(HASH_TABLE_INITIAL_CAPACITY, sizeof(bool));
+            buckets = (Bucket *)tracked_calloc(HASH_TABLE_INITIAL_CAPACITY, sizeof(Bucket), ALLOCATION_TAG_ARRAYS);
+            occupancy_mask = (bool *)tracked_calloc(HASH_TABLE_INITIAL_CAPACITY, sizeof(bool), ALLOCATION_TAG_ARRAYS);
+            if (!buckets || !occupancy_mask) out_of_memory(HASH_TABLE_INITIAL_CAPACITY * (sizeof(Bucket) + sizeof(bool)));
             
             allocated = HASH_TABLE_INITIAL_CAPACITY;
             count = 0;
         } else {
             String_Hash_Table <Value> new_hash_table = {
-                (Bucket *)calloc(allocated * 2, sizeof(Bucket)),
-                (bool *)calloc(allocated * 2, sizeof(bool)),
+                (Bucket *)tracked_calloc(allocated * 2, sizeof(Bucket), ALLOCATION_TAG_ARRAYS),
+                (bool *)tracked_calloc(allocated * 2, sizeof(bool), ALLOCATION_TAG_ARRAYS),
                 allocated * 2,
                 0,
             };
+            if (!new_hash_table.buckets || !new_hash_table.occupancy_mask) out_of_memory(allocated * 2 * (sizeof(Bucket) + sizeof(bool)));
 
             for (int i = 0; i < count; i++) {
                 if (occupancy_mask[i]) {
@@ -155,8 +203,8 @@ struct String_Hash_Table {
                 }
             }
 
-            free(buckets);
-            free(occupancy_mask);
+            tracked_free(buckets);
+            tracked_free(occupancy_mask);
 
             *this = new_hash_table;
         }
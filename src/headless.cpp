@@ -0,0 +1,453 @@
+#include "main.h"
+#include "headless.h"
+#include "benchmarks.h"
+#include "jobs.h"
+#include "world.h"
+#include "entity.h"
+#include "camera.h"
+#include "particles.h"
+#include "text_file_handler.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define INPUT_SCRIPT_FILE_VERSION 1
+
+enum Script_Key {
+    SCRIPT_KEY_LEFT  = Bit(0),
+    SCRIPT_KEY_RIGHT = Bit(1),
+    SCRIPT_KEY_JUMP  = Bit(2),
+};
+
+struct Input_Script_Step {
+    int num_ticks;
+    u32 keys;
+};
+
+struct Input_Script {
+    Array <Input_Script_Step> steps;
+
+    int current_step = 0;
+    int ticks_into_step = 0;
+};
+
+struct Headless_Options {
+    s64 num_ticks = 120 * 60 * 5;
+    int tick_rate = FIXED_UPDATE_HZ;
+    int level_width = 30;
+    u64 seed = 1;
+    char *script_filepath = NULL;
+
+    int num_worker_threads = -1; // One per core.
+    bool verify_parallel_update = false;
+    int verify_batch_size = 4;
+
+    char *profile_filepath = NULL; // Chrome trace of the run's zones.
+    bool check_allocations = false; // Fail if a steady-state tick allocates.
+};
+
+struct Headless_Stats {
+    s64 num_ticks = 0;
+    s64 simulation_nanoseconds = 0;
+
+    s64 enemy_nanoseconds = 0;
+    s64 projectile_nanoseconds = 0;
+    s64 broadphase_nanoseconds = 0;
+    s64 hero_nanoseconds = 0;
+    s64 particle_nanoseconds = 0;
+    s64 destruction_nanoseconds = 0;
+
+    s64 num_enemy_updates = 0;
+    s64 num_projectile_updates = 0;
+    s64 num_particle_updates = 0;
+    s64 num_entities_destroyed = 0;
+
+    int num_levels_completed = 0;
+    int num_deaths = 0;
+};
+
+static void make_default_input_script(Input_Script *script) {
+    // Run right and hop every now and then, with a short stretch of backing up,
+    // so that the hero keeps meeting enemies, pickups and the door.
+    script->steps.add({90, SCRIPT_KEY_RIGHT});
+    script->steps.add({12, SCRIPT_KEY_RIGHT | SCRIPT_KEY_JUMP});
+    script->steps.add({60, SCRIPT_KEY_RIGHT});
+    script->steps.add({8,  SCRIPT_KEY_JUMP});
+    script->steps.add({20, SCRIPT_KEY_LEFT});
+    script->steps.add({12, SCRIPT_KEY_RIGHT | SCRIPT_KEY_JUMP});
+}
+
+static bool load_input_script(Input_Script *script, char *filepath) {
+    Text_File_Handler handler;
+    if (!start_file(&handler, filepath)) return false;
+    defer { end_file(&handler); };
+
+    if (handler.version < 1 || handler.version > INPUT_SCRIPT_FILE_VERSION) {
+        report_error(&handler, "Invalid version number for an input script file!");
+        return false;
+    }
+
+    for (;;) {
+        char *line = consume_next_line(&handler);
+        if (!line) break;
+
+        char *rhs = break_by_space(line);
+        int num_ticks = atoi(line);
+        if (num_ticks <= 0) {
+            report_error(&handler, "Expected a positive tick count instead found '%s'!", line);
+            return false;
+        }
+
+        u32 keys = 0;
+        line = rhs;
+        while (line && *line) {
+            line = eat_spaces(line);
+            rhs = break_by_space(line);
+
+            if (strings_match(line, "left")) {
+                keys |= SCRIPT_KEY_LEFT;
+            } else if (strings_match(line, "right")) {
+                keys |= SCRIPT_KEY_RIGHT;
+            } else if (strings_match(line, "jump")) {
+                keys |= SCRIPT_KEY_JUMP;
+            } else if (line[0]) {
+                report_error(&handler, "Unknown key '%s', expected left, right or jump!", line);
+                return false;
+            }
+
+            line = rhs;
+        }
+
+        script->steps.add({num_ticks, keys});
+    }
+
+    if (!script->steps.count) {
+        report_error(&handler, "Input script has no steps!");
+        return false;
+    }
+
+    return true;
+}
+
+static void apply_input_script(Input_Script *script) {
+    Input_Script_Step *step = &script->steps[script->current_step];
+
+    advance_key_states();
+    set_key_state(SDL_SCANCODE_A, (step->keys & SCRIPT_KEY_LEFT) != 0);
+    set_key_state(SDL_SCANCODE_D, (step->keys & SCRIPT_KEY_RIGHT) != 0);
+    set_key_state(SDL_SCANCODE_W, (step->keys & SCRIPT_KEY_JUMP) != 0);
+
+    script->ticks_into_step++;
+    if (script->ticks_into_step >= step->num_ticks) {
+        script->ticks_into_step = 0;
+        script->current_step = (script->current_step + 1) % script->steps.count;
+    }
+}
+
+World *make_headless_world(int level_width) {
+    allocation_tag(ALLOCATION_TAG_WORLD);
+
+    World *world = new World();
+    init_world(world, v2i(level_width, 18));
+
+    generate_random_level(world, level_width, 18, random_u64(&globals.level_random));
+
+    Hero *hero = world->by_type._Hero;
+
+    world->camera                 = new Camera();
+    world->camera->position       = hero->position;
+    world->camera->target         = hero->position;
+    world->camera->following_id   = hero->id;
+    world->camera->dead_zone_size = v2(VIEW_AREA_WIDTH, VIEW_AREA_HEIGHT) * 0.1f;
+    world->camera->smooth_factor  = 0.95f;
+
+    // Nobody is watching, so skip straight to gameplay.
+    world->level_intro       = false;
+    world->level_fade.active = false;
+
+    return world;
+}
+
+static void accumulate_stats(Headless_Stats *stats, World_Update_Stats *update_stats) {
+    stats->enemy_nanoseconds       += update_stats->enemy_nanoseconds;
+    stats->projectile_nanoseconds  += update_stats->projectile_nanoseconds;
+    stats->broadphase_nanoseconds  += update_stats->broadphase_nanoseconds;
+    stats->hero_nanoseconds        += update_stats->hero_nanoseconds;
+    stats->particle_nanoseconds    += update_stats->particle_nanoseconds;
+    stats->destruction_nanoseconds += update_stats->destruction_nanoseconds;
+
+    stats->num_enemy_updates      += update_stats->num_enemies_updated;
+    stats->num_projectile_updates += update_stats->num_projectiles_updated;
+    stats->num_particle_updates   += update_stats->num_particles_updated;
+    stats->num_entities_destroyed += update_stats->num_entities_destroyed;
+}
+
+static void print_cost_line(char *name, s64 nanoseconds, s64 num_ticks, s64 num_updates) {
+    double per_tick   = num_ticks   > 0 ? (double)nanoseconds / (double)num_ticks   : 0.0;
+    double per_update = num_updates > 0 ? (double)nanoseconds / (double)num_updates : 0.0;
+    printf("  %-12s %12.1f ns/tick %12lld updates %10.1f ns/update\n", name, per_tick, (long long)num_updates, per_update);
+}
+
+void print_allocation_report(Allocation_Counters *before) {
+    printf("  %-10s %10s %14s %10s %14s %14s\n", "tag", "allocs", "bytes", "frees", "live bytes", "peak live");
+    for (int i = 0; i < NUM_ALLOCATION_TAGS; i++) {
+        Allocation_Tag_Counters *now  = &allocation_counters.by_tag[i];
+        Allocation_Tag_Counters *then = &before->by_tag[i];
+
+        s64 num_allocations = now->num_allocations - then->num_allocations;
+        s64 num_frees       = now->num_frees       - then->num_frees;
+        if (!num_allocations && !num_frees && !now->live_bytes) continue;
+
+        printf("  %-10s %10lld %14lld %10lld %14lld %14lld\n", allocation_tag_names[i],
+               (long long)num_allocations, (long long)(now->num_bytes_allocated - then->num_bytes_allocated),
+               (long long)num_frees, (long long)now->live_bytes, (long long)now->peak_live_bytes);
+    }
+    printf("  %-10s %10s %14s %10s %14lld %14lld\n", "total", "", "", "", (long long)allocation_counters.live_bytes, (long long)allocation_counters.peak_live_bytes);
+}
+
+static void print_report(Headless_Options *options, Headless_Stats *stats, s64 wall_nanoseconds, Allocation_Counters *allocations_before, u64 world_state_hash) {
+    double wall_seconds = nanoseconds_to_seconds(wall_nanoseconds);
+    double sim_seconds  = nanoseconds_to_seconds(stats->simulation_nanoseconds);
+
+    printf("Headless run: %lld ticks at %d Hz (%.1f simulated seconds), seed %llu\n",
+           (long long)stats->num_ticks, options->tick_rate, (double)stats->num_ticks / options->tick_rate, (unsigned long long)options->seed);
+    printf("Wall time: %.3f s, %.0f ticks/sec (%.0f ticks/sec in update_world alone)\n",
+           wall_seconds,
+           wall_seconds > 0.0 ? stats->num_ticks / wall_seconds : 0.0,
+           sim_seconds  > 0.0 ? stats->num_ticks / sim_seconds  : 0.0);
+    printf("Levels completed: %d, deaths: %d\n", stats->num_levels_completed, stats->num_deaths);
+
+    printf("Update cost:\n");
+    print_cost_line("enemies",     stats->enemy_nanoseconds,       stats->num_ticks, stats->num_enemy_updates);
+    print_cost_line("projectiles", stats->projectile_nanoseconds,  stats->num_ticks, stats->num_projectile_updates);
+    print_cost_line("broadphase",  stats->broadphase_nanoseconds,  stats->num_ticks, stats->num_ticks);
+    print_cost_line("hero",        stats->hero_nanoseconds,        stats->num_ticks, stats->num_ticks);
+    print_cost_line("particles",   stats->particle_nanoseconds,    stats->num_ticks, stats->num_particle_updates);
+    print_cost_line("destruction", stats->destruction_nanoseconds, stats->num_ticks, stats->num_entities_destroyed);
+
+    s64 num_allocations = allocation_counters.num_allocations     - allocations_before->num_allocations;
+    s64 num_bytes       = allocation_counters.num_bytes_allocated - allocations_before->num_bytes_allocated;
+    s64 num_frees       = allocation_counters.num_frees           - allocations_before->num_frees;
+
+    double per_tick = stats->num_ticks > 0 ? (double)num_allocations / (double)stats->num_ticks : 0.0;
+    printf("Allocations: %lld (%lld bytes), frees: %lld, %.3f allocations/tick\n",
+           (long long)num_allocations, (long long)num_bytes, (long long)num_frees, per_tick);
+    print_allocation_report(allocations_before);
+
+    Allocation_Frame_Stats *frames = &allocation_frame_stats;
+    printf("Steady-state ticks (after each level's first second): %lld, %lld of them allocated, at most %lld allocations (%lld bytes) in one\n",
+           (long long)frames->num_frames, (long long)frames->num_frames_that_allocated,
+           (long long)frames->peak_frame_allocations, (long long)frames->peak_frame_bytes);
+    printf("World state hash: %016llx\n", (unsigned long long)world_state_hash);
+    fflush(stdout);
+}
+
+static bool parse_options(Headless_Options *options, int argc, char *argv[]) {
+    for (int i = 1; i < argc; i++) {
+        char *arg = argv[i];
+        bool has_value = i < argc - 1;
+
+        if (strings_match(arg, "-ticks") && has_value) {
+            options->num_ticks = atoll(argv[++i]);
+        } else if (strings_match(arg, "-hz") && has_value) {
+            options->tick_rate = atoi(argv[++i]);
+        } else if (strings_match(arg, "-level_width") && has_value) {
+            options->level_width = atoi(argv[++i]);
+        } else if (strings_match(arg, "-seed") && has_value) {
+            options->seed = strtoull(argv[++i], NULL, 10);
+        } else if (strings_match(arg, "-script") && has_value) {
+            options->script_filepath = argv[++i];
+        } else if (strings_match(arg, "-threads") && has_value) {
+            options->num_worker_threads = atoi(argv[++i]);
+        } else if (strings_match(arg, "-verify_parallel_update")) {
+            options->verify_parallel_update = true;
+        } else if (strings_match(arg, "-batch_size") && has_value) {
+            options->verify_batch_size = Max(atoi(argv[++i]), 1);
+        } else if (strings_match(arg, "-profile") && has_value) {
+            options->profile_filepath = argv[++i];
+        } else if (strings_match(arg, "-check_allocations")) {
+            options->check_allocations = true;
+        }
+    }
+
+    if (options->num_ticks <= 0) {
+        logprintf("Headless: tick count must be positive!\n");
+        return false;
+    }
+
+    if (options->tick_rate <= 0) {
+        logprintf("Headless: tick rate must be positive!\n");
+        return false;
+    }
+
+    if (options->level_width < 16) {
+        logprintf("Headless: level width must be at least 16!\n");
+        return false;
+    }
+
+    return true;
+}
+
+// Runs the whole simulation from the seed, so it can be run more than once.
+// If tick_hashes is given, the world state hash after every tick goes there.
+static u64 run_simulation(Headless_Options *options, Input_Script *script, Headless_Stats *stats, Array <u64> *tick_hashes = NULL) {
+    globals.session_seed = options->seed;
+    globals.should_switch_worlds = false;
+    seed_random(options->seed);
+    seed_random(&globals.level_random, get_hash(options->seed));
+
+    script->current_step    = 0;
+    script->ticks_into_step = 0;
+    
+    float dt = 1.0f / (float)options->tick_rate;
+    int level_width = options->level_width;
+
+    World *world = make_headless_world(level_width);
+    s64 ticks_into_level = 0;
+
+    reset_allocation_frame_stats();
+
+    for (s64 tick = 0; tick < options->num_ticks; tick++) {
+        reset_frame_arena();
+        apply_input_script(script);
+
+        // The first second of a level grows its arrays, pools and particle
+        // storage to their working size; after that a tick should not touch
+        // the heap at all.
+        bool steady_state = ticks_into_level >= options->tick_rate;
+        begin_allocation_frame();
+
+        s64 update_start_time = get_time_nanoseconds();
+        update_world(world, dt);
+        stats->simulation_nanoseconds += get_time_nanoseconds() - update_start_time;
+
+        if (steady_state) end_allocation_frame();
+        ticks_into_level++;
+
+        accumulate_stats(stats, &world->update_stats);
+        stats->num_ticks++;
+
+        if (tick_hashes) tick_hashes->add(get_world_state_hash(world));
+
+        if (globals.should_switch_worlds) {
+            globals.should_switch_worlds = false;
+
+            Hero *hero = world->by_type._Hero;
+            if (!hero || hero->health <= 0.0) {
+                stats->num_deaths++;
+            } else {
+                stats->num_levels_completed++;
+                level_width += 30;
+            }
+
+            destroy_world(world);
+            delete world;
+            world = make_headless_world(level_width);
+            ticks_into_level = 0;
+        }
+    }
+
+    u64 hash = get_world_state_hash(world);
+    
+    destroy_world(world);
+    delete world;
+
+    return hash;
+}
+
+// Runs the simulation once entirely inline and once with every parallel loop
+// split into small batches over the job threads, and checks that the world
+// state matches after every single tick.
+static int verify_parallel_update(Headless_Options *options, Input_Script *script) {
+    bool parallel_world_update = globals.parallel_world_update;
+    int world_update_batch_size = globals.world_update_batch_size;
+    defer {
+        globals.parallel_world_update   = parallel_world_update;
+        globals.world_update_batch_size = world_update_batch_size;
+    };
+
+    Headless_Stats serial_stats;
+    Array <u64> serial_hashes;
+    globals.parallel_world_update = false;
+    run_simulation(options, script, &serial_stats, &serial_hashes);
+
+    Headless_Stats parallel_stats;
+    Array <u64> parallel_hashes;
+    globals.parallel_world_update   = true;
+    globals.world_update_batch_size = options->verify_batch_size;
+    run_simulation(options, script, &parallel_stats, &parallel_hashes);
+
+    printf("Parallel update check: %lld ticks, level width %d, batches of %d on %d worker threads\n",
+           (long long)options->num_ticks, options->level_width, options->verify_batch_size, get_num_worker_threads());
+    printf("  %lld enemy, %lld projectile and %lld particle updates\n",
+           (long long)parallel_stats.num_enemy_updates, (long long)parallel_stats.num_projectile_updates,
+           (long long)parallel_stats.num_particle_updates);
+
+    for (int i = 0; i < serial_hashes.count; i++) {
+        if (serial_hashes[i] != parallel_hashes[i]) {
+            printf("  FAILED: world state differs after tick %d (%016llx serial, %016llx parallel)\n",
+                   i + 1, (unsigned long long)serial_hashes[i], (unsigned long long)parallel_hashes[i]);
+            fflush(stdout);
+            return 1;
+        }
+    }
+
+    printf("  passed, final world state hash %016llx\n", (unsigned long long)serial_hashes[serial_hashes.count - 1]);
+    fflush(stdout);
+    return 0;
+}
+
+int run_headless(int argc, char *argv[]) {
+    Headless_Options options;
+    options.level_width = globals.start_level_width;
+    if (!parse_options(&options, argc, argv)) return 1;
+
+    init_job_system(options.num_worker_threads);
+    defer { shutdown_job_system(); };
+
+    defer {
+        if (!options.profile_filepath) return;
+#ifdef PROFILER
+        write_chrome_trace(options.profile_filepath);
+#else
+        logprintf("Profile zones are compiled out of this build; not writing '%s'.\n", options.profile_filepath);
+#endif
+    };
+    
+    for (int i = 1; i < argc - 1; i++) {
+        if (strings_match(argv[i], "-benchmark")) return run_benchmark(argv[i + 1], argc, argv);
+    }
+
+    Input_Script script;
+    if (options.script_filepath) {
+        if (!load_input_script(&script, options.script_filepath)) return 1;
+    } else {
+        make_default_input_script(&script);
+    }
+
+    if (options.verify_parallel_update) return verify_parallel_update(&options, &script);
+    
+    Headless_Stats stats;
+
+    Allocation_Counters allocations_before = allocation_counters;
+    s64 start_time = get_time_nanoseconds();
+
+    u64 world_state_hash = run_simulation(&options, &script, &stats);
+
+    s64 wall_nanoseconds = get_time_nanoseconds() - start_time;
+
+    print_report(&options, &stats, wall_nanoseconds, &allocations_before, world_state_hash);
+
+    if (options.check_allocations && allocation_frame_stats.num_frames_that_allocated) {
+        printf("FAILED: steady-state ticks allocated:");
+        for (int i = 0; i < NUM_ALLOCATION_TAGS; i++) {
+            s64 n = allocation_frame_stats.allocations_by_tag[i];
+            if (n) printf(" %s %lld", allocation_tag_names[i], (long long)n);
+        }
+        printf("\n");
+        fflush(stdout);
+        return 1;
+    }
+
+    return 0;
+}
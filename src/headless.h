@@ -0,0 +1,14 @@
+#pragma once
+
+// Runs the world simulation with no window, GL context or audio device.
+// Entered from main() with the -headless flag; returns the process exit code.
+struct World;
+
+int run_headless(int argc, char *argv[]);
+
+// A generated level with a camera on the hero and the intro skipped, ready
+// for update_world. Seeded from globals.level_random.
+World *make_headless_world(int level_width);
+
+// Heap traffic per allocation tag since `before`, and what each holds now.
+void print_allocation_report(Allocation_Counters *before);
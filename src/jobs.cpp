@@ -0,0 +1,209 @@
+#include "main.h"
+#include "jobs.h"
+
+#include <stdio.h>
+
+const int MAX_JOB_THREADS = 64;
+const int JOB_DEQUE_CAPACITY = 4096; // Power of two.
+
+struct Job {
+    Job_Proc proc;
+    void *data;
+    int index;
+    Job_Counter *counter;
+};
+
+// Guarded by a spinlock rather than lock-free; jobs here are batches of
+// hundreds of entities, so the lock is never the bottleneck.
+struct Job_Deque {
+    SDL_SpinLock lock = 0;
+    Job jobs[JOB_DEQUE_CAPACITY];
+    s64 top = 0;    // Thieves take from here.
+    s64 bottom = 0; // The owner pushes and pops here.
+};
+
+struct Job_Thread {
+    SDL_Thread *thread = NULL;
+    int index = 0;
+    Job_Deque deque;
+};
+
+static Job_Thread *job_threads = NULL; // [0] is the main thread.
+static int num_job_threads = 1;
+static SDL_sem *work_semaphore = NULL;
+static SDL_atomic_t quit_workers;
+
+static thread_local int current_job_thread_index = 0;
+
+static bool push_job(Job_Deque *deque, Job job) {
+    bool pushed = false;
+
+    SDL_AtomicLock(&deque->lock);
+    if (deque->bottom - deque->top < JOB_DEQUE_CAPACITY) {
+        deque->jobs[deque->bottom & (JOB_DEQUE_CAPACITY - 1)] = job;
+        deque->bottom++;
+        pushed = true;
+    }
+    SDL_AtomicUnlock(&deque->lock);
+
+    return pushed;
+}
+
+static bool pop_job(Job_Deque *deque, Job *job) {
+    bool popped = false;
+
+    SDL_AtomicLock(&deque->lock);
+    if (deque->bottom > deque->top) {
+        deque->bottom--;
+        *job = deque->jobs[deque->bottom & (JOB_DEQUE_CAPACITY - 1)];
+        popped = true;
+    }
+    SDL_AtomicUnlock(&deque->lock);
+
+    return popped;
+}
+
+static bool steal_job(Job_Deque *deque, Job *job) {
+    bool stolen = false;
+
+    SDL_AtomicLock(&deque->lock);
+    if (deque->bottom > deque->top) {
+        *job = deque->jobs[deque->top & (JOB_DEQUE_CAPACITY - 1)];
+        deque->top++;
+        stolen = true;
+    }
+    SDL_AtomicUnlock(&deque->lock);
+
+    return stolen;
+}
+
+static void run_job(Job job) {
+    profile_zone("job");
+    job.proc(job.data, job.index);
+    SDL_AtomicAdd(&job.counter->remaining, -1);
+}
+
+static bool find_job(Job *job) {
+    int self = current_job_thread_index;
+    if (pop_job(&job_threads[self].deque, job)) return true;
+
+    for (int i = 1; i < num_job_threads; i++) {
+        int victim = (self + i) % num_job_threads;
+        if (steal_job(&job_threads[victim].deque, job)) return true;
+    }
+
+    return false;
+}
+
+static int worker_thread_proc(void *data) {
+    Job_Thread *thread = (Job_Thread *)data;
+    current_job_thread_index = thread->index;
+
+    char name[32];
+    snprintf(name, sizeof(name), "Job worker %d", thread->index);
+    set_profile_thread_name(name);
+
+    while (!SDL_AtomicGet(&quit_workers)) {
+        Job job;
+        if (find_job(&job)) {
+            run_job(job);
+        } else {
+            SDL_SemWait(work_semaphore);
+        }
+    }
+
+    return 0;
+}
+
+void init_job_system(int num_worker_threads) {
+    assert(!job_threads);
+
+    if (num_worker_threads < 0) num_worker_threads = SDL_GetCPUCount() - 1;
+    num_worker_threads = Max(0, Min(num_worker_threads, MAX_JOB_THREADS - 1));
+
+    job_threads = new Job_Thread[num_worker_threads + 1];
+    num_job_threads = 1;
+    current_job_thread_index = 0;
+
+    SDL_AtomicSet(&quit_workers, 0);
+    if (num_worker_threads) work_semaphore = SDL_CreateSemaphore(0);
+
+    for (int i = 1; i <= num_worker_threads && work_semaphore; i++) {
+        Job_Thread *thread = &job_threads[i];
+        thread->index = i;
+
+        char name[32];
+        snprintf(name, sizeof(name), "Job worker %d", i);
+        thread->thread = SDL_CreateThread(worker_thread_proc, name, thread);
+        if (!thread->thread) {
+            logprintf("Failed to create job worker thread: %s\n", SDL_GetError());
+            break;
+        }
+
+        num_job_threads++;
+    }
+
+    logprintf("Job system running with %d worker threads.\n", num_job_threads - 1);
+}
+
+void shutdown_job_system() {
+    if (!job_threads) return;
+
+    SDL_AtomicSet(&quit_workers, 1);
+    for (int i = 1; i < num_job_threads; i++) {
+        SDL_SemPost(work_semaphore);
+    }
+
+    for (int i = 1; i < num_job_threads; i++) {
+        SDL_WaitThread(job_threads[i].thread, NULL);
+    }
+
+    if (work_semaphore) {
+        SDL_DestroySemaphore(work_semaphore);
+        work_semaphore = NULL;
+    }
+
+    delete [] job_threads;
+    job_threads = NULL;
+    num_job_threads = 1;
+}
+
+int get_num_worker_threads() {
+    return num_job_threads - 1;
+}
+
+void run_jobs(Job_Proc proc, void *data, int num_jobs, Job_Counter *counter) {
+    SDL_AtomicSet(&counter->remaining, num_jobs);
+
+    // Without the job system there is nobody to hand work to.
+    if (!job_threads || num_job_threads == 1) {
+        for (int i = 0; i < num_jobs; i++) {
+            run_job({proc, data, i, counter});
+        }
+        return;
+    }
+
+    // Pushed back to front, so the owner pops them in order and thieves
+    // take from the far end.
+    Job_Deque *deque = &job_threads[current_job_thread_index].deque;
+    for (int i = num_jobs - 1; i >= 0; i--) {
+        Job job = {proc, data, i, counter};
+        if (!push_job(deque, job)) run_job(job);
+    }
+
+    int num_wakeups = Min(num_jobs, num_job_threads - 1);
+    for (int i = 0; i < num_wakeups; i++) {
+        SDL_SemPost(work_semaphore);
+    }
+}
+
+void wait_for_counter(Job_Counter *counter) {
+    while (SDL_AtomicGet(&counter->remaining) > 0) {
+        Job job;
+        if (job_threads && find_job(&job)) {
+            run_job(job);
+        } else {
+            SDL_CPUPauseInstruction();
+        }
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+// Small work-stealing job system. Every worker thread owns a deque of jobs: it
+// pushes and pops its own at the bottom and, when it runs dry, steals from the
+// top of the others'. The main thread counts as worker 0 and runs jobs while it
+// waits, so with no worker threads (or on the web) everything runs inline.
+
+struct Job_Counter {
+    SDL_atomic_t remaining;
+};
+
+typedef void (*Job_Proc)(void *data, int index);
+
+// num_worker_threads < 0 means one per core, not counting the main thread.
+void init_job_system(int num_worker_threads = -1);
+void shutdown_job_system();
+
+int get_num_worker_threads();
+
+// Queues proc(data, 0) .. proc(data, num_jobs - 1) and returns right away;
+// the counter reaches zero once they have all finished.
+void run_jobs(Job_Proc proc, void *data, int num_jobs, Job_Counter *counter);
+
+// Runs queued jobs (ours or stolen) until the counter reaches zero.
+void wait_for_counter(Job_Counter *counter);
+
+// Splits [0, count) into batches of batch_size, calls
+// proc(batch_index, begin, end) for each across all threads and returns when
+// they are done. Returns the number of batches.
+template <typename Proc>
+int parallel_for(int count, int batch_size, Proc proc) {
+    assert(batch_size > 0);
+
+    struct Parallel_For {
+        Proc *proc;
+        int count;
+        int batch_size;
+    };
+
+    Parallel_For parallel_for = {&proc, count, batch_size};
+    int num_batches = (count + batch_size - 1) / batch_size;
+
+    auto run_batch = [](void *data, int batch_index) {
+        Parallel_For *parallel_for = (Parallel_For *)data;
+        int begin = batch_index * parallel_for->batch_size;
+        int end   = Min(begin + parallel_for->batch_size, parallel_for->count);
+        (*parallel_for->proc)(batch_index, begin, end);
+    };
+
+    Job_Counter counter;
+    run_jobs(run_batch, &parallel_for, num_batches, &counter);
+    wait_for_counter(&counter);
+
+    return num_batches;
+}
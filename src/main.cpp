@@ -9,6 +9,11 @@
 #include "main_menu.h"
 #include "audio.h"
 #include "packager/packager.h"
+#include "headless.h"
+#include "recording.h"
+#include "jobs.h"
+#include "frame_pacer.h"
+#include "render_queue.h"
 #ifndef OS_WINDOWS
 #include "icon_data.h"
 #endif
@@ -16,7 +21,7 @@
 #ifdef __EMSCRIPTEN__
 #include <emscripten.h>
 #include <emscripten/html5.h>
-#else
+#elif defined(RENDER_OPENGL)
 #include <GL/glew.h>
 #endif
 #include <stdio.h>
@@ -39,6 +44,20 @@ struct Key_State {
 };
 
 static Key_State key_states[SDL_NUM_SCANCODES];
+static Array <Recorded_Key> frame_keys;
+
+struct Replay_Stats {
+    s64 num_frames = 0;
+    s64 total_frame_time = 0;
+    s64 max_frame_time = 0;
+};
+
+static Replay_Stats replay_stats;
+
+static Frame_Pacer frame_pacer;
+static Frame_Pacer_Stats last_frame_pacer_window; // For the debug HUD.
+
+static s64 startup_time; // For logging when the first frame went up.
 
 static void toggle_fullscreen(SDL_Window *window);
 
@@ -54,6 +73,20 @@ bool was_key_just_released(int key_code) {
     return key_states[key_code].was_down && !key_states[key_code].is_down;
 }
 
+void set_key_state(int key_code, bool is_down) {
+    Key_State *state = &key_states[key_code];
+    state->changed   = state->is_down != is_down;
+    state->is_down   = is_down;
+}
+
+void advance_key_states() {
+    for (int i = 0; i < ArrayCount(key_states); i++) {
+        Key_State *state = &key_states[i];
+        state->was_down  = state->is_down;
+        state->changed   = false;
+    }
+}
+
 double nanoseconds_to_seconds(u64 nanoseconds) {
     double result = (double)nanoseconds / NS_PER_SECOND;
     return result;
@@ -80,38 +113,36 @@ static void update_time() {
     }
 }
 
-static void adjust_fps_cap_based_on_performance() {    
-    int fps = 0;
-    if (globals.time_info.fps_dt > 0.0) {
-        fps = (int)(1.0 / globals.time_info.fps_dt);
-    } else {
-        return;
-    }
-    
-    if (fps < globals.time_info.fps_cap * 0.9f) { // Only count if significantly below target
-        globals.time_info.slow_frame_count++;
+// Once per window of MAX_SLOW_FRAMES frames: halve the cap if more than a
+// quarter of them overran their deadline, double it once frames have had
+// half their time to spare for a few hundred frames running.
+static void adjust_fps_cap_based_on_performance() {
+    Frame_Pacer_Stats *window = &frame_pacer.window;
+    if (window->num_frames < MAX_SLOW_FRAMES) return;
+
+    Time_Info *time_info = &globals.time_info;
+    time_info->slow_frame_count = (int)window->num_late_frames;
+
+    if (window->num_late_frames * 4 > window->num_frames) {
+        time_info->fps_cap = Max(30, time_info->fps_cap / 2);
+        time_info->fast_frame_count = 0;
+    } else if (window->num_early_frames * 20 >= window->num_frames * 19) {
+        time_info->fast_frame_count += (int)window->num_frames;
+        if (time_info->fast_frame_count > 300 && time_info->fps_cap < MAX_FPS_CAP) {
+            time_info->fps_cap = Min(MAX_FPS_CAP, time_info->fps_cap * 2);
+            time_info->fast_frame_count = 0;
+        }
     } else {
-        globals.time_info.slow_frame_count = 0; // reset if performance recovers
+        time_info->fast_frame_count = 0;
     }
 
-    if (globals.time_info.slow_frame_count > MAX_SLOW_FRAMES) {
-        globals.time_info.fps_cap = Max(30, globals.time_info.fps_cap / 2);
-        globals.time_info.slow_frame_count = 0;
-    }
+    set_frame_pacer_rate(&frame_pacer, time_info->fps_cap);
 
-    if (fps > globals.time_info.fps_cap * 1.1f) {
-        globals.time_info.fast_frame_count++;
-        if (globals.time_info.fast_frame_count > 300 && globals.time_info.fps_cap < 120) {
-            globals.time_info.fps_cap *= 2;
-            globals.time_info.fps_cap = Max(MAX_FPS_CAP, globals.time_info.fps_cap);
-            globals.time_info.fast_frame_count = 0;
-        }
-    } else {
-        globals.time_info.fast_frame_count = 0;
-    }
+    last_frame_pacer_window = *window;
+    *window = {};
 }
 
-static void init_shaders() {
+void init_shaders() {
     globals.shader_color   = make_shader();
     load_shader(globals.shader_color, R"(
 precision highp float;
@@ -148,6 +179,46 @@ void main() {
 #endif
 )", "color");
     
+    globals.shader_circle  = make_shader();
+    load_shader(globals.shader_circle, R"(
+precision highp float;
+
+OUT_IN vec4 v_color;
+OUT_IN vec2 v_uv;
+
+#ifdef VERTEX_SHADER
+
+in vec2 a_position;
+in vec4 a_color;
+in vec2 a_uv;
+
+uniform mat4 object_to_proj_matrix;
+
+void main() {
+    gl_Position = object_to_proj_matrix * vec4(a_position, 0.0, 1.0);
+    v_color     = a_color;
+    v_uv        = a_uv;
+}
+
+#endif
+
+#ifdef FRAGMENT_SHADER
+
+out vec4 o_color;
+
+void main() {
+    if (dot(v_uv, v_uv) > 1.0) discard;
+    
+#ifdef SGLES
+    o_color = vec4(pow(v_color.xyz, vec3(1.0 / 2.2)), 1.0);
+#else
+    o_color = v_color;
+#endif
+}
+
+#endif
+)", "circle");
+    
     globals.shader_texture = make_shader();
     load_shader(globals.shader_texture, R"(
 precision highp float;
@@ -244,39 +315,46 @@ void main() {
 )", "text");
 }
 
-static void load_assets() {
+void load_textures() {
     Texture *white_texture = make_texture();
     u8 white_texture_data[4] = { 0xFF, 0xFF, 0xFF, 0xFF };
     load_texture_from_data(white_texture, 1, 1, TEXTURE_FORMAT_RGBA8, white_texture_data);
     
-    globals.full_heart    = find_or_load_texture("heart_full_16x16");
+    globals.full_heart    = find_or_start_loading_texture("heart_full_16x16");
     if (!globals.full_heart) globals.full_heart = white_texture;
     
-    globals.half_heart    = find_or_load_texture("heart_half_16x16");
+    globals.half_heart    = find_or_start_loading_texture("heart_half_16x16");
     if (!globals.half_heart) globals.half_heart = white_texture;
     
-    globals.empty_heart   = find_or_load_texture("heart_empty_16x16");
+    globals.empty_heart   = find_or_start_loading_texture("heart_empty_16x16");
     if (!globals.empty_heart) globals.empty_heart = white_texture;
     
-    globals.restart_taken = find_or_load_texture("restart_taken");
+    globals.restart_taken = find_or_start_loading_texture("restart_taken");
     if (!globals.restart_taken) globals.restart_taken = white_texture;
     
-    globals.restart_available = find_or_load_texture("restart_available");
+    globals.restart_available = find_or_start_loading_texture("restart_available");
     if (!globals.restart_available) globals.restart_available = white_texture;
-    
-    globals.menu_background_music = find_or_load_sound("menu-music", true);
-    globals.level_background_music = find_or_load_sound("level-music", true);
-    globals.coin_pickup_sfx    = find_or_load_sound("coin-pickup", false);
-    globals.level_complete_sfx = find_or_load_sound("level-completed", false);
-    globals.death_sfx = find_or_load_sound("death", false);
-    globals.jump_sfx = find_or_load_sound("jump", false);
-    globals.damage_sfx = find_or_load_sound("damage", false);
-    globals.enemy_kill_sfx = find_or_load_sound("enemy-kill", false);
-    globals.level_fail_sfx = find_or_load_sound("level-failed", false);
-
-    globals.menu_change_option = find_or_load_sound("menu-change-option", false);
-    globals.menu_select = find_or_load_sound("menu-select", false);
-    globals.exit_menu = find_or_load_sound("exit-menu", false);
+}
+
+// Starts loading everything on the asset loader thread and returns, so the
+// menu is up before the music has finished decoding; main_loop fills the
+// handles in as they come back.
+static void load_assets() {
+    load_textures();
+
+    globals.menu_background_music = find_or_start_loading_sound("menu-music", true);
+    globals.level_background_music = find_or_start_loading_sound("level-music", true);
+    globals.coin_pickup_sfx    = find_or_start_loading_sound("coin-pickup", false);
+    globals.level_complete_sfx = find_or_start_loading_sound("level-completed", false);
+    globals.death_sfx = find_or_start_loading_sound("death", false);
+    globals.jump_sfx = find_or_start_loading_sound("jump", false);
+    globals.damage_sfx = find_or_start_loading_sound("damage", false);
+    globals.enemy_kill_sfx = find_or_start_loading_sound("enemy-kill", false);
+    globals.level_fail_sfx = find_or_start_loading_sound("level-failed", false);
+
+    globals.menu_change_option = find_or_start_loading_sound("menu-change-option", false);
+    globals.menu_select = find_or_start_loading_sound("menu-select", false);
+    globals.exit_menu = find_or_start_loading_sound("exit-menu", false);
 }
 
 static void init_framebuffer() {
@@ -307,14 +385,45 @@ static void init_framebuffer() {
 #endif
 }
 
-static void draw_debug_hud() {
-    set_shader(globals.shader_text);
-    rendering_2d(globals.render_width, globals.render_height);
+#ifdef PROFILER
+
+// The main thread's zones over the last frame along the bottom of the
+// screen, a row per nesting depth, each as wide as its share of the frame.
+static void draw_profile_flame_bar() {
+    Array <Profile_Event> events;
+    events.use_arena(&frame_arena);
+    s64 frame_start, frame_end;
+    if (!get_last_profile_frame(&events, &frame_start, &frame_end) || frame_end <= frame_start) return;
 
-    set_blend_mode(BLEND_MODE_ALPHA);
-    set_cull_mode(CULL_MODE_OFF);
-    set_depth_test_mode(DEPTH_TEST_OFF);
+    int font_size = (int)(0.02f * globals.render_height);
+    Dynamic_Font *font = get_font_at_size("OpenSans-Regular", font_size);
+
+    float row_height = (float)font->character_height + 2.0f;
+    float scale = (float)globals.render_width / (float)(frame_end - frame_start);
+
+    for (Profile_Event event : events) {
+        float x     = (event.start - frame_start) * scale;
+        float width = (event.end - event.start) * scale;
+        if (width < 1.0f) continue;
+
+        float y = event.depth * row_height;
+
+        u64 hash = get_hash(event.name);
+        Vector4 color = v4(0.4f + 0.5f * ((hash >>  0) & 0xFF) / 255.0f,
+                           0.4f + 0.5f * ((hash >>  8) & 0xFF) / 255.0f,
+                           0.4f + 0.5f * ((hash >> 16) & 0xFF) / 255.0f, 0.85f);
+        queue_quad(RENDER_LAYER_HUD, v2(x, y), v2(Max(width - 1.0f, 1.0f), row_height - 1.0f), color);
+
+        char *text = tprint("%s %.2f ms", event.name, (event.end - event.start) / 1000000.0);
+        if (font->get_string_width_in_pixels(text) + 4 <= width) {
+            draw_text(font, text, (int)x + 2, (int)(y + row_height * 0.25f), v4(0, 0, 0, 1));
+        }
+    }
+}
 
+#endif
+
+static void draw_debug_hud() {
     int fps = 0;
     if (globals.time_info.fps_dt > 0.0) {
         fps = (int)(1.0 / globals.time_info.fps_dt);
@@ -322,11 +431,53 @@ static void draw_debug_hud() {
     
     int font_size = (int)(0.03f * globals.render_height);
     Dynamic_Font *font = get_font_at_size("OpenSans-Regular", font_size);
-    char text[128];
-    snprintf(text, sizeof(text), "FPS: %d", fps);
+    char *text = tprint("FPS: %d", fps);
     int x = globals.render_width  - font->get_string_width_in_pixels(text);
     int y = globals.render_height - font->character_height - ((int)(0.08f * globals.render_height));
     draw_text(font, text, x, y, v4(1, 1, 1, 1));
+
+    text = tprint("Ticks: %d (%lld dropped)", globals.time_info.num_fixed_updates, (long long)globals.time_info.num_dropped_updates);
+    x  = globals.render_width - font->get_string_width_in_pixels(text);
+    y -= font->character_height;
+    draw_text(font, text, x, y, v4(1, 1, 1, 1));
+
+    Frame_Pacer_Stats *window = &last_frame_pacer_window;
+    text = tprint("Frame: %.2f +- %.2f ms, %lld/%lld late, cap %d",
+                  get_average_frame_milliseconds(window), get_frame_time_standard_deviation_milliseconds(window),
+                  (long long)window->num_late_frames, (long long)window->num_frames, globals.time_info.fps_cap);
+    x  = globals.render_width - font->get_string_width_in_pixels(text);
+    y -= font->character_height;
+    draw_text(font, text, x, y, v4(1, 1, 1, 1));
+
+    text = tprint("Entities: %lld drawn, %lld culled; particles: %lld drawn, %lld culled",
+                  (long long)render_stats.num_entities_drawn, (long long)render_stats.num_entities_culled,
+                  (long long)render_stats.num_particles_drawn, (long long)render_stats.num_particles_culled);
+    x  = globals.render_width - font->get_string_width_in_pixels(text);
+    y -= font->character_height;
+    draw_text(font, text, x, y, v4(1, 1, 1, 1));
+
+    // Everything drawn so far this frame, which is all of it bar this HUD.
+    text = tprint("Draw: %lld calls, %lld state changes, %lld vertices, %lld flushes, %.1f KB uploaded",
+                  (long long)render_stats.num_draw_calls, (long long)render_stats.num_state_changes, (long long)render_stats.num_vertices,
+                  (long long)render_stats.num_flushes, render_stats.num_bytes_uploaded / 1024.0);
+    x  = globals.render_width - font->get_string_width_in_pixels(text);
+    y -= font->character_height;
+    draw_text(font, text, x, y, v4(1, 1, 1, 1));
+
+    Allocation_Frame_Stats *allocations = &allocation_frame_stats;
+    text = tprint("Heap: %lld allocations (%.1f KB) last frame, %lld/%lld frames allocated, %.1f MB live (peak %.1f MB)",
+                  (long long)allocations->last_frame_allocations, allocations->last_frame_bytes / 1024.0,
+                  (long long)allocations->num_frames_that_allocated, (long long)allocations->num_frames,
+                  allocation_counters.live_bytes / (1024.0 * 1024.0), allocation_counters.peak_live_bytes / (1024.0 * 1024.0));
+    x  = globals.render_width - font->get_string_width_in_pixels(text);
+    y -= font->character_height;
+    draw_text(font, text, x, y, v4(1, 1, 1, 1));
+
+#ifdef PROFILER
+    draw_profile_flame_bar();
+#endif
+
+    flush_render_queue();
 }
 
 static void respond_to_input() {
@@ -339,25 +490,18 @@ static void respond_to_input() {
 
             case SDL_KEYDOWN:
             case SDL_KEYUP: {
+                // While replaying, key state comes from the recording.
+                if (is_replaying()) break;
+                
                 bool is_down = event.type == SDL_KEYDOWN;
                 
-                Key_State *state = &key_states[event.key.keysym.scancode];
-                state->changed   = state->is_down != is_down;
-                state->is_down   = is_down;
+                set_key_state(event.key.keysym.scancode, is_down);
 
                 if (is_down && !event.key.repeat) {
                     if (event.key.keysym.scancode == SDL_SCANCODE_F11) {
                         toggle_fullscreen(globals.window);
                     }
                 }
-
-                if (globals.program_mode == PROGRAM_MODE_END) {
-                    if (is_down && !event.key.repeat && event.key.keysym.scancode != SDL_SCANCODE_F11) {
-                        if (!globals.menu_fade.active) {
-                            start_menu_fade(globals.current_world);
-                        }
-                    }
-                }
             } break;
 
             case SDL_WINDOWEVENT: {
@@ -375,9 +519,15 @@ static void respond_to_input() {
     }
 }
 
-static void generate_random_level(World *world, int level_width, int level_height) {
+void generate_random_level(World *world, int level_width, int level_height, u64 seed) {
     if (!world) return;
 
+    profile_zone("generate_random_level");
+    allocation_tag(ALLOCATION_TAG_WORLD);
+
+    Random_State random;
+    seed_random(&random, seed);
+
     if (!world->tilemap) {
         world->tilemap = new Tilemap();
     }
@@ -409,7 +559,15 @@ static void generate_random_level(World *world, int level_width, int level_heigh
         int x_end;
         int y;
     };
+
+    // Levels also get generated outside the main loop (at startup, in the
+    // headless runner and benchmarks), so give the scratch back when done
+    // rather than waiting for the next frame.
+    size_t frame_arena_mark = frame_arena.offset;
+    defer { frame_arena.offset = frame_arena_mark; };
+
     Array <Platform> platforms;
+    platforms.use_arena(&frame_arena);
 
     int last_x = 1;
     int last_y = 2;
@@ -420,8 +578,8 @@ static void generate_random_level(World *world, int level_width, int level_heigh
     bool first_platform = true;
     
     while (last_x + min_gap + min_platform_length < level_width - 6) {
-        int gap = min_gap + rand() % (max_gap - min_gap + 1);
-        int plat_length = min_platform_length + rand() % (max_platform_length - min_platform_length + 1);
+        int gap = min_gap + random_int(&random, max_gap - min_gap + 1);
+        int plat_length = min_platform_length + random_int(&random, max_platform_length - min_platform_length + 1);
 
         int y = 2;
         if (first_platform) {
@@ -431,7 +589,7 @@ static void generate_random_level(World *world, int level_width, int level_heigh
             max_y = Min(max_y, level_height - 4);
             int min_y = Max(2, last_y - (int)max_jump_height);
             min_y = Min(min_y, max_y);
-            y = min_y + rand() % (max_y - min_y + 1);
+            y = min_y + random_int(&random, max_y - min_y + 1);
         }
 
         int x_start = last_x + gap;
@@ -454,7 +612,7 @@ static void generate_random_level(World *world, int level_width, int level_heigh
     }
 
     int door_platform_length = 3;
-    int door_y = platforms[platforms.count - 1].y + 2 + rand() % (int)max_jump_height;
+    int door_y = platforms[platforms.count - 1].y + 2 + random_int(&random, (int)max_jump_height);
     door_y = Min(level_height - 2, door_y);
     int door_x_end = level_width - 1;
     int door_x_start = Max(0, door_x_end - door_platform_length + 1);
@@ -470,6 +628,8 @@ static void generate_random_level(World *world, int level_width, int level_heigh
     }
 
     platforms.add({door_x_start, door_x_end, door_y});
+
+    update_tilemap_collision(tilemap);
     
     Hero *hero = make_hero(world);
     hero->position = v2(1, ground_y + 1.0f);
@@ -477,20 +637,19 @@ static void generate_random_level(World *world, int level_width, int level_heigh
 
     for (int i = 0; i < platforms.count - 1; i++) {
         Platform plat = platforms[i];
-        int num_coins = 1 + rand() % 2;
+        int num_coins = 1 + random_int(&random, 2);
 
         for (int i = 0; i < num_coins; i++) {
-            float coin_x = plat.x_start + 0.5f + rand() % (plat.x_end - plat.x_start + 1);
+            float coin_x = plat.x_start + 0.5f + random_int(&random, plat.x_end - plat.x_start + 1);
             float coin_y = plat.y + 2.5f;
 
-            bool boost_coin = (rand() % 3 == 0);
+            bool boost_coin = (random_int(&random, 3) == 0);
             if (boost_coin) {
-                coin_y = plat.y + max_jump_height + 3.0f + rand() % 2;
+                coin_y = plat.y + max_jump_height + 3.0f + random_int(&random, 2);
 
-                Enemy *enemy    = make_enemy(world);
-                enemy->position = v2(coin_x, plat.y + 1.5f);
-                enemy->color    = v4(0, 0, 1, 1);
-                enemy->radius   = 0.5f;
+                Enemy *enemy = make_enemy(world);
+                enemy->color = v4(0, 0, 1, 1);
+                set_position(enemy, v2(coin_x, plat.y + 1.5f));
             }
 
             Pickup *pickup = make_pickup(world);
@@ -509,10 +668,12 @@ static void generate_random_level(World *world, int level_width, int level_heigh
 }
 
 bool create_menu_world() {
+    allocation_tag(ALLOCATION_TAG_WORLD);
+
     globals.menu_world = new World();
     init_world(globals.menu_world, v2i(20, 18));
 
-    generate_random_level(globals.menu_world, 20, 18);
+    generate_random_level(globals.menu_world, 20, 18, random_u64(&globals.level_random));
 
     globals.menu_world->camera           = new Camera();
     globals.menu_world->camera->position = globals.menu_world->by_type._Hero->position + v2(VIEW_AREA_WIDTH * 0.5f, VIEW_AREA_HEIGHT * 0.5f);
@@ -521,6 +682,8 @@ bool create_menu_world() {
 }
 
 bool switch_to_random_world(int total_width) {
+    allocation_tag(ALLOCATION_TAG_WORLD);
+
     if (globals.current_world && globals.current_world != globals.menu_world) {
         destroy_world(globals.current_world);
         delete globals.current_world;
@@ -530,7 +693,9 @@ bool switch_to_random_world(int total_width) {
     globals.current_world = new World();
     init_world(globals.current_world, v2i(total_width, 18));
 
-    generate_random_level(globals.current_world, total_width, 18);
+    u64 seed = random_u64(&globals.level_random);
+    generate_random_level(globals.current_world, total_width, 18, seed);
+    logprintf("Generated level %d (width %d) with seed %llu.\n", globals.current_world_index + 1, total_width, (unsigned long long)seed);
 
     globals.current_world->camera                 = new Camera();
     globals.current_world->camera->position       = v2(total_width * 0.5f, 9);
@@ -566,6 +731,8 @@ bool switch_to_random_world(int total_width) {
 
     globals.current_world->camera->zoom = globals.current_world->camera->intro_start_zoom;
     globals.current_world->camera->position = globals.current_world->camera->intro_start_pos;
+    globals.current_world->camera->previous_zoom     = globals.current_world->camera->zoom;
+    globals.current_world->camera->previous_position = globals.current_world->camera->position;
     
     globals.current_world_index++;
     
@@ -594,7 +761,7 @@ bool restart_current_world() {
     globals.num_restarts_for_current_world++;
     if (globals.num_restarts_for_current_world > MAX_RESTARTS) {
         globals.program_mode = PROGRAM_MODE_END;
-        globals.current_fail_msg_index = rand() % ArrayCount(fail_msgs);
+        globals.current_fail_msg_index = random_u32() % ArrayCount(fail_msgs);
         globals.highscores.add(globals.num_worlds_completed);
         play_sound(globals.level_fail_sfx);
         return true;
@@ -609,14 +776,8 @@ bool restart_current_world() {
 }
 
 static void draw_end_screen() {
-    set_shader(globals.shader_color);
-    rendering_2d(globals.render_width, globals.render_height, matrix4_identity());
-    
-    immediate_begin();
-    immediate_quad(v2(0, 0), v2((float)globals.render_width, (float)globals.render_height), v4(0, 0, 0, 0.5f));
-    immediate_flush();
+    queue_quad(RENDER_LAYER_BACKDROP, v2(0, 0), v2((float)globals.render_width, (float)globals.render_height), v4(0, 0, 0, 0.5f));
 
-    immediate_begin();
     int num_drops = 50;
     for (int i = 0; i < num_drops; i++) {
         float speed = 200.0f + (i * 10.0f);
@@ -628,16 +789,8 @@ static void draw_end_screen() {
         float height = 10.0f + (i % 5);
         Vector4 color = v4(0.8f, 0.9f, 1.0f, 0.2f + 0.1f * sinf(i + t));
     
-        immediate_quad(v2(x, y), v2(width, height), color);
+        queue_quad(RENDER_LAYER_HUD, v2(x, y), v2(width, height), color);
     }
-    immediate_flush();
-    
-    set_shader(globals.shader_text);
-    rendering_2d(globals.render_width, globals.render_height);
-
-    set_blend_mode(BLEND_MODE_ALPHA);
-    set_cull_mode(CULL_MODE_OFF);
-    set_depth_test_mode(DEPTH_TEST_OFF);
     
     int font_size = (int)(0.045f * globals.render_height);
     Dynamic_Font *font = get_font_at_size("Lora-BoldItalic", font_size);
@@ -656,6 +809,8 @@ static void draw_end_screen() {
     x = (globals.render_width - font->get_string_width_in_pixels(text)) / 2;
     y = (int)(globals.render_height * 0.25f);
     draw_text(font, text, x, y, v4(1, 1, 1, 1));
+
+    flush_render_queue();
 }
 
 #ifdef __EMSCRIPTEN__
@@ -734,6 +889,7 @@ static void toggle_fullscreen(SDL_Window *window) {
 #endif
 
 static SDL_Window *create_window(int width, int height, char *title) {
+#ifdef RENDER_OPENGL
     Uint32 window_flags = SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE;
     
     SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
@@ -751,6 +907,10 @@ static SDL_Window *create_window(int width, int height, char *title) {
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
     SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
 #endif
+#else
+    // The software renderer presents through the window surface.
+    Uint32 window_flags = SDL_WINDOW_RESIZABLE;
+#endif
 
     SDL_Window *window = SDL_CreateWindow(title, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, width, height, window_flags);
     if (!window) {
@@ -758,6 +918,7 @@ static SDL_Window *create_window(int width, int height, char *title) {
         return NULL;
     }
 
+#ifdef RENDER_OPENGL
     globals.gl_context = SDL_GL_CreateContext(window);
     if (!globals.gl_context) {
 #ifdef __EMSCRIPTEN__
@@ -785,6 +946,7 @@ static SDL_Window *create_window(int width, int height, char *title) {
         return NULL;
     }
 #endif
+#endif // RENDER_OPENGL
     
 #ifndef OS_WINDOWS
     SDL_RWops *rw = SDL_RWFromMem(icon_bmp, icon_bmp_len);
@@ -821,7 +983,89 @@ static void init_window_size(int *width, int *height) {
     }
 }
 
+static bool was_any_key_pressed_except(int ignored_key_code) {
+    for (int i = 0; i < ArrayCount(key_states); i++) {
+        if (i == ignored_key_code) continue;
+        if (is_key_pressed(i)) return true;
+    }
+    return false;
+}
+
+static void collect_frame_keys(Array <Recorded_Key> *keys) {
+    keys->count = 0;
+    for (int i = 0; i < ArrayCount(key_states); i++) {
+        Key_State *state = &key_states[i];
+        if (!state->changed && state->is_down == state->was_down) continue;
+
+        Recorded_Key key;
+        key.scancode = (u16)i;
+        key.is_down  = state->is_down;
+        key.changed  = state->changed;
+        keys->add(key);
+    }
+}
+
+static void set_frame_delta_time(s64 delta_time) {
+    globals.time_info.real_world_time   += delta_time - globals.time_info.delta_time;
+    globals.time_info.delta_time         = delta_time;
+    globals.time_info.delta_time_seconds = nanoseconds_to_seconds(delta_time);
+}
+
+static void finish_replay() {
+    stop_replay();
+
+    double average_ms = 0.0;
+    if (replay_stats.num_frames) {
+        average_ms = nanoseconds_to_seconds(replay_stats.total_frame_time / replay_stats.num_frames) * 1000.0;
+    }
+    double max_ms = nanoseconds_to_seconds(replay_stats.max_frame_time) * 1000.0;
+
+    logprintf("Replay finished: %lld frames, %.3f ms average frame, %.3f ms worst frame, world state hash %016llx.\n",
+              (long long)replay_stats.num_frames, average_ms, max_ms,
+              (unsigned long long)get_world_state_hash(globals.current_world));
+
+    globals.should_quit_game = true;
+}
+
+// Runs as many fixed ticks as the frame's wall-clock time pays for and leaves
+// the remainder for the next frame, so gameplay doesn't depend on how fast
+// frames are drawn. The leftover fraction of a tick is how far to draw
+// between the last two ticks.
+static void update_world_at_fixed_rate(World *world, s64 delta_time) {
+    const s64 tick_nanoseconds = 1000000000LL / FIXED_UPDATE_HZ;
+    const float dt = 1.0f / (float)FIXED_UPDATE_HZ;
+
+    Time_Info *time_info = &globals.time_info;
+    time_info->update_accumulator += Max(delta_time, 0);
+    time_info->num_fixed_updates = 0;
+
+    while (time_info->update_accumulator >= tick_nanoseconds) {
+        if (time_info->num_fixed_updates == MAX_FIXED_UPDATES_PER_FRAME) {
+            time_info->num_dropped_updates += time_info->update_accumulator / tick_nanoseconds;
+            time_info->update_accumulator  %= tick_nanoseconds;
+            break;
+        }
+
+        update_world(world, dt);
+        time_info->update_accumulator -= tick_nanoseconds;
+        time_info->num_fixed_updates++;
+
+        // The world is about to be replaced; don't run it any further.
+        if (globals.should_switch_worlds) {
+            time_info->update_accumulator = 0;
+            break;
+        }
+    }
+
+    world->interpolation_alpha = (float)time_info->update_accumulator / (float)tick_nanoseconds;
+}
+
 static void main_loop() {
+    begin_profile_frame();
+    end_allocation_frame();
+    reset_frame_arena();
+    update_asset_loads();
+
     globals.num_frames_since_startup++;
         
     if (globals.should_switch_worlds) {
@@ -847,16 +1091,46 @@ static void main_loop() {
     update_time();
     adjust_fps_cap_based_on_performance();
         
-    for (int i = 0; i < ArrayCount(key_states); i++) {
-        Key_State *state = &key_states[i];
-        state->was_down  = state->is_down;
-        state->changed   = false;
+    advance_key_states();
+    respond_to_input();
+
+#ifdef PROFILER
+    if (is_key_pressed(SDL_SCANCODE_F9)) {
+        write_chrome_trace("profile.json");
     }
+#endif
 
-    respond_to_input();
+    if (is_replaying()) {
+        s64 real_delta_time = globals.time_info.delta_time;
+        s64 recorded_delta_time;
+        if (!read_replay_frame(&recorded_delta_time, &frame_keys)) {
+            finish_replay();
+            return;
+        }
+
+        for (Recorded_Key key : frame_keys) {
+            Key_State *state = &key_states[key.scancode];
+            state->is_down   = key.is_down;
+            state->changed   = key.changed;
+        }
+        set_frame_delta_time(recorded_delta_time);
+
+        replay_stats.num_frames++;
+        replay_stats.total_frame_time += real_delta_time;
+        replay_stats.max_frame_time    = Max(replay_stats.max_frame_time, real_delta_time);
+    } else if (is_recording()) {
+        collect_frame_keys(&frame_keys);
+        record_frame(globals.time_info.delta_time, &frame_keys);
+    }
+
+    if (globals.program_mode == PROGRAM_MODE_END && !globals.menu_fade.active) {
+        if (was_any_key_pressed_except(SDL_SCANCODE_F11)) {
+            start_menu_fade(globals.current_world);
+        }
+    }
 
     if (globals.program_mode == PROGRAM_MODE_GAME) {
-        update_world(globals.current_world, (float)globals.time_info.delta_time_seconds);
+        update_world_at_fixed_rate(globals.current_world, globals.time_info.delta_time);
 
         if (is_key_pressed(SDL_SCANCODE_ESCAPE)) {
             toggle_menu();
@@ -866,8 +1140,12 @@ static void main_loop() {
     }
 
     update_menu_fade((float)globals.time_info.delta_time_seconds);
+
+    render_stats = {};
         
     if (globals.window_width > 0 && globals.window_height > 0) {
+        profile_zone("draw_frame");
+
 #ifndef __EMSCRIPTEN__
         set_framebuffer(globals.offscreen_buffer);
 #endif
@@ -896,18 +1174,27 @@ static void main_loop() {
         blit_framebuffer_to_back_buffer_with_letter_boxing(globals.offscreen_buffer);
 #endif
     }
-        
-    swap_buffers();
 
-    s64 fps_cap_nanoseconds = 1000000000 / globals.time_info.fps_cap;
+    {
+        profile_zone("swap_buffers");
+        swap_buffers();
+    }
 
-    while (get_time_nanoseconds() <= globals.time_info.sync_last_time + fps_cap_nanoseconds) {
-        // @TODO: Maybe sleep.
+    if (globals.num_frames_since_startup == 1) {
+        logprintf("First frame shown %.1f ms after startup, %d assets still loading.\n",
+                  (get_time_nanoseconds() - startup_time) / 1.0e6, get_num_asset_loads_in_flight());
     }
-    globals.time_info.sync_last_time += fps_cap_nanoseconds;
+
+    // Replays run flat out, so their frame times measure the actual work.
+    if (is_replaying()) return;
+
+    profile_zone("wait_for_next_frame");
+    wait_for_next_frame(&frame_pacer);
 }
 
 int main(int argc, char *argv[]) {    
+    startup_time = get_time_nanoseconds();
+
 #ifdef _WIN32
     void enable_dpi_awareness();
     enable_dpi_awareness();
@@ -916,6 +1203,9 @@ int main(int argc, char *argv[]) {
     init_log();
     defer { close_log(); };
 
+    set_profile_thread_name("Main");
+    init_frame_arena();
+
     bool start_fullscreen = false;
 #ifdef BUILD_RELEASE
     start_fullscreen = true;
@@ -923,6 +1213,11 @@ int main(int argc, char *argv[]) {
 
     globals.window_width  = -1;
     globals.window_height = -1;
+
+    u64 seed = (u64)get_time_nanoseconds();
+    char *record_filepath = NULL;
+    char *replay_filepath = NULL;
+    int num_worker_threads = -1;
     
     for (int i = 1; i < argc; i++) {
         char *arg = argv[i];
@@ -944,6 +1239,37 @@ int main(int argc, char *argv[]) {
             start_fullscreen = true;
         } else if (strings_match(arg, "-windowed")) {
             start_fullscreen = false;
+        } else if (strings_match(arg, "-seed")) {
+            if (i == argc - 1) {
+                logprintf("Tried to set the seed but with no seed provided!\n");
+                break;
+            } else {
+                seed = strtoull(argv[++i], NULL, 10);
+            }
+        } else if (strings_match(arg, "-record")) {
+            if (i == argc - 1) {
+                logprintf("Tried to record but with no file provided!\n");
+                break;
+            } else {
+                record_filepath = argv[++i];
+            }
+        } else if (strings_match(arg, "-replay")) {
+            if (i == argc - 1) {
+                logprintf("Tried to replay but with no file provided!\n");
+                break;
+            } else {
+                replay_filepath = argv[++i];
+            }
+        } else if (strings_match(arg, "-threads")) {
+            if (i == argc - 1) {
+                logprintf("Tried to set the number of worker threads but with no number provided!\n");
+                break;
+            } else {
+                num_worker_threads = atoi(argv[++i]);
+            }
+        } else if (strings_match(arg, "-headless")) {
+            // No window, GL context or audio device; see headless.cpp.
+            return run_headless(argc, argv);
         }
     }
 
@@ -953,8 +1279,20 @@ int main(int argc, char *argv[]) {
         return 1;
     }
     defer { SDL_Quit(); };
+
+    init_job_system(num_worker_threads);
+    defer { shutdown_job_system(); };
     
-    srand((u32)get_time_nanoseconds());
+    if (replay_filepath) {
+        if (!start_replay(replay_filepath, &seed)) return 1;
+    } else if (record_filepath) {
+        start_recording(record_filepath, seed);
+    }
+    defer { stop_recording(); };
+
+    globals.session_seed = seed;
+    seed_random(seed);
+    seed_random(&globals.level_random, get_hash(seed));
 
     init_window_size(&globals.window_width, &globals.window_height);
     globals.window = create_window(globals.window_width, globals.window_height, "Vertune!");
@@ -997,6 +1335,7 @@ int main(int argc, char *argv[]) {
 #endif
 
     load_assets();
+    defer { shutdown_asset_loader(); };
     
     if (!create_menu_world()) return 1;
     globals.current_world = globals.menu_world;
@@ -1006,7 +1345,7 @@ int main(int argc, char *argv[]) {
     //switch_to_random_world(current_level_width);
 
     globals.time_info.last_time = get_time_nanoseconds();
-    globals.time_info.sync_last_time = get_time_nanoseconds();
+    init_frame_pacer(&frame_pacer, globals.time_info.fps_cap);
 
 #ifdef __EMSCRIPTEN__
     emscripten_set_main_loop(main_loop, 0, 1);
@@ -1016,6 +1355,10 @@ int main(int argc, char *argv[]) {
     }
 #endif
 
+    if (is_recording()) {
+        logprintf("Recording finished, world state hash %016llx.\n", (unsigned long long)get_world_state_hash(globals.current_world));
+    }
+
 #ifndef __EMSCRIPTEN__
     save_audio_settings();
     save_highscores();
@@ -1080,15 +1423,12 @@ void draw_menu_fade_overlay() {
     }
 
     // Draw fade overlay
-    set_shader(globals.shader_color);
-    rendering_2d(globals.render_width, globals.render_height);
-    immediate_begin();
-    immediate_quad(
+    queue_quad(RENDER_LAYER_FADE,
         v2(0, 0),
         v2((float)globals.render_width, (float)globals.render_height),
         v4(0, 0, 0, alpha)
                    );
-    immediate_flush();
+    flush_render_queue();
 }
 
 bool save_audio_settings() {
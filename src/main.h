@@ -4,6 +4,8 @@
 #include "geometry.h"
 #include "array.h"
 #include "hash_table.h"
+#include "pool.h"
+#include "profiler.h"
 #include "packager/packager.h"
 
 #include <SDL.h>
@@ -18,6 +20,12 @@ const int MAX_RESTARTS = 3;
 const int MAX_FPS_CAP = 120;
 const int MAX_SLOW_FRAMES = 120;
 
+// The simulation always steps at this rate, however fast frames are drawn.
+// A frame that falls further behind than MAX_FIXED_UPDATES_PER_FRAME ticks
+// drops the rest instead of spiralling.
+const int FIXED_UPDATE_HZ = 120;
+const int MAX_FIXED_UPDATES_PER_FRAME = 8;
+
 const int AUDIO_FILE_MAGIC_NUMBER = 0x504C4159;
 const int AUDIO_FILE_VERSION = 1;
 
@@ -40,7 +48,6 @@ enum Program_Mode {
 
 struct Time_Info {
     s64 last_time = 0;
-    s64 sync_last_time = 0;
 
     s64 real_world_time = 0;
     s64 delta_time = 0;
@@ -51,6 +58,12 @@ struct Time_Info {
     double accumulated_fps_dt = 0.0;
     double fps_dt = 0.0;
 
+    // Fixed-step simulation: wall-clock time not yet simulated, and how many
+    // ticks the last frame ran.
+    s64 update_accumulator = 0;
+    int num_fixed_updates = 0;
+    s64 num_dropped_updates = 0;
+
     // Fps cap variables.
     int fps_cap = 120;
     int slow_frame_count = 0;
@@ -78,6 +91,7 @@ struct Global_Variables {
     Shader *shader_color = NULL;
     Shader *shader_texture = NULL;
     Shader *shader_text = NULL;
+    Shader *shader_circle = NULL;
 
     Matrix4 object_to_proj_matrix;
     Matrix4 view_to_proj_matrix;
@@ -95,6 +109,11 @@ struct Global_Variables {
     int num_worlds_completed = 0;
     int start_level_width = 30;
 
+    // update_world spreads enemies, projectiles and particles over the job
+    // system in batches of this many, once there are at least two batches.
+    bool parallel_world_update = true;
+    int world_update_batch_size = 256;
+
     int num_frames_since_startup = 0;
 
     bool draw_debug_hud = false;
@@ -127,6 +146,11 @@ struct Global_Variables {
 
     Array <int> highscores;
     int current_level_width = 20;
+
+    // Seeds the global random state and the stream of per-level seeds, so a
+    // session is reproducible from this one number and its input.
+    u64 session_seed = 0;
+    Random_State level_random;
     
 #ifdef USE_PACKAGE
     Package package;
@@ -139,10 +163,20 @@ bool is_key_down(int key_code);
 bool is_key_pressed(int key_code);
 bool was_key_just_released(int key_code);
 
+void set_key_state(int key_code, bool is_down);
+void advance_key_states();
+
 double nanoseconds_to_seconds(u64 nanoseconds);
 u64 seconds_to_nanoseconds(double seconds);
 
+// What main() sets up for drawing, apart from the window: also used by the
+// headless frame benchmarks.
+void init_shaders();
+void load_textures();
+
 void toggle_menu();
+void generate_random_level(World *world, int level_width, int level_height, u64 seed);
+bool create_menu_world();
 bool switch_to_random_world(int total_width);
 bool restart_current_world();
 
@@ -4,6 +4,7 @@
 #include "font.h"
 #include "world.h"
 #include "audio.h"
+#include "render_queue.h"
 
 #include <stdio.h>
 
@@ -163,26 +164,19 @@ static int draw_item(char *text, Dynamic_Font *font, int center_x, int y, Vector
 
         Vector4 bg_color = v4(1.0f, 0.85f, 0.4f, 0.15f);
 
-        set_shader(globals.shader_color);
-        
-        immediate_begin();
-        immediate_quad(
+        queue_quad(RENDER_LAYER_HUD,
             v2(x_pad - pad_x, y - pad_y),
             v2(text_width + pad_x * 2, rect_height),
             bg_color);
-        immediate_flush();
 
         double now = nanoseconds_to_seconds(globals.time_info.real_world_time);
         double t = 0.5 + 0.5 * sin(now * 2.0);
         t = 0.3 + 0.7 * t;
         Vector4 animated_color = lerp(MENU_COLOR_HIGHLIGHT, v4(1, 0.9f, 0.5f, 1), (float)t);
 
-        set_shader(globals.shader_text);
-        
         draw_text(font, text, x_pad, (int)(y - font->character_height * 0.05f), MENU_COLOR_SHADOW);
         draw_text(font, text, x_pad, y, animated_color);
     } else {
-        set_shader(globals.shader_text);
         draw_text(font, text, x_pad, y, item_color);
     }
 
@@ -194,13 +188,6 @@ static void draw_menu_choices() {
     int BIG_FONT_SIZE = (int)(globals.render_height * 0.0725f);
     auto body_font    = get_font_at_size("Lora-Bold", (int)(BIG_FONT_SIZE * 0.9f));
     
-    set_shader(globals.shader_text);
-    rendering_2d(globals.render_width, globals.render_height);
-
-    set_blend_mode(BLEND_MODE_ALPHA);
-    set_cull_mode(CULL_MODE_OFF);
-    set_depth_test_mode(DEPTH_TEST_OFF);
-
     int center_x = globals.render_width / 2;
     int cursor_y = (int)(globals.render_height * 0.7f);
 
@@ -266,13 +253,6 @@ static void draw_menu_choices() {
 }
 
 static void draw_title() {
-    set_shader(globals.shader_text);
-    rendering_2d(globals.render_width, globals.render_height);
-
-    set_blend_mode(BLEND_MODE_ALPHA);
-    set_cull_mode(CULL_MODE_OFF);
-    set_depth_test_mode(DEPTH_TEST_OFF);
-
     int BIG_FONT_SIZE = (int)(globals.render_height * 0.0725f);
     auto title_font = get_font_at_size("Lora-BoldItalic", (int)(BIG_FONT_SIZE * 1.6f));
 
@@ -301,13 +281,6 @@ static void draw_controls() {
     auto title_font   = get_font_at_size("Lora-BoldItalic", (int)(BIG_FONT_SIZE * 1.6f));
     auto body_font    = get_font_at_size("Lora-Bold", (int)(BIG_FONT_SIZE * 0.9f));
 
-    set_shader(globals.shader_text);
-    rendering_2d(globals.render_width, globals.render_height);
-
-    set_blend_mode(BLEND_MODE_ALPHA);
-    set_cull_mode(CULL_MODE_OFF);
-    set_depth_test_mode(DEPTH_TEST_OFF);
-
     Dynamic_Font *font = body_font;
     char *text = "Controls";
     int x = (globals.render_width - font->get_string_width_in_pixels(text)) / 2;
@@ -339,16 +312,13 @@ static void draw_controls() {
 }
 
 static void draw_slider(int x, int y, float value, float max_value, float width, float height, Vector4 knob_color) {
-    set_shader(globals.shader_color);
-
 #ifdef __EMSCRIPTEN__
     Vector4 grey_color = v4(0.55f, 0.55f, 0.55f, 1.0f);
 #else
     Vector4 grey_color = v4(0.4f, 0.4f, 0.4f, 1.0f);
 #endif
     
-    immediate_begin();
-    immediate_quad(v2((float)x, (float)y), v2(width, height), grey_color);
+    queue_quad(RENDER_LAYER_HUD, v2((float)x, (float)y), v2(width, height), grey_color);
 
     Vector2 knob_size = v2(height, height * 2.0f);
     
@@ -356,9 +326,7 @@ static void draw_slider(int x, int y, float value, float max_value, float width,
     knob_position.x = (float)x + ((value / max_value) * width);
     knob_position.y = y - knob_size.y * 0.5f + height * 0.5f;
     
-    immediate_quad(knob_position, knob_size, knob_color);
-
-    immediate_flush();
+    queue_quad(RENDER_LAYER_HUD, knob_position, knob_size, knob_color);
 }
 
 static void draw_settings() {
@@ -368,13 +336,6 @@ static void draw_settings() {
     auto title_font   = get_font_at_size("Lora-BoldItalic", (int)(BIG_FONT_SIZE * 1.6f));
     auto body_font    = get_font_at_size("Lora-Bold", (int)(BIG_FONT_SIZE * 0.9f));
 
-    set_shader(globals.shader_text);
-    rendering_2d(globals.render_width, globals.render_height);
-
-    set_blend_mode(BLEND_MODE_ALPHA);
-    set_cull_mode(CULL_MODE_OFF);
-    set_depth_test_mode(DEPTH_TEST_OFF);
-
     Dynamic_Font *font = body_font;
     char *text = "Settings";
     int x = (globals.render_width - font->get_string_width_in_pixels(text)) / 2;
@@ -390,7 +351,6 @@ static void draw_settings() {
     {
         Vector4 knob_color = (current_menu_choice == 0) ? v4(1, 0.8f, 0.2f, 1) : v4(1, 1, 1, 1);
         
-        set_shader(globals.shader_text);
         char *text = "Master volume: ";
         x = (int)(0.005f * globals.render_width);
         draw_text(font, text, x, cursor_y, v4(1, 1, 1, 1));
@@ -407,7 +367,6 @@ static void draw_settings() {
     {
         Vector4 knob_color = (current_menu_choice == 1) ? v4(1, 0.8f, 0.2f, 1) : v4(1, 1, 1, 1);
         
-        set_shader(globals.shader_text);
         char *text = "Music volume: ";
         x = (int)(0.005f * globals.render_width);
         draw_text(font, text, x, cursor_y, v4(1, 1, 1, 1));
@@ -424,7 +383,6 @@ static void draw_settings() {
     {
         Vector4 knob_color = (current_menu_choice == 2) ? v4(1, 0.8f, 0.2f, 1) : v4(1, 1, 1, 1);
         
-        set_shader(globals.shader_text);
         char *text = "Sfx volume: ";
         x = (int)(0.005f * globals.render_width);
         draw_text(font, text, x, cursor_y, v4(1, 1, 1, 1));
@@ -456,12 +414,9 @@ static void draw_highscores() {
     auto title_font   = get_font_at_size("Lora-BoldItalic", (int)(BIG_FONT_SIZE * 1.6f));
     auto body_font    = get_font_at_size("Lora-Bold", (int)(BIG_FONT_SIZE * 0.9f));
 
-    set_shader(globals.shader_text);
-    rendering_2d(globals.render_width, globals.render_height, draw_y_offset_for_highscores_due_to_scrolling);
-
-    set_blend_mode(BLEND_MODE_ALPHA);
-    set_cull_mode(CULL_MODE_OFF);
-    set_depth_test_mode(DEPTH_TEST_OFF);
+    Matrix4 scroll = matrix4_identity();
+    scroll._24 = draw_y_offset_for_highscores_due_to_scrolling;
+    set_render_transform(scroll);
 
     Dynamic_Font *font = body_font;
     char text[256];
@@ -485,13 +440,11 @@ static void draw_highscores() {
 
 void draw_main_menu() {  
     draw_world(globals.current_world, true);
-    
-    set_shader(globals.shader_color);
-    rendering_2d(globals.render_width, globals.render_height, matrix4_identity());
-    
-    immediate_begin();
-    immediate_quad(v2(0, 0), v2((float)globals.render_width, (float)globals.render_height), v4(0, 0, 0, 0.1f));
-    immediate_flush();
+
+    // The other pages clear the screen first.
+    if (current_menu_page == MENU_PAGE_MAIN) {
+        queue_quad(RENDER_LAYER_BACKDROP, v2(0, 0), v2((float)globals.render_width, (float)globals.render_height), v4(0, 0, 0, 0.1f));
+    }
     
     switch (current_menu_page) {
         case MENU_PAGE_MAIN: {
@@ -554,6 +507,8 @@ void draw_main_menu() {
         } break;
     }
 
+    flush_render_queue();
+
     if (current_menu_page == MENU_PAGE_HIGHSCORES && globals.highscores.count > 0) {
         float delta = 20.0f;
         
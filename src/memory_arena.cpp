@@ -1,6 +1,9 @@
 #include "main.h"
 #include "memory_arena.h"
 
+#include <stdio.h>
+#include <stdarg.h>
+
 #ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
@@ -32,9 +35,13 @@ void Memory_Arena::init(size_t _size) {
 #else
     base = malloc(_size);
 #endif
+    if (!base) out_of_memory((s64)_size);
+    count_allocation((s64)_size, get_allocation_tag(ALLOCATION_TAG_OTHER)); // Never freed.
     size = _size;
     offset   = 0;
     commited = 0;
+    overflow = NULL;
+    num_overflows = 0;
 }
 
 void Memory_Arena::init_from_other_arena(Memory_Arena *other, size_t _offset, size_t _size) {
@@ -42,21 +49,50 @@ void Memory_Arena::init_from_other_arena(Memory_Arena *other, size_t _offset, si
     size = _size;
     offset   = 0;
     commited = 0;
+    overflow = NULL;
+    num_overflows = 0;
 }
 
+struct Arena_Overflow_Header {
+    Arena_Overflow_Header *next;
+};
+
 void Memory_Arena::reset() {
+    while (overflow) {
+        Arena_Overflow_Header *header = (Arena_Overflow_Header *)overflow;
+        overflow = header->next;
+        tracked_free(header);
+    }
+
     offset   = 0;
     commited = 0;
 }
 
+static void *allocate_overflow(Memory_Arena *arena, size_t size, size_t alignment) {
+    if (!arena->num_overflows) {
+        logprintf("Memory arena of %lld bytes is full; falling back to the heap until it is reset.\n", (long long)arena->size);
+    }
+    arena->num_overflows++;
+
+    size_t block_size = sizeof(Arena_Overflow_Header) + alignment + size;
+    if (block_size < size) out_of_memory(INT64_MAX);
+
+    Arena_Overflow_Header *header = (Arena_Overflow_Header *)tracked_malloc((s64)block_size);
+    if (!header) out_of_memory((s64)block_size);
+
+    header->next = (Arena_Overflow_Header *)arena->overflow;
+    arena->overflow = header;
+
+    return (void *)align_forward((uintptr_t)(header + 1), alignment);
+}
+
 void *Memory_Arena::allocate_aligned(size_t _size, size_t alignment) {
     uintptr_t curr_ptr = (uintptr_t)base + (uintptr_t)offset;
     uintptr_t offs = align_forward(curr_ptr, alignment);
     offs -= (uintptr_t)base;
 
-    if (offs + _size > size) {
-        assert(!"Size is too large");
-        return 0;
+    if (offs > size || _size > size - offs) {
+        return allocate_overflow(this, _size, alignment);
     }
 
     commited += _size;
@@ -73,3 +109,34 @@ void *Memory_Arena::allocate(size_t _size) {
     }
     return allocate_aligned(_size, MEMORY_ARENA_DEFAULT_ALIGNMENT);
 }
+
+Memory_Arena frame_arena;
+
+void init_frame_arena() {
+    if (frame_arena.base) return;
+    frame_arena.init(FRAME_ARENA_SIZE);
+}
+
+void reset_frame_arena() {
+#ifdef BUILD_DEBUG
+    // So that anything kept past the end of the frame shows up as garbage
+    // rather than quietly working until the memory is reused.
+    memset(frame_arena.base, 0xCD, frame_arena.offset);
+#endif
+    frame_arena.reset();
+}
+
+char *tprint(char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(NULL, 0, format, args);
+    va_end(args);
+
+    char *result = (char *)frame_arena.allocate(length + 1);
+    
+    va_start(args, format);
+    vsnprintf(result, length + 1, format, args);
+    va_end(args);
+
+    return result;
+}
@@ -1,13 +1,20 @@
 #pragma once
 
+#include "general.h"
+
 #define MEMORY_ARENA_DEFAULT_ALIGNMENT (2 * sizeof(void *))
 
+// When full, allocations fall back to the heap until the next reset, so a
+// full arena costs time rather than memory safety; num_overflows counts them.
 struct Memory_Arena {
     void *base;
     size_t size;
     size_t offset;
     size_t commited;
 
+    void *overflow; // Heap blocks handed out since the last reset, as a list.
+    s64 num_overflows;
+
     void init(size_t size);
     void init_from_other_arena(Memory_Arena *other, size_t offset, size_t size);
     
@@ -29,3 +36,16 @@ struct Memory_Arena {
     }
 };
 
+// Scratch memory for anything that only has to live until the end of the
+// frame: reset at the top of every main loop iteration (and every headless
+// tick), so nothing allocated from it may be kept past that. Arrays get
+// their storage from it with Array::use_arena. Main thread only.
+const size_t FRAME_ARENA_SIZE = 8 * 1024 * 1024;
+
+extern Memory_Arena frame_arena;
+
+void init_frame_arena();
+void reset_frame_arena();
+
+// snprintf into the frame arena.
+char *tprint(char *format, ...);
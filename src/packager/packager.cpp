@@ -2,14 +2,26 @@
 #include "../geometry.h"
 #include "../array.h"
 #include "../hash_table.h"
+#include "../compression.h"
+#include "../text_file_handler.h"
 #include "packager.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <stb_image.h>
 
-const int PACKAGE_FILE_MAGIC_NUMBER = 0x4153504B;
-const int PACKAGE_FILE_VERSION = 1;
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+#ifndef PACKAGER_STANDALONE
+#include <SDL.h>
+#include "../jobs.h"
+#endif
 
 struct Span {
     s64 size;
@@ -48,148 +60,747 @@ static Span my_read_entire_file(char *filepath) {
 
     u8 *data = new u8[length];
     fread(data, 1, length, file);
-    fclose(file);
 
     return make_span(length, data);
 }
 
-bool create_package() {
-    char *files_to_include[] = {
-        "data/fonts/OpenSans-Regular.ttf",
-        "data/fonts/Lora-BoldItalic.ttf",
-        "data/fonts/Inconsolata-Regular.ttf",
-        "data/fonts/Lora-Bold.ttf",
-        "data/textures/heart_empty_16x16.png",
-        "data/textures/heart_half_16x16.png",
-        "data/textures/heart_full_16x16.png",
-        "data/textures/restart_available.png",
-        "data/textures/restart_taken.png",
-        "data/sounds/coin-pickup.wav",
-        "data/sounds/damage.wav",
-        "data/sounds/death.wav",
-        "data/sounds/enemy-kill.wav",
-        "data/sounds/exit-menu.wav",
-        "data/sounds/jump.wav",
-        "data/sounds/level-completed.wav",
-        "data/sounds/level-failed.wav",
-        "data/sounds/level-music.wav",
-        "data/sounds/menu-change-option.wav",
-        "data/sounds/menu-music.wav",
-        "data/sounds/menu-select.wav",
-    };
+static void write_padding(FILE *file, s64 count) {
+    static u8 zeroes[PACKAGE_DATA_ALIGNMENT] = {};
+    assert(count >= 0 && count < PACKAGE_DATA_ALIGNMENT);
+    fwrite(zeroes, sizeof(u8), count, file);
+}
 
-    Array <Span> loaded_files;
-    for (int i = 0; i < ArrayCount(files_to_include); i++) {
-        Span span = my_read_entire_file(files_to_include[i]);
-        if (span.size <= 0 || span.data == NULL) {
-            return false;
+static void write_package_v1(FILE *file, Package_Asset_Entry *entries, int num_assets) {
+    int version = 1;
+    fwrite(&PACKAGE_FILE_MAGIC_NUMBER, sizeof(int), 1, file);
+    fwrite(&version, sizeof(int), 1, file);
+    fwrite(&num_assets, sizeof(int), 1, file);
+
+    for (int i = 0; i < num_assets; i++) {
+        Package_Asset_Entry *entry = &entries[i];
+
+        fwrite(&entry->type, sizeof(u8), 1, file);
+        fwrite(&entry->name_length, sizeof(s64), 1, file);
+        fwrite(entry->name, sizeof(char), entry->name_length, file);
+
+        fwrite(&entry->size, sizeof(s64), 1, file);
+        fwrite(entry->data, sizeof(u8), entry->size, file);
+
+        if (entry->type == PACKAGE_ASSET_SOUND) {
+            u8 is_looping = entry->is_looping ? 1 : 0;
+            fwrite(&is_looping, sizeof(u8), 1, file);
+        } else if (entry->type == PACKAGE_ASSET_TEXTURE) {
+            fwrite(&entry->width, sizeof(int), 1, file);
+            fwrite(&entry->height, sizeof(int), 1, file);
         }
-        loaded_files.add(span);
     }
+}
 
-    FILE *file = fopen("assets.pak", "wb");
-    if (!file) {
-        logprintf("Failed to open file 'src/generated_assets.h' for writing!\n");
-        return 1;
+u64 get_package_name_hash(char *name, s64 name_length) {
+    u64 hash = 0xcbf29ce484222325ULL;
+    for (s64 i = 0; i < name_length; i++) {
+        hash ^= (u8)name[i];
+        hash *= 0x100000001b3ULL;
     }
-    defer { fclose(file); };
-    
-    fwrite(&PACKAGE_FILE_MAGIC_NUMBER, sizeof(int), 1, file);
-    fwrite(&PACKAGE_FILE_VERSION, sizeof(int), 1, file);
-    
-    int num_assets = ArrayCount(files_to_include);
-    fwrite(&num_assets, sizeof(int), 1, file);
+    return hash;
+}
 
-    int i = 0;
-    for (Span span : loaded_files) {
-        char *extension = strrchr(files_to_include[i], '.');
-        assert(extension);
-        
-        extension++;
-
-        int type = -1; // 0 - font, 1 - texture, 2 - sound
-        if (strings_match(extension, "ttf")) {
-            type = PACKAGE_ASSET_FONT;
-        } else if (strings_match(extension, "png")) {
-            type = PACKAGE_ASSET_TEXTURE;
-        } else if (strings_match(extension, "wav")) {
-            type = PACKAGE_ASSET_SOUND;
+// Same as above, for a zero-terminated name, without a separate pass for
+// its length.
+static u64 get_package_name_hash(char *name) {
+    u64 hash = 0xcbf29ce484222325ULL;
+    for (char *at = name; *at; at++) {
+        hash ^= (u8)*at;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static bool build_package_index(Package_Asset_Entry *entries, int num_assets, Array <Package_Index_Slot> *index) {
+    int num_slots = 2;
+    while (num_slots < num_assets * 2) num_slots *= 2;
+
+    index->reserve(num_slots);
+    index->count = num_slots;
+    memset(index->data, 0, num_slots * sizeof(Package_Index_Slot));
+
+    u32 mask = (u32)num_slots - 1;
+    for (int i = 0; i < num_assets; i++) {
+        u64 hash = get_package_name_hash(entries[i].name, entries[i].name_length);
+
+        u32 slot = (u32)hash & mask;
+        while ((*index)[slot].entry_plus_one) {
+            if ((*index)[slot].name_hash == hash) {
+                int other = (*index)[slot].entry_plus_one - 1;
+                logprintf("Assets '%.*s' and '%.*s' have the same name hash!\n",
+                          (int)entries[i].name_length, entries[i].name, (int)entries[other].name_length, entries[other].name);
+                return false;
+            }
+            slot = (slot + 1) & mask;
         }
 
-        char *slash = strrchr(files_to_include[i], '/');
-        assert(slash);
-        slash++;
+        (*index)[slot].name_hash      = hash;
+        (*index)[slot].entry_plus_one = (u32)i + 1;
+    }
 
-        s64 name_length = (extension - 1) - slash;
-        char *name = new char[name_length];
-        memcpy(name, slash, name_length);
-        
-        fwrite(&type, sizeof(u8), 1, file);
-        fwrite(&name_length, sizeof(s64), 1, file);
-        fwrite(name, sizeof(char), name_length, file);
+    return true;
+}
 
-        int width = 0, height = 0;
-        if (type == PACKAGE_ASSET_TEXTURE) {
-            int channels;
-            stbi_set_flip_vertically_on_load(1);
-            stbi_uc *data = stbi_load(files_to_include[i], &width, &height, &channels, 4);
-            if (!data) {
-                logprintf("Failed to load image '%s' while creating package!\n", files_to_include[i]);
+// What actually goes in the file for an asset.
+struct Stored_Asset {
+    u8 compression;
+    s64 size;
+    u8 *data; // The entry's own, or compressed into a buffer of our own.
+};
+
+static s64 align_package_offset(s64 offset) {
+    return (offset + PACKAGE_DATA_ALIGNMENT - 1) & ~(s64)(PACKAGE_DATA_ALIGNMENT - 1);
+}
+
+static bool compress_asset(Package_Asset_Entry *entry, Stored_Asset *stored) {
+    s64 num_chunks = (entry->size + PACKAGE_CHUNK_SIZE - 1) / PACKAGE_CHUNK_SIZE;
+    s64 tables_size = sizeof(Package_Chunk_Header) + num_chunks * sizeof(Package_Chunk);
+    if (tables_size + entry->size > 0xFFFFFFFFLL) return false; // Chunk offsets are 32 bits.
+
+    // Chunks that don't shrink are stored as they are, so this is the most it takes.
+    u8 *buffer = new u8[tables_size + entry->size];
+
+    Package_Chunk_Header *header = (Package_Chunk_Header *)buffer;
+    header->size       = entry->size;
+    header->chunk_size = PACKAGE_CHUNK_SIZE;
+    header->num_chunks = (int)num_chunks;
+
+    Package_Chunk *chunks = (Package_Chunk *)(buffer + sizeof(Package_Chunk_Header));
+
+    s64 offset = tables_size;
+    for (s64 c = 0; c < num_chunks; c++) {
+        s64 begin = c * PACKAGE_CHUNK_SIZE;
+        s64 size  = Min((s64)PACKAGE_CHUNK_SIZE, entry->size - begin);
+
+        s64 stored_size = lz_compress(entry->data + begin, size, buffer + offset, size - 1);
+        if (!stored_size) {
+            memcpy(buffer + offset, entry->data + begin, size);
+            stored_size = size;
+        }
+
+        chunks[c].offset      = (u32)offset;
+        chunks[c].stored_size = (u32)stored_size;
+        offset += stored_size;
+    }
+
+    if (offset > entry->size - entry->size / 16) {
+        delete [] buffer;
+        return false;
+    }
+
+    stored->compression = PACKAGE_COMPRESSION_LZ;
+    stored->size        = offset;
+    stored->data        = buffer;
+    return true;
+}
+
+static void write_package_v2(FILE *file, Package_Asset_Entry *entries, int num_assets, Array <Package_Index_Slot> *index, Stored_Asset *stored) {
+    Package_File_Header header = {};
+    header.magic_number    = PACKAGE_FILE_MAGIC_NUMBER;
+    header.version         = 2;
+    header.num_assets      = num_assets;
+    header.num_index_slots = index->count;
+    fwrite(&header, sizeof(header), 1, file);
+
+    s64 names_offset = sizeof(Package_File_Header) + num_assets * sizeof(Package_Toc_Entry) + index->count * sizeof(Package_Index_Slot);
+
+    s64 data_offset = names_offset;
+    for (int i = 0; i < num_assets; i++) data_offset += entries[i].name_length + 1;
+
+    Array <Package_Toc_Entry> toc;
+    toc.reserve(num_assets);
+
+    s64 name_offset = names_offset;
+    for (int i = 0; i < num_assets; i++) {
+        Package_Asset_Entry *entry = &entries[i];
+        data_offset = align_package_offset(data_offset);
+
+        Package_Toc_Entry *toc_entry = toc.add();
+        *toc_entry = {};
+        toc_entry->data_offset = data_offset;
+        toc_entry->size        = stored[i].size;
+        toc_entry->name_offset = name_offset;
+        toc_entry->name_length = entry->name_length;
+        toc_entry->width       = entry->width;
+        toc_entry->height      = entry->height;
+        toc_entry->type        = entry->type;
+        toc_entry->is_looping  = entry->is_looping ? 1 : 0;
+        toc_entry->compression = stored[i].compression;
+
+        name_offset += entry->name_length + 1;
+        data_offset += stored[i].size;
+    }
+
+    fwrite(toc.data, sizeof(Package_Toc_Entry), num_assets, file);
+    fwrite(index->data, sizeof(Package_Index_Slot), index->count, file);
+
+    for (int i = 0; i < num_assets; i++) {
+        fwrite(entries[i].name, sizeof(char), entries[i].name_length, file);
+        fputc(0, file);
+    }
+
+    s64 offset = name_offset;
+    for (int i = 0; i < num_assets; i++) {
+        write_padding(file, toc[i].data_offset - offset);
+        fwrite(stored[i].data, sizeof(u8), stored[i].size, file);
+        offset = toc[i].data_offset + stored[i].size;
+    }
+}
+
+static char *join_path(char *directory, char *name) {
+    if (strings_match(directory, ".")) return copy_string(name);
+
+    s64 directory_length = string_length(directory);
+    s64 name_length      = string_length(name);
+
+    char *result = new char[directory_length + 1 + name_length + 1];
+    memcpy(result, directory, directory_length);
+    result[directory_length] = '/';
+    memcpy(result + directory_length + 1, name, name_length + 1);
+    return result;
+}
+
+static bool is_directory(char *path) {
+#ifdef _WIN32
+    DWORD attributes = GetFileAttributesA(path);
+    return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+    struct stat info;
+    return stat(path, &info) == 0 && S_ISDIR(info.st_mode);
+#endif
+}
+
+// The names of the files directly in directory, in no particular order.
+static bool list_directory(char *directory, Array <char *> *names) {
+#ifdef _WIN32
+    char *pattern = join_path(directory, "*");
+    defer { delete [] pattern; };
+
+    WIN32_FIND_DATAA data;
+    HANDLE find = FindFirstFileA(pattern, &data);
+    if (find == INVALID_HANDLE_VALUE) return false;
+    defer { FindClose(find); };
+
+    do {
+        if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) continue;
+        names->add(copy_string(data.cFileName));
+    } while (FindNextFileA(find, &data));
+#else
+    DIR *dir = opendir(directory);
+    if (!dir) return false;
+    defer { closedir(dir); };
+
+    while (struct dirent *it = readdir(dir)) {
+        char *path = join_path(directory, it->d_name);
+        bool is_file = !is_directory(path);
+        delete [] path;
+
+        if (is_file) names->add(copy_string(it->d_name));
+    }
+#endif
+
+    return true;
+}
+
+// * matches any run of characters, ? any one.
+static bool wildcard_match(char *pattern, char *s) {
+    if (!*pattern) return !*s;
+    if (*pattern == '*') return wildcard_match(pattern + 1, s) || (*s && wildcard_match(pattern, s + 1));
+    if (!*s) return false;
+    if (*pattern != '?' && *pattern != *s) return false;
+    return wildcard_match(pattern + 1, s + 1);
+}
+
+static int get_asset_type(char *path) {
+    char *extension = strrchr(path, '.');
+    if (!extension) return -1;
+    extension++;
+
+    if (strings_match(extension, "ttf")) return PACKAGE_ASSET_FONT;
+    if (strings_match(extension, "png")) return PACKAGE_ASSET_TEXTURE;
+    if (strings_match(extension, "wav")) return PACKAGE_ASSET_SOUND;
+    return -1;
+}
+
+static int compare_paths(const void *a, const void *b) {
+    return strcmp(*(char **)a, *(char **)b);
+}
+
+// Takes path; a file listed twice goes in once.
+static void add_manifest_path(Array <char *> *paths, char *path) {
+    for (char *it : *paths) {
+        if (!strings_match(it, path)) continue;
+
+        delete [] path;
+        return;
+    }
+    paths->add(path);
+}
+
+// Every file the manifest names, in the order it names them; what a
+// directory or pattern matches goes in sorted, so the package comes out the
+// same whatever order the file system lists things in.
+static bool read_package_manifest(char *filepath, Array <char *> *paths) {
+    Text_File_Handler handler;
+    if (!start_file(&handler, filepath)) return false;
+    defer { end_file(&handler); };
+
+    if (handler.version < 1 || handler.version > PACKAGE_MANIFEST_VERSION) {
+        report_error(&handler, "Invalid version number for a package manifest!");
+        return false;
+    }
+
+    for (;;) {
+        char *line = consume_next_line(&handler);
+        if (!line) break;
+
+        for (char *at = line; *at; at++) {
+            if (*at == '\\') *at = '/';
+        }
+
+        char *slash = strrchr(line, '/');
+        char *name  = slash ? slash + 1 : line;
+
+        if (strpbrk(line, "*?") && strpbrk(line, "*?") < name) {
+            report_error(&handler, "Only the last part of '%s' can have wildcards!", line);
+            return false;
+        }
+
+        bool has_wildcards = strpbrk(name, "*?") != NULL;
+        if (!has_wildcards && !is_directory(line)) {
+            if (get_asset_type(line) < 0) {
+                report_error(&handler, "'%s' is not a font, texture or sound!", line);
+                return false;
+            }
+            if (!file_exists(line)) {
+                report_error(&handler, "'%s' does not exist!", line);
                 return false;
             }
-            defer { stbi_image_free(data); };
 
-            s64 total_size = (s64)width * (s64)height * sizeof(u8) * 4;
-            fwrite(&total_size, sizeof(s64), 1, file);
-            fwrite(data, sizeof(u8), total_size, file);
+            add_manifest_path(paths, copy_string(line));
+            continue;
+        }
+
+        // A directory takes everything in it, a pattern what matches in its.
+        char *pattern = "*";
+        char *directory = line;
+        if (has_wildcards) {
+            pattern = name;
+            if (slash) *slash = 0;
+            else       directory = ".";
         } else {
-            fwrite(&span.size, sizeof(s64), 1, file);
-            fwrite(span.data, sizeof(u8), span.size, file);
+            s64 length = string_length(line);
+            while (length > 1 && line[length - 1] == '/') line[--length] = 0;
         }
-        
-        if (type == PACKAGE_ASSET_SOUND) {
-            u8 is_looping = strstr(files_to_include[i], "music") ? 1 : 0;
-            fwrite(&is_looping, sizeof(u8), 1, file);
-        } else if (type == PACKAGE_ASSET_TEXTURE) {
-            fwrite(&width, sizeof(int), 1, file);
-            fwrite(&height, sizeof(int), 1, file);
+
+        Array <char *> names;
+        defer { for (char *it : names) delete [] it; };
+
+        if (!list_directory(directory, &names)) {
+            report_error(&handler, "Failed to list directory '%s'!", directory);
+            return false;
+        }
+
+        qsort(names.data, names.count, sizeof(char *), compare_paths);
+
+        int num_matched = 0;
+        for (char *it : names) {
+            if (!wildcard_match(pattern, it) || get_asset_type(it) < 0) continue;
+
+            add_manifest_path(paths, join_path(directory, it));
+            num_matched++;
+        }
+
+        if (!num_matched) {
+            report_error(&handler, "No fonts, textures or sounds match '%s' in '%s'!", pattern, directory);
+            return false;
         }
-        
-        i++;        
     }
 
     return true;
 }
 
-bool read_package(Package *package) {
-    FILE *file = fopen("assets.pak", "rb");
+static char *get_temporary_filepath(char *filepath) {
+    s64 length = string_length(filepath);
+
+    char *result = new char[length + 5];
+    memcpy(result, filepath, length);
+    memcpy(result + length, ".tmp", 5);
+    return result;
+}
+
+// Moves a temporary file over filepath once all of it is written, so a
+// failed or interrupted write never leaves half a file there; otherwise
+// it is removed.
+static bool finish_temporary_file(FILE *file, char *temporary, char *filepath) {
+    bool written = !ferror(file);
+    if (fclose(file) != 0) written = false;
+
+    if (written && replace_file(temporary, filepath)) return true;
+
+    logprintf("Failed to write '%s'!\n", filepath);
+    remove(temporary);
+    return false;
+}
+
+static bool write_package_file(char *filepath, Package_Asset_Entry *entries, Stored_Asset *stored, int num_assets, int version) {
+    Array <Package_Index_Slot> index;
+    if (version == 2 && !build_package_index(entries, num_assets, &index)) return false;
+
+    char *temporary = get_temporary_filepath(filepath);
+    defer { delete [] temporary; };
+
+    FILE *file = fopen(temporary, "wb");
     if (!file) {
-        logprintf("Failed to open file '%s' for reading", "assets.pak");
+        logprintf("Failed to open file '%s' for writing!\n", temporary);
         return false;
     }
-    defer { fclose(file); };
-    
-    int magic_number;
-    fread(&magic_number, sizeof(int), 1, file);
-    if (magic_number != PACKAGE_FILE_MAGIC_NUMBER) {
-        logprintf("Invalid magic number for 'assets.pak'\n");
+
+    if (version == 1) write_package_v1(file, entries, num_assets);
+    else              write_package_v2(file, entries, num_assets, &index, stored);
+
+    return finish_temporary_file(file, temporary, filepath);
+}
+
+struct Cached_Asset {
+    Package_Cache_Entry *entry; // Into the mapping, as are the rest.
+    char *path;
+    u8 *pixels;
+    u8 *compressed;
+};
+
+struct Package_Cache {
+    File_Mapping mapping;
+    Array <Cached_Asset> assets;
+    Hash_Table <u64, int> assets_by_path; // Hash of the path to an index into assets.
+};
+
+static void free_package_cache(Package_Cache *cache) {
+    cache->assets.deallocate();
+    cache->assets_by_path.deallocate();
+    unmap_file(&cache->mapping);
+}
+
+static bool parse_package_cache(Package_Cache *cache) {
+    u8 *data = cache->mapping.data;
+    s64 size = cache->mapping.size;
+    if (size < (s64)sizeof(Package_Cache_Header)) return false;
+
+    Package_Cache_Header *header = (Package_Cache_Header *)data;
+    if (header->magic_number != PACKAGE_CACHE_MAGIC_NUMBER || header->version != PACKAGE_CACHE_VERSION) return false;
+    if (header->num_entries < 0) return false;
+
+    s64 offset = sizeof(Package_Cache_Header);
+    for (int i = 0; i < header->num_entries; i++) {
+        offset = align_package_offset(offset);
+        if (offset + (s64)sizeof(Package_Cache_Entry) > size) return false;
+
+        Cached_Asset cached;
+        cached.entry = (Package_Cache_Entry *)(data + offset);
+        offset += sizeof(Package_Cache_Entry);
+
+        Package_Cache_Entry *entry = cached.entry;
+        if (entry->path_length <= 0 || entry->size < 0 || entry->stored_size < 0) return false;
+
+        if (entry->path_length >= size - offset) return false;
+        cached.path = (char *)(data + offset);
+        if (cached.path[entry->path_length] != 0) return false;
+        offset += entry->path_length + 1;
+
+        if (entry->size > size - offset) return false;
+        cached.pixels = entry->size ? data + offset : NULL;
+        offset += entry->size;
+
+        if (entry->stored_size > size - offset) return false;
+        cached.compressed = entry->stored_size ? data + offset : NULL;
+        offset += entry->stored_size;
+
+        cache->assets.add(cached);
+        cache->assets_by_path.add(get_package_name_hash(cached.path, entry->path_length), cache->assets.count - 1);
+    }
+
+    return true;
+}
+
+// A missing cache is an empty one, as is one that can't be used.
+static void load_package_cache(Package_Cache *cache, char *filepath) {
+    if (!map_file(filepath, &cache->mapping)) return;
+    if (parse_package_cache(cache)) return;
+
+    logprintf("Ignoring the package cache '%s', which is invalid.\n", filepath);
+    free_package_cache(cache);
+}
+
+static Cached_Asset *find_cached_asset(Package_Cache *cache, char *path, Span source, u64 source_hash, int type) {
+    int *index = cache->assets_by_path.find(get_package_name_hash(path));
+    if (!index) return NULL;
+
+    Cached_Asset *cached = &cache->assets[*index];
+    Package_Cache_Entry *entry = cached->entry;
+
+    if (!strings_match(cached->path, path)) return NULL;
+    if (entry->source_hash != source_hash || entry->source_size != source.size || entry->type != type) return NULL;
+
+    if (type == PACKAGE_ASSET_TEXTURE) {
+        if (entry->width <= 0 || entry->height <= 0) return NULL;
+        if (entry->size != (s64)entry->width * (s64)entry->height * 4) return NULL;
+    } else if (entry->size) {
+        return NULL;
+    }
+
+    return cached;
+}
+
+// One asset as create_package builds it.
+struct Built_Asset {
+    char *path;
+    Span source; // Fonts and sounds go in as this.
+    u64 source_hash;
+
+    Package_Asset_Entry entry;
+    bool decoded_here; // The entry's pixels are stb_image's, not the cache's.
+
+    // Kept whether or not this package is compressed, so the cache doesn't
+    // lose it between compressed and uncompressed builds.
+    bool compression_tried;
+    Stored_Asset compressed; // Meaningless unless its compression is LZ.
+    bool compressed_here;
+};
+
+static void free_built_asset(Built_Asset *it) {
+    delete [] it->path;
+    delete [] it->source.data;
+    delete [] it->entry.name;
+    if (it->decoded_here) stbi_image_free(it->entry.data);
+    if (it->compressed_here && it->compressed.compression != PACKAGE_COMPRESSION_NONE) delete [] it->compressed.data;
+}
+
+static bool build_asset(Built_Asset *it, Package_Cache *cache, Package_Options *options, Package_Build_Stats *stats) {
+    it->source = my_read_entire_file(it->path);
+    if (!it->source.data) return false;
+    it->source_hash = get_package_name_hash((char *)it->source.data, it->source.size);
+
+    int type = get_asset_type(it->path);
+
+    char *name = strrchr(it->path, '/');
+    name = name ? name + 1 : it->path;
+
+    Package_Asset_Entry *entry = &it->entry;
+    entry->type        = (u8)type;
+    entry->name_length = strrchr(name, '.') - name;
+    entry->name        = new char[entry->name_length];
+    memcpy(entry->name, name, entry->name_length);
+    entry->is_looping  = type == PACKAGE_ASSET_SOUND && strstr(it->path, "music");
+    entry->compression = options->compress ? PACKAGE_COMPRESSION_LZ : PACKAGE_COMPRESSION_NONE;
+
+    Cached_Asset *cached = options->force ? NULL : find_cached_asset(cache, it->path, it->source, it->source_hash, type);
+
+    // Textures go in already decoded, as flipped RGBA8.
+    if (type == PACKAGE_ASSET_TEXTURE && cached) {
+        entry->data   = cached->pixels;
+        entry->size   = cached->entry->size;
+        entry->width  = cached->entry->width;
+        entry->height = cached->entry->height;
+    } else if (type == PACKAGE_ASSET_TEXTURE) {
+        int channels;
+        stbi_set_flip_vertically_on_load(1);
+        entry->data = stbi_load_from_memory(it->source.data, (int)it->source.size, &entry->width, &entry->height, &channels, 4);
+        if (!entry->data) {
+            logprintf("Failed to load image '%s' while creating package!\n", it->path);
+            return false;
+        }
+        entry->size = (s64)entry->width * (s64)entry->height * sizeof(u8) * 4;
+
+        it->decoded_here = true;
+        stats->num_decoded++;
+    } else {
+        entry->data = it->source.data;
+        entry->size = it->source.size;
+    }
+
+    bool reused = cached != NULL;
+
+    it->compressed.compression = PACKAGE_COMPRESSION_NONE;
+    if (cached && cached->entry->compression_tried) {
+        it->compression_tried = true;
+        if (cached->compressed) {
+            it->compressed.compression = PACKAGE_COMPRESSION_LZ;
+            it->compressed.size        = cached->entry->stored_size;
+            it->compressed.data        = cached->compressed;
+        }
+    } else if (options->compress && options->version == 2) {
+        it->compression_tried = true;
+        it->compressed_here   = compress_asset(entry, &it->compressed);
+        stats->num_compressed++;
+        reused = false;
+    }
+
+    if (reused) stats->num_reused++;
+    return true;
+}
+
+static bool write_package_cache(char *filepath, Built_Asset *assets, int num_assets) {
+    FILE *file = fopen(filepath, "wb");
+    if (!file) {
+        logprintf("Failed to open file '%s' for writing!\n", filepath);
         return false;
     }
 
-    int version;
-    fread(&version, sizeof(int), 1, file);
-    if (version <= 0 || version > PACKAGE_FILE_VERSION) {
-        logprintf("Invalid version for 'assets.dat'\n");
+    Package_Cache_Header header = {};
+    header.magic_number = PACKAGE_CACHE_MAGIC_NUMBER;
+    header.version      = PACKAGE_CACHE_VERSION;
+    header.num_entries  = num_assets;
+    fwrite(&header, sizeof(header), 1, file);
+
+    s64 offset = sizeof(header);
+    for (int i = 0; i < num_assets; i++) {
+        Built_Asset *it = &assets[i];
+        bool is_texture = it->entry.type == PACKAGE_ASSET_TEXTURE;
+        bool has_compressed = it->compressed.compression == PACKAGE_COMPRESSION_LZ;
+
+        Package_Cache_Entry entry = {};
+        entry.source_hash       = it->source_hash;
+        entry.source_size       = it->source.size;
+        entry.path_length       = string_length(it->path);
+        entry.size              = is_texture ? it->entry.size : 0;
+        entry.stored_size       = has_compressed ? it->compressed.size : 0;
+        entry.width             = it->entry.width;
+        entry.height            = it->entry.height;
+        entry.type              = it->entry.type;
+        entry.compression_tried = it->compression_tried ? 1 : 0;
+
+        write_padding(file, align_package_offset(offset) - offset);
+        offset = align_package_offset(offset);
+
+        fwrite(&entry, sizeof(entry), 1, file);
+        fwrite(it->path, sizeof(char), entry.path_length + 1, file);
+        if (is_texture) fwrite(it->entry.data, sizeof(u8), entry.size, file);
+        if (has_compressed) fwrite(it->compressed.data, sizeof(u8), entry.stored_size, file);
+
+        offset += sizeof(entry) + entry.path_length + 1 + entry.size + entry.stored_size;
+    }
+
+    bool written = !ferror(file);
+    if (fclose(file) != 0) written = false;
+    if (!written) remove(filepath);
+    return written;
+}
+
+bool create_package(Package_Options *options, Package_Build_Stats *stats) {
+    Package_Build_Stats unused_stats;
+    if (!stats) stats = &unused_stats;
+    *stats = {};
+
+    if (options->version != 1 && options->version != 2) {
+        logprintf("Can't write package version %d!\n", options->version);
         return false;
     }
 
-    int num_assets;
-    fread(&num_assets, sizeof(int), 1, file);
-    if (num_assets <= 0) {
-        logprintf("Invalid num_assets for 'assets.dat'\n");
+    Array <char *> paths;
+    if (!read_package_manifest(options->manifest_filepath, &paths)) {
+        for (char *path : paths) delete [] path;
         return false;
     }
 
+    Package_Cache cache;
+    defer { free_package_cache(&cache); };
+    if (options->cache_filepath && !options->force) load_package_cache(&cache, options->cache_filepath);
+
+    Array <Built_Asset> built;
+    defer { for (Built_Asset &it : built) free_built_asset(&it); };
+
+    built.reserve(paths.count);
+    for (char *path : paths) {
+        Built_Asset *it = built.add();
+        it->path = path;
+    }
+
+    for (Built_Asset &it : built) {
+        if (!build_asset(&it, &cache, options, stats)) return false;
+    }
+    stats->num_assets = built.count;
+
+    Array <Package_Asset_Entry> entries;
+    Array <Stored_Asset> stored;
+    entries.reserve(built.count);
+    stored.reserve(built.count);
+
+    for (Built_Asset &it : built) {
+        entries.add(it.entry);
+
+        Stored_Asset *s = stored.add();
+        if (options->compress && it.compressed.compression == PACKAGE_COMPRESSION_LZ) {
+            *s = it.compressed;
+        } else {
+            s->compression = PACKAGE_COMPRESSION_NONE;
+            s->size        = it.entry.size;
+            s->data        = it.entry.data;
+        }
+    }
+
+    if (!write_package_file(options->output_filepath, entries.data, stored.data, entries.count, options->version)) return false;
+    if (!options->cache_filepath) return true;
+
+    // Everything came out of the cache and it has nothing else in it, so it
+    // is already what would be written.
+    if (stats->num_reused == built.count && cache.assets.count == built.count) return true;
+
+    // What gets written is only what this manifest has in it now, so files
+    // taken out of it drop out of the cache too. The old cache is still
+    // mapped until everything in it has been copied, and a mapped file
+    // can't be replaced everywhere, so it is let go of first.
+    char *temporary = get_temporary_filepath(options->cache_filepath);
+    defer { delete [] temporary; };
+
+    bool written = write_package_cache(temporary, built.data, built.count);
+
+    for (Built_Asset &it : built) free_built_asset(&it);
+    built.count = 0;
+    free_package_cache(&cache);
+
+    if (!written || !replace_file(temporary, options->cache_filepath)) {
+        // The package is fine; the next build just has more to redo.
+        logprintf("Failed to write the package cache '%s'!\n", options->cache_filepath);
+        remove(temporary);
+    }
+
+    return true;
+}
+
+bool write_package(char *filepath, Package_Asset_Entry *entries, int num_assets, int version) {
+    if (version != 1 && version != 2) {
+        logprintf("Can't write package version %d!\n", version);
+        return false;
+    }
+
+    Array <Stored_Asset> stored;
+    defer {
+        for (Stored_Asset &it : stored) {
+            if (it.compression != PACKAGE_COMPRESSION_NONE) delete [] it.data;
+        }
+    };
+
+    if (version == 2) {
+        stored.reserve(num_assets);
+        for (int i = 0; i < num_assets; i++) {
+            Stored_Asset *it = stored.add();
+            it->compression = PACKAGE_COMPRESSION_NONE;
+            it->size        = entries[i].size;
+            it->data        = entries[i].data;
+
+            if (entries[i].compression == PACKAGE_COMPRESSION_LZ) compress_asset(&entries[i], it);
+        }
+    }
+
+    return write_package_file(filepath, entries, stored.data, num_assets, version);
+}
+
+static bool read_package_v1(Package *package, FILE *file, int num_assets) {
     Package_Asset_Entry *assets = new Package_Asset_Entry[num_assets];
 
     for (int i = 0; i < num_assets; i++) {
@@ -219,9 +830,6 @@ bool read_package(Package *package) {
             return false;
         }
 
-        // TODO: In the future when reading this package file
-        // read it whole(or stream chunks) and use offsets into the data
-        // instead of what im doing right now
         u8 *data = new u8[size];
         fread(data, sizeof(u8), size, file);
 
@@ -254,19 +862,294 @@ bool read_package(Package *package) {
         entry.is_looping  = is_looping == 1 ? true : false;
         entry.width       = width;
         entry.height      = height;
+        entry.compression = PACKAGE_COMPRESSION_NONE;
         
         assets[i] = entry;
     }
 
+    package->assets = assets;
+    return true;
+}
+
+static bool chunk_tables_are_valid(Package_Asset_Entry *entry) {
+    if (entry->size < (s64)sizeof(Package_Chunk_Header)) return false;
+
+    Package_Chunk_Header *header = (Package_Chunk_Header *)entry->data;
+    if (header->size <= 0 || header->chunk_size != PACKAGE_CHUNK_SIZE || header->num_chunks <= 0) return false;
+    if (header->size > (s64)header->num_chunks * header->chunk_size) return false;
+    if (header->num_chunks != (header->size + header->chunk_size - 1) / header->chunk_size) return false;
+
+    s64 tables_size = sizeof(Package_Chunk_Header) + (s64)header->num_chunks * sizeof(Package_Chunk);
+    if (tables_size > entry->size) return false;
+
+    Package_Chunk *chunks = (Package_Chunk *)(entry->data + sizeof(Package_Chunk_Header));
+    for (int c = 0; c < header->num_chunks; c++) {
+        s64 size = Min((s64)header->chunk_size, header->size - (s64)c * header->chunk_size);
+        if (chunks[c].offset < tables_size || (s64)chunks[c].offset + chunks[c].stored_size > entry->size) return false;
+        if (chunks[c].stored_size == 0 || chunks[c].stored_size > size) return false;
+        // Without this a few bytes of table could ask for a huge buffer.
+        if (size > (s64)chunks[c].stored_size * LZ_MAX_EXPANSION) return false;
+    }
+
+    return true;
+}
+
+struct Chunk_Decode {
+    u8 *source;
+    s64 stored_size;
+    u8 *dest;
+    s64 size;
+    bool succeeded;
+};
+
+static void decode_chunk(Chunk_Decode *chunk) {
+    if (chunk->stored_size == chunk->size) {
+        memcpy(chunk->dest, chunk->source, chunk->size);
+        chunk->succeeded = true;
+    } else {
+        chunk->succeeded = lz_decompress(chunk->source, chunk->stored_size, chunk->dest, chunk->size);
+    }
+}
+
+// Decodes every compressed asset into one buffer and points its entry there
+// instead of at the stored bytes. The chunks are decoded across the job
+// system's threads. The stored assets all fit in file_size bytes, so anything
+// adding up to more than LZ_MAX_EXPANSION times that is corrupt, however
+// valid each table looks.
+static bool decompress_assets(Package_Asset_Entry *assets, int num_assets, s64 file_size, u8 **result) {
+    s64 total_size = 0;
+    for (int i = 0; i < num_assets; i++) {
+        Package_Asset_Entry *entry = &assets[i];
+        if (entry->compression == PACKAGE_COMPRESSION_NONE) continue;
+        if (!chunk_tables_are_valid(entry)) return false;
+
+        total_size = align_package_offset(total_size) + ((Package_Chunk_Header *)entry->data)->size;
+        if (total_size > file_size * LZ_MAX_EXPANSION) return false;
+    }
+
+    if (!total_size) return true;
+
+    u8 *buffer = new u8[total_size];
+    Array <Chunk_Decode> decodes;
+
+    s64 offset = 0;
+    for (int i = 0; i < num_assets; i++) {
+        Package_Asset_Entry *entry = &assets[i];
+        if (entry->compression == PACKAGE_COMPRESSION_NONE) continue;
+
+        Package_Chunk_Header *header = (Package_Chunk_Header *)entry->data;
+        Package_Chunk *chunks = (Package_Chunk *)(entry->data + sizeof(Package_Chunk_Header));
+
+        offset = align_package_offset(offset);
+        u8 *dest = buffer + offset;
+
+        for (int c = 0; c < header->num_chunks; c++) {
+            s64 begin = (s64)c * header->chunk_size;
+
+            Chunk_Decode *decode = decodes.add();
+            decode->source      = entry->data + chunks[c].offset;
+            decode->stored_size = chunks[c].stored_size;
+            decode->dest        = dest + begin;
+            decode->size        = Min((s64)header->chunk_size, header->size - begin);
+            decode->succeeded   = false;
+        }
+
+        entry->data = dest;
+        entry->size = header->size;
+        offset += header->size;
+    }
+
+#ifdef PACKAGER_STANDALONE
+    for (Chunk_Decode &decode : decodes) decode_chunk(&decode);
+#else
+    parallel_for(decodes.count, 1, [&](int batch_index, int begin, int end) {
+        for (int i = begin; i < end; i++) decode_chunk(&decodes[i]);
+    });
+#endif
+
+    for (Chunk_Decode &decode : decodes) {
+        if (decode.succeeded) continue;
+
+        delete [] buffer;
+        return false;
+    }
+
+    *result = buffer;
+    return true;
+}
+
+static bool read_package_v2(Package *package, char *filepath, int num_assets) {
+    File_Mapping mapping;
+    if (!map_file(filepath, &mapping)) {
+        logprintf("Failed to map '%s'!\n", filepath);
+        return false;
+    }
+
+    // read_package only read the first three fields.
+    if (mapping.size < (s64)sizeof(Package_File_Header)) {
+        logprintf("'%s' is too short for its header!\n", filepath);
+        unmap_file(&mapping);
+        return false;
+    }
+
+    Package_File_Header *header = (Package_File_Header *)mapping.data;
+    int num_index_slots = header->num_index_slots;
+
+    s64 toc_end   = sizeof(Package_File_Header) + num_assets * sizeof(Package_Toc_Entry);
+    s64 index_end = toc_end + (s64)num_index_slots * sizeof(Package_Index_Slot);
+
+    bool index_valid = num_index_slots == 0 || (num_index_slots > num_assets && (num_index_slots & (num_index_slots - 1)) == 0);
+    if (!index_valid || index_end > mapping.size) {
+        logprintf("'%s' is too short for its table of contents and index!\n", filepath);
+        unmap_file(&mapping);
+        return false;
+    }
+
+    Package_Index_Slot *index = NULL;
+    if (num_index_slots) {
+        index = (Package_Index_Slot *)(mapping.data + toc_end);
+        for (int i = 0; i < num_index_slots; i++) {
+            if (index[i].entry_plus_one > (u32)num_assets) {
+                logprintf("Invalid name index slot %d in '%s'\n", i, filepath);
+                unmap_file(&mapping);
+                return false;
+            }
+        }
+    }
+
+    Package_Toc_Entry *toc = (Package_Toc_Entry *)(mapping.data + sizeof(Package_File_Header));
+    Package_Asset_Entry *assets = new Package_Asset_Entry[num_assets];
+
+    for (int i = 0; i < num_assets; i++) {
+        Package_Toc_Entry *toc_entry = &toc[i];
+
+        // Offsets first, then lengths against what is left after them, so
+        // that nothing here can overflow.
+        bool valid = toc_entry->type <= PACKAGE_ASSET_SOUND &&
+                     toc_entry->name_length > 0 && toc_entry->size > 0 &&
+                     toc_entry->name_offset >= index_end && toc_entry->name_offset <= mapping.size &&
+                     toc_entry->name_length < mapping.size - toc_entry->name_offset &&
+                     toc_entry->data_offset >= index_end && toc_entry->data_offset <= mapping.size &&
+                     toc_entry->size <= mapping.size - toc_entry->data_offset &&
+                     toc_entry->data_offset % PACKAGE_DATA_ALIGNMENT == 0 &&
+                     toc_entry->compression <= PACKAGE_COMPRESSION_LZ;
+        if (toc_entry->type == PACKAGE_ASSET_TEXTURE && (toc_entry->width <= 0 || toc_entry->height <= 0)) valid = false;
+
+        if (!valid) {
+            logprintf("Invalid table of contents entry for %d asset\n", i);
+            delete [] assets;
+            unmap_file(&mapping);
+            return false;
+        }
+
+        Package_Asset_Entry *entry = &assets[i];
+        entry->type        = toc_entry->type;
+        entry->name_length = toc_entry->name_length;
+        entry->name        = (char *)(mapping.data + toc_entry->name_offset);
+        entry->size        = toc_entry->size;
+        entry->data        = mapping.data + toc_entry->data_offset;
+        entry->is_looping  = toc_entry->is_looping == 1;
+        entry->width       = toc_entry->width;
+        entry->height      = toc_entry->height;
+        entry->compression = toc_entry->compression;
+    }
+
+    u8 *decompressed = NULL;
+    if (!decompress_assets(assets, num_assets, mapping.size, &decompressed)) {
+        logprintf("Failed to decompress the assets in '%s'!\n", filepath);
+        delete [] assets;
+        unmap_file(&mapping);
+        return false;
+    }
+
+    package->assets          = assets;
+    package->decompressed    = decompressed;
+    package->mapping         = mapping;
+    package->index           = index;
+    package->num_index_slots = num_index_slots;
+    return true;
+}
+
+bool read_package(Package *package, char *filepath) {
+    allocation_tag(ALLOCATION_TAG_PACKAGE);
+
+    FILE *file = fopen(filepath, "rb");
+    if (!file) {
+        logprintf("Failed to open file '%s' for reading", filepath);
+        return false;
+    }
+    defer { fclose(file); };
+    
+    int magic_number;
+    if (fread(&magic_number, sizeof(int), 1, file) != 1 || magic_number != PACKAGE_FILE_MAGIC_NUMBER) {
+        logprintf("Invalid magic number for '%s'\n", filepath);
+        return false;
+    }
+
+    int version;
+    if (fread(&version, sizeof(int), 1, file) != 1 || version <= 0 || version > PACKAGE_FILE_VERSION) {
+        logprintf("Invalid version for '%s'\n", filepath);
+        return false;
+    }
+
+    int num_assets;
+    if (fread(&num_assets, sizeof(int), 1, file) != 1 || num_assets <= 0) {
+        logprintf("Invalid num_assets for '%s'\n", filepath);
+        return false;
+    }
+
+    *package = {};
+
+    bool success;
+    if (version == 1) success = read_package_v1(package, file, num_assets);
+    else              success = read_package_v2(package, filepath, num_assets);
+    if (!success) return false;
+
     package->magic_number = magic_number;
     package->version      = version;
     package->num_assets   = num_assets;
-    package->assets       = assets;
 
     return true;
 }
 
+void free_package(Package *package) {
+    if (package->version == 1) {
+        for (int i = 0; i < package->num_assets; i++) {
+            delete [] package->assets[i].name;
+            delete [] package->assets[i].data;
+        }
+    }
+
+    delete [] package->assets;
+    delete [] package->decompressed;
+    unmap_file(&package->mapping);
+
+    *package = {};
+}
+
 Package_Asset_Entry *find_asset_by_name(Package *package, char *name) {
+    if (package->index) {
+        u64 hash = get_package_name_hash(name);
+        u32 mask = (u32)package->num_index_slots - 1;
+
+        u32 slot = (u32)hash & mask;
+        for (int i = 0; i < package->num_index_slots; i++) {
+            Package_Index_Slot *it = &package->index[slot];
+            if (!it->entry_plus_one) return NULL;
+
+            if (it->name_hash == hash) {
+                Package_Asset_Entry *entry = &package->assets[it->entry_plus_one - 1];
+                // Only a name outside the package sharing a hash with one in
+                // it could get here wrongly.
+                assert(strings_match(entry->name, entry->name_length, name));
+                return entry;
+            }
+
+            slot = (slot + 1) & mask;
+        }
+        return NULL;
+    }
+
     for (int i = 0; i < package->num_assets; i++) {
         Package_Asset_Entry *entry = &package->assets[i];
         if (strings_match(entry->name, entry->name_length, name)) {
@@ -279,11 +1162,56 @@ Package_Asset_Entry *find_asset_by_name(Package *package, char *name) {
 
 #ifdef PACKAGER_STANDALONE
 
+static void print_usage() {
+    printf("Usage: packager [-manifest path] [-output path] [-cache path | -no_cache] [-version n] [-compress] [-force]\n");
+    printf("The cache defaults to the output's path with .cache on the end.\n");
+}
+
 int main(int argc, char *argv[]) {
-    if (!create_package()) {
+    Package_Options options;
+    bool use_cache = true;
+
+    for (int i = 1; i < argc; i++) {
+        char *arg = argv[i];
+        bool has_value = i < argc - 1;
+
+        if (strings_match(arg, "-manifest") && has_value) {
+            options.manifest_filepath = argv[++i];
+        } else if (strings_match(arg, "-output") && has_value) {
+            options.output_filepath = argv[++i];
+        } else if (strings_match(arg, "-cache") && has_value) {
+            options.cache_filepath = argv[++i];
+        } else if (strings_match(arg, "-no_cache")) {
+            use_cache = false;
+        } else if (strings_match(arg, "-version") && has_value) {
+            options.version = atoi(argv[++i]);
+        } else if (strings_match(arg, "-compress")) {
+            options.compress = true;
+        } else if (strings_match(arg, "-force")) {
+            options.force = true;
+        } else {
+            printf("Unknown argument '%s'\n", arg);
+            print_usage();
+            return 1;
+        }
+    }
+
+    char cache_filepath[1024];
+    if (!use_cache) {
+        options.cache_filepath = NULL;
+    } else if (!options.cache_filepath) {
+        snprintf(cache_filepath, sizeof(cache_filepath), "%s.cache", options.output_filepath);
+        options.cache_filepath = cache_filepath;
+    }
+
+    Package_Build_Stats stats;
+    if (!create_package(&options, &stats)) {
+        printf("Failed to write '%s'!\n", options.output_filepath);
         return 1;
     }
 
+    printf("Wrote %d assets to '%s': %d decoded, %d compressed, %d taken from the cache.\n",
+           stats.num_assets, options.output_filepath, stats.num_decoded, stats.num_compressed, stats.num_reused);
     return 0;
 }
 
@@ -6,6 +6,11 @@ enum Package_Asset_Type : u8 {
     PACKAGE_ASSET_SOUND,
 };
 
+enum Package_Compression : u8 {
+    PACKAGE_COMPRESSION_NONE,
+    PACKAGE_COMPRESSION_LZ, // In chunks; see compression.h.
+};
+
 struct Package_Asset_Entry {
     u8 type;
     s64 name_length;
@@ -15,17 +20,150 @@ struct Package_Asset_Entry {
     bool is_looping; // Only valid for sounds.
     int width; // Only valid for textures
     int height; // Only valid for textures
+    u8 compression; // How it is stored; data is always decompressed.
+};
+
+// Version 2 on disk: a Package_File_Header, num_assets Package_Toc_Entry
+// right after it, the name index, the names (each zero-terminated), then
+// every asset's data at an offset that is a multiple of
+// PACKAGE_DATA_ALIGNMENT. Everything is found by offset, so the reader maps
+// the file and points the entries straight into it; only the pages of assets
+// actually used get read in.
+//
+// The name index is an open-addressing table of num_index_slots slots,
+// probed linearly from name_hash & (num_index_slots - 1), at most half full.
+// The packager refuses two names with the same hash, so a lookup compares
+// hashes only and never reads a name. Packages written before there was an
+// index have num_index_slots 0 and are searched name by name.
+//
+// Assets may be compressed. Their data then starts with a
+// Package_Chunk_Header and num_chunks Package_Chunk, followed by the chunks:
+// each is chunk_size bytes of the asset (the last may be fewer) compressed
+// on its own, so they can all be decoded at once on the job system, or
+// stored as they are if that didn't make them smaller. The table of
+// contents has the stored size; the asset's own is in the chunk header.
+// Compressed assets are decoded when the package is read, so they cost a
+// copy where the rest don't; the packager only compresses an asset if that
+// saves at least a sixteenth of it.
+//
+// Version 1 is the entries one after another, each with its data inline,
+// and is read with a copy per asset. It is still read, and written on
+// request, so the two can be compared.
+const int PACKAGE_FILE_MAGIC_NUMBER = 0x4153504B;
+const int PACKAGE_FILE_VERSION = 2;
+const int PACKAGE_DATA_ALIGNMENT = 64;
+const int PACKAGE_CHUNK_SIZE = 64 * 1024;
+
+const int PACKAGE_MANIFEST_VERSION = 1; // See data/package.manifest.
+
+struct Package_File_Header {
+    int magic_number;
+    int version;
+    int num_assets;
+    int num_index_slots; // A power of two, or 0.
+};
+
+struct Package_Toc_Entry {
+    s64 data_offset; // From the start of the file, as is name_offset.
+    s64 size;        // As stored.
+    s64 name_offset;
+    s64 name_length; // Not counting the terminator.
+    int width;  // Only for textures.
+    int height; // Only for textures.
+    u8 type;
+    u8 is_looping;
+    u8 compression;
+    u8 reserved[5];
+};
+
+struct Package_Chunk_Header {
+    s64 size; // Decompressed.
+    int chunk_size;
+    int num_chunks;
+};
+
+struct Package_Chunk {
+    u32 offset; // From the start of the asset's data.
+    u32 stored_size; // The chunk's own size if it is stored as it is.
+};
+
+struct Package_Index_Slot {
+    u64 name_hash;
+    u32 entry_plus_one; // 0 for an empty slot.
+    u32 reserved;
 };
 
+// FNV-1a over the name's bytes; part of the file format, so it must not change.
+u64 get_package_name_hash(char *name, s64 name_length);
+
 struct Package {
     int magic_number;
     int version;
     int num_assets;
-    
+
     Package_Asset_Entry *assets;
+
+    File_Mapping mapping; // Version 2: names and data point into this.
+
+    Package_Index_Slot *index; // Into the mapping; NULL if there is none.
+    int num_index_slots;
+
+    u8 *decompressed; // Every compressed asset's data, decoded.
+};
+
+// The packager's cache: what it made of every asset last time, so the next
+// run only decodes and compresses the files that changed. A
+// Package_Cache_Header, then for each asset a Package_Cache_Entry, its path
+// (zero-terminated), its decoded pixels if it is a texture, and its
+// compressed data if compressing it paid off, every entry starting at a
+// multiple of PACKAGE_DATA_ALIGNMENT. Fonts and sounds go in as their files
+// are, so there is nothing of theirs to keep but the hash. An entry is used
+// only if the file's size and content hash still match.
+const int PACKAGE_CACHE_MAGIC_NUMBER = 0x4843504B;
+const int PACKAGE_CACHE_VERSION = 1;
+
+struct Package_Cache_Header {
+    int magic_number;
+    int version;
+    int num_entries;
+    int reserved;
+};
+
+struct Package_Cache_Entry {
+    u64 source_hash; // FNV-1a over the whole file.
+    s64 source_size;
+    s64 path_length; // Not counting the terminator.
+    s64 size;        // Of the pixels; 0 for fonts and sounds.
+    s64 stored_size; // Of the compressed data; 0 if there is none.
+    int width;
+    int height;
+    u8 type;
+    u8 compression_tried;
+    u8 reserved[6];
+};
+
+struct Package_Options {
+    char *manifest_filepath = "data/package.manifest";
+    char *output_filepath = "assets.pak";
+    char *cache_filepath = NULL; // No cache if NULL.
+    int version = PACKAGE_FILE_VERSION;
+    bool compress = false; // Every asset of a version 2 package.
+    bool force = false;    // Ignore the cache, but still write a new one.
+};
+
+struct Package_Build_Stats {
+    int num_assets;
+    int num_decoded;    // Textures decoded with stb_image.
+    int num_compressed; // Assets run through the compressor.
+    int num_reused;     // Assets taken from the cache with nothing redone.
 };
 
-bool create_package();
-bool read_package(Package *package);
+// Writes the package to a temporary file and renames it over the old one
+// once it is complete, and the cache the same way.
+bool create_package(Package_Options *options, Package_Build_Stats *stats = NULL);
+// An entry's compression asks for it; version 1 packages can't have it.
+bool write_package(char *filepath, Package_Asset_Entry *entries, int num_assets, int version = PACKAGE_FILE_VERSION);
+bool read_package(Package *package, char *filepath = "assets.pak");
+void free_package(Package *package);
 
 Package_Asset_Entry *find_asset_by_name(Package *package, char *name);
@@ -2,6 +2,7 @@
 #include "particles.h"
 #include "rendering.h"
 #include "world.h"
+#include "jobs.h"
 
 void update_particles(Particle_System *system, float dt) {
     for (int i = 0; i < system->particles.count;) {
@@ -18,12 +19,47 @@ void update_particles(Particle_System *system, float dt) {
     }
 }
 
-void draw_particles(Particle_System *system, World *world) {
+void update_particles_in_parallel(Particle_System *system, float dt, int batch_size) {
+    Particle *particles = system->particles.data;
+
+    parallel_for(system->particles.count, batch_size, [&](int batch_index, int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            Particle *particle = &particles[i];
+            particle->age += dt;
+            particle->position += particle->velocity * dt;
+            particle->color.w = 1.0f - (particle->age / particle->lifetime);
+        }
+    });
+
+    for (int i = 0; i < system->particles.count;) {
+        if (system->particles[i].age >= system->particles[i].lifetime) {
+            system->particles.unordered_remove_by_index(i);
+            continue;
+        }
+
+        i++;
+    }
+}
+
+void draw_particles(Particle_System *system, World *world, Rectangle2 visible_rect) {
+    float x0 = visible_rect.x;
+    float y0 = visible_rect.y;
+    float x1 = visible_rect.x + visible_rect.width;
+    float y1 = visible_rect.y + visible_rect.height;
+
+    s64 num_drawn = 0;
     for (Particle p : system->particles) {
+        if (p.position.x + p.size < x0 || p.position.x > x1) continue;
+        if (p.position.y + p.size < y0 || p.position.y > y1) continue;
+        num_drawn++;
+
         Vector2 position = world_space_to_screen_space(world, p.position);
         Vector2 size = world_space_to_screen_space(world, v2(p.size, p.size));
         immediate_quad(position, size, p.color);
     }
+
+    render_stats.num_particles_drawn  += num_drawn;
+    render_stats.num_particles_culled += system->particles.count - num_drawn;
 }
 
 void emit_jump_particles(Particle_System *system, Vector2 position) {
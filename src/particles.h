@@ -16,7 +16,14 @@ struct Particle_System {
 };
 
 void update_particles(Particle_System *system, float dt);
-void draw_particles(Particle_System *system, World *world);
+
+// Same result as update_particles, bit for bit: every particle is aged and
+// moved first, spread over the job threads, then the dead ones are swapped
+// out in the order the serial loop would have.
+void update_particles_in_parallel(Particle_System *system, float dt, int batch_size);
+
+// Only the particles overlapping visible_rect (in world space) get drawn.
+void draw_particles(Particle_System *system, World *world, Rectangle2 visible_rect);
 
 void emit_jump_particles(Particle_System *system, Vector2 position);
 void emit_stomp_particles(Particle_System *system, Vector2 position);
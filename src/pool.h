@@ -0,0 +1,181 @@
+#pragma once
+
+#include "general.h"
+#include "array.h"
+
+#include <stdlib.h>
+#include <new>
+
+// Refers to a slot in a Pool. The generation is bumped every time the slot is
+// freed, so a handle to a removed item stops resolving even after the slot
+// gets reused. Generation 0 is never handed out, so a zeroed handle is invalid.
+struct Pool_Handle {
+    u32 index = 0;
+    u32 generation = 0;
+};
+
+inline bool operator==(Pool_Handle a, Pool_Handle b) {
+    return a.index == b.index && a.generation == b.generation;
+}
+
+inline bool operator!=(Pool_Handle a, Pool_Handle b) {
+    return !(a == b);
+}
+
+const int POOL_BLOCK_SIZE = 256;
+
+struct Pool_No_Hot_Fields {};
+
+// Items live in fixed-size blocks that never move, so pointers into the pool
+// stay valid until the item is removed, and iterating walks memory in order.
+// Freed slots go on a free list and get reused before the pool grows.
+//
+// Hot, if given, is a struct of POOL_BLOCK_SIZE-long arrays, one per field,
+// that every block keeps next to its items: the fields a tight loop sweeps
+// over, kept out of T so the sweep pulls in only those. Slot i of a block's
+// hot arrays belongs to items[i]; whoever adds an item sets its hot fields.
+template <typename T, typename Hot = Pool_No_Hot_Fields>
+struct Pool {
+    static const int ITEMS_PER_BLOCK = POOL_BLOCK_SIZE;
+
+    struct Block {
+        T items[ITEMS_PER_BLOCK]; // First, so an item's block is found from its address.
+        u32 generations[ITEMS_PER_BLOCK];
+        bool occupied[ITEMS_PER_BLOCK];
+        Hot hot;
+    };
+
+    struct Iterator {
+        Pool *pool;
+        int index;
+
+        inline Iterator &operator++() {
+            index = pool->next_occupied(index + 1);
+            return *this;
+        }
+
+        inline T *operator*() {
+            return &pool->blocks[index / ITEMS_PER_BLOCK]->items[index % ITEMS_PER_BLOCK];
+        }
+
+        inline bool operator==(Iterator const &other) const { return index == other.index; }
+        inline bool operator!=(Iterator const &other) const { return index != other.index; }
+    };
+
+    Array <Block *> blocks;
+    Array <u32> free_slots;
+    int num_slots = 0; // Slots ever handed out, occupied or not.
+    int count = 0;     // Occupied slots.
+
+    inline void deallocate() {
+        for (Block *block : blocks) {
+            for (int i = 0; i < ITEMS_PER_BLOCK; i++) {
+                if (block->occupied[i]) block->items[i].~T();
+            }
+
+            tracked_free(block);
+        }
+
+        blocks.deallocate();
+        free_slots.deallocate();
+        num_slots = 0;
+        count = 0;
+    }
+
+    // The free list grows along with the blocks, so removing never allocates.
+    inline void add_block() {
+        Block *block = (Block *)tracked_malloc(sizeof(Block));
+        if (!block) out_of_memory(sizeof(Block));
+        memset(block->generations, 0, sizeof(block->generations));
+        memset(block->occupied, 0, sizeof(block->occupied));
+        memset(&block->hot, 0, sizeof(block->hot));
+        blocks.add(block);
+        free_slots.reserve(blocks.count * ITEMS_PER_BLOCK);
+    }
+
+    // Makes room for num_items in all, so adding up to that many never
+    // allocates.
+    inline void reserve(int num_items) {
+        while (blocks.count * ITEMS_PER_BLOCK < num_items) add_block();
+    }
+
+    inline T *add(Pool_Handle *handle_result = NULL) {
+        u32 index;
+        if (free_slots.count) {
+            index = free_slots[free_slots.count - 1];
+            free_slots.count--;
+        } else {
+            if (num_slots == blocks.count * ITEMS_PER_BLOCK) add_block();
+            index = num_slots++;
+        }
+
+        Block *block = blocks[index / ITEMS_PER_BLOCK];
+        int slot = index % ITEMS_PER_BLOCK;
+
+        block->generations[slot]++;
+        if (block->generations[slot] == 0) block->generations[slot] = 1;
+        block->occupied[slot] = true;
+        count++;
+
+        if (handle_result) {
+            handle_result->index      = index;
+            handle_result->generation = block->generations[slot];
+        }
+
+        return new (&block->items[slot]) T();
+    }
+
+    inline T *get(Pool_Handle handle) {
+        if (handle.index >= (u32)num_slots) return NULL;
+
+        Block *block = blocks[handle.index / ITEMS_PER_BLOCK];
+        int slot = handle.index % ITEMS_PER_BLOCK;
+        if (!block->occupied[slot] || block->generations[slot] != handle.generation) return NULL;
+
+        return &block->items[slot];
+    }
+
+    inline void remove(Pool_Handle handle) {
+        T *item = get(handle);
+        assert(item);
+        if (!item) return;
+
+        Block *block = blocks[handle.index / ITEMS_PER_BLOCK];
+        int slot = handle.index % ITEMS_PER_BLOCK;
+
+        item->~T();
+        block->occupied[slot] = false;
+        block->generations[slot]++;
+        count--;
+
+        free_slots.add(handle.index);
+    }
+
+    // The hot fields of item's block and its slot in them, straight from
+    // where the item is; handle is the item's own.
+    static inline Hot *get_hot(T *item, Pool_Handle handle, int *slot) {
+        *slot = handle.index % ITEMS_PER_BLOCK;
+        Block *block = (Block *)(item - *slot);
+        return &block->hot;
+    }
+
+    // For splitting a pool across threads: slots are [0, num_slots), and an
+    // unoccupied one gives NULL.
+    inline T *get_slot(int index) {
+        Block *block = blocks.data[index / ITEMS_PER_BLOCK];
+        int slot = index % ITEMS_PER_BLOCK;
+        return block->occupied[slot] ? &block->items[slot] : NULL;
+    }
+
+    inline int next_occupied(int index) {
+        while (index < num_slots) {
+            Block *block = blocks.data[index / ITEMS_PER_BLOCK];
+            if (block->occupied[index % ITEMS_PER_BLOCK]) break;
+            index++;
+        }
+        return index;
+    }
+
+    inline Iterator begin() { return {this, next_occupied(0)}; }
+    inline Iterator end() { return {this, num_slots}; }
+};
@@ -0,0 +1,169 @@
+#include "main.h"
+#include "profiler.h"
+
+#include <stdio.h>
+
+// One per thread that has recorded a zone, made on its first one. Only the
+// owner writes; readers (the HUD, the trace dump) look at events up to
+// num_events, which is bumped after the event it counts is in place.
+struct Profile_Thread {
+    int id = 0;
+    int depth = 0;
+    char name[64] = {};
+
+    volatile s64 num_events = 0; // Ever recorded; the newest are still in the ring.
+    Profile_Event events[PROFILE_EVENTS_PER_THREAD];
+};
+
+static Profile_Thread *profile_threads[MAX_PROFILE_THREADS];
+static SDL_atomic_t num_profile_threads;
+
+static thread_local Profile_Thread *current_profile_thread;
+static thread_local bool out_of_profile_threads;
+
+// Frame boundaries, on the main thread.
+static Profile_Thread *main_profile_thread;
+static s64 last_frame_start;
+static s64 current_frame_start;
+
+static s64 ticks_to_nanoseconds(s64 ticks) {
+    static u64 frequency = SDL_GetPerformanceFrequency();
+    u64 seconds   = (u64)ticks / frequency;
+    u64 remainder = (u64)ticks % frequency;
+    return (s64)(seconds * 1000000000ULL + remainder * 1000000000ULL / frequency);
+}
+
+static Profile_Thread *get_profile_thread() {
+    if (current_profile_thread || out_of_profile_threads) return current_profile_thread;
+
+    int id = SDL_AtomicAdd(&num_profile_threads, 1);
+    if (id >= MAX_PROFILE_THREADS) {
+        out_of_profile_threads = true;
+        return NULL;
+    }
+
+    Profile_Thread *thread = new Profile_Thread();
+    thread->id = id;
+    snprintf(thread->name, sizeof(thread->name), "Thread %d", id);
+
+    SDL_MemoryBarrierRelease();
+    profile_threads[id] = thread;
+    current_profile_thread = thread;
+    return thread;
+}
+
+s64 begin_profile_zone() {
+    Profile_Thread *thread = get_profile_thread();
+    if (thread) thread->depth++;
+    return (s64)SDL_GetPerformanceCounter();
+}
+
+void end_profile_zone(char *name, s64 start) {
+    s64 end = (s64)SDL_GetPerformanceCounter();
+
+    Profile_Thread *thread = current_profile_thread;
+    if (!thread) return;
+
+    thread->depth--;
+
+    s64 n = thread->num_events;
+    Profile_Event *event = &thread->events[n & (PROFILE_EVENTS_PER_THREAD - 1)];
+    event->name  = name;
+    event->start = start;
+    event->end   = end;
+    event->depth = thread->depth;
+
+    SDL_MemoryBarrierRelease();
+    thread->num_events = n + 1;
+}
+
+void set_profile_thread_name(char *name) {
+#ifdef PROFILER
+    Profile_Thread *thread = get_profile_thread();
+    if (thread) snprintf(thread->name, sizeof(thread->name), "%s", name);
+#endif
+}
+
+void begin_profile_frame() {
+#ifdef PROFILER
+    main_profile_thread = get_profile_thread();
+    last_frame_start    = current_frame_start;
+    current_frame_start = (s64)SDL_GetPerformanceCounter();
+#endif
+}
+
+bool get_last_profile_frame(Array <Profile_Event> *events, s64 *frame_start, s64 *frame_end) {
+    events->count = 0;
+
+    Profile_Thread *thread = main_profile_thread;
+    if (!thread || !last_frame_start) return false;
+
+    *frame_start = ticks_to_nanoseconds(last_frame_start);
+    *frame_end   = ticks_to_nanoseconds(current_frame_start);
+
+    // Events are recorded as zones end, so end times only grow: walk back
+    // to the first that ended inside the frame, then forward from there.
+    s64 newest = thread->num_events;
+    s64 oldest = Max(newest - PROFILE_EVENTS_PER_THREAD, 0);
+
+    s64 first = newest;
+    while (first > oldest && thread->events[(first - 1) & (PROFILE_EVENTS_PER_THREAD - 1)].end >= last_frame_start) {
+        first--;
+    }
+
+    for (s64 i = first; i < newest; i++) {
+        Profile_Event *event = &thread->events[i & (PROFILE_EVENTS_PER_THREAD - 1)];
+        if (event->start < last_frame_start || event->end > current_frame_start) continue;
+
+        Profile_Event *result = events->add();
+        *result = *event;
+        result->start = ticks_to_nanoseconds(event->start);
+        result->end   = ticks_to_nanoseconds(event->end);
+    }
+
+    return true;
+}
+
+bool write_chrome_trace(char *filepath) {
+    FILE *file = fopen(filepath, "wb");
+    if (!file) {
+        logprintf("Failed to open '%s' for writing the profile!\n", filepath);
+        return false;
+    }
+    defer { fclose(file); };
+
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+
+    char *separator = "\n";
+    s64 num_written = 0;
+
+    int num_threads = Min(SDL_AtomicGet(&num_profile_threads), MAX_PROFILE_THREADS);
+    for (int t = 0; t < num_threads; t++) {
+        Profile_Thread *thread = profile_threads[t];
+        if (!thread) continue;
+        SDL_MemoryBarrierAcquire();
+
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", separator, thread->id, thread->name);
+        separator = ",\n";
+
+        s64 newest = thread->num_events;
+        SDL_MemoryBarrierAcquire();
+
+        // Other threads keep recording while this runs, so the oldest part
+        // of a full ring may be overwritten under us: leave it out.
+        s64 oldest = Max(newest - PROFILE_EVENTS_PER_THREAD * 3 / 4, 0);
+
+        for (s64 i = oldest; i < newest; i++) {
+            Profile_Event event = thread->events[i & (PROFILE_EVENTS_PER_THREAD - 1)];
+            fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                    separator, event.name, thread->id, ticks_to_nanoseconds(event.start) / 1000.0,
+                    (ticks_to_nanoseconds(event.end) - ticks_to_nanoseconds(event.start)) / 1000.0);
+            num_written++;
+        }
+    }
+
+    fprintf(file, "\n]}\n");
+
+    logprintf("Wrote %lld profile events to '%s'.\n", (long long)num_written, filepath);
+    return true;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+// Scoped CPU zones: profile_zone("name") at the top of a block records when
+// the block started and ended, on the calling thread, into that thread's own
+// ring of events, so recording takes no locks. The debug HUD draws the main
+// thread's zones for the last frame as a flame bar, and write_chrome_trace
+// dumps every thread's recent zones for chrome://tracing or Perfetto.
+//
+// Zones are compiled in for debug builds, and for any build that defines
+// PROFILER; elsewhere profile_zone is nothing at all.
+
+#if defined(BUILD_DEBUG) && !defined(PROFILER)
+#define PROFILER
+#endif
+
+const int MAX_PROFILE_THREADS = 80; // The job system's 64, plus main, audio and whatever else.
+const int PROFILE_EVENTS_PER_THREAD = 1 << 16; // Power of two.
+
+// Recorded in raw SDL_GetPerformanceCounter ticks, which are cheap to read;
+// handed out in nanoseconds.
+struct Profile_Event {
+    char *name; // A string literal; only the pointer is kept.
+    s64 start;
+    s64 end;
+    int depth;  // How many zones this one is nested in.
+};
+
+s64 begin_profile_zone();
+void end_profile_zone(char *name, s64 start);
+
+struct Profile_Zone {
+    char *name;
+    s64 start;
+
+    inline Profile_Zone(char *name) {
+        this->name  = name;
+        this->start = begin_profile_zone();
+    }
+
+    inline ~Profile_Zone() {
+        end_profile_zone(name, start);
+    }
+};
+
+#ifdef PROFILER
+#define profile_zone(name) Profile_Zone CONCAT(profile_zone__, __LINE__)(name)
+#else
+#define profile_zone(name)
+#endif
+
+// Shown in the trace; threads that never name themselves are "Thread N".
+void set_profile_thread_name(char *name);
+
+// Called by the main thread at the start of every frame.
+void begin_profile_frame();
+
+// The main thread's zones that fell inside the last complete frame, in the
+// order they ended, times in nanoseconds. Returns false if there has not
+// been one yet.
+bool get_last_profile_frame(Array <Profile_Event> *events, s64 *frame_start, s64 *frame_end);
+
+bool write_chrome_trace(char *filepath);
@@ -0,0 +1,181 @@
+#include "main.h"
+#include "recording.h"
+
+#include <stdio.h>
+
+const int RECORDING_FILE_MAGIC_NUMBER = 0x56524543;
+const int RECORDING_FILE_VERSION = 1;
+
+const u8 RECORDED_KEY_IS_DOWN = Bit(0);
+const u8 RECORDED_KEY_CHANGED = Bit(1);
+
+static FILE *record_file = NULL;
+static s64 num_recorded_frames = 0;
+
+static FILE *replay_file = NULL;
+static s64 num_replayed_frames = 0;
+
+//
+// Variable-length integers: 7 bits per byte, high bit set on all but the last.
+// Frame delta times and scancodes are small, so most frames are 3 bytes.
+//
+
+static void write_varint(FILE *file, u64 value) {
+    u8 bytes[10];
+    int count = 0;
+
+    do {
+        u8 byte = value & 0x7F;
+        value >>= 7;
+        if (value) byte |= 0x80;
+        bytes[count++] = byte;
+    } while (value);
+
+    fwrite(bytes, 1, count, file);
+}
+
+static bool read_varint(FILE *file, u64 *value) {
+    u64 result = 0;
+
+    for (int shift = 0; shift < 64; shift += 7) {
+        int c = fgetc(file);
+        if (c == EOF) return false;
+
+        result |= (u64)(c & 0x7F) << shift;
+        if (!(c & 0x80)) {
+            *value = result;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool start_recording(char *filepath, u64 seed) {
+    assert(!record_file);
+
+    record_file = fopen(filepath, "wb");
+    if (!record_file) {
+        logprintf("Failed to open '%s' for recording!\n", filepath);
+        return false;
+    }
+
+    fwrite(&RECORDING_FILE_MAGIC_NUMBER, sizeof(int), 1, record_file);
+    fwrite(&RECORDING_FILE_VERSION, sizeof(int), 1, record_file);
+    fwrite(&seed, sizeof(u64), 1, record_file);
+
+    num_recorded_frames = 0;
+
+    logprintf("Recording input to '%s' with seed %llu.\n", filepath, (unsigned long long)seed);
+    return true;
+}
+
+void record_frame(s64 delta_time, Array <Recorded_Key> *keys) {
+    if (!record_file) return;
+
+    write_varint(record_file, (u64)Max(delta_time, 0));
+    write_varint(record_file, (u64)keys->count);
+
+    for (Recorded_Key key : *keys) {
+        u8 flags = 0;
+        if (key.is_down) flags |= RECORDED_KEY_IS_DOWN;
+        if (key.changed) flags |= RECORDED_KEY_CHANGED;
+
+        write_varint(record_file, key.scancode);
+        fwrite(&flags, sizeof(u8), 1, record_file);
+    }
+
+    num_recorded_frames++;
+}
+
+void stop_recording() {
+    if (!record_file) return;
+
+    fclose(record_file);
+    record_file = NULL;
+
+    logprintf("Recorded %lld frames.\n", (long long)num_recorded_frames);
+}
+
+bool is_recording() {
+    return record_file != NULL;
+}
+
+bool start_replay(char *filepath, u64 *seed) {
+    assert(!replay_file);
+
+    replay_file = fopen(filepath, "rb");
+    if (!replay_file) {
+        logprintf("Failed to open '%s' for replay!\n", filepath);
+        return false;
+    }
+
+    int magic_number = 0;
+    fread(&magic_number, sizeof(int), 1, replay_file);
+    if (magic_number != RECORDING_FILE_MAGIC_NUMBER) {
+        logprintf("Invalid magic number for '%s'\n", filepath);
+        stop_replay();
+        return false;
+    }
+
+    int version = 0;
+    fread(&version, sizeof(int), 1, replay_file);
+    if (version <= 0 || version > RECORDING_FILE_VERSION) {
+        logprintf("Invalid version for '%s'\n", filepath);
+        stop_replay();
+        return false;
+    }
+
+    if (fread(seed, sizeof(u64), 1, replay_file) != 1) {
+        logprintf("Missing seed in '%s'\n", filepath);
+        stop_replay();
+        return false;
+    }
+
+    num_replayed_frames = 0;
+
+    logprintf("Replaying input from '%s' with seed %llu.\n", filepath, (unsigned long long)*seed);
+    return true;
+}
+
+bool read_replay_frame(s64 *delta_time, Array <Recorded_Key> *keys) {
+    keys->count = 0;
+    if (!replay_file) return false;
+
+    u64 dt, num_keys;
+    if (!read_varint(replay_file, &dt)) return false;
+    if (!read_varint(replay_file, &num_keys)) return false;
+    if (num_keys > SDL_NUM_SCANCODES) return false;
+
+    for (u64 i = 0; i < num_keys; i++) {
+        u64 scancode;
+        if (!read_varint(replay_file, &scancode)) return false;
+        if (scancode >= SDL_NUM_SCANCODES) return false;
+
+        int flags = fgetc(replay_file);
+        if (flags == EOF) return false;
+
+        Recorded_Key key;
+        key.scancode = (u16)scancode;
+        key.is_down  = (flags & RECORDED_KEY_IS_DOWN) != 0;
+        key.changed  = (flags & RECORDED_KEY_CHANGED) != 0;
+        keys->add(key);
+    }
+
+    *delta_time = (s64)dt;
+    num_replayed_frames++;
+    return true;
+}
+
+void stop_replay() {
+    if (!replay_file) return;
+
+    fclose(replay_file);
+    replay_file = NULL;
+
+    logprintf("Replayed %lld frames.\n", (long long)num_replayed_frames);
+}
+
+bool is_replaying() {
+    return replay_file != NULL;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+// Per-frame input recording, so that a session can be replayed bit-exactly.
+// A frame stores the frame delta time and only the keys whose state differs
+// from "same as last frame, unchanged".
+
+struct Recorded_Key {
+    u16 scancode;
+    bool is_down;
+    bool changed;
+};
+
+bool start_recording(char *filepath, u64 seed);
+void record_frame(s64 delta_time, Array <Recorded_Key> *keys);
+void stop_recording();
+bool is_recording();
+
+bool start_replay(char *filepath, u64 *seed);
+bool read_replay_frame(s64 *delta_time, Array <Recorded_Key> *keys);
+void stop_replay();
+bool is_replaying();
@@ -0,0 +1,283 @@
+#include "main.h"
+#include "rendering.h"
+#include "render_queue.h"
+#include "font.h"
+#include "sort.h"
+
+// Sort key, high bits first: layer, transform, shader, texture (with its
+// filtering), blend mode, and the order the command was recorded in, which
+// keeps the sort stable.
+const int SORT_KEY_SEQUENCE_BITS  = 26;
+const int SORT_KEY_BLEND_BITS     = 2;
+const int SORT_KEY_TEXTURE_BITS   = 12;
+const int SORT_KEY_SHADER_BITS    = 8;
+const int SORT_KEY_TRANSFORM_BITS = 8;
+
+const int SORT_KEY_BLEND_SHIFT     = SORT_KEY_SEQUENCE_BITS;
+const int SORT_KEY_TEXTURE_SHIFT   = SORT_KEY_BLEND_SHIFT + SORT_KEY_BLEND_BITS;
+const int SORT_KEY_SHADER_SHIFT    = SORT_KEY_TEXTURE_SHIFT + SORT_KEY_TEXTURE_BITS;
+const int SORT_KEY_TRANSFORM_SHIFT = SORT_KEY_SHADER_SHIFT + SORT_KEY_SHADER_BITS;
+const int SORT_KEY_LAYER_SHIFT     = SORT_KEY_TRANSFORM_SHIFT + SORT_KEY_TRANSFORM_BITS;
+
+struct Render_Command {
+    u64 sort_key;
+
+    // State, compared directly when batching.
+    int transform;
+    Shader *shader;
+    Texture *texture;
+    bool point_sample;
+    Blend_Mode blend_mode;
+
+    Vector2 positions[4];
+    Vector2 uvs[4];
+    Vector4 color;
+};
+
+struct Render_Queue {
+    Array <Render_Command> commands;
+    Array <int> order; // Into commands, sorted by plan_render_queue.
+    Array <int> sort_scratch;
+
+    Array <Matrix4> transforms;
+    Array <Shader *> shaders;
+    Array <Texture *> textures;
+
+    Blend_Mode blend_mode = BLEND_MODE_ALPHA;
+};
+
+static Render_Queue render_queue;
+
+// Everything the queue holds lives in the frame arena. Every flush (or
+// clear) leaves the arrays with no storage at all, so the next command takes
+// fresh arena memory whichever frame it is in.
+static Render_Queue *get_render_queue() {
+    Render_Queue *queue = &render_queue;
+    if (!queue->commands.arena) clear_render_queue();
+    return queue;
+}
+
+static int get_state_index(Array <Shader *> *shaders, Shader *shader) {
+    for (int i = 0; i < shaders->count; i++) {
+        if ((*shaders)[i] == shader) return i;
+    }
+    shaders->add(shader);
+    return shaders->count - 1;
+}
+
+static int get_state_index(Array <Texture *> *textures, Texture *texture) {
+    for (int i = 0; i < textures->count; i++) {
+        if ((*textures)[i] == texture) return i;
+    }
+    textures->add(texture);
+    return textures->count - 1;
+}
+
+static bool matrices_match(Matrix4 a, Matrix4 b) {
+    return memcmp(&a, &b, sizeof(Matrix4)) == 0;
+}
+
+void set_render_transform(Matrix4 world_to_view_matrix) {
+    Render_Queue *queue = get_render_queue();
+    if (queue->transforms.count && matrices_match(queue->transforms[queue->transforms.count - 1], world_to_view_matrix)) return;
+
+    queue->transforms.add(world_to_view_matrix);
+}
+
+void set_render_blend_mode(Blend_Mode blend_mode) {
+    render_queue.blend_mode = blend_mode;
+}
+
+static void queue_command(Render_Layer layer, Shader *shader, Texture *texture, bool point_sample, Render_Command *command) {
+    Render_Queue *queue = get_render_queue();
+    if (!queue->transforms.count) queue->transforms.add(matrix4_identity());
+
+    command->transform    = queue->transforms.count - 1;
+    command->shader       = shader;
+    command->texture      = texture;
+    command->point_sample = point_sample;
+    command->blend_mode   = queue->blend_mode;
+
+    u64 shader_index  = get_state_index(&queue->shaders, shader);
+    u64 texture_index = get_state_index(&queue->textures, texture) * 2 + (point_sample ? 0 : 1);
+
+    assert(command->transform < (1 << SORT_KEY_TRANSFORM_BITS));
+    assert(shader_index  < (1 << SORT_KEY_SHADER_BITS));
+    assert(texture_index < (1 << SORT_KEY_TEXTURE_BITS));
+    assert(queue->commands.count < (1 << SORT_KEY_SEQUENCE_BITS));
+
+    command->sort_key = ((u64)layer                       << SORT_KEY_LAYER_SHIFT)
+                      | ((u64)command->transform          << SORT_KEY_TRANSFORM_SHIFT)
+                      | (shader_index                     << SORT_KEY_SHADER_SHIFT)
+                      | (texture_index                    << SORT_KEY_TEXTURE_SHIFT)
+                      | ((u64)command->blend_mode         << SORT_KEY_BLEND_SHIFT)
+                      | (u64)queue->commands.count;
+
+    queue->commands.add(*command);
+}
+
+void queue_quad(Render_Layer layer, Shader *shader, Texture *texture, Vector2 p0, Vector2 p1, Vector2 p2, Vector2 p3, Vector2 uv0, Vector2 uv1, Vector2 uv2, Vector2 uv3, Vector4 color) {
+    Render_Command command;
+    command.positions[0] = p0;
+    command.positions[1] = p1;
+    command.positions[2] = p2;
+    command.positions[3] = p3;
+    command.uvs[0] = uv0;
+    command.uvs[1] = uv1;
+    command.uvs[2] = uv2;
+    command.uvs[3] = uv3;
+    command.color = color;
+
+    queue_command(layer, shader, texture, true, &command);
+}
+
+void queue_quad(Render_Layer layer, Shader *shader, Texture *texture, Vector2 position, Vector2 size, Vector4 color) {
+    Vector2 p0 = position;
+    Vector2 p1 = v2(position.x + size.x, position.y);
+    Vector2 p2 = position + size;
+    Vector2 p3 = v2(position.x, position.y + size.y);
+
+    queue_quad(layer, shader, texture, p0, p1, p2, p3, v2(0, 0), v2(1, 0), v2(1, 1), v2(0, 1), color);
+}
+
+void queue_quad(Render_Layer layer, Vector2 position, Vector2 size, Vector4 color) {
+    queue_quad(layer, globals.shader_color, NULL, position, size, color);
+}
+
+void queue_circle(Render_Layer layer, Vector2 center, float radius, Vector4 color) {
+    Immediate_Vertex v[6];
+    get_circle_quad_vertices(center, radius, color, v);
+
+    queue_quad(layer, globals.shader_circle, NULL,
+               v[0].position, v[1].position, v[2].position, v[5].position,
+               get_vertex_uv(v[0]), get_vertex_uv(v[1]), get_vertex_uv(v[2]), get_vertex_uv(v[5]), color);
+}
+
+void draw_text(Dynamic_Font *font, char *text, int x, int y, Vector4 color) {
+    font->prep_text(text, x, y);
+
+    for (Font_Quad quad : font->font_quads) {
+        Render_Command command;
+        command.positions[0] = v2(quad.x0, quad.y0);
+        command.positions[1] = v2(quad.x1, quad.y0);
+        command.positions[2] = v2(quad.x1, quad.y1);
+        command.positions[3] = v2(quad.x0, quad.y1);
+
+        command.uvs[0] = v2(quad.u0, quad.v1);
+        command.uvs[1] = v2(quad.u1, quad.v1);
+        command.uvs[2] = v2(quad.u1, quad.v0);
+        command.uvs[3] = v2(quad.u0, quad.v0);
+
+        command.color = color;
+
+        queue_command(RENDER_LAYER_TEXT, globals.shader_text, quad.texture, false, &command);
+    }
+
+    font->font_quads.count = 0;
+}
+
+// Most key bytes are the same in every command (there are few layers,
+// shaders and textures), and the sort skips those.
+static void sort_commands(Render_Queue *queue) {
+    Render_Command *commands = queue->commands.data;
+    radix_sort_by_u64_key(queue->order.data, queue->order.count, &queue->sort_scratch,
+                          [&](int index) { return commands[index].sort_key; });
+}
+
+static int count_state_changes(Render_Command *a, Render_Command *b) {
+    int result = 0;
+    if (a->transform  != b->transform)  result++;
+    if (a->shader     != b->shader)     result++;
+    if (a->texture    != b->texture || a->point_sample != b->point_sample) result++;
+    if (a->blend_mode != b->blend_mode) result++;
+    return result;
+}
+
+Render_Queue_Stats plan_render_queue(bool sort) {
+    Render_Queue *queue = get_render_queue();
+
+    int count = queue->commands.count;
+    queue->order.reserve(count);
+    queue->order.count = count;
+    for (int i = 0; i < count; i++) queue->order[i] = i;
+
+    if (sort) sort_commands(queue);
+
+    Render_Queue_Stats stats;
+    stats.num_commands = count;
+
+    int num_batch_vertices = 0;
+    for (int i = 0; i < count; i++) {
+        Render_Command *command = &queue->commands[queue->order[i]];
+
+        int num_changes = 0;
+        if (i) num_changes = count_state_changes(&queue->commands[queue->order[i - 1]], command);
+        stats.num_state_changes += num_changes;
+
+        if (!i || num_changes || num_batch_vertices + 6 > MAX_IMMEDIATE_VERTICES) {
+            stats.num_batches++;
+            num_batch_vertices = 0;
+        }
+        num_batch_vertices += 6;
+    }
+
+    return stats;
+}
+
+void flush_render_queue() {
+    Render_Queue *queue = get_render_queue();
+    if (!queue->commands.count) {
+        clear_render_queue();
+        return;
+    }
+
+    Render_Queue_Stats stats = plan_render_queue();
+    render_stats.num_state_changes += stats.num_state_changes;
+
+    immediate_flush();
+
+    Render_Command *last = NULL;
+    for (int index : queue->order) {
+        Render_Command *command = &queue->commands[index];
+
+        if (!last || last->transform != command->transform) {
+            immediate_flush();
+            rendering_2d(globals.render_width, globals.render_height, queue->transforms[command->transform]);
+        }
+
+        if (!last || last->shader != command->shader) {
+            immediate_flush();
+            set_shader(command->shader);
+        }
+
+        if (!last || last->texture != command->texture || last->point_sample != command->point_sample) {
+            immediate_flush();
+            if (command->texture) set_texture(0, command->texture, command->point_sample);
+        }
+
+        if (!last || last->blend_mode != command->blend_mode) {
+            immediate_flush();
+            set_blend_mode(command->blend_mode);
+        }
+
+        Vector2 *p  = command->positions;
+        Vector2 *uv = command->uvs;
+        immediate_quad(p[0], p[1], p[2], p[3], uv[0], uv[1], uv[2], uv[3], command->color);
+
+        last = command;
+    }
+
+    immediate_flush();
+    clear_render_queue();
+}
+
+void clear_render_queue() {
+    Render_Queue *queue = &render_queue;
+    queue->commands.use_arena(&frame_arena);
+    queue->order.use_arena(&frame_arena);
+    queue->sort_scratch.use_arena(&frame_arena);
+    queue->transforms.use_arena(&frame_arena);
+    queue->shaders.use_arena(&frame_arena);
+    queue->textures.use_arena(&frame_arena);
+    queue->blend_mode       = BLEND_MODE_ALPHA;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+// Deferred drawing for the HUD, menus and overlays. Quads, circles and text
+// are recorded with a sort key and drawn at flush_render_queue, grouped by
+// layer, then transform, shader, texture and blend mode, so things sharing
+// state go out together however they were interleaved when recorded. Within
+// a layer anything with the same state keeps the order it was recorded in;
+// anything that has to be on top of something drawn differently goes in a
+// higher layer.
+
+struct Shader;
+struct Texture;
+struct Dynamic_Font;
+
+enum Render_Layer {
+    RENDER_LAYER_BACKDROP, // Full-screen dimming over the world.
+    RENDER_LAYER_HUD,      // Icons, panels, sliders.
+    RENDER_LAYER_TEXT,     // Over whatever panel it sits on.
+    RENDER_LAYER_FADE,     // Covers everything.
+
+    NUM_RENDER_LAYERS
+};
+
+// What a flush did, or would do: a state change is any one of transform,
+// shader, texture or blend mode switching between two commands, and a batch
+// is a run of commands going out in one draw call.
+struct Render_Queue_Stats {
+    int num_commands = 0;
+    int num_batches = 0;
+    int num_state_changes = 0;
+};
+
+// Commands recorded from here on are drawn with this world-to-view matrix,
+// under the usual rendering_2d projection. Identity until set; reset by
+// every flush.
+void set_render_transform(Matrix4 world_to_view_matrix);
+void set_render_blend_mode(Blend_Mode blend_mode);
+
+void queue_quad(Render_Layer layer, Shader *shader, Texture *texture, Vector2 p0, Vector2 p1, Vector2 p2, Vector2 p3, Vector2 uv0, Vector2 uv1, Vector2 uv2, Vector2 uv3, Vector4 color);
+void queue_quad(Render_Layer layer, Shader *shader, Texture *texture, Vector2 position, Vector2 size, Vector4 color);
+void queue_quad(Render_Layer layer, Vector2 position, Vector2 size, Vector4 color); // Untextured.
+void queue_circle(Render_Layer layer, Vector2 center, float radius, Vector4 color);
+
+// Text goes in RENDER_LAYER_TEXT.
+void draw_text(Dynamic_Font *font, char *text, int x, int y, Vector4 color);
+
+// Sorts the commands (or not, to see what drawing them in recorded order
+// would cost) and works out the batches, without touching the GPU.
+Render_Queue_Stats plan_render_queue(bool sort = true);
+
+// Draws everything recorded and empties the queue. Leaves the shader,
+// texture and transform set to whatever the last batch used.
+void flush_render_queue();
+void clear_render_queue();
@@ -1,5 +1,12 @@
 #pragma once
 
+// The API is implemented twice, picked at build time: rendering_opengl.cpp
+// under RENDER_OPENGL, and rendering_software.cpp, a CPU rasterizer for
+// machines with no GPU, under RENDER_SOFTWARE.
+#if !defined(RENDER_OPENGL) && !defined(RENDER_SOFTWARE)
+#error "Define RENDER_OPENGL or RENDER_SOFTWARE to pick a rendering backend."
+#endif
+
 bool init_rendering(SDL_Window *window, bool vsync);
 void swap_buffers();
 
@@ -58,9 +65,98 @@ Framebuffer *make_framebuffer(int width, int height);
 void release_framebuffer(Framebuffer *framebuffer);
 void blit_framebuffer_to_back_buffer_with_letter_boxing(Framebuffer *framebuffer);
 void set_framebuffer(Framebuffer *framebuffer);
+
+// Copies the framebuffer out as RGBA8, sRGB encoded, bottom row first;
+// rgba needs room for width * height * 4 bytes.
+void read_framebuffer(Framebuffer *framebuffer, u8 *rgba);
 #endif
 void clear_framebuffer(float r, float g, float b, float a);
 
+// What the backend has been asked to draw since the counters were last
+// cleared (once a frame, by main_loop).
+struct Render_Stats {
+    s64 num_vertices = 0;
+    s64 num_draw_calls = 0;
+    s64 num_state_changes = 0;  // Made by flush_render_queue.
+    s64 num_flushes = 0;        // Immediate batches streamed to the GPU.
+    s64 num_bytes_uploaded = 0; // Streamed plus vertex buffer updates.
+
+    // Filled by draw_world; culled ones were off screen and never submitted.
+    s64 num_entities_drawn = 0;
+    s64 num_entities_culled = 0;
+    s64 num_particles_drawn = 0;
+    s64 num_particles_culled = 0;
+};
+
+extern Render_Stats render_stats;
+
+// 16 bytes: the color as unorm8x4 and the uv as snorm16x2, both scaled back
+// to floats by the vertex fetch. Signed so the circle quads' -1..1 fits; for
+// texture coordinates that still leaves steps of 1/32767.
+struct Immediate_Vertex {
+    Vector2 position;
+    u8 color[4];
+    s16 uv[2];
+};
+
+inline u8 pack_unorm8(float f) {
+    if (!(f > 0.0f)) return 0;
+    if (f >= 1.0f)   return 255;
+    return (u8)(f * 255.0f + 0.5f);
+}
+
+inline s16 pack_snorm16(float f) {
+    if (f <= -1.0f) return -32767;
+    if (f >=  1.0f) return  32767;
+    return (s16)(f * 32767.0f + (f < 0.0f ? -0.5f : 0.5f));
+}
+
+inline Immediate_Vertex make_immediate_vertex(Vector2 position, Vector4 color, Vector2 uv) {
+    Immediate_Vertex v;
+    v.position = position;
+    v.color[0] = pack_unorm8(color.x);
+    v.color[1] = pack_unorm8(color.y);
+    v.color[2] = pack_unorm8(color.z);
+    v.color[3] = pack_unorm8(color.w);
+    v.uv[0]    = pack_snorm16(uv.x);
+    v.uv[1]    = pack_snorm16(uv.y);
+    return v;
+}
+
+inline Vector2 get_vertex_uv(Immediate_Vertex v) {
+    return v2(v.uv[0] / 32767.0f, v.uv[1] / 32767.0f);
+}
+
+// Immediate geometry goes out in draw calls of at most this many vertices;
+// in practice batches end at the next state change long before that.
+const int MAX_IMMEDIATE_VERTICES = 16384;
+
+// The quad immediate_circle draws: the circle's bounding square as two
+// triangles, uv -1..1 across it. globals.shader_circle keeps the pixels
+// with length(uv) <= 1.
+inline void get_circle_quad_vertices(Vector2 center, float radius, Vector4 color, Immediate_Vertex v[6]) {
+    Vector2 p0 = v2(center.x - radius, center.y - radius);
+    Vector2 p1 = v2(center.x + radius, center.y - radius);
+    Vector2 p2 = v2(center.x + radius, center.y + radius);
+    Vector2 p3 = v2(center.x - radius, center.y + radius);
+
+    v[0] = make_immediate_vertex(p0, color, v2(-1, -1));
+    v[1] = make_immediate_vertex(p1, color, v2(+1, -1));
+    v[2] = make_immediate_vertex(p2, color, v2(+1, +1));
+    v[3] = v[0];
+    v[4] = v[2];
+    v[5] = make_immediate_vertex(p3, color, v2(-1, +1));
+}
+
+// Vertices uploaded once and drawn as often as needed, for geometry that
+// rarely changes. Drawn with the current shader and transform, after
+// flushing whatever immediate geometry came before.
+struct Vertex_Buffer;
+Vertex_Buffer *make_vertex_buffer();
+void release_vertex_buffer(Vertex_Buffer *buffer);
+void update_vertex_buffer(Vertex_Buffer *buffer, Immediate_Vertex *vertices, int num_vertices);
+void draw_vertex_buffer(Vertex_Buffer *buffer);
+
 void immediate_begin();
 void immediate_flush();
 void immediate_quad(Vector2 p0, Vector2 p1, Vector2 p2, Vector2 p3, Vector2 uv0, Vector2 uv1, Vector2 uv2, Vector2 uv3, Vector4 color);
@@ -68,6 +164,9 @@ void immediate_quad(Vector2 p0, Vector2 p1, Vector2 p2, Vector2 p3, Vector4 colo
 void immediate_quad(float x, float y, float w, float h, Vector4 color);
 void immediate_quad(Vector2 position, Vector2 size, Vector4 color);
 void immediate_triangle(Vector2 p0, Vector2 p1, Vector2 p2, Vector4 color);
+
+// Batched apart from the rest until something else gets drawn, so a run of
+// circles is a single draw call however long it is.
 void immediate_circle(Vector2 center, float radius, Vector4 color);
 
 struct Shader;
@@ -81,6 +180,3 @@ void refresh_transform();
 void rendering_2d(int width, int height);
 void rendering_2d(int width, int height, Matrix4 world_to_view_matrix);
 void rendering_2d(int width, int height, float y_offset);
-
-struct Dynamic_Font;
-void draw_text(Dynamic_Font *font, char *text, int x, int y, Vector4 color);
@@ -2,6 +2,8 @@
 
 #include "rendering.h"
 
+#ifdef RENDER_OPENGL
+
 #ifdef __EMSCRIPTEN__
 #include <GLES3/gl3.h>
 #include <emscripten.h>
@@ -40,20 +42,52 @@ struct Shader {
     GLint object_to_world_matrix_loc;
 };
 
-struct Immediate_Vertex {
-    Vector2 position;
-    Vector4 color;
-    Vector2 uv;
+struct Vertex_Buffer {
+    GLuint id;
+    GLuint vao;
+    int num_vertices;
+    int capacity;
 };
 
 static SDL_Window *window;
 static Shader *current_shader;
 
-const int MAX_IMMEDIATE_VERTICES = 2400;
 static Immediate_Vertex immediate_vertices[MAX_IMMEDIATE_VERTICES];
 static int num_immediate_vertices;
 
-static GLuint immediate_vbo;
+// Circles are batched apart from the other immediate geometry, since they
+// need their own shader: a quad each, uv running -1..1 across it, with the
+// edge cut out per pixel. The batch grows so a frame's worth of them goes
+// out in one draw call.
+static Array <Immediate_Vertex> circle_vertices;
+
+// Every immediate batch is appended to one big ring of a vertex buffer (see
+// stream_vertices), bound to stream_vao for good.
+const s64 INITIAL_STREAM_BUFFER_SIZE = 4 * 1024 * 1024;
+
+static GLuint stream_vbo;
+static GLuint stream_vao;
+static s64 stream_buffer_size;
+static s64 stream_buffer_offset;
+
+// The attribute layout is recorded once per vertex array object: one for the
+// stream buffer, one per Vertex_Buffer. Drawing only binds the right one.
+static void set_immediate_vertex_format() {
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Immediate_Vertex), (void *)offsetof(Immediate_Vertex, position));
+    glEnableVertexAttribArray(0);
+
+    glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Immediate_Vertex), (void *)offsetof(Immediate_Vertex, color));
+    glEnableVertexAttribArray(1);
+
+    glVertexAttribPointer(2, 2, GL_SHORT, GL_TRUE, sizeof(Immediate_Vertex), (void *)offsetof(Immediate_Vertex, uv));
+    glEnableVertexAttribArray(2);
+}
+
+static void set_stream_buffer_size(s64 size) {
+    glBufferData(GL_ARRAY_BUFFER, size, NULL, GL_STREAM_DRAW);
+    stream_buffer_size   = size;
+    stream_buffer_offset = 0;
+}
 
 bool init_rendering(SDL_Window *_window, bool vsync) {
     window = _window;
@@ -66,21 +100,21 @@ bool init_rendering(SDL_Window *_window, bool vsync) {
         logprintf("vsync: off\n");
     }
 
-    GLuint vao;
-    glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
-
 #ifndef __EMSCRIPTEN__
     glEnable(GL_FRAMEBUFFER_SRGB);
     glDisable(GL_MULTISAMPLE);
 #endif
 
-    glGenBuffers(1, &immediate_vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, immediate_vbo);
-    glBufferData(GL_ARRAY_BUFFER, MAX_IMMEDIATE_VERTICES * sizeof(Immediate_Vertex), NULL, GL_DYNAMIC_DRAW);
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glGenVertexArrays(1, &stream_vao);
+    glBindVertexArray(stream_vao);
+
+    glGenBuffers(1, &stream_vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, stream_vbo);
+    set_stream_buffer_size(INITIAL_STREAM_BUFFER_SIZE);
+    set_immediate_vertex_format();
 
     num_immediate_vertices = 0;
+    circle_vertices.reserve(6 * 1024);
 
     globals.object_to_world_matrix = matrix4_identity();
     globals.view_to_proj_matrix    = matrix4_identity();
@@ -298,6 +332,17 @@ void set_framebuffer(Framebuffer *framebuffer) {
     glBindFramebuffer(GL_FRAMEBUFFER, framebuffer->fbo_id);
 }
 
+void read_framebuffer(Framebuffer *framebuffer, u8 *rgba) {
+    GLint previous = 0;
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previous);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer->fbo_id);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, framebuffer->width, framebuffer->height, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, previous);
+}
+
 #endif
 
 void clear_framebuffer(float r, float g, float b, float a) {
@@ -316,57 +361,152 @@ void immediate_begin() {
     immediate_flush();
 }
 
-static void enable_immediate_vertex_format() {
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Immediate_Vertex), (void *)offsetof(Immediate_Vertex, position));
-    glEnableVertexAttribArray(0);
+// Appends the vertices to the stream buffer and returns the index of the
+// first one. Writes never touch a range the GPU may still be reading: the
+// offset only moves forward, and when it would run off the end the buffer is
+// orphaned, which hands the old storage to the driver to free once the GPU
+// is done with it. So the mapping needs no synchronization and no fences.
+static int stream_vertices(Immediate_Vertex *vertices, int num_vertices) {
+    s64 size = num_vertices * sizeof(Immediate_Vertex);
 
-    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Immediate_Vertex), (void *)offsetof(Immediate_Vertex, color));
-    glEnableVertexAttribArray(1);
+    glBindBuffer(GL_ARRAY_BUFFER, stream_vbo);
 
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Immediate_Vertex), (void *)offsetof(Immediate_Vertex, uv));
-    glEnableVertexAttribArray(2);
+    if (size > stream_buffer_size) {
+        s64 new_size = stream_buffer_size;
+        while (new_size < size) new_size *= 2;
+        set_stream_buffer_size(new_size);
+    } else if (stream_buffer_offset + size > stream_buffer_size) {
+        set_stream_buffer_size(stream_buffer_size);
+    }
+
+#ifdef __EMSCRIPTEN__
+    // WebGL has no buffer mapping.
+    glBufferSubData(GL_ARRAY_BUFFER, stream_buffer_offset, size, vertices);
+#else
+    GLbitfield access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+    void *dest = glMapBufferRange(GL_ARRAY_BUFFER, stream_buffer_offset, size, access);
+    if (dest) {
+        memcpy(dest, vertices, size);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    } else {
+        glBufferSubData(GL_ARRAY_BUFFER, stream_buffer_offset, size, vertices);
+    }
+#endif
+
+    int first = (int)(stream_buffer_offset / sizeof(Immediate_Vertex));
+    stream_buffer_offset += size;
+
+    render_stats.num_flushes++;
+    render_stats.num_bytes_uploaded += size;
+    
+    return first;
 }
 
-static void disable_immediate_vertex_format() {
-    glDisableVertexAttribArray(2);
-    glDisableVertexAttribArray(1);
-    glDisableVertexAttribArray(0);
+static void draw_stream_vertices(Immediate_Vertex *vertices, int num_vertices) {
+    int first = stream_vertices(vertices, num_vertices);
+
+    glDrawArrays(GL_TRIANGLES, first, num_vertices);
+    render_stats.num_vertices += num_vertices;
+    render_stats.num_draw_calls++;
 }
 
-void immediate_flush() {
-    if (!num_immediate_vertices) return;
+static void flush_circles() {
+    if (!circle_vertices.count) return;
 
-    glBindBuffer(GL_ARRAY_BUFFER, immediate_vbo);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, num_immediate_vertices * sizeof(Immediate_Vertex), immediate_vertices);
+    Shader *previous_shader = current_shader;
+    set_shader(globals.shader_circle);
+    
+    draw_stream_vertices(circle_vertices.data, circle_vertices.count);
+
+    set_shader(previous_shader);
 
-    enable_immediate_vertex_format();
+    circle_vertices.count = 0;
+}
 
-    glDrawArrays(GL_TRIANGLES, 0, num_immediate_vertices);
+static void flush_immediate_vertices() {
+    if (!num_immediate_vertices) return;
 
-    disable_immediate_vertex_format();
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    draw_stream_vertices(immediate_vertices, num_immediate_vertices);
     
     num_immediate_vertices = 0;
 }
 
-static void put_vertex(Immediate_Vertex *v, Vector2 position, Vector4 color, Vector2 uv) {
-    v->position = position;
-    v->color    = color;
-    v->uv       = uv;
+// Only one of the two batches is ever pending: adding to one flushes the
+// other, so everything still lands in the order it was submitted.
+void immediate_flush() {
+    if (!circle_vertices.count && !num_immediate_vertices) return;
+
+    profile_zone("immediate_flush");
+    flush_circles();
+    flush_immediate_vertices();
+}
+
+Vertex_Buffer *make_vertex_buffer() {
+    Vertex_Buffer *buffer = (Vertex_Buffer *)malloc(sizeof(Vertex_Buffer));
+    glGenBuffers(1, &buffer->id);
+    buffer->num_vertices = 0;
+    buffer->capacity     = 0;
+
+    glGenVertexArrays(1, &buffer->vao);
+    glBindVertexArray(buffer->vao);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer->id);
+    set_immediate_vertex_format();
+    glBindVertexArray(stream_vao);
+    
+    return buffer;
+}
+
+void release_vertex_buffer(Vertex_Buffer *buffer) {
+    if (buffer->vao) {
+        glDeleteVertexArrays(1, &buffer->vao);
+        buffer->vao = 0;
+    }
+    if (buffer->id) {
+        glDeleteBuffers(1, &buffer->id);
+        buffer->id = 0;
+    }
+    free(buffer);
+}
+
+void update_vertex_buffer(Vertex_Buffer *buffer, Immediate_Vertex *vertices, int num_vertices) {
+    glBindBuffer(GL_ARRAY_BUFFER, buffer->id);
+    if (num_vertices > buffer->capacity) {
+        glBufferData(GL_ARRAY_BUFFER, num_vertices * sizeof(Immediate_Vertex), vertices, GL_STATIC_DRAW);
+        buffer->capacity = num_vertices;
+    } else if (num_vertices) {
+        glBufferSubData(GL_ARRAY_BUFFER, 0, num_vertices * sizeof(Immediate_Vertex), vertices);
+    }
+
+    buffer->num_vertices = num_vertices;
+    render_stats.num_bytes_uploaded += num_vertices * sizeof(Immediate_Vertex);
+}
+
+void draw_vertex_buffer(Vertex_Buffer *buffer) {
+    if (!buffer->num_vertices) return;
+
+    immediate_flush();
+
+    glBindVertexArray(buffer->vao);
+    glDrawArrays(GL_TRIANGLES, 0, buffer->num_vertices);
+    glBindVertexArray(stream_vao);
+    
+    render_stats.num_vertices += buffer->num_vertices;
+    render_stats.num_draw_calls++;
 }
 
 void immediate_quad(Vector2 p0, Vector2 p1, Vector2 p2, Vector2 p3, Vector2 uv0, Vector2 uv1, Vector2 uv2, Vector2 uv3, Vector4 color) {
-    if (num_immediate_vertices + 6 > MAX_IMMEDIATE_VERTICES) immediate_flush();
+    flush_circles();
+    if (num_immediate_vertices + 6 > MAX_IMMEDIATE_VERTICES) flush_immediate_vertices();
 
     auto v = immediate_vertices + num_immediate_vertices;
 
-    put_vertex(&v[0], p0, color, uv0);
-    put_vertex(&v[1], p1, color, uv1);
-    put_vertex(&v[2], p2, color, uv2);
+    v[0] = make_immediate_vertex(p0, color, uv0);
+    v[1] = make_immediate_vertex(p1, color, uv1);
+    v[2] = make_immediate_vertex(p2, color, uv2);
     
-    put_vertex(&v[3], p0, color, uv0);
-    put_vertex(&v[4], p2, color, uv2);
-    put_vertex(&v[5], p3, color, uv3);
+    v[3] = v[0];
+    v[4] = v[2];
+    v[5] = make_immediate_vertex(p3, color, uv3);
     
     num_immediate_vertices += 6;
 }
@@ -394,36 +534,29 @@ void immediate_quad(Vector2 position, Vector2 size, Vector4 color) {
 }
 
 void immediate_triangle(Vector2 p0, Vector2 p1, Vector2 p2, Vector4 color) {
-    if (num_immediate_vertices + 6 > MAX_IMMEDIATE_VERTICES) immediate_flush();
+    flush_circles();
+    if (num_immediate_vertices + 3 > MAX_IMMEDIATE_VERTICES) flush_immediate_vertices();
 
     auto v = immediate_vertices + num_immediate_vertices;
 
     Vector2 uv = v2(0, 0);
     
-    put_vertex(&v[0], p0, color, uv);
-    put_vertex(&v[1], p1, color, uv);
-    put_vertex(&v[2], p2, color, uv);
+    v[0] = make_immediate_vertex(p0, color, uv);
+    v[1] = make_immediate_vertex(p1, color, uv);
+    v[2] = make_immediate_vertex(p2, color, uv);
 
     num_immediate_vertices += 3;
 }
 
 void immediate_circle(Vector2 center, float radius, Vector4 color) {
-    const int NUM_TRIANGLES = 100;
-    float dtheta = TAU / (float)NUM_TRIANGLES;
-
-    for (int i = 0; i < NUM_TRIANGLES; i++) {
-        float theta0 = i * dtheta;
-        float theta1 = (i+1) * dtheta;
+    flush_immediate_vertices();
 
-        Vector2 v0 = get_vec2(theta0);
-        Vector2 v1 = get_vec2(theta1);
-
-        Vector2 p0 = center;
-        Vector2 p1 = center + radius * v0;
-        Vector2 p2 = center + radius * v1;
-
-        immediate_triangle(p0, p1, p2, color);
+    if (circle_vertices.count + 6 > circle_vertices.allocated) {
+        circle_vertices.reserve(circle_vertices.allocated * 2);
     }
+    Immediate_Vertex *v = circle_vertices.data + circle_vertices.count;
+    get_circle_quad_vertices(center, radius, color, v);
+    circle_vertices.count += 6;
 }
 
 Shader *make_shader() {
@@ -555,3 +688,5 @@ void refresh_transform() {
         set_matrix4(current_shader->object_to_world_matrix_loc, globals.object_to_world_matrix);
     }
 }
+
+#endif
@@ -0,0 +1,692 @@
+#include "main.h"
+
+#include "rendering.h"
+
+// The rendering.h API drawn by the CPU into plain RGBA buffers, for machines
+// with no GPU: CI, servers, golden image checks. It does what the OpenGL
+// backend asks of the GPU closely enough that the two produce matching
+// frames: an sRGB framebuffer blended in linear space, pixel-center sampling
+// with a top-left fill rule on a 1/256 pixel grid, nearest/repeat and
+// linear/clamp texture filtering, and each of the game's shaders written out
+// by hand. Geometry is rasterized when a batch would go to the GPU, with the
+// state current at that point, the same as a draw call.
+
+#ifdef RENDER_SOFTWARE
+
+enum Shader_Kind {
+    SHADER_KIND_COLOR,
+    SHADER_KIND_CIRCLE,
+    SHADER_KIND_TEXTURE,
+    SHADER_KIND_TEXT,
+};
+
+struct Texture {
+    int width;
+    int height;
+
+    Texture_Format format;
+    int bytes_per_pixel;
+
+    // Filtering belongs to the texture, as it does in GL: whatever
+    // set_texture last asked for.
+    bool point_sample;
+
+    u8 *data; // Bottom row first.
+};
+
+struct Framebuffer {
+    int width;
+    int height;
+
+    u8 *pixels; // RGBA8, sRGB encoded, bottom row first.
+};
+
+struct Shader {
+    Shader_Kind kind;
+
+    // The uniform, as of the last refresh_transform with this shader bound.
+    Matrix4 object_to_proj_matrix;
+};
+
+struct Vertex_Buffer {
+    Array <Immediate_Vertex> vertices;
+};
+
+const int MAX_TEXTURE_SLOTS = 8;
+
+static SDL_Window *window;
+static Shader *current_shader;
+
+// Stands in for the window's back buffer; swap_buffers copies it out.
+static Framebuffer back_buffer;
+static Framebuffer *current_framebuffer = &back_buffer;
+
+static Texture *bound_textures[MAX_TEXTURE_SLOTS];
+static Blend_Mode current_blend_mode = BLEND_MODE_OFF;
+static Cull_Mode current_cull_mode = CULL_MODE_OFF;
+static Rectangle2i viewport;
+
+static Immediate_Vertex immediate_vertices[MAX_IMMEDIATE_VERTICES];
+static int num_immediate_vertices;
+
+// Batched apart like in the GL backend, so the draw call counts match.
+static Array <Immediate_Vertex> circle_vertices;
+
+// Framebuffer values are sRGB encoded; blending happens on linear values.
+// Encoding goes through a table fine enough that it rounds the same as the
+// exact curve nearly everywhere.
+const int LINEAR_TO_SRGB_TABLE_SIZE = 1 << 14;
+
+static float srgb_to_linear_table[256];
+static u8 linear_to_srgb_table[LINEAR_TO_SRGB_TABLE_SIZE];
+
+static float srgb_to_linear_exact(float c) {
+    if (c <= 0.04045f) return c / 12.92f;
+    return powf((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static float linear_to_srgb_exact(float c) {
+    if (c <= 0.0031308f) return c * 12.92f;
+    return 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+}
+
+static void init_srgb_tables() {
+    for (int i = 0; i < 256; i++) {
+        srgb_to_linear_table[i] = srgb_to_linear_exact(i / 255.0f);
+    }
+    for (int i = 0; i < LINEAR_TO_SRGB_TABLE_SIZE; i++) {
+        linear_to_srgb_table[i] = pack_unorm8(linear_to_srgb_exact(i / (float)(LINEAR_TO_SRGB_TABLE_SIZE - 1)));
+    }
+}
+
+static u8 encode_srgb(float linear) {
+    if (!(linear > 0.0f)) return 0;
+    if (linear >= 1.0f)   return 255;
+    return linear_to_srgb_table[(int)(linear * (LINEAR_TO_SRGB_TABLE_SIZE - 1) + 0.5f)];
+}
+
+static void resize_framebuffer(Framebuffer *framebuffer, int width, int height) {
+    if (framebuffer->width == width && framebuffer->height == height && framebuffer->pixels) return;
+
+    if (framebuffer->pixels) free(framebuffer->pixels);
+    framebuffer->width  = width;
+    framebuffer->height = height;
+    framebuffer->pixels = (u8 *)calloc((size_t)Max(width * height, 1), 4);
+}
+
+bool init_rendering(SDL_Window *_window, bool vsync) {
+    window = _window;
+
+    // Frames are presented by copying; there is nothing to sync to.
+    logprintf("Software renderer, vsync: off\n");
+
+    init_srgb_tables();
+
+    int width = 0, height = 0;
+    if (window) SDL_GetWindowSize(window, &width, &height);
+    resize_framebuffer(&back_buffer, width, height);
+    current_framebuffer = &back_buffer;
+    viewport = {0, 0, width, height};
+
+    num_immediate_vertices = 0;
+    circle_vertices.reserve(6 * 1024);
+
+    globals.object_to_world_matrix = matrix4_identity();
+    globals.view_to_proj_matrix    = matrix4_identity();
+    globals.world_to_view_matrix   = matrix4_identity();
+    globals.object_to_world_matrix = matrix4_identity();
+
+    return true;
+}
+
+void swap_buffers() {
+    if (!window) return;
+
+    SDL_Surface *surface = SDL_GetWindowSurface(window);
+    if (!surface) return;
+
+    int width  = Min(surface->w, back_buffer.width);
+    int height = Min(surface->h, back_buffer.height);
+
+    if (SDL_MUSTLOCK(surface)) SDL_LockSurface(surface);
+    for (int y = 0; y < height; y++) {
+        u8 *source = back_buffer.pixels + (s64)(back_buffer.height - 1 - y) * back_buffer.width * 4;
+        u8 *dest   = (u8 *)surface->pixels + (s64)y * surface->pitch;
+        SDL_ConvertPixels(width, 1, SDL_PIXELFORMAT_RGBA32, source, back_buffer.width * 4, surface->format->format, dest, surface->pitch);
+    }
+    if (SDL_MUSTLOCK(surface)) SDL_UnlockSurface(surface);
+
+    SDL_UpdateWindowSurface(window);
+}
+
+void set_viewport(int x, int y, int width, int height) {
+    viewport = {x, y, width, height};
+}
+
+void set_blend_mode(Blend_Mode blend_mode) {
+    assert(blend_mode == BLEND_MODE_OFF || blend_mode == BLEND_MODE_ALPHA);
+    current_blend_mode = blend_mode;
+}
+
+void set_cull_mode(Cull_Mode cull_mode) {
+    current_cull_mode = cull_mode;
+}
+
+// Everything is drawn at z = 0 and nothing reads depth back, so with
+// LEQUAL every fragment passes: there is no depth buffer.
+void set_depth_test_mode(Depth_Test_Mode depth_test_mode) {
+}
+
+Texture *make_texture() {
+    return (Texture *)malloc(sizeof(Texture));
+}
+
+void release_texture(Texture *texture) {
+    if (texture->data) {
+        free(texture->data);
+        texture->data = NULL;
+    }
+}
+
+void load_texture_from_data(Texture *texture, int width, int height, Texture_Format format, u8 *data) {
+    texture->width  = width;
+    texture->height = height;
+
+    texture->format          = format;
+    texture->bytes_per_pixel = get_bpp(format);
+    texture->point_sample    = false;
+
+    s64 size = (s64)width * height * texture->bytes_per_pixel;
+    texture->data = (u8 *)calloc((size_t)Max(size, 1), 1);
+    if (data) memcpy(texture->data, data, size);
+}
+
+void update_texture(Texture *texture, int x, int y, int width, int height, u8 *data) {
+    int bpp = texture->bytes_per_pixel;
+    for (int row = 0; row < height; row++) {
+        u8 *dest = texture->data + ((s64)(y + row) * texture->width + x) * bpp;
+        memcpy(dest, data + (s64)row * width * bpp, width * bpp);
+    }
+}
+
+void set_texture(int slot, Texture *texture, bool point_sample) {
+    assert(slot >= 0 && slot < MAX_TEXTURE_SLOTS);
+    bound_textures[slot] = texture;
+    texture->point_sample = point_sample;
+}
+
+Framebuffer *make_framebuffer(int width, int height) {
+    Framebuffer *framebuffer = (Framebuffer *)malloc(sizeof(*framebuffer));
+    framebuffer->pixels = NULL;
+    resize_framebuffer(framebuffer, width, height);
+    return framebuffer;
+}
+
+void release_framebuffer(Framebuffer *framebuffer) {
+    if (current_framebuffer == framebuffer) current_framebuffer = &back_buffer;
+
+    if (framebuffer->pixels) {
+        free(framebuffer->pixels);
+        framebuffer->pixels = NULL;
+    }
+}
+
+void blit_framebuffer_to_back_buffer_with_letter_boxing(Framebuffer *framebuffer) {
+    assert(framebuffer);
+
+    resize_framebuffer(&back_buffer, globals.window_width, globals.window_height);
+    memset(back_buffer.pixels, 0, (s64)back_buffer.width * back_buffer.height * 4);
+
+    int dx0 = (back_buffer.width  - framebuffer->width)  / 2;
+    int dy0 = (back_buffer.height - framebuffer->height) / 2;
+
+    int x0 = Max(dx0, 0);
+    int x1 = Min(dx0 + framebuffer->width, back_buffer.width);
+    if (x1 <= x0) return;
+
+    for (int y = Max(dy0, 0); y < Min(dy0 + framebuffer->height, back_buffer.height); y++) {
+        u8 *source = framebuffer->pixels + ((s64)(y - dy0) * framebuffer->width + (x0 - dx0)) * 4;
+        u8 *dest   = back_buffer.pixels  + ((s64)y * back_buffer.width + x0) * 4;
+        memcpy(dest, source, (x1 - x0) * 4);
+    }
+}
+
+void set_framebuffer(Framebuffer *framebuffer) {
+    current_framebuffer = framebuffer;
+}
+
+void read_framebuffer(Framebuffer *framebuffer, u8 *rgba) {
+    memcpy(rgba, framebuffer->pixels, (s64)framebuffer->width * framebuffer->height * 4);
+}
+
+void clear_framebuffer(float r, float g, float b, float a) {
+    u8 color[4] = { encode_srgb(r), encode_srgb(g), encode_srgb(b), pack_unorm8(a) };
+
+    Framebuffer *target = current_framebuffer;
+    s64 num_pixels = (s64)target->width * target->height;
+    for (s64 i = 0; i < num_pixels; i++) {
+        memcpy(target->pixels + i * 4, color, 4);
+    }
+}
+
+//
+// Rasterization.
+//
+
+const int SUBPIXEL_BITS  = 8;
+const s64 SUBPIXEL_STEPS = 1 << SUBPIXEL_BITS;
+
+// Window positions past this many pixels would overflow the edge functions;
+// triangles reaching that far are dropped rather than clipped.
+const float MAX_WINDOW_COORDINATE = (float)(1 << 22);
+
+struct Raster_Vertex {
+    s64 x, y; // Window position in 1/SUBPIXEL_STEPS of a pixel, y up.
+    Vector4 color;
+    Vector2 uv;
+};
+
+static bool to_raster_vertex(Immediate_Vertex *v, Matrix4 *m, Raster_Vertex *result) {
+    float x = v->position.x;
+    float y = v->position.y;
+
+    float clip_x = m->_11 * x + m->_12 * y + m->_14;
+    float clip_y = m->_21 * x + m->_22 * y + m->_24;
+    float clip_w = m->_41 * x + m->_42 * y + m->_44;
+    if (!(clip_w > 0.0f)) return false;
+
+    float window_x = viewport.x + (clip_x / clip_w * 0.5f + 0.5f) * viewport.width;
+    float window_y = viewport.y + (clip_y / clip_w * 0.5f + 0.5f) * viewport.height;
+    if (!(fabsf(window_x) < MAX_WINDOW_COORDINATE && fabsf(window_y) < MAX_WINDOW_COORDINATE)) return false;
+
+    result->x = (s64)floorf(window_x * SUBPIXEL_STEPS + 0.5f);
+    result->y = (s64)floorf(window_y * SUBPIXEL_STEPS + 0.5f);
+
+    result->color = v4(v->color[0] / 255.0f, v->color[1] / 255.0f, v->color[2] / 255.0f, v->color[3] / 255.0f);
+    result->uv    = get_vertex_uv(*v);
+    return true;
+}
+
+static s64 edge_function(Raster_Vertex *a, Raster_Vertex *b, s64 px, s64 py) {
+    return (b->x - a->x) * (py - a->y) - (b->y - a->y) * (px - a->x);
+}
+
+// With y up and the triangle counter-clockwise, the inside is left of every
+// edge. A pixel center exactly on an edge belongs to the triangle only if
+// that edge is a top or a left one, so two triangles sharing an edge never
+// both draw (and blend) the pixels along it.
+static bool is_top_left_edge(Raster_Vertex *a, Raster_Vertex *b) {
+    s64 dx = b->x - a->x;
+    s64 dy = b->y - a->y;
+    return dy < 0 || (dy == 0 && dx < 0);
+}
+
+static Vector4 fetch_texel(Texture *texture, int x, int y) {
+    u8 *texel = texture->data + ((s64)y * texture->width + x) * texture->bytes_per_pixel;
+
+    if (texture->format == TEXTURE_FORMAT_R8) return v4(texel[0] / 255.0f, 0, 0, 1);
+
+    return v4(srgb_to_linear_table[texel[0]], srgb_to_linear_table[texel[1]], srgb_to_linear_table[texel[2]], texel[3] / 255.0f);
+}
+
+static int wrap_texel(int i, int n) {
+    i %= n;
+    return i < 0 ? i + n : i;
+}
+
+static Vector4 sample_texture(Texture *texture, Vector2 uv) {
+    if (!texture || !texture->data) return v4(0, 0, 0, 1);
+
+    int w = texture->width;
+    int h = texture->height;
+
+    if (texture->point_sample) {
+        int x = wrap_texel(floor_float32_to_s32(uv.x * w), w);
+        int y = wrap_texel(floor_float32_to_s32(uv.y * h), h);
+        return fetch_texel(texture, x, y);
+    }
+
+    float fx = uv.x * w - 0.5f;
+    float fy = uv.y * h - 0.5f;
+    int x0 = floor_float32_to_s32(fx);
+    int y0 = floor_float32_to_s32(fy);
+    float tx = fx - x0;
+    float ty = fy - y0;
+
+    int x1 = Min(Max(x0 + 1, 0), w - 1);
+    int y1 = Min(Max(y0 + 1, 0), h - 1);
+    x0 = Min(Max(x0, 0), w - 1);
+    y0 = Min(Max(y0, 0), h - 1);
+
+    Vector4 bottom = lerp(fetch_texel(texture, x0, y0), fetch_texel(texture, x1, y0), tx);
+    Vector4 top    = lerp(fetch_texel(texture, x0, y1), fetch_texel(texture, x1, y1), tx);
+    return lerp(bottom, top, ty);
+}
+
+// The fragment shaders from init_shaders. Returns false to discard.
+static bool shade_pixel(Shader_Kind kind, Vector4 color, Vector2 uv, Vector4 *result) {
+    switch (kind) {
+        case SHADER_KIND_COLOR: {
+            *result = color;
+        } break;
+
+        case SHADER_KIND_CIRCLE: {
+            if (uv.x * uv.x + uv.y * uv.y > 1.0f) return false;
+            *result = color;
+        } break;
+
+        case SHADER_KIND_TEXTURE: {
+            Vector4 t = sample_texture(bound_textures[0], uv);
+            *result = v4(color.x * t.x, color.y * t.y, color.z * t.z, color.w * t.w);
+        } break;
+
+        case SHADER_KIND_TEXT: {
+            Vector4 t = sample_texture(bound_textures[0], uv);
+            *result = v4(color.x, color.y, color.z, color.w * t.x);
+        } break;
+    }
+
+    return true;
+}
+
+static float saturate(float f) {
+    if (!(f > 0.0f)) return 0.0f;
+    if (f > 1.0f) return 1.0f;
+    return f;
+}
+
+static void write_pixel(u8 *dest, Vector4 src) {
+    src.x = saturate(src.x);
+    src.y = saturate(src.y);
+    src.z = saturate(src.z);
+    src.w = saturate(src.w);
+
+    if (current_blend_mode == BLEND_MODE_ALPHA) {
+        float inverse = 1.0f - src.w;
+        src.x = src.x * src.w + srgb_to_linear_table[dest[0]] * inverse;
+        src.y = src.y * src.w + srgb_to_linear_table[dest[1]] * inverse;
+        src.z = src.z * src.w + srgb_to_linear_table[dest[2]] * inverse;
+        src.w = src.w * src.w + (dest[3] / 255.0f) * inverse;
+    }
+
+    dest[0] = encode_srgb(src.x);
+    dest[1] = encode_srgb(src.y);
+    dest[2] = encode_srgb(src.z);
+    dest[3] = pack_unorm8(src.w);
+}
+
+static void rasterize_triangle(Framebuffer *target, Shader_Kind kind, Raster_Vertex *a, Raster_Vertex *b, Raster_Vertex *c) {
+    s64 area = edge_function(a, b, c->x, c->y);
+    if (area == 0) return;
+
+    if (current_cull_mode == CULL_MODE_BACK  && area < 0) return;
+    if (current_cull_mode == CULL_MODE_FRONT && area > 0) return;
+
+    if (area < 0) {
+        Raster_Vertex *swap = b;
+        b = c;
+        c = swap;
+        area = -area;
+    }
+
+    // Pixels whose centers could be inside, within the target and viewport.
+    s64 min_x = Min(a->x, Min(b->x, c->x));
+    s64 min_y = Min(a->y, Min(b->y, c->y));
+    s64 max_x = Max(a->x, Max(b->x, c->x));
+    s64 max_y = Max(a->y, Max(b->y, c->y));
+
+    s64 half = SUBPIXEL_STEPS / 2;
+    int x0 = (int)Max((min_x - half) >> SUBPIXEL_BITS, (s64)Max(viewport.x, 0));
+    int y0 = (int)Max((min_y - half) >> SUBPIXEL_BITS, (s64)Max(viewport.y, 0));
+    int x1 = (int)Min((max_x - half) >> SUBPIXEL_BITS, (s64)Min(viewport.x + viewport.width,  target->width)  - 1);
+    int y1 = (int)Min((max_y - half) >> SUBPIXEL_BITS, (s64)Min(viewport.y + viewport.height, target->height) - 1);
+    if (x0 > x1 || y0 > y1) return;
+
+    // A pixel is in when all three edge functions are positive, or zero on a
+    // top-left edge: testing w + bias > 0 covers both with integers.
+    s64 bias0 = is_top_left_edge(b, c) ? 1 : 0;
+    s64 bias1 = is_top_left_edge(c, a) ? 1 : 0;
+    s64 bias2 = is_top_left_edge(a, b) ? 1 : 0;
+
+    s64 px = ((s64)x0 << SUBPIXEL_BITS) + half;
+    s64 py = ((s64)y0 << SUBPIXEL_BITS) + half;
+
+    s64 row0 = edge_function(b, c, px, py);
+    s64 row1 = edge_function(c, a, px, py);
+    s64 row2 = edge_function(a, b, px, py);
+
+    // Steps per pixel in x and y.
+    s64 step_x0 = -(c->y - b->y) * SUBPIXEL_STEPS, step_y0 = (c->x - b->x) * SUBPIXEL_STEPS;
+    s64 step_x1 = -(a->y - c->y) * SUBPIXEL_STEPS, step_y1 = (a->x - c->x) * SUBPIXEL_STEPS;
+    s64 step_x2 = -(b->y - a->y) * SUBPIXEL_STEPS, step_y2 = (b->x - a->x) * SUBPIXEL_STEPS;
+
+    float inverse_area = 1.0f / (float)area;
+    bool flat_color = memcmp(&a->color, &b->color, sizeof(Vector4)) == 0 && memcmp(&a->color, &c->color, sizeof(Vector4)) == 0;
+    bool needs_uv = kind != SHADER_KIND_COLOR;
+
+    for (int y = y0; y <= y1; y++) {
+        s64 w0 = row0;
+        s64 w1 = row1;
+        s64 w2 = row2;
+
+        u8 *dest = target->pixels + ((s64)y * target->width + x0) * 4;
+
+        for (int x = x0; x <= x1; x++, dest += 4) {
+            if (w0 + bias0 > 0 && w1 + bias1 > 0 && w2 + bias2 > 0) {
+                float l0 = w0 * inverse_area;
+                float l1 = w1 * inverse_area;
+                float l2 = w2 * inverse_area;
+
+                Vector4 color = a->color;
+                if (!flat_color) color = a->color * l0 + b->color * l1 + c->color * l2;
+
+                Vector2 uv = {};
+                if (needs_uv) uv = a->uv * l0 + b->uv * l1 + c->uv * l2;
+
+                Vector4 result;
+                if (shade_pixel(kind, color, uv, &result)) write_pixel(dest, result);
+            }
+
+            w0 += step_x0;
+            w1 += step_x1;
+            w2 += step_x2;
+        }
+
+        row0 += step_y0;
+        row1 += step_y1;
+        row2 += step_y2;
+    }
+}
+
+// What a glDrawArrays(GL_TRIANGLES) would do with the current state.
+static void draw_triangles(Immediate_Vertex *vertices, int num_vertices) {
+    render_stats.num_vertices += num_vertices;
+    render_stats.num_draw_calls++;
+
+    Framebuffer *target = current_framebuffer;
+    if (!current_shader || !target || !target->pixels) return;
+
+    Matrix4 m = current_shader->object_to_proj_matrix;
+    for (int i = 0; i + 3 <= num_vertices; i += 3) {
+        Raster_Vertex v[3];
+        if (!to_raster_vertex(&vertices[i + 0], &m, &v[0])) continue;
+        if (!to_raster_vertex(&vertices[i + 1], &m, &v[1])) continue;
+        if (!to_raster_vertex(&vertices[i + 2], &m, &v[2])) continue;
+
+        rasterize_triangle(target, current_shader->kind, &v[0], &v[1], &v[2]);
+    }
+}
+
+static void draw_stream_vertices(Immediate_Vertex *vertices, int num_vertices) {
+    render_stats.num_flushes++;
+    render_stats.num_bytes_uploaded += num_vertices * sizeof(Immediate_Vertex);
+
+    draw_triangles(vertices, num_vertices);
+}
+
+void immediate_begin() {
+    immediate_flush();
+}
+
+static void flush_circles() {
+    if (!circle_vertices.count) return;
+
+    Shader *previous_shader = current_shader;
+    set_shader(globals.shader_circle);
+
+    draw_stream_vertices(circle_vertices.data, circle_vertices.count);
+
+    set_shader(previous_shader);
+
+    circle_vertices.count = 0;
+}
+
+static void flush_immediate_vertices() {
+    if (!num_immediate_vertices) return;
+
+    draw_stream_vertices(immediate_vertices, num_immediate_vertices);
+
+    num_immediate_vertices = 0;
+}
+
+void immediate_flush() {
+    if (!circle_vertices.count && !num_immediate_vertices) return;
+
+    profile_zone("immediate_flush");
+    flush_circles();
+    flush_immediate_vertices();
+}
+
+Vertex_Buffer *make_vertex_buffer() {
+    return new Vertex_Buffer();
+}
+
+void release_vertex_buffer(Vertex_Buffer *buffer) {
+    delete buffer;
+}
+
+void update_vertex_buffer(Vertex_Buffer *buffer, Immediate_Vertex *vertices, int num_vertices) {
+    buffer->vertices.reserve(num_vertices);
+    if (num_vertices) memcpy(buffer->vertices.data, vertices, num_vertices * sizeof(Immediate_Vertex));
+    buffer->vertices.count = num_vertices;
+
+    render_stats.num_bytes_uploaded += num_vertices * sizeof(Immediate_Vertex);
+}
+
+void draw_vertex_buffer(Vertex_Buffer *buffer) {
+    if (!buffer->vertices.count) return;
+
+    immediate_flush();
+
+    draw_triangles(buffer->vertices.data, buffer->vertices.count);
+}
+
+void immediate_quad(Vector2 p0, Vector2 p1, Vector2 p2, Vector2 p3, Vector2 uv0, Vector2 uv1, Vector2 uv2, Vector2 uv3, Vector4 color) {
+    flush_circles();
+    if (num_immediate_vertices + 6 > MAX_IMMEDIATE_VERTICES) flush_immediate_vertices();
+
+    auto v = immediate_vertices + num_immediate_vertices;
+
+    v[0] = make_immediate_vertex(p0, color, uv0);
+    v[1] = make_immediate_vertex(p1, color, uv1);
+    v[2] = make_immediate_vertex(p2, color, uv2);
+
+    v[3] = v[0];
+    v[4] = v[2];
+    v[5] = make_immediate_vertex(p3, color, uv3);
+
+    num_immediate_vertices += 6;
+}
+
+void immediate_quad(Vector2 p0, Vector2 p1, Vector2 p2, Vector2 p3, Vector4 color) {
+    Vector2 uv0 = v2(0, 0);
+    Vector2 uv1 = v2(1, 0);
+    Vector2 uv2 = v2(1, 1);
+    Vector2 uv3 = v2(0, 1);
+
+    immediate_quad(p0, p1, p2, p3, uv0, uv1, uv2, uv3, color);
+}
+
+void immediate_quad(float x, float y, float w, float h, Vector4 color) {
+    Vector2 p0 = v2(x, y);
+    Vector2 p1 = v2(x + w, y);
+    Vector2 p2 = v2(x + w, y + h);
+    Vector2 p3 = v2(x, y + h);
+
+    immediate_quad(p0, p1, p2, p3, color);
+}
+
+void immediate_quad(Vector2 position, Vector2 size, Vector4 color) {
+    immediate_quad(position.x, position.y, size.x, size.y, color);
+}
+
+void immediate_triangle(Vector2 p0, Vector2 p1, Vector2 p2, Vector4 color) {
+    flush_circles();
+    if (num_immediate_vertices + 3 > MAX_IMMEDIATE_VERTICES) flush_immediate_vertices();
+
+    auto v = immediate_vertices + num_immediate_vertices;
+
+    Vector2 uv = v2(0, 0);
+
+    v[0] = make_immediate_vertex(p0, color, uv);
+    v[1] = make_immediate_vertex(p1, color, uv);
+    v[2] = make_immediate_vertex(p2, color, uv);
+
+    num_immediate_vertices += 3;
+}
+
+void immediate_circle(Vector2 center, float radius, Vector4 color) {
+    flush_immediate_vertices();
+
+    if (circle_vertices.count + 6 > circle_vertices.allocated) {
+        circle_vertices.reserve(circle_vertices.allocated * 2);
+    }
+    Immediate_Vertex *v = circle_vertices.data + circle_vertices.count;
+    get_circle_quad_vertices(center, radius, color, v);
+    circle_vertices.count += 6;
+}
+
+Shader *make_shader() {
+    return (Shader *)malloc(sizeof(Shader));
+}
+
+void release_shader(Shader *shader) {
+}
+
+// There is no GLSL here: the source is ignored and the shader is picked by
+// name from the ones shade_pixel knows.
+bool load_shader(Shader *shader, char *file_data, char *filepath) {
+    if      (strings_match(filepath, "color"))   shader->kind = SHADER_KIND_COLOR;
+    else if (strings_match(filepath, "circle"))  shader->kind = SHADER_KIND_CIRCLE;
+    else if (strings_match(filepath, "texture")) shader->kind = SHADER_KIND_TEXTURE;
+    else if (strings_match(filepath, "text"))    shader->kind = SHADER_KIND_TEXT;
+    else {
+        logprintf("The software renderer has no version of shader '%s'.\n", filepath);
+        return false;
+    }
+
+    shader->object_to_proj_matrix = matrix4_identity();
+    return true;
+}
+
+void set_shader(Shader *shader) {
+    if (current_shader == shader) return;
+
+    current_shader = shader;
+    if (!shader) return;
+
+    refresh_transform();
+}
+
+Shader *get_current_shader() {
+    return current_shader;
+}
+
+void refresh_transform() {
+    globals.object_to_proj_matrix = globals.view_to_proj_matrix * (globals.world_to_view_matrix * globals.object_to_world_matrix);
+    if (current_shader) {
+        current_shader->object_to_proj_matrix = globals.object_to_proj_matrix;
+    }
+}
+
+#endif
@@ -4,6 +4,7 @@
 #include "audio.h"
 
 #include <stdio.h>
+#include <stb_image.h>
 
 static char *texture_directory = "data/textures";
 static char *texture_extension = "png";
@@ -15,14 +16,280 @@ template <typename T>
 struct Resource_Info {
     char *name;
     T *data;
+    bool loading; // Queued on the asset loader and not filled in yet.
 };
 
 static String_Hash_Table <Resource_Info <Texture>> loaded_textures;
 static String_Hash_Table <Resource_Info <Sound>> loaded_sounds;
 
+//
+// The asset loader: one thread that reads and decodes what the
+// find_or_start_loading_* functions queue, so the main thread only has the
+// uploads left to do. Loads go to it and come back on two lists, linked
+// through the loads themselves, so the loader thread allocates nothing but
+// what the assets need, and that it counts on counters of the load's own.
+// Without threads (the web) the main thread does the loads itself, in
+// update_asset_loads, within the same budget.
+//
+
+enum Asset_Load_Type {
+    ASSET_LOAD_TEXTURE,
+    ASSET_LOAD_SOUND,
+};
+
+struct Asset_Load {
+    Asset_Load *next;
+
+    Asset_Load_Type type;
+    char *name;
+    char *filepath;              // When it isn't from the package,
+    Package_Asset_Entry *entry;  // and when it is.
+
+    Texture *texture; // The handle to fill in.
+    Sound *sound;
+
+    // Filled in by the loader.
+    bool succeeded;
+    u8 *pixels; // The package's, or stb_image's.
+    int width;
+    int height;
+    u8 *sound_buffer;
+    u32 sound_length;
+    u64 touched;
+
+    Allocation_Counters allocations;
+};
+
+struct Asset_Load_List {
+    Asset_Load *first;
+    Asset_Load *last;
+};
+
+struct Asset_Loader {
+    bool started;
+    SDL_Thread *thread; // NULL if loads run on the main thread.
+
+    SDL_mutex *mutex; // Guards queued, finished and quit.
+    SDL_sem *work_semaphore;     // Posted for every queued load, and to quit.
+    SDL_sem *finished_semaphore; // Posted for every finished one.
+
+    Asset_Load_List queued;
+    Asset_Load_List finished;
+    bool quit;
+
+    int num_in_flight; // Main thread only.
+};
+
+static Asset_Loader asset_loader;
+
+static void push_asset_load(Asset_Load_List *list, Asset_Load *load) {
+    load->next = NULL;
+    if (list->last) list->last->next = load;
+    else            list->first = load;
+    list->last = load;
+}
+
+static Asset_Load *pop_asset_load(Asset_Load_List *list) {
+    Asset_Load *load = list->first;
+    if (!load) return NULL;
+
+    list->first = load->next;
+    if (!list->first) list->last = NULL;
+    return load;
+}
+
+static void run_asset_load(Asset_Load *load) {
+    profile_zone("run_asset_load");
+
+    current_allocation_counters = &load->allocations;
+    defer { current_allocation_counters = &allocation_counters; };
+
+    if (load->type == ASSET_LOAD_TEXTURE && load->entry) {
+        // Already decoded in the mapped package. Reading a byte of every page
+        // is what actually reads it from disk, here rather than in the upload.
+        load->pixels = load->entry->data;
+        load->width  = load->entry->width;
+        load->height = load->entry->height;
+        for (s64 i = 0; i < load->entry->size; i += 4096) load->touched += load->pixels[i];
+        load->succeeded = true;
+    } else if (load->type == ASSET_LOAD_TEXTURE) {
+        int channels;
+        stbi_set_flip_vertically_on_load_thread(1);
+        load->pixels = stbi_load(load->filepath, &load->width, &load->height, &channels, 4);
+        load->succeeded = load->pixels != NULL;
+        if (!load->succeeded) logprintf("Failed to load image '%s'.\n", load->filepath);
+    } else {
+        SDL_RWops *rw;
+        if (load->entry) rw = SDL_RWFromConstMem(load->entry->data, (int)load->entry->size);
+        else             rw = SDL_RWFromFile(load->filepath, "rb");
+
+        load->succeeded = decode_sound(rw, load->name, &load->sound_buffer, &load->sound_length);
+    }
+}
+
+static int asset_loader_thread_proc(void *data) {
+    set_profile_thread_name("Asset loader");
+
+    for (;;) {
+        SDL_SemWait(asset_loader.work_semaphore);
+
+        SDL_LockMutex(asset_loader.mutex);
+        Asset_Load *load = pop_asset_load(&asset_loader.queued);
+        bool quit = asset_loader.quit;
+        SDL_UnlockMutex(asset_loader.mutex);
+
+        if (!load) {
+            if (quit) break;
+            continue;
+        }
+
+        run_asset_load(load);
+
+        SDL_LockMutex(asset_loader.mutex);
+        push_asset_load(&asset_loader.finished, load);
+        SDL_UnlockMutex(asset_loader.mutex);
+        SDL_SemPost(asset_loader.finished_semaphore);
+    }
+
+    return 0;
+}
+
+static void start_asset_loader() {
+    if (asset_loader.started) return;
+    asset_loader.started = true;
+
+#ifndef __EMSCRIPTEN__
+    asset_loader.mutex              = SDL_CreateMutex();
+    asset_loader.work_semaphore     = SDL_CreateSemaphore(0);
+    asset_loader.finished_semaphore = SDL_CreateSemaphore(0);
+
+    if (asset_loader.mutex && asset_loader.work_semaphore && asset_loader.finished_semaphore) {
+        asset_loader.thread = SDL_CreateThread(asset_loader_thread_proc, "Asset loader", NULL);
+    }
+
+    if (!asset_loader.thread) {
+        logprintf("Failed to start the asset loader thread, loading on the main thread instead: %s\n", SDL_GetError());
+    }
+#endif
+}
+
+static Asset_Load *make_asset_load(Asset_Load_Type type, char *name) {
+    Asset_Load *load = new Asset_Load();
+    load->type = type;
+    load->name = copy_string(name);
+    return load;
+}
+
+static void queue_asset_load(Asset_Load *load) {
+    start_asset_loader();
+    asset_loader.num_in_flight++;
+
+    if (!asset_loader.thread) {
+        push_asset_load(&asset_loader.queued, load);
+        return;
+    }
+
+    SDL_LockMutex(asset_loader.mutex);
+    push_asset_load(&asset_loader.queued, load);
+    SDL_UnlockMutex(asset_loader.mutex);
+    SDL_SemPost(asset_loader.work_semaphore);
+}
+
+// The next load that is done, if any; without a loader thread, the next
+// queued one, done now.
+static Asset_Load *take_finished_asset_load() {
+    if (!asset_loader.thread) {
+        Asset_Load *load = pop_asset_load(&asset_loader.queued);
+        if (load) run_asset_load(load);
+        return load;
+    }
+
+    SDL_LockMutex(asset_loader.mutex);
+    Asset_Load *load = pop_asset_load(&asset_loader.finished);
+    SDL_UnlockMutex(asset_loader.mutex);
+    return load;
+}
+
+static void finish_asset_load(Asset_Load *load) {
+    add_allocation_counters(&load->allocations);
+
+    if (load->type == ASSET_LOAD_TEXTURE) {
+        if (load->succeeded) {
+            release_texture(load->texture);
+            load_texture_from_data(load->texture, load->width, load->height, TEXTURE_FORMAT_RGBA8, load->pixels);
+            if (!load->entry) stbi_image_free(load->pixels);
+        }
+
+        auto info = loaded_textures.find(load->name);
+        if (info) info->loading = false;
+    } else {
+        if (load->succeeded) set_sound_data(load->sound, load->sound_buffer, load->sound_length);
+
+        auto info = loaded_sounds.find(load->name);
+        if (info) info->loading = false;
+    }
+
+    asset_loader.num_in_flight--;
+
+    delete [] load->name;
+    delete [] load->filepath;
+    delete load;
+}
+
+void update_asset_loads(s64 budget_nanoseconds) {
+    if (!asset_loader.num_in_flight) return;
+
+    profile_zone("update_asset_loads");
+
+    s64 start_time = get_time_nanoseconds();
+    for (;;) {
+        Asset_Load *load = take_finished_asset_load();
+        if (!load) break;
+
+        finish_asset_load(load);
+        if (get_time_nanoseconds() - start_time >= budget_nanoseconds) break;
+    }
+}
+
+void wait_for_asset_loads() {
+    while (asset_loader.num_in_flight) {
+        Asset_Load *load = take_finished_asset_load();
+        if (load) finish_asset_load(load);
+        else      SDL_SemWait(asset_loader.finished_semaphore);
+    }
+}
+
+int get_num_asset_loads_in_flight() {
+    return asset_loader.num_in_flight;
+}
+
+void shutdown_asset_loader() {
+    if (!asset_loader.started) return;
+
+    wait_for_asset_loads();
+
+    if (asset_loader.thread) {
+        SDL_LockMutex(asset_loader.mutex);
+        asset_loader.quit = true;
+        SDL_UnlockMutex(asset_loader.mutex);
+        SDL_SemPost(asset_loader.work_semaphore);
+
+        SDL_WaitThread(asset_loader.thread, NULL);
+    }
+
+    if (asset_loader.finished_semaphore) SDL_DestroySemaphore(asset_loader.finished_semaphore);
+    if (asset_loader.work_semaphore)     SDL_DestroySemaphore(asset_loader.work_semaphore);
+    if (asset_loader.mutex)              SDL_DestroyMutex(asset_loader.mutex);
+
+    asset_loader = {};
+}
+
 Texture *find_or_load_texture(char *name) {
     auto _info = loaded_textures.find(name);
-    if (_info) return (*_info).data;
+    if (_info) {
+        if ((*_info).loading) wait_for_asset_loads();
+        return (*_info).data;
+    }
 
 #ifdef USE_PACKAGE
     Package_Asset_Entry *entry = find_asset_by_name(&globals.package, name);
@@ -51,14 +318,61 @@ Texture *find_or_load_texture(char *name) {
     Resource_Info <Texture> info;
     info.name      = copy_string(name);
     info.data      = texture;
+    info.loading   = false;
+
+    loaded_textures.add(name, info);
+    return texture;
+}
+
+Texture *find_or_start_loading_texture(char *name) {
+    auto _info = loaded_textures.find(name);
+    if (_info) return (*_info).data;
+
+    Asset_Load *load;
+
+#ifdef USE_PACKAGE
+    Package_Asset_Entry *entry = find_asset_by_name(&globals.package, name);
+    if (!entry || entry->type != PACKAGE_ASSET_TEXTURE) {
+        logprintf("No texture '%s' found in asset package.\n", name);
+        return NULL;
+    }
+
+    load = make_asset_load(ASSET_LOAD_TEXTURE, name);
+    load->entry = entry;
+#else
+    char full_path[256];
+    snprintf(full_path, sizeof(full_path), "%s/%s.%s", texture_directory, name, texture_extension);
+    if (!file_exists(full_path)) {
+        logprintf("Unable to find file '%s' in '%s'!\n", name, texture_directory);
+        return NULL;
+    }
+
+    load = make_asset_load(ASSET_LOAD_TEXTURE, name);
+    load->filepath = copy_string(full_path);
+#endif
+
+    u8 transparent[4] = {};
+    Texture *texture = make_texture();
+    load_texture_from_data(texture, 1, 1, TEXTURE_FORMAT_RGBA8, transparent);
+
+    Resource_Info <Texture> info;
+    info.name      = copy_string(name);
+    info.data      = texture;
+    info.loading   = true;
 
     loaded_textures.add(name, info);
+
+    load->texture = texture;
+    queue_asset_load(load);
     return texture;
 }
 
 Sound *find_or_load_sound(char *name, bool is_looping) {
     auto _info = loaded_sounds.find(name);
-    if (_info) return (*_info).data;
+    if (_info) {
+        if ((*_info).loading) wait_for_asset_loads();
+        return (*_info).data;
+    }
 
 #ifdef USE_PACKAGE
     Package_Asset_Entry *entry = find_asset_by_name(&globals.package, name);
@@ -89,12 +403,76 @@ Sound *find_or_load_sound(char *name, bool is_looping) {
     Resource_Info <Sound> info;
     info.name      = copy_string(name);
     info.data      = sound;
+    info.loading   = false;
 
     loaded_sounds.add(name, info);
     return sound;
 }
 
+Sound *find_or_start_loading_sound(char *name, bool is_looping) {
+    auto _info = loaded_sounds.find(name);
+    if (_info) return (*_info).data;
+
+    Asset_Load *load;
+
+#ifdef USE_PACKAGE
+    Package_Asset_Entry *entry = find_asset_by_name(&globals.package, name);
+    if (!entry || entry->type != PACKAGE_ASSET_SOUND) {
+        logprintf("No sound '%s' found in asset package.\n", name);
+        return NULL;
+    }
+
+    is_looping = entry->is_looping;
+
+    load = make_asset_load(ASSET_LOAD_SOUND, name);
+    load->entry = entry;
+#else
+    char full_path[256];
+    snprintf(full_path, sizeof(full_path), "%s/%s.%s", sound_directory, name, sound_extension);
+    if (!file_exists(full_path)) {
+        logprintf("Unable to find file '%s' in '%s'!\n", name, sound_directory);
+        return NULL;
+    }
+
+    load = make_asset_load(ASSET_LOAD_SOUND, name);
+    load->filepath = copy_string(full_path);
+#endif
+
+    Sound *sound = make_sound(is_looping);
+
+    Resource_Info <Sound> info;
+    info.name      = copy_string(name);
+    info.data      = sound;
+    info.loading   = true;
+
+    loaded_sounds.add(name, info);
+
+    load->sound = sound;
+    queue_asset_load(load);
+    return sound;
+}
+
 void resource_manager_reset() {
+    wait_for_asset_loads();
+
+    for (int i = 0; i < loaded_textures.allocated; i++) {
+        if (!loaded_textures.occupancy_mask[i]) continue;
+
+        Resource_Info <Texture> *info = &loaded_textures.buckets[i].value;
+        release_texture(info->data);
+        free(info->data); // From make_texture.
+        delete [] info->name;
+    }
+
+    for (int i = 0; i < loaded_sounds.allocated; i++) {
+        if (!loaded_sounds.occupancy_mask[i]) continue;
+
+        Resource_Info <Sound> *info = &loaded_sounds.buckets[i].value;
+        free_sound(info->data);
+        delete info->data;
+        delete [] info->name;
+    }
+
     loaded_sounds.deallocate();
     loaded_textures.deallocate();
 }
@@ -8,4 +8,22 @@ Shader *find_or_load_shader(char *name);
 Texture *find_or_load_texture(char *name);
 Sound *find_or_load_sound(char *name, bool is_looping);
 
+// The same, except that they return straight away and the asset is loaded on
+// the asset loader thread, then filled in by update_asset_loads. Till then
+// the texture is a transparent 1x1 and the sound plays silence. They return
+// NULL only if there is no such asset. The blocking versions wait for an
+// asset that is already loading.
+Texture *find_or_start_loading_texture(char *name);
+Sound *find_or_start_loading_sound(char *name, bool is_looping);
+
+// Once a frame: fills in the handles whose loads have finished, uploading
+// textures, until budget_nanoseconds has gone (at least one, though).
+const s64 ASSET_LOAD_FRAME_BUDGET_NANOSECONDS = 2000000;
+void update_asset_loads(s64 budget_nanoseconds = ASSET_LOAD_FRAME_BUDGET_NANOSECONDS);
+void wait_for_asset_loads();
+int get_num_asset_loads_in_flight();
+void shutdown_asset_loader();
+
+// Frees every texture and sound loaded through here, which nothing may
+// still be using, playing or drawing.
 void resource_manager_reset();
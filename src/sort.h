@@ -0,0 +1,55 @@
+#pragma once
+
+#include "general.h"
+#include "array.h"
+
+#include <string.h>
+
+// Sorts items by a 64-bit key, least significant byte first, skipping bytes
+// that are the same in every key. Stable. scratch is grown to count and used
+// as the other buffer of each pass; get_key is called on an item and may be
+// called several times per item, so it should be cheap.
+template <typename T, typename Get_Key>
+void radix_sort_by_u64_key(T *items, int count, Array <T> *scratch, Get_Key get_key) {
+    if (count < 2) return;
+
+    scratch->reserve(count);
+    scratch->count = count;
+
+    T *from = items;
+    T *to   = scratch->data;
+
+    u64 all_or  = 0;
+    u64 all_and = ~0ULL;
+    for (int i = 0; i < count; i++) {
+        u64 key = get_key(items[i]);
+        all_or  |= key;
+        all_and &= key;
+    }
+
+    for (int shift = 0; shift < 64; shift += 8) {
+        if ((((all_or ^ all_and) >> shift) & 0xFF) == 0) continue;
+
+        int offsets[256] = {};
+        for (int i = 0; i < count; i++) {
+            offsets[(get_key(from[i]) >> shift) & 0xFF]++;
+        }
+
+        int total = 0;
+        for (int i = 0; i < 256; i++) {
+            int n = offsets[i];
+            offsets[i] = total;
+            total += n;
+        }
+
+        for (int i = 0; i < count; i++) {
+            to[offsets[(get_key(from[i]) >> shift) & 0xFF]++] = from[i];
+        }
+
+        T *swap = from;
+        from = to;
+        to   = swap;
+    }
+
+    if (from != items) memcpy(items, from, count * sizeof(T));
+}
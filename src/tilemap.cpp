@@ -3,8 +3,10 @@
 #include "text_file_handler.h"
 #include "rendering.h"
 #include "world.h"
+#include "camera.h"
 
 #include <stdio.h>
+#include <float.h>
 
 #define TILEMAP_FILE_VERSION 1
 
@@ -142,41 +144,156 @@ bool load_tilemap(Tilemap *tilemap, char *filepath) {
     tilemap->collidable_ids     = collidable_ids.copy_to_array();
 
     tilemap->tiles = tiles;
+
+    update_tilemap_collision(tilemap);
     
     return true;
 }
 
-void draw_tilemap(Tilemap *tilemap, World *world) {
-    float xpos = 0.0f;
-    float ypos = 0.0f;
-    
+void update_tilemap_collision(Tilemap *tilemap) {
+    memset(tilemap->collidable_id_bits, 0, sizeof(tilemap->collidable_id_bits));
+    for (int i = 0; i < tilemap->num_collidable_ids; i++) {
+        u8 id = tilemap->collidable_ids[i];
+        tilemap->collidable_id_bits[id / 64] |= 1ULL << (id % 64);
+    }
+
+    tilemap->outside_is_solid = is_tile_id_collidable(tilemap, 0);
+
+    int num_chunks = tilemap->num_chunks_x * tilemap->num_chunks_y;
+    for (int i = 0; i < num_chunks; i++) {
+        tilemap->chunks[i].dirty = true;
+    }
+
+    free_tilemap_collision(tilemap);
+
+    tilemap->solid_words_per_row = (tilemap->width + 63) / 64;
+    s64 num_words = (s64)tilemap->solid_words_per_row * tilemap->height;
+    tilemap->solid_bits = (u64 *)tracked_calloc(Max(num_words, 1), sizeof(u64), ALLOCATION_TAG_WORLD);
+    if (!tilemap->solid_bits) out_of_memory(Max(num_words, 1) * (s64)sizeof(u64));
+
     for (int y = 0; y < tilemap->height; y++) {
+        u64 *row = tilemap->solid_bits + (s64)y * tilemap->solid_words_per_row;
         for (int x = 0; x < tilemap->width; x++) {
+            if (is_tile_id_collidable(tilemap, tilemap->tiles[y * tilemap->width + x])) {
+                row[x / 64] |= 1ULL << (x % 64);
+            }
+        }
+    }
+}
+
+bool get_tilemap_chunks_in_rect(Tilemap *tilemap, Rectangle2 rect, int *x0, int *y0, int *x1, int *y1) {
+    int num_chunks_x = (tilemap->width  + TILEMAP_CHUNK_WIDTH  - 1) / TILEMAP_CHUNK_WIDTH;
+    int num_chunks_y = (tilemap->height + TILEMAP_CHUNK_HEIGHT - 1) / TILEMAP_CHUNK_HEIGHT;
+
+    *x0 = Max((int)floorf(rect.x / TILEMAP_CHUNK_WIDTH),  0);
+    *y0 = Max((int)floorf(rect.y / TILEMAP_CHUNK_HEIGHT), 0);
+    *x1 = Min((int)floorf((rect.x + rect.width)  / TILEMAP_CHUNK_WIDTH),  num_chunks_x - 1);
+    *y1 = Min((int)floorf((rect.y + rect.height) / TILEMAP_CHUNK_HEIGHT), num_chunks_y - 1);
+
+    return *x0 <= *x1 && *y0 <= *y1;
+}
+
+static void put_vertex(Immediate_Vertex *v, float x, float y, Vector4 color) {
+    *v = make_immediate_vertex(v2(x, y), color, v2(0, 0));
+}
+
+void build_tilemap_chunk_vertices(Tilemap *tilemap, int chunk_x, int chunk_y, Array <Immediate_Vertex> *vertices) {
+    vertices->count = 0;
+    vertices->reserve(TILEMAP_CHUNK_WIDTH * TILEMAP_CHUNK_HEIGHT * 6);
+
+    int x0 = chunk_x * TILEMAP_CHUNK_WIDTH;
+    int y0 = chunk_y * TILEMAP_CHUNK_HEIGHT;
+    int x1 = Min(x0 + TILEMAP_CHUNK_WIDTH,  tilemap->width);
+    int y1 = Min(y0 + TILEMAP_CHUNK_HEIGHT, tilemap->height);
+
+    for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++) {
             u8 tile_id = tilemap->tiles[y * tilemap->width + x];
-            if (tile_id > 0) {
-                assert(tile_id > 0 && tile_id <= tilemap->num_colors);
-                Vector4 color = tilemap->colors[tile_id - 1];
+            if (tile_id == 0) continue;
 
-                Vector2 screen_space_position = world_space_to_screen_space(world, v2(xpos, ypos));
-                Vector2 screen_space_size     = world_space_to_screen_space(world, v2(1, 1));
-                
-                immediate_quad(screen_space_position, screen_space_size, color);
-            }
+            assert(tile_id > 0 && tile_id <= tilemap->num_colors);
+            Vector4 color = tilemap->colors[tile_id - 1];
 
-            xpos += 1.0f;
+            Immediate_Vertex *v = vertices->data + vertices->count;
+            put_vertex(&v[0], (float)x,     (float)y,     color);
+            put_vertex(&v[1], (float)x + 1, (float)y,     color);
+            put_vertex(&v[2], (float)x + 1, (float)y + 1, color);
+            put_vertex(&v[3], (float)x,     (float)y,     color);
+            put_vertex(&v[4], (float)x + 1, (float)y + 1, color);
+            put_vertex(&v[5], (float)x,     (float)y + 1, color);
+            vertices->count += 6;
         }
-        ypos += 1.0f;
-        xpos = 0.0f;
     }
 }
 
-bool is_tile_id_collidable(Tilemap *tilemap, u8 tile_id) {
-    // TODO: Speed!!!
-    for (int i = 0; i < tilemap->num_collidable_ids; i++) {
-        if (tilemap->collidable_ids[i] == tile_id) return true;
+void free_tilemap_chunks(Tilemap *tilemap) {
+    if (!tilemap->chunks) return;
+
+    int num_chunks = tilemap->num_chunks_x * tilemap->num_chunks_y;
+    for (int i = 0; i < num_chunks; i++) {
+        if (tilemap->chunks[i].vertex_buffer) release_vertex_buffer(tilemap->chunks[i].vertex_buffer);
     }
 
-    return false;
+    delete [] tilemap->chunks;
+    tilemap->chunks = NULL;
+    tilemap->num_chunks_x = 0;
+    tilemap->num_chunks_y = 0;
+}
+
+void draw_tilemap(Tilemap *tilemap, World *world) {
+    profile_zone("draw_tilemap");
+
+    // Scratch for rebuilding chunks; only drawn from the main thread.
+    static Array <Immediate_Vertex> chunk_vertices;
+
+    if (!tilemap->chunks) {
+        tilemap->num_chunks_x = (tilemap->width  + TILEMAP_CHUNK_WIDTH  - 1) / TILEMAP_CHUNK_WIDTH;
+        tilemap->num_chunks_y = (tilemap->height + TILEMAP_CHUNK_HEIGHT - 1) / TILEMAP_CHUNK_HEIGHT;
+        tilemap->chunks = new Tilemap_Chunk[tilemap->num_chunks_x * tilemap->num_chunks_y];
+    }
+
+    int x0, y0, x1, y1;
+    if (!get_tilemap_chunks_in_rect(tilemap, get_visible_world_rect(world->camera, world), &x0, &y0, &x1, &y1)) return;
+
+    // Chunks are in tiles; scale them to screen space the way
+    // world_space_to_screen_space does.
+    immediate_flush();
+    Vector2 tile_size = world_space_to_screen_space(world, v2(1, 1));
+    globals.object_to_world_matrix = matrix4_identity();
+    globals.object_to_world_matrix._11 = tile_size.x;
+    globals.object_to_world_matrix._22 = tile_size.y;
+    refresh_transform();
+
+    for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++) {
+            Tilemap_Chunk *chunk = &tilemap->chunks[y * tilemap->num_chunks_x + x];
+
+            if (chunk->dirty) {
+                if (!chunk->vertex_buffer) chunk->vertex_buffer = make_vertex_buffer();
+
+                build_tilemap_chunk_vertices(tilemap, x, y, &chunk_vertices);
+                update_vertex_buffer(chunk->vertex_buffer, chunk_vertices.data, chunk_vertices.count);
+                chunk->dirty = false;
+            }
+
+            draw_vertex_buffer(chunk->vertex_buffer);
+        }
+    }
+
+    globals.object_to_world_matrix = matrix4_identity();
+    refresh_transform();
+}
+
+void free_tilemap_collision(Tilemap *tilemap) {
+    if (!tilemap->solid_bits) return;
+
+    tracked_free(tilemap->solid_bits);
+    tilemap->solid_bits = NULL;
+    tilemap->solid_words_per_row = 0;
+}
+
+bool is_tile_id_collidable(Tilemap *tilemap, u8 tile_id) {
+    return (tilemap->collidable_id_bits[tile_id / 64] >> (tile_id % 64)) & 1;
 }
 
 u8 get_tile_id_at(Tilemap *tilemap, Vector2 position) {
@@ -190,3 +307,203 @@ u8 get_tile_id_at(Tilemap *tilemap, Vector2 position) {
 
     return tilemap->tiles[iy * tilemap->width + ix];
 }
+
+bool is_cell_solid(Tilemap *tilemap, int x, int y) {
+    if (x < 0 || y < 0 || x >= tilemap->width || y >= tilemap->height) return tilemap->outside_is_solid;
+
+    u64 word = tilemap->solid_bits[(s64)y * tilemap->solid_words_per_row + x / 64];
+    return (word >> (x % 64)) & 1;
+}
+
+bool is_region_solid(Tilemap *tilemap, int x0, int y0, int x1, int y1) {
+    if (x0 > x1 || y0 > y1) return false;
+
+    if (x0 < 0 || y0 < 0 || x1 >= tilemap->width || y1 >= tilemap->height) {
+        if (tilemap->outside_is_solid) return true;
+
+        x0 = Max(x0, 0);
+        y0 = Max(y0, 0);
+        x1 = Min(x1, tilemap->width  - 1);
+        y1 = Min(y1, tilemap->height - 1);
+        if (x0 > x1 || y0 > y1) return false;
+    }
+
+    int first_word = x0 / 64;
+    int last_word  = x1 / 64;
+    u64 first_mask = ~0ULL << (x0 % 64);
+    u64 last_mask  = ~0ULL >> (63 - x1 % 64);
+
+    for (int y = y0; y <= y1; y++) {
+        u64 *row = tilemap->solid_bits + (s64)y * tilemap->solid_words_per_row;
+
+        if (first_word == last_word) {
+            if (row[first_word] & first_mask & last_mask) return true;
+            continue;
+        }
+
+        if (row[first_word] & first_mask) return true;
+        for (int w = first_word + 1; w < last_word; w++) {
+            if (row[w]) return true;
+        }
+        if (row[last_word] & last_mask) return true;
+    }
+
+    return false;
+}
+
+// Boxes within this of a cell boundary count as touching it, not overlapping
+// the cell, so a box stopped flush against a wall stays outside it whatever
+// the rounding.
+const float TILE_SWEEP_EPSILON = 1e-4f;
+
+// Far enough out that it is never inside a map and still fits in an int.
+const float TILE_SWEEP_LIMIT = 1e9f;
+
+static int first_cell_overlapped(float min) {
+    min = Max(-TILE_SWEEP_LIMIT, Min(min, TILE_SWEEP_LIMIT));
+    return (int)floorf(min + TILE_SWEEP_EPSILON);
+}
+
+static int last_cell_overlapped(float max) {
+    max = Max(-TILE_SWEEP_LIMIT, Min(max, TILE_SWEEP_LIMIT));
+    return (int)ceilf(max - TILE_SWEEP_EPSILON) - 1;
+}
+
+struct Sweep_Axis {
+    float velocity;  // Fraction of delta per unit of sweep time; 0 once blocked.
+    int leading;     // The furthest cell the leading edge is in.
+    int step;        // +1 or -1.
+};
+
+static void init_sweep_axis(Sweep_Axis *axis, float min, float size, float delta) {
+    axis->velocity = delta;
+    if (delta >= 0.0f) {
+        axis->step    = +1;
+        axis->leading = last_cell_overlapped(min + size);
+    } else {
+        axis->step    = -1;
+        axis->leading = first_cell_overlapped(min);
+    }
+}
+
+// Sweep time until the leading edge crosses into the next cell.
+static float time_to_next_cell(Sweep_Axis *axis, float min, float size) {
+    if (axis->velocity == 0.0f) return FLT_MAX;
+
+    float time;
+    if (axis->step > 0) time = ((float)(axis->leading + 1) - (min + size)) / axis->velocity;
+    else                time = (min - (float)axis->leading) / -axis->velocity;
+    return Max(time, 0.0f);
+}
+
+// Whether the bounding box of the whole move is empty, which takes a few word
+// tests per row.
+static bool is_move_clear(Tilemap *tilemap, Vector2 start, Vector2 end, Vector2 size) {
+    int x0 = first_cell_overlapped(Min(start.x, end.x));
+    int y0 = first_cell_overlapped(Min(start.y, end.y));
+    int x1 = last_cell_overlapped(Max(start.x, end.x) + size.x);
+    int y1 = last_cell_overlapped(Max(start.y, end.y) + size.y);
+    return !is_region_solid(tilemap, x0, y0, x1, y1);
+}
+
+// Outside the map is empty unless tile 0 is collidable, so once the box is
+// past the edge and still heading away there is nothing left to hit.
+static bool has_left_tilemap(Tilemap *tilemap, Sweep_Axis *x_axis, Sweep_Axis *y_axis, Vector2 p, Vector2 size) {
+    if (tilemap->outside_is_solid) return false;
+
+    if (x_axis->velocity >= 0.0f && first_cell_overlapped(p.x) >= tilemap->width)  return true;
+    if (x_axis->velocity <= 0.0f && last_cell_overlapped(p.x + size.x) < 0)        return true;
+    if (y_axis->velocity >= 0.0f && first_cell_overlapped(p.y) >= tilemap->height) return true;
+    if (y_axis->velocity <= 0.0f && last_cell_overlapped(p.y + size.y) < 0)        return true;
+    return false;
+}
+
+// The cells the box covers across the other axis, counting the one its
+// leading edge has just entered even if it is only touching it.
+static void get_covered_cells(Sweep_Axis *axis, float min, float size, int *first, int *last) {
+    *first = first_cell_overlapped(min);
+    *last  = last_cell_overlapped(min + size);
+    if (axis->velocity > 0.0f) *last  = Max(*last, axis->leading);
+    if (axis->velocity < 0.0f) *first = Min(*first, axis->leading);
+}
+
+Tile_Sweep sweep_box_through_tilemap(Tilemap *tilemap, Vector2 position, Vector2 size, Vector2 delta, int max_steps) {
+    Tile_Sweep result;
+    result.position = position;
+
+    // Most moves cross nothing solid at all.
+    if (is_move_clear(tilemap, position, position + delta, size)) {
+        result.position = position + delta;
+        return result;
+    }
+
+    Sweep_Axis x_axis, y_axis;
+    init_sweep_axis(&x_axis, position.x, size.x, delta.x);
+    init_sweep_axis(&y_axis, position.y, size.y, delta.y);
+
+    Vector2 p = position;
+    float time = 0.0f;
+    bool is_clear = false;
+
+    while (true) {
+        float tx = time_to_next_cell(&x_axis, p.x, size.x);
+        float ty = time_to_next_cell(&y_axis, p.y, size.y);
+        float dt = Min(tx, ty);
+
+        if (is_clear || time + dt >= 1.0f || has_left_tilemap(tilemap, &x_axis, &y_axis, p, size)) {
+            p.x += x_axis.velocity * (1.0f - time);
+            p.y += y_axis.velocity * (1.0f - time);
+            break;
+        }
+
+        if (result.num_steps >= max_steps) {
+            result.ran_out_of_steps = true;
+            break;
+        }
+        result.num_steps++;
+
+        p.x += x_axis.velocity * dt;
+        p.y += y_axis.velocity * dt;
+        time += dt;
+
+        // On a tie the column goes first, so a box moving diagonally into a
+        // corner checks the corner cell when it then crosses the row.
+        if (tx <= ty) {
+            int next = x_axis.leading + x_axis.step;
+
+            int first_row, last_row;
+            get_covered_cells(&y_axis, p.y, size.y, &first_row, &last_row);
+
+            if (is_region_solid(tilemap, next, first_row, next, last_row)) {
+                p.x = x_axis.step > 0 ? (float)next - size.x : (float)(next + 1);
+                x_axis.velocity = 0.0f;
+                result.hit_x = true;
+
+                // What is left is a straight slide along y, often into open space.
+                Vector2 end = v2(p.x, p.y + y_axis.velocity * (1.0f - time));
+                is_clear = is_move_clear(tilemap, p, end, size);
+            } else {
+                x_axis.leading = next;
+            }
+        } else {
+            int next = y_axis.leading + y_axis.step;
+
+            int first_column, last_column;
+            get_covered_cells(&x_axis, p.x, size.x, &first_column, &last_column);
+
+            if (is_region_solid(tilemap, first_column, next, last_column, next)) {
+                p.y = y_axis.step > 0 ? (float)next - size.y : (float)(next + 1);
+                y_axis.velocity = 0.0f;
+                result.hit_y = true;
+
+                Vector2 end = v2(p.x + x_axis.velocity * (1.0f - time), p.y);
+                is_clear = is_move_clear(tilemap, p, end, size);
+            } else {
+                y_axis.leading = next;
+            }
+        }
+    }
+
+    result.position = p;
+    return result;
+}
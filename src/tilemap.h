@@ -1,6 +1,19 @@
 #pragma once
 
 struct World;
+struct Vertex_Buffer;
+struct Immediate_Vertex;
+
+// Tiles are drawn from static vertex buffers, one per chunk of this many
+// tiles, built the first time a chunk is drawn and again only after the
+// tiles change. Chunks outside the camera's view are skipped.
+const int TILEMAP_CHUNK_WIDTH  = 32;
+const int TILEMAP_CHUNK_HEIGHT = 18;
+
+struct Tilemap_Chunk {
+    Vertex_Buffer *vertex_buffer = NULL;
+    bool dirty = true;
+};
 
 struct Tilemap {
     int width = 0;
@@ -13,10 +26,57 @@ struct Tilemap {
     u8 *collidable_ids = NULL;
 
     u8 *tiles = NULL;
+
+    // Built from the above by update_tilemap_collision. One bit per tile id,
+    // and one bit per cell, rows padded to whole words, bit x % 64 of word
+    // x / 64 for column x.
+    u64 collidable_id_bits[4] = {};
+    int solid_words_per_row = 0;
+    u64 *solid_bits = NULL;
+    bool outside_is_solid = false; // Outside the map reads as tile 0.
+
+    int num_chunks_x = 0;
+    int num_chunks_y = 0;
+    Tilemap_Chunk *chunks = NULL; // Made on first draw.
 };
 
 bool load_tilemap(Tilemap *tilemap, char *filepath);
 void draw_tilemap(Tilemap *tilemap, World *world);
 
+// Call after changing tiles or collidable_ids; also marks every chunk for
+// rebuilding.
+void update_tilemap_collision(Tilemap *tilemap);
+void free_tilemap_collision(Tilemap *tilemap);
+void free_tilemap_chunks(Tilemap *tilemap);
+
+// The chunks overlapping rect, as an inclusive range; false if none do.
+bool get_tilemap_chunks_in_rect(Tilemap *tilemap, Rectangle2 rect, int *x0, int *y0, int *x1, int *y1);
+// The chunk's tiles as world-space triangles, one unit per tile.
+void build_tilemap_chunk_vertices(Tilemap *tilemap, int chunk_x, int chunk_y, Array <Immediate_Vertex> *vertices);
+
 bool is_tile_id_collidable(Tilemap *tilemap, u8 tile_id);
 u8 get_tile_id_at(Tilemap *tilemap, Vector2 position);
+
+bool is_cell_solid(Tilemap *tilemap, int x, int y);
+// True if any cell in [x0, x1] x [y0, y1] (inclusive) is solid.
+bool is_region_solid(Tilemap *tilemap, int x0, int y0, int x1, int y1);
+
+// A sweep visits at most this many cell boundaries; past that the box stops
+// where it got to rather than risk going through something.
+const int MAX_TILE_SWEEP_STEPS = 1024;
+
+struct Tile_Sweep {
+    Vector2 position; // Where the box ends up.
+    bool hit_x = false;
+    bool hit_y = false;
+    bool ran_out_of_steps = false;
+    int num_steps = 0;
+};
+
+// Moves the box with bottom-left corner at position by delta, stopping
+// flush against the first solid cell on each axis and sliding along the
+// other. Only the columns and rows the box's leading edges cross are looked
+// at, in the order they are crossed, so nothing is skipped however large
+// delta is. Cells the box already overlaps don't block it, so it can always
+// move out of them.
+Tile_Sweep sweep_box_through_tilemap(Tilemap *tilemap, Vector2 position, Vector2 size, Vector2 delta, int max_steps = MAX_TILE_SWEEP_STEPS);
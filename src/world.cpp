@@ -7,6 +7,9 @@
 #include "font.h"
 #include "text_file_handler.h"
 #include "particles.h"
+#include "broadphase.h"
+#include "jobs.h"
+#include "render_queue.h"
 
 #include "mt19937-64.h"
 
@@ -16,7 +19,22 @@
 
 static void register_entity(World *world, Entity *e, Entity_Type type);
 
+// Takes a slot from the pool and, if given a source, copies it in. The slot's
+// own handle is kept either way; hot fields are left to the caller.
+template <typename T, typename Hot>
+static T *add_to_pool(Pool <T, Hot> *pool, T *source = NULL) {
+    allocation_tag(ALLOCATION_TAG_ENTITIES);
+
+    Pool_Handle handle;
+    T *result = pool->add(&handle);
+    if (source) *result = *source;
+    result->pool_handle = handle;
+    return result;
+}
+
 void init_world(World *world, Vector2i size) {
+    allocation_tag(ALLOCATION_TAG_WORLD);
+
     unsigned long long init[] = {(u64)size.x, (u64)size.y};
     init_by_array64(init, ArrayCount(init));
 
@@ -25,25 +43,100 @@ void init_world(World *world, Vector2i size) {
 
     world->particle_system = new Particle_System();
     world->particle_system->particles.reserve(1024);
+
+    world->broadphase = new Broadphase();
+    init_broadphase(world->broadphase, size.x, size.y);
+
+    // Enemies only start firing once the level is running, so the first
+    // projectile would otherwise grow the pool mid-game.
+    world->by_type._Projectile.reserve(1);
+    world->entities_to_be_destroyed.reserve(256);
+}
+
+static bool should_update_in_parallel(int count) {
+    return globals.parallel_world_update && count >= 2 * globals.world_update_batch_size;
+}
+
+// Runs update_proc (update_enemies or update_projectiles) over the pool's
+// slots across the job threads. Side effects go into one command buffer per
+// batch, applied in batch order afterwards, so the result matches the serial
+// sweep exactly. Returns how many were updated.
+template <typename T, typename Hot, typename Update_Proc>
+static int update_pool_in_parallel(World *world, Pool <T, Hot> *pool, float dt, Update_Proc update_proc) {
+    int batch_size  = globals.world_update_batch_size;
+    int num_batches = (pool->num_slots + batch_size - 1) / batch_size;
+    while (world->command_buffers.count < num_batches) {
+        world->command_buffers.add(new Entity_Commands());
+    }
+
+    parallel_for(pool->num_slots, batch_size, [&](int batch_index, int begin, int end) {
+        Entity_Commands *commands = world->command_buffers.data[batch_index];
+        commands->num_updated += update_proc(world, begin, end, dt, commands);
+    });
+
+    int num_updated = 0;
+    for (int i = 0; i < num_batches; i++) {
+        Entity_Commands *commands = world->command_buffers[i];
+        num_updated += commands->num_updated;
+        apply_entity_commands(world, commands);
+    }
+
+    return num_updated;
+}
+
+// Called at the start of every tick; drawing blends from these to where
+// the tick leaves things.
+static void save_previous_positions(World *world) {
+    for (Entity *e : world->all_entities) {
+        e->previous_position     = get_position(e);
+        e->has_previous_position = true;
+    }
+
+    if (world->camera) {
+        world->camera->previous_position = world->camera->position;
+        world->camera->previous_zoom     = world->camera->zoom;
+    }
 }
 
 void update_world(World *world, float dt) {
+    profile_zone("update_world");
+    allocation_tag(ALLOCATION_TAG_WORLD);
+
+    save_previous_positions(world);
+
     bool camera_intro = false;
     if (world && world->camera && world->camera->intro_active) camera_intro = true;
+
+    World_Update_Stats *stats = &world->update_stats;
+    *stats = {};
     
     if (!world->level_intro && !camera_intro) {
-        for (Enemy *enemy : world->by_type._Enemy) {
-            if (enemy->scheduled_for_destruction) continue;
-
-            update_single_enemy(enemy, dt);
+        s64 start_time = get_time_nanoseconds();
+        if (should_update_in_parallel(world->by_type._Enemy.count)) {
+            stats->num_enemies_updated = update_pool_in_parallel(world, &world->by_type._Enemy, dt, update_enemies);
+        } else {
+            stats->num_enemies_updated = update_enemies(world, 0, world->by_type._Enemy.num_slots, dt);
         }
-
-        for (Projectile *projectile : world->by_type._Projectile) {
-            if (projectile->scheduled_for_destruction) continue;
-
-            update_single_projectile(projectile, dt);
+        s64 end_time = get_time_nanoseconds();
+        stats->enemy_nanoseconds = end_time - start_time;
+
+        start_time = end_time;
+        if (should_update_in_parallel(world->by_type._Projectile.count)) {
+            stats->num_projectiles_updated = update_pool_in_parallel(world, &world->by_type._Projectile, dt, update_projectiles);
+        } else {
+            stats->num_projectiles_updated = update_projectiles(world, 0, world->by_type._Projectile.num_slots, dt);
         }
+        end_time = get_time_nanoseconds();
+        stats->projectile_nanoseconds = end_time - start_time;
+
+        // Movers were re-filed as they went; file whatever got made this tick
+        // before the hero looks around.
+        start_time = end_time;
+        sync_broadphase(world->broadphase);
+        end_time = get_time_nanoseconds();
+        stats->broadphase_nanoseconds = end_time - start_time;
     
+        start_time = end_time;
         if (world->by_type._Hero) {
             if (!world->by_type._Hero->scheduled_for_destruction) {
                 update_single_hero(world->by_type._Hero, dt);
@@ -57,6 +150,7 @@ void update_world(World *world, float dt) {
                 }
             }
         }
+        stats->hero_nanoseconds = get_time_nanoseconds() - start_time;
     }
         
     if (world->level_fade.active) {
@@ -75,50 +169,68 @@ void update_world(World *world, float dt) {
     }
 
     if (!world->level_intro && !camera_intro) {
-        update_particles(world->particle_system, dt);
+        s64 start_time = get_time_nanoseconds();
+        stats->num_particles_updated = world->particle_system->particles.count;
+        if (should_update_in_parallel(world->particle_system->particles.count)) {
+            update_particles_in_parallel(world->particle_system, dt, globals.world_update_batch_size);
+        } else {
+            update_particles(world->particle_system, dt);
+        }
+        s64 end_time = get_time_nanoseconds();
+        stats->particle_nanoseconds = end_time - start_time;
         
-        // Is it safe to do this here???
-        for (Entity *e : world->entities_to_be_destroyed) {
-            int index = world->all_entities.find(e);
-            if (index != -1) {
-                world->all_entities.ordered_remove_by_index(index);
-            }
+        start_time = end_time;
+        stats->num_entities_destroyed = world->entities_to_be_destroyed.count;
+        destroy_scheduled_entities(world);
+        stats->destruction_nanoseconds = get_time_nanoseconds() - start_time;
+    }
+}
 
-            for (int i = 0; i < world->entity_lookup.allocated; i++) {
-                auto bucket = &world->entity_lookup.buckets[i];
-                if (bucket->key == e->id && bucket->value == e) {
-                    world->entity_lookup.occupancy_mask[i] = false;
-                    break;
-                }
-            }
-            world->entity_lookup.count--;
+void destroy_scheduled_entities(World *world) {
+    // Everything here is O(1) per entity: all_entities is swap-removed using
+    // the stored index, the lookup does a real remove, and pools free by handle.
+    for (Entity *e : world->entities_to_be_destroyed) {
+        int index = e->all_entities_index;
+        assert(index >= 0 && index < world->all_entities.count);
+        assert(world->all_entities[index] == e);
+
+        world->all_entities.unordered_remove_by_index(index);
+        if (index < world->all_entities.count) {
+            world->all_entities[index]->all_entities_index = index;
+        }
 
-            switch (e->type) {
-                case ENTITY_TYPE_HERO: {
-                    world->by_type._Hero = NULL;
-                } break;
+        world->entity_lookup.remove(e->id);
+        remove_from_broadphase(world->broadphase, e);
 
-                case ENTITY_TYPE_ENEMY: {
-                    world->by_type._Enemy.ordered_remove_by_value((Enemy *)e);
-                } break;
+        switch (e->type) {
+            case ENTITY_TYPE_HERO: {
+                world->by_type._Hero = NULL;
+                delete (Hero *)e;
+            } break;
 
-                case ENTITY_TYPE_PROJECTILE: {
-                    world->by_type._Projectile.ordered_remove_by_value((Projectile *)e);
-                } break;
+            case ENTITY_TYPE_ENEMY: {
+                world->by_type._Enemy.remove(e->pool_handle);
+            } break;
 
-                case ENTITY_TYPE_PICKUP: {
-                    world->by_type._Pickup.ordered_remove_by_value((Pickup *)e);
-                } break;
+            case ENTITY_TYPE_PROJECTILE: {
+                world->by_type._Projectile.remove(e->pool_handle);
+            } break;
 
-                case ENTITY_TYPE_DOOR: {
-                    world->by_type._Door = NULL;
-                } break;
-            }
+            case ENTITY_TYPE_PICKUP: {
+                world->by_type._Pickup.remove(e->pool_handle);
+            } break;
+
+            case ENTITY_TYPE_DOOR: {
+                world->by_type._Door = NULL;
+                delete (Door *)e;
+            } break;
 
-            delete e;
+            default: {
+                delete e;
+            } break;
         }
-        world->entities_to_be_destroyed.count = 0;
     }
+    world->entities_to_be_destroyed.count = 0;
 }
 
 static void draw_health(Vector2 position, Vector2 size) {
@@ -131,7 +243,6 @@ static void draw_health(Vector2 position, Vector2 size) {
     int full_hearts = (int)health;
     bool half_heart = (health - (double)full_hearts) >= 0.5;
 
-    set_shader(globals.shader_texture);
     for (int i = 0; i < max_hearts; i++) {
         Vector2 pos = v2(position.x + i * (size.x + 6), position.y);
         Texture *texture = NULL;
@@ -139,11 +250,7 @@ static void draw_health(Vector2 position, Vector2 size) {
         else if (i == full_hearts && half_heart) texture = globals.half_heart;
         else texture = globals.empty_heart;
 
-        set_texture(0, texture);
-        
-        immediate_begin();
-        immediate_quad(pos, size, v4(1, 1, 1, 1));
-        immediate_flush();
+        queue_quad(RENDER_LAYER_HUD, globals.shader_texture, texture, pos, size, v4(1, 1, 1, 1));
     }
 }
 
@@ -151,13 +258,8 @@ static void draw_pickups(Vector2 position, Vector2 size) {
     World *world = globals.current_world;
     if (!world) return;
     
-    set_shader(globals.shader_color);
-    
-    immediate_begin();
-    immediate_circle(position + size * 0.5f, size.y * 0.5f, v4(1, 1, 0, 1));
-    immediate_flush();
+    queue_circle(RENDER_LAYER_HUD, position + size * 0.5f, size.y * 0.5f, v4(1, 1, 0, 1));
 
-    set_shader(globals.shader_text);
     //int font_size = (int)(0.05f * globals.render_height);
     int font_size = (int)size.y;
     Dynamic_Font *font = get_font_at_size("Inconsolata-Regular", font_size);
@@ -171,21 +273,56 @@ static void draw_pickups(Vector2 position, Vector2 size) {
 static void draw_restarts(Vector2 position, Vector2 size) {
     if (!globals.current_world) return;
     
-    set_shader(globals.shader_texture);
     for (int i = 0; i < MAX_RESTARTS; i++) {
         Vector2 pos = v2(position.x + i * (size.x + 6), position.y);
         Texture *texture = globals.restart_available;
         if (i < globals.num_restarts_for_current_world) texture = globals.restart_taken;
         
-        set_texture(0, texture);
-        
-        immediate_begin();
-        immediate_quad(pos, size, v4(1, 1, 1, 1));
-        immediate_flush();
+        queue_quad(RENDER_LAYER_HUD, globals.shader_texture, texture, pos, size, v4(1, 1, 1, 1));
     }
 }
 
+void collect_visible_entities(World *world, Rectangle2 visible_rect, Array <Entity *> *results) {
+    // Filed by their current position but drawn between ticks, hence the margin.
+    const float INTERPOLATION_MARGIN = 1.0f;
+    Rectangle2 query_rect = visible_rect;
+    query_rect.x      -= INTERPOLATION_MARGIN;
+    query_rect.y      -= INTERPOLATION_MARGIN;
+    query_rect.width  += INTERPOLATION_MARGIN * 2.0f;
+    query_rect.height += INTERPOLATION_MARGIN * 2.0f;
+
+    u32 type_mask = Bit(ENTITY_TYPE_ENEMY) | Bit(ENTITY_TYPE_PROJECTILE) | Bit(ENTITY_TYPE_PICKUP);
+    query_broadphase(world->broadphase, query_rect, type_mask, results);
+
+    int num_visible = 0;
+    for (Entity *e : *results) {
+        if (e->scheduled_for_destruction) continue;
+        if (!are_rect_and_circle_colliding(visible_rect, get_draw_position(e), get_radius(e))) continue;
+        results->data[num_visible++] = e;
+    }
+    results->count = num_visible;
+}
+
+static void draw_visible_entities(World *world, Rectangle2 visible_rect) {
+    static Array <Entity *> visible;
+    collect_visible_entities(world, visible_rect, &visible);
+
+    for (Entity *e : visible) {
+        switch (e->type) {
+            case ENTITY_TYPE_ENEMY:      draw_single_enemy((Enemy *)e);           break;
+            case ENTITY_TYPE_PROJECTILE: draw_single_projectile((Projectile *)e); break;
+            case ENTITY_TYPE_PICKUP:     draw_single_pickup((Pickup *)e);         break;
+        }
+    }
+
+    s64 num_entities = world->by_type._Enemy.count + world->by_type._Projectile.count + world->by_type._Pickup.count;
+    render_stats.num_entities_drawn  += visible.count;
+    render_stats.num_entities_culled += num_entities - visible.count;
+}
+
 void draw_world(World *world, bool skip_hud) {
+    profile_zone("draw_world");
+
     clear_framebuffer(0.2f, 0.5f, 0.8f, 1.0f);
 
     set_shader(globals.shader_color);
@@ -200,24 +337,10 @@ void draw_world(World *world, bool skip_hud) {
     assert(world->tilemap);
     draw_tilemap(world->tilemap, world);
 
-    if (!skip_hud) {
-        for (Enemy *enemy : world->by_type._Enemy) {
-            if (enemy->scheduled_for_destruction) continue;
-        
-            draw_single_enemy(enemy);
-        }
-
-        for (Projectile *projectile : world->by_type._Projectile) {
-            if (projectile->scheduled_for_destruction) continue;
-
-            draw_single_projectile(projectile);
-        }
-
-        for (Pickup *pickup : world->by_type._Pickup) {
-            if (pickup->scheduled_for_destruction) continue;
+    Rectangle2 visible_rect = get_visible_world_rect(world->camera, world);
 
-            draw_single_pickup(pickup);
-        }
+    if (!skip_hud) {
+        draw_visible_entities(world, visible_rect);
 
         Door *door = world->by_type._Door;
         if (door && !door->scheduled_for_destruction) {
@@ -230,17 +353,12 @@ void draw_world(World *world, bool skip_hud) {
         draw_single_hero(hero);
     }
 
-    draw_particles(world->particle_system, world);
+    draw_particles(world->particle_system, world, visible_rect);
     
     immediate_flush();
-    
-    set_shader(globals.shader_text);
-    rendering_2d(globals.render_width, globals.render_height);
-
-    set_blend_mode(BLEND_MODE_ALPHA);
-    set_cull_mode(CULL_MODE_OFF);
-    set_depth_test_mode(DEPTH_TEST_OFF);
 
+    // The HUD is queued, so the hearts, icons and text go out a few draw
+    // calls in all.
     if (!skip_hud) {
         Vector2 screen_space_health_position = world_space_to_screen_space(world, v2(0, VIEW_AREA_HEIGHT - 1.0f));
         Vector2 screen_space_health_size = world_space_to_screen_space(world, v2(1, 1));
@@ -252,8 +370,6 @@ void draw_world(World *world, bool skip_hud) {
         screen_space_health_position.y -= screen_space_health_size.y;
         draw_restarts(screen_space_health_position, screen_space_health_size);
 
-        set_shader(globals.shader_text);
-
         if (!world->level_fade.active) {
             int font_size = (int)(0.08f * globals.render_height);
             Dynamic_Font *font = get_font_at_size("OpenSans-Regular", font_size);
@@ -265,8 +381,6 @@ void draw_world(World *world, bool skip_hud) {
         }
             
         if (world->level_fade.active) {
-            set_shader(globals.shader_text);
-            
             int font_size = (int)(0.15f * globals.render_height);
             Dynamic_Font *font = get_font_at_size("Inconsolata-Regular", font_size);
             float alpha = 1.0f;
@@ -281,6 +395,8 @@ void draw_world(World *world, bool skip_hud) {
             draw_text(font, text, x, y, color);
         }
     }
+
+    flush_render_queue();
 }
 
 void destroy_world(World *world) {
@@ -290,18 +406,27 @@ void destroy_world(World *world) {
     }
 
     if (world->tilemap) {
+        free_tilemap_collision(world->tilemap);
+        free_tilemap_chunks(world->tilemap);
         delete world->tilemap;
         world->tilemap = NULL;
     }
 
+    if (world->broadphase) {
+        deinit_broadphase(world->broadphase);
+        delete world->broadphase;
+        world->broadphase = NULL;
+    }
+
     world->num_pickups_needed_to_unlock_door = 0;
 
     world->entities_to_be_destroyed.deallocate();
 
-    for (int i = 0; i < world->all_entities.count; i++) {
-        delete world->all_entities[i];
-        world->all_entities[i] = NULL;
-    }
+    for (Entity_Commands *commands : world->command_buffers) delete commands;
+    world->command_buffers.deallocate();
+
+    if (world->by_type._Hero) delete world->by_type._Hero;
+    if (world->by_type._Door) delete world->by_type._Door;
     world->all_entities.deallocate();
 
     world->entity_lookup.deallocate();
@@ -341,12 +466,16 @@ static Tilemap *copy_tilemap(Tilemap *tilemap) {
         memcpy(result->collidable_ids, tilemap->collidable_ids, tilemap->num_collidable_ids * sizeof(u8));
     }
 
+    update_tilemap_collision(result);
+
     return result;
 }
 
 World *copy_world(World *world) {
     if (!world) return NULL;
     
+    allocation_tag(ALLOCATION_TAG_WORLD);
+
     World *result = new World();
     
     result->size = world->size;
@@ -366,6 +495,9 @@ World *copy_world(World *world) {
     result->particle_system = new Particle_System();
     result->particle_system->particles.reserve(128);
 
+    result->broadphase = new Broadphase();
+    init_broadphase(result->broadphase, result->size.x, result->size.y);
+
     result->all_entities.reserve(world->all_entities.count);
 
     auto clone_entity = [&](Entity *e) -> Entity * {
@@ -388,23 +520,38 @@ World *copy_world(World *world) {
             } break;
                 
             case ENTITY_TYPE_ENEMY: {
-                Enemy *en = new Enemy(*((Enemy *)e));
+                Enemy *en = add_to_pool(&result->by_type._Enemy, (Enemy *)e);
                 copy = en;
-                result->by_type._Enemy.add(en);
                 register_entity(result, en, ENTITY_TYPE_ENEMY);
+
+                int from_slot, to_slot;
+                Enemy_Fields *from = get_fields((Enemy *)e, &from_slot);
+                Enemy_Fields *to   = get_fields(en, &to_slot);
+                to->position[to_slot]                   = from->position[from_slot];
+                to->speed[to_slot]                      = from->speed[from_slot];
+                to->radius[to_slot]                     = from->radius[from_slot];
+                to->flags[to_slot]                      = from->flags[from_slot] & ~MOVER_SCHEDULED_FOR_DESTRUCTION;
+                to->time_since_last_projectile[to_slot] = from->time_since_last_projectile[from_slot];
+                to->time_between_projectiles[to_slot]   = from->time_between_projectiles[from_slot];
             } break;
                 
             case ENTITY_TYPE_PROJECTILE: {
-                Projectile *p = new Projectile(*((Projectile *)e));
+                Projectile *p = add_to_pool(&result->by_type._Projectile, (Projectile *)e);
                 copy = p;
-                result->by_type._Projectile.add(p);
                 register_entity(result, p, ENTITY_TYPE_PROJECTILE);
+
+                int from_slot, to_slot;
+                Projectile_Fields *from = get_fields((Projectile *)e, &from_slot);
+                Projectile_Fields *to   = get_fields(p, &to_slot);
+                to->position[to_slot] = from->position[from_slot];
+                to->speed[to_slot]    = from->speed[from_slot];
+                to->radius[to_slot]   = from->radius[from_slot];
+                to->flags[to_slot]    = from->flags[from_slot] & ~MOVER_SCHEDULED_FOR_DESTRUCTION;
             } break;
                 
             case ENTITY_TYPE_PICKUP: {
-                Pickup *p = new Pickup(*((Pickup *)e));
+                Pickup *p = add_to_pool(&result->by_type._Pickup, (Pickup *)e);
                 copy = p;
-                result->by_type._Pickup.add(p);
                 register_entity(result, p, ENTITY_TYPE_PICKUP);
             } break;
                 
@@ -427,6 +574,12 @@ World *copy_world(World *world) {
     return result;
 }
 
+Vector2 get_draw_position(Entity *e) {
+    Vector2 position = get_position(e);
+    if (!e->has_previous_position) return position;
+    return lerp(e->previous_position, position, e->world->interpolation_alpha);
+}
+
 Vector2 world_space_to_screen_space(World *world, Vector2 v) {
     assert(world->size.x > 0);
     assert(world->size.y > 0);
@@ -457,6 +610,84 @@ Vector2 screen_space_to_world_space(World *world, Vector2 v) {
     return result;
 }
 
+static void hash_bytes(u64 *hash, void *data, s64 size) {
+    // FNV-1a
+    u8 *bytes = (u8 *)data;
+    for (s64 i = 0; i < size; i++) {
+        *hash ^= bytes[i];
+        *hash *= 0x100000001b3ULL;
+    }
+}
+
+#define HashValue(hash, value) hash_bytes(hash, &(value), sizeof(value))
+
+u64 get_world_state_hash(World *world) {
+    u64 hash = 0xcbf29ce484222325ULL;
+    if (!world) return hash;
+
+    HashValue(&hash, world->size);
+    HashValue(&hash, world->num_pickups_needed_to_unlock_door);
+
+    if (world->tilemap) {
+        hash_bytes(&hash, world->tilemap->tiles, world->tilemap->width * world->tilemap->height);
+    }
+
+    if (world->camera) {
+        HashValue(&hash, world->camera->position);
+        HashValue(&hash, world->camera->target);
+    }
+
+    for (Entity *e : world->all_entities) {
+        HashValue(&hash, e->type);
+        HashValue(&hash, e->id);
+        HashValue(&hash, e->scheduled_for_destruction);
+        Vector2 position = get_position(e);
+        HashValue(&hash, position);
+        HashValue(&hash, e->size);
+
+        switch (e->type) {
+            case ENTITY_TYPE_HERO: {
+                Hero *hero = (Hero *)e;
+                HashValue(&hash, hero->state);
+                HashValue(&hash, hero->velocity);
+                HashValue(&hash, hero->is_facing_right);
+                HashValue(&hash, hero->is_on_ground);
+                HashValue(&hash, hero->health);
+                HashValue(&hash, hero->num_pickups);
+                HashValue(&hash, hero->coin_flash_timer);
+            } break;
+
+            case ENTITY_TYPE_ENEMY: {
+                int slot;
+                Enemy_Fields *fields = get_fields((Enemy *)e, &slot);
+                bool is_facing_right = (fields->flags[slot] & MOVER_FACING_RIGHT) != 0;
+                HashValue(&hash, is_facing_right);
+                HashValue(&hash, fields->time_since_last_projectile[slot]);
+            } break;
+
+            case ENTITY_TYPE_PROJECTILE: {
+                int slot;
+                Projectile_Fields *fields = get_fields((Projectile *)e, &slot);
+                bool is_facing_right = (fields->flags[slot] & MOVER_FACING_RIGHT) != 0;
+                HashValue(&hash, is_facing_right);
+            } break;
+
+            case ENTITY_TYPE_DOOR: {
+                Door *door = (Door *)e;
+                HashValue(&hash, door->locked);
+            } break;
+        }
+    }
+
+    for (Particle p : world->particle_system->particles) {
+        HashValue(&hash, p.position);
+        HashValue(&hash, p.velocity);
+        HashValue(&hash, p.age);
+    }
+
+    return hash;
+}
+
 Entity *get_entity_by_id(World *world, u64 id) {
     Entity **_e = world->entity_lookup.find(id);
     if (!_e) return NULL;
@@ -474,6 +705,8 @@ static u64 generate_id(World *world) {
 }
 
 static void register_entity(World *world, Entity *e, Entity_Type type) {
+    allocation_tag(ALLOCATION_TAG_ENTITIES);
+
     u64 id = generate_id(world);
 
     e->id    = id;
@@ -482,10 +715,18 @@ static void register_entity(World *world, Entity *e, Entity_Type type) {
     e->scheduled_for_destruction = false;
 
     world->entity_lookup.add(id, e);
+    e->all_entities_index = world->all_entities.count;
     world->all_entities.add(e);
+
+    if (type == ENTITY_TYPE_ENEMY || type == ENTITY_TYPE_PROJECTILE || type == ENTITY_TYPE_PICKUP) {
+        e->broadphase_link = Broadphase_Link();
+        add_to_broadphase(world->broadphase, e);
+    }
 }
 
 Hero *make_hero(World *world) {
+    allocation_tag(ALLOCATION_TAG_ENTITIES);
+
     Hero *hero = new Hero();
 
     world->by_type._Hero = hero;
@@ -495,6 +736,8 @@ Hero *make_hero(World *world) {
 }
 
 Door *make_door(World *world) {
+    allocation_tag(ALLOCATION_TAG_ENTITIES);
+
     Door *door = new Door();
 
     world->by_type._Door = door;
@@ -504,27 +747,40 @@ Door *make_door(World *world) {
 }
 
 Enemy *make_enemy(World *world) {
-    Enemy *enemy = new Enemy();
+    Enemy *enemy = add_to_pool(&world->by_type._Enemy);
 
-    world->by_type._Enemy.add(enemy);
     register_entity(world, enemy, ENTITY_TYPE_ENEMY);
+
+    int slot;
+    Enemy_Fields *fields = get_fields(enemy, &slot);
+    fields->position[slot]                   = v2(0, 0);
+    fields->speed[slot]                      = 2.0f;
+    fields->radius[slot]                     = 0.5f;
+    fields->flags[slot]                      = MOVER_FACING_RIGHT;
+    fields->time_since_last_projectile[slot] = 0.0f;
+    fields->time_between_projectiles[slot]   = 3.0f;
     
     return enemy;
 }
 
 Projectile *make_projectile(World *world) {
-    Projectile *projectile = new Projectile();
+    Projectile *projectile = add_to_pool(&world->by_type._Projectile);
 
-    world->by_type._Projectile.add(projectile);
     register_entity(world, projectile, ENTITY_TYPE_PROJECTILE);
 
+    int slot;
+    Projectile_Fields *fields = get_fields(projectile, &slot);
+    fields->position[slot] = v2(0, 0);
+    fields->speed[slot]    = 5.0f;
+    fields->radius[slot]   = 0.5f;
+    fields->flags[slot]    = MOVER_FACING_RIGHT;
+
     return projectile;
 }
 
 Pickup *make_pickup(World *world) {
-    Pickup *pickup = new Pickup();
+    Pickup *pickup = add_to_pool(&world->by_type._Pickup);
 
-    world->by_type._Pickup.add(pickup);
     register_entity(world, pickup, ENTITY_TYPE_PICKUP);
 
     return pickup;
@@ -534,6 +790,16 @@ void schedule_for_destruction(Entity *entity) {
     World *world = entity->world;
     assert(world);
 
+    // The hero can take lethal damage twice in one tick; only queue it once.
+    if (entity->scheduled_for_destruction) return;
+    
     entity->scheduled_for_destruction = true;
     world->entities_to_be_destroyed.add(entity);
+
+    int slot;
+    if (entity->type == ENTITY_TYPE_ENEMY) {
+        get_fields((Enemy *)entity, &slot)->flags[slot] |= MOVER_SCHEDULED_FOR_DESTRUCTION;
+    } else if (entity->type == ENTITY_TYPE_PROJECTILE) {
+        get_fields((Projectile *)entity, &slot)->flags[slot] |= MOVER_SCHEDULED_FOR_DESTRUCTION;
+    }
 }
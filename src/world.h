@@ -11,15 +11,23 @@ struct Enemy;
 struct Projectile;
 struct Pickup;
 struct Door;
+struct Enemy_Fields;
+struct Projectile_Fields;
 
 struct Particle_System;
+struct Broadphase;
+struct Entity_Commands;
 
+// Enemies, projectiles and pickups come and go in large numbers, so they live
+// in pools instead of being allocated one by one. Iterating a pool yields
+// pointers, in slot order. Enemies and projectiles keep what their updates
+// sweep over in the pools' hot fields (see entity.h).
 struct Entities_By_Type {
     Hero *_Hero = NULL;
     Door *_Door = NULL;
-    Array <Enemy *> _Enemy;
-    Array <Projectile *> _Projectile;
-    Array <Pickup *> _Pickup;
+    Pool <Enemy, Enemy_Fields> _Enemy;
+    Pool <Projectile, Projectile_Fields> _Projectile;
+    Pool <Pickup> _Pickup;
 };
 
 struct Level_Fade {
@@ -29,12 +37,28 @@ struct Level_Fade {
     int level_number = 0;
 };
 
+// Filled by update_world every tick, so callers can see where the time went.
+struct World_Update_Stats {
+    s64 enemy_nanoseconds = 0;
+    s64 projectile_nanoseconds = 0;
+    s64 broadphase_nanoseconds = 0;
+    s64 hero_nanoseconds = 0;
+    s64 particle_nanoseconds = 0;
+    s64 destruction_nanoseconds = 0;
+
+    int num_enemies_updated = 0;
+    int num_projectiles_updated = 0;
+    int num_particles_updated = 0;
+    int num_entities_destroyed = 0;
+};
+
 struct World {
     Entities_By_Type by_type;
     Hash_Table <u64, Entity *> entity_lookup;
     Array <Entity *> all_entities;
 
     Array <Entity *> entities_to_be_destroyed;
+    Array <Entity_Commands *> command_buffers; // One per batch of a parallel update.
 
     int num_pickups_needed_to_unlock_door = 0;
     Level_Fade level_fade;
@@ -43,8 +67,15 @@ struct World {
     Tilemap *tilemap;
     Camera *camera;
     Particle_System *particle_system;
+    Broadphase *broadphase;
     
     Vector2i size;
+
+    // How far from the previous tick to the current one to draw things; set
+    // each frame from the fixed-step accumulator.
+    float interpolation_alpha = 1.0f;
+
+    World_Update_Stats update_stats;
 };
 
 void init_world(World *world, Vector2i size);
@@ -56,10 +87,23 @@ World *copy_world(World *world);
 bool load_world_from_file(World *world, char *filepath);
 
 Vector2 world_space_to_screen_space(World *world, Vector2 v);
+
+// The entity's position blended between its last two ticks.
+Vector2 get_draw_position(Entity *e);
 Vector2 screen_space_to_world_space(World *world, Vector2 v);
 
+// The enemies, projectiles and pickups drawn over visible_rect, found through
+// the broadphase grid so only the cells under the view get walked. In the
+// order the pools iterate: by type, then slot.
+void collect_visible_entities(World *world, Rectangle2 visible_rect, Array <Entity *> *results);
+
+// Hash of everything the simulation depends on, for checking that two runs
+// (a recording and its replay, say) ended up in exactly the same state.
+u64 get_world_state_hash(World *world);
+
 Entity *get_entity_by_id(World *world, u64 id);
 void schedule_for_destruction(Entity *entity);
+void destroy_scheduled_entities(World *world); // Called by update_world at the end of a tick.
 
 Hero *make_hero(World *world);
 Door *make_door(World *world);